@@ -12,7 +12,9 @@
 #include <freertos/semphr.h>
 #include <nvs_flash.h>
 #include <nvs.h>
+#include <esp_rom_crc.h>
 #include <ctime>
+#include <functional>
 #include <cJSON.h>
 
 static const char* TAG = "AlarmManager";
@@ -21,10 +23,16 @@ static const char* TAG = "AlarmManager";
 int AlarmManager::next_alarm_id_ = 1;
 
 #define NVS_NAMESPACE "alarms"
+#define ALARM_KEY_PREFIX "al_"           // 每个闹钟一条记录，键为 al_<id>
+#define ALARM_RECORD_VERSION 1
+#define ALARM_RECORD_HEADER_SIZE 12
+#define ALARM_MAX_DESC_LEN 1024
 #define MAX_ALARMS 20
-#define CHECK_INTERVAL_MS 10000   // 10秒检查一次，配合秒数容错确保闹钟触发
+#define ALARM_MAX_SLEEP_S 300          // 定时器最长间隔，用于发现未通知的时间跳变
+#define ALARM_TIMER_SLACK_US 200000     // 晚一点醒来，保证醒来时已到触发秒
 
-AlarmManager::AlarmManager() : check_timer_(nullptr), rtc_(nullptr), default_sound_type_(AlarmSoundType::NETWORK_MUSIC) {
+AlarmManager::AlarmManager() : fire_timer_(nullptr),
+    rtc_(nullptr), default_sound_type_(AlarmSoundType::NETWORK_MUSIC) {
     // 创建互斥锁
     alarms_mutex_ = xSemaphoreCreateMutex();
     if (alarms_mutex_ == nullptr) {
@@ -33,8 +41,9 @@ AlarmManager::AlarmManager() : check_timer_(nullptr), rtc_(nullptr), default_sou
 }
 
 AlarmManager::~AlarmManager() {
-    if (check_timer_ != nullptr) {
-        xTimerDelete(check_timer_, portMAX_DELAY);
+    if (fire_timer_ != nullptr) {
+        esp_timer_stop(fire_timer_);
+        esp_timer_delete(fire_timer_);
     }
     SaveAlarmsToNVS();
     
@@ -47,17 +56,16 @@ AlarmManager::~AlarmManager() {
 bool AlarmManager::Initialize() {
     ESP_LOGI(TAG, "Initializing AlarmManager");
     
-    // 创建定时检查定时器
-    check_timer_ = xTimerCreate(
-        "alarm_check",
-        pdMS_TO_TICKS(CHECK_INTERVAL_MS),
-        pdTRUE,  // 自动重载
-        this,
-        CheckTimerCallback
-    );
-    
-    if (check_timer_ == nullptr) {
-        ESP_LOGE(TAG, "Failed to create check timer");
+    // 创建单次触发定时器，每次只为最早的闹钟上弦
+    esp_timer_create_args_t fire_timer_args = {
+        .callback = FireTimerCallback,
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "alarm_fire",
+        .skip_unhandled_events = true
+    };
+    if (esp_timer_create(&fire_timer_args, &fire_timer_) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create fire timer");
         return false;
     }
     
@@ -70,11 +78,8 @@ bool AlarmManager::Initialize() {
         ESP_LOGI(TAG, "Initialize: Removed %d expired alarms on startup", removed_count);
     }
     
-    // 启动定时器
-    if (xTimerStart(check_timer_, 0) != pdPASS) {
-        ESP_LOGE(TAG, "Failed to start check timer");
-        return false;
-    }
+    // 建立触发索引并启动定时器
+    CheckAlarms(true);
     
     ESP_LOGI(TAG, "AlarmManager initialized successfully");
     return true;
@@ -124,6 +129,9 @@ int AlarmManager::SetAlarm(int hour, int minute, const std::string& description,
     if (xSemaphoreTake(alarms_mutex_, pdMS_TO_TICKS(1000)) == pdTRUE) {
         alarms_.push_back(alarm);
         SaveAlarmsToNVS();
+        time_t now = GetCurrentTimestamp();
+        ScheduleAlarmLocked(alarm, now);
+        ArmTimerLocked(now);
         xSemaphoreGive(alarms_mutex_);
         
         ESP_LOGI(TAG, "Alarm set successfully. ID: %d, Time: %02d:%02d, Description: %s", 
@@ -167,6 +175,8 @@ int AlarmManager::SetRelativeAlarm(int minutes_later, const std::string& descrip
     if (xSemaphoreTake(alarms_mutex_, pdMS_TO_TICKS(1000)) == pdTRUE) {
         alarms_.push_back(alarm);
         SaveAlarmsToNVS();
+        ScheduleAlarmLocked(alarm, now);
+        ArmTimerLocked(now);
         xSemaphoreGive(alarms_mutex_);
         
         ESP_LOGI(TAG, "Relative alarm set: %d minutes later at %02d:%02d - %s (ID: %d)", 
@@ -184,6 +194,11 @@ std::vector<AlarmInfo> AlarmManager::GetAllAlarms() {
 }
 
 bool AlarmManager::CancelAlarm(int alarm_id) {
+    if (xSemaphoreTake(alarms_mutex_, pdMS_TO_TICKS(1000)) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to acquire mutex in CancelAlarm");
+        return false;
+    }
+    
     auto it = std::find_if(alarms_.begin(), alarms_.end(),
         [alarm_id](const AlarmInfo& alarm) {
             return alarm.id == alarm_id;
@@ -193,17 +208,28 @@ bool AlarmManager::CancelAlarm(int alarm_id) {
         ESP_LOGI(TAG, "Canceling alarm ID: %d", alarm_id);
         alarms_.erase(it);
         SaveAlarmsToNVS();
+        schedule_.Unschedule(alarm_id);
+        ArmTimerLocked(GetCurrentTimestamp());
+        xSemaphoreGive(alarms_mutex_);
         return true;
     }
     
+    xSemaphoreGive(alarms_mutex_);
     ESP_LOGW(TAG, "Alarm ID %d not found", alarm_id);
     return false;
 }
 
 void AlarmManager::CancelAllAlarms() {
     ESP_LOGI(TAG, "Canceling all alarms");
+    if (xSemaphoreTake(alarms_mutex_, pdMS_TO_TICKS(1000)) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to acquire mutex in CancelAllAlarms");
+        return;
+    }
     alarms_.clear();
     SaveAlarmsToNVS();
+    schedule_.Rebuild(alarms_, 0);
+    ArmTimerLocked(GetCurrentTimestamp());
+    xSemaphoreGive(alarms_mutex_);
 }
 
 AlarmInfo AlarmManager::GetNextAlarm() {
@@ -213,105 +239,25 @@ AlarmInfo AlarmManager::GetNextAlarm() {
         return AlarmInfo{}; // 返回空的AlarmInfo
     }
     
+    // 直接取触发索引的堆顶，不再逐个闹钟重新计算
     AlarmInfo next_alarm;
-    time_t current_time;
-    
-    if (rtc_ && rtc_->GetTime(&current_time)) {
-        // 使用RTC时间
-    } else {
-        time(&current_time);
-    }
-    
-    struct tm current_tm;
-    localtime_r(&current_time, &current_tm);
-    
-    ESP_LOGI(TAG, "GetNextAlarm: Current time: %02d:%02d, checking %zu alarms", 
-             current_tm.tm_hour, current_tm.tm_min, alarms_.size());
-    
-    time_t closest_time = 0;
-    
-    for (const auto& alarm : alarms_) {
-        if (!alarm.enabled) continue;
-        
-        // 计算下一次触发时间
-        time_t next_trigger_time = 0;
-        
-        if (alarm.weekdays.empty()) {
-            // 一次性闹钟：检查今天是否还未到时间
-            struct tm alarm_tm = current_tm;
-            alarm_tm.tm_hour = alarm.hour;
-            alarm_tm.tm_min = alarm.minute;
-            alarm_tm.tm_sec = 0;
-            
-            time_t today_alarm_time = mktime(&alarm_tm);
-            if (today_alarm_time > current_time) {
-                next_trigger_time = today_alarm_time;
-            }
-        } else {
-            // 重复闹钟：检查每个星期几
-            for (int weekday : alarm.weekdays) {
-                struct tm alarm_tm = current_tm;
-                alarm_tm.tm_hour = alarm.hour;
-                alarm_tm.tm_min = alarm.minute;
-                alarm_tm.tm_sec = 0;
-                
-                // 计算到目标星期几的天数差
-                int days_diff = (weekday - current_tm.tm_wday + 7) % 7;
-                
-                // 如果是今天，检查时间是否已过
-                if (days_diff == 0) {
-                    time_t today_alarm_time = mktime(&alarm_tm);
-                    if (today_alarm_time <= current_time) {
-                        // 今天的时间已过，设置为下周同一天
-                        days_diff = 7;
-                    }
-                    // 如果今天的时间还没到，days_diff保持为0（今天）
-                } else if (days_diff > 0) {
-                    // 本周内的其他日期，直接使用计算出的天数差
-                    // days_diff已经正确，不需要修改
-                }
-                
-                // 设置正确的日期
-                alarm_tm.tm_mday += days_diff;
-                
-                // 规范化时间结构（处理月份、年份跨越）
-                time_t trigger_time = mktime(&alarm_tm);
-                
-                if (trigger_time == -1) {
-                    ESP_LOGW(TAG, "GetNextAlarm: mktime failed for alarm ID=%d, weekday=%d, days_diff=%d", 
-                             alarm.id, weekday, days_diff);
-                    continue;
-                }
-                
-                // 记录详细的计算过程，便于调试
-                struct tm debug_tm;
-                localtime_r(&trigger_time, &debug_tm);
-                ESP_LOGI(TAG, "GetNextAlarm: Alarm ID=%d, weekday=%d, days_diff=%d, trigger_time=%02d:%02d on %04d-%02d-%02d (wday=%d)", 
-                         alarm.id, weekday, days_diff, debug_tm.tm_hour, debug_tm.tm_min,
-                         debug_tm.tm_year + 1900, debug_tm.tm_mon + 1, debug_tm.tm_mday, debug_tm.tm_wday);
-                
-                // 找到最近的触发时间
-                if (next_trigger_time == 0 || trigger_time < next_trigger_time) {
-                    next_trigger_time = trigger_time;
-                    ESP_LOGI(TAG, "GetNextAlarm: Updated next_trigger_time for alarm ID=%d", alarm.id);
-                }
-            }
-        }
-        
-        // 比较所有闹钟，找到最早的
-        if (next_trigger_time > 0 && (closest_time == 0 || next_trigger_time < closest_time)) {
-            next_alarm = alarm;
-            closest_time = next_trigger_time;
-            ESP_LOGI(TAG, "GetNextAlarm: Found candidate alarm ID=%d, Time=%02d:%02d, Description='%s'", 
-                     alarm.id, alarm.hour, alarm.minute, alarm.description.c_str());
+    time_t fire_time;
+    int alarm_id;
+    if (schedule_.PeekNext(&fire_time, &alarm_id)) {
+        auto it = std::find_if(alarms_.begin(), alarms_.end(),
+            [alarm_id](const AlarmInfo& alarm) {
+                return alarm.id == alarm_id;
+            });
+        if (it != alarms_.end()) {
+            next_alarm = *it;
         }
     }
     
     if (next_alarm.id > 0) {
-        ESP_LOGI(TAG, "GetNextAlarm: Returning alarm ID=%d, Time=%02d:%02d", 
+        ESP_LOGD(TAG, "GetNextAlarm: Returning alarm ID=%d, Time=%02d:%02d", 
                  next_alarm.id, next_alarm.hour, next_alarm.minute);
     } else {
-        ESP_LOGI(TAG, "GetNextAlarm: No valid next alarm found");
+        ESP_LOGD(TAG, "GetNextAlarm: No valid next alarm found");
     }
     
     // 释放互斥锁
@@ -319,6 +265,21 @@ AlarmInfo AlarmManager::GetNextAlarm() {
     return next_alarm;
 }
 
+int AlarmManager::GetSecondsToNextAlarm() {
+    if (xSemaphoreTake(alarms_mutex_, pdMS_TO_TICKS(1000)) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to acquire mutex in GetSecondsToNextAlarm");
+        return -1;
+    }
+    time_t fire_time;
+    int alarm_id;
+    int seconds = -1;
+    if (schedule_.PeekNext(&fire_time, &alarm_id)) {
+        seconds = std::max<time_t>(fire_time - GetCurrentTimestamp(), 0);
+    }
+    xSemaphoreGive(alarms_mutex_);
+    return seconds;
+}
+
 std::string AlarmManager::GetCurrentTimeString() const {
     if (rtc_) {
         return rtc_->GetTimeString();
@@ -344,137 +305,46 @@ void AlarmManager::SetAlarmCallback(std::function<void(const AlarmInfo&)> callba
     alarm_callback_ = callback;
 }
 
-void AlarmManager::CheckAlarms() {
-    struct tm current_tm;
-    bool time_valid = false;
-    
-    // 防重复触发：记录上一次触发的时间和闹钟ID
-    static int last_triggered_hour = -1;
-    static int last_triggered_minute = -1;
-    static std::vector<int> last_triggered_ids;
+void AlarmManager::CheckAlarms(bool force_rebuild) {
+    time_t now = GetCurrentTimestamp();
+    int64_t mono_now = esp_timer_get_time();
     
-    // 使用TimeSyncManager的统一时间获取函数
-    auto& time_sync_manager = TimeSyncManager::GetInstance();
-    time_valid = time_sync_manager.GetUnifiedTime(&current_tm);
-    
-    if (!time_valid) {
-        ESP_LOGE(TAG, "Failed to get unified time for alarm check");
+    if (xSemaphoreTake(alarms_mutex_, pdMS_TO_TICKS(1000)) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to acquire mutex in CheckAlarms");
         return;
     }
     
-    // 如果时间改变了，清空上次触发的闹钟列表
-    if (last_triggered_hour != current_tm.tm_hour || last_triggered_minute != current_tm.tm_min) {
-        last_triggered_hour = current_tm.tm_hour;
-        last_triggered_minute = current_tm.tm_min;
-        last_triggered_ids.clear();
-        ESP_LOGD(TAG, "Time changed to %02d:%02d, cleared trigger history", 
-                 current_tm.tm_hour, current_tm.tm_min);
+    auto result = schedule_.Check(alarms_, now, mono_now, force_rebuild);
+    if (result.time_jump_s != 0) {
+        ESP_LOGW(TAG, "Time jumped by %lld seconds, rebuilt alarm schedule", (long long)result.time_jump_s);
     }
-    
-    // 每次检查都打印当前时间和闹钟状态，便于调试
-    ESP_LOGI(TAG, "CheckAlarms: Current time: %02d:%02d:%02d, weekday: %d, total alarms: %zu", 
-             current_tm.tm_hour, current_tm.tm_min, current_tm.tm_sec, current_tm.tm_wday, alarms_.size());
-    
-    // 打印每个闹钟的详细信息
-    for (size_t i = 0; i < alarms_.size(); i++) {
-        const auto& alarm = alarms_[i];
-        ESP_LOGI(TAG, "Alarm[%zu]: ID=%d, Time=%02d:%02d, Enabled=%s, Weekdays=%s, Desc='%s'", 
-                 i, alarm.id, alarm.hour, alarm.minute, 
-                 alarm.enabled ? "YES" : "NO",
-                 alarm.weekdays.empty() ? "Once" : "Repeat",
-                 alarm.description.c_str());
+    for (const auto& [alarm_id, late_s] : result.missed) {
+        ESP_LOGW(TAG, "Alarm ID=%d missed by %lld seconds, skipping", alarm_id, (long long)late_s);
     }
-    
-    // 在定时器任务中只检查触发条件，立即标记已触发避免重复
-    std::vector<int> triggered_alarm_ids;
-    
-    for (auto& alarm : alarms_) {
-        if (!alarm.enabled) {
-            ESP_LOGD(TAG, "Alarm ID=%d is disabled, skipping", alarm.id);
-            continue;
-        }
-        
-        // 详细的时间匹配检查
-        ESP_LOGD(TAG, "Checking alarm ID=%d: current=%02d:%02d:%02d vs alarm=%02d:%02d", 
-                 alarm.id, current_tm.tm_hour, current_tm.tm_min, current_tm.tm_sec, alarm.hour, alarm.minute);
-        
-        // 检查当前时间是否匹配闹钟时间（增加容错机制）
-        // 只要在闹钟时间的同一分钟内就认为匹配，避免因为检查间隔错过闹钟
-        if (current_tm.tm_hour != alarm.hour || current_tm.tm_min != alarm.minute) {
-            ESP_LOGV(TAG, "Alarm ID=%d time mismatch: %02d:%02d != %02d:%02d", 
-                     alarm.id, current_tm.tm_hour, current_tm.tm_min, alarm.hour, alarm.minute);
-            continue;
-        }
-        
-        ESP_LOGI(TAG, "Alarm ID=%d time matched! Now checking weekday...", alarm.id);
-        
-        // 防重复触发检查：如果这个闹钟在当前分钟已经触发过，跳过
-        if (std::find(last_triggered_ids.begin(), last_triggered_ids.end(), alarm.id) != last_triggered_ids.end()) {
-            ESP_LOGW(TAG, "Alarm ID=%d already triggered this minute, skipping", alarm.id);
-            continue;
-        }
-        
-        // 检查星期几匹配：如果weekdays为空（一次性闹钟），则总是匹配
-        bool weekday_matches = false;
-        if (alarm.weekdays.empty()) {
-            // 一次性闹钟，总是匹配
-            weekday_matches = true;
-            ESP_LOGI(TAG, "Alarm ID=%d is one-time alarm, weekday matches", alarm.id);
-        } else {
-            // 重复闹钟，检查当前星期几是否在列表中
-            ESP_LOGI(TAG, "Alarm ID=%d is recurring, checking weekdays. Current weekday: %d", 
-                     alarm.id, current_tm.tm_wday);
-            for (int weekday : alarm.weekdays) {
-                ESP_LOGD(TAG, "Checking weekday %d", weekday);
-                if (current_tm.tm_wday == weekday) {
-                    weekday_matches = true;
-                    ESP_LOGI(TAG, "Alarm ID=%d weekday matches! Current: %d, Target: %d", 
-                             alarm.id, current_tm.tm_wday, weekday);
-                    break;
-                }
-            }
-            if (!weekday_matches) {
-                ESP_LOGI(TAG, "Alarm ID=%d weekday does not match. Current: %d", 
-                         alarm.id, current_tm.tm_wday);
-            }
-        }
-        
-        if (!weekday_matches) continue;
-        
-        // 闹钟触发
+    for (int alarm_id : result.duplicates) {
+        ESP_LOGW(TAG, "Alarm ID=%d already triggered at this time, skipping", alarm_id);
+    }
+    for (const auto& alarm : result.triggered) {
         ESP_LOGI(TAG, "🔔 ALARM TRIGGERED! ID=%d, Time=%02d:%02d, Description='%s', Type=%s", 
                  alarm.id, alarm.hour, alarm.minute, alarm.description.c_str(),
                  alarm.weekdays.empty() ? "One-time" : "Recurring");
-        
-        // 添加到防重复触发列表
-        last_triggered_ids.push_back(alarm.id);
-        
+    }
+    
+    ArmTimerLocked(now);
+    xSemaphoreGive(alarms_mutex_);
+    
+    for (const auto& alarm : result.triggered) {
         if (alarm_callback_) {
             ESP_LOGI(TAG, "Calling alarm callback for ID=%d", alarm.id);
             alarm_callback_(alarm);
         } else {
             ESP_LOGW(TAG, "No alarm callback set! Alarm triggered but no handler available.");
         }
-        
-        // 检查是否已经在触发列表中，避免重复添加
-        if (std::find(triggered_alarm_ids.begin(), triggered_alarm_ids.end(), alarm.id) == triggered_alarm_ids.end()) {
-            triggered_alarm_ids.push_back(alarm.id);
-        }
-        
-        // 立即禁用一次性闹钟（weekdays为空的为一次性闹钟）
-        if (alarm.weekdays.empty()) {
-            alarm.enabled = false;
-            ESP_LOGI(TAG, "Disabled one-time alarm ID=%d", alarm.id);
-        }
-    }
-    
-    if (triggered_alarm_ids.empty()) {
-        ESP_LOGD(TAG, "No alarms triggered at %02d:%02d", current_tm.tm_hour, current_tm.tm_min);
     }
     
-    // 如果有闹钟触发，异步处理保存操作
-    if (!triggered_alarm_ids.empty()) {
-        auto* ids = new std::vector<int>(triggered_alarm_ids);
+    // 如果有一次性闹钟触发，异步处理删除和保存操作
+    if (!result.finished_ids.empty()) {
+        auto* ids = new std::vector<int>(result.finished_ids);
         xTaskCreate([](void* param) {
             auto* ids_ptr = static_cast<std::vector<int>*>(param);
             auto& manager = AlarmManager::GetInstance();
@@ -485,6 +355,41 @@ void AlarmManager::CheckAlarms() {
     }
 }
 
+void AlarmManager::OnTimeChanged() {
+    ESP_LOGI(TAG, "System time changed, rescheduling alarms");
+    CheckAlarms(true);
+}
+
+time_t AlarmManager::GetCurrentTimestamp() {
+    time_t now;
+    if (!TimeSyncManager::GetInstance().GetUnifiedTimestamp(&now)) {
+        time(&now);
+    }
+    return now;
+}
+
+void AlarmManager::ScheduleAlarmLocked(const AlarmInfo& alarm, time_t after) {
+    if (!schedule_.Schedule(alarm, after)) {
+        ESP_LOGW(TAG, "Alarm ID=%d has no valid trigger time", alarm.id);
+    }
+}
+
+void AlarmManager::ArmTimerLocked(time_t now) {
+    if (fire_timer_ == nullptr) {
+        return;
+    }
+    
+    int64_t delay_s = ALARM_MAX_SLEEP_S;
+    time_t fire_time;
+    int alarm_id;
+    if (now >= MIN_VALID_TIMESTAMP && schedule_.PeekNext(&fire_time, &alarm_id)) {
+        delay_s = std::min<int64_t>(std::max<int64_t>(fire_time - now, 0), ALARM_MAX_SLEEP_S);
+    }
+    
+    esp_timer_stop(fire_timer_);
+    esp_timer_start_once(fire_timer_, delay_s * 1000000 + ALARM_TIMER_SLACK_US);
+}
+
 void AlarmManager::ProcessTriggeredAlarms(const std::vector<int>& triggered_ids, time_t trigger_time) {
     ESP_LOGI(TAG, "ProcessTriggeredAlarms: Processing %d triggered alarms", triggered_ids.size());
     
@@ -525,99 +430,244 @@ bool AlarmManager::GetRtcTime(time_t* timestamp) const {
     return false;
 }
 
+// 单条闹钟记录（小端）：
+//   u8 version | u8 flags(bit0=enabled) | u8 hour | u8 minute | u8 weekdays(bit0=周日)
+//   u8 sound_type | u16 desc_len | i32 id | desc bytes | u32 crc32
+std::vector<uint8_t> AlarmManager::EncodeAlarmRecord(const AlarmInfo& alarm) {
+    size_t desc_len = std::min<size_t>(alarm.description.size(), ALARM_MAX_DESC_LEN);
+    // 截断时退回到UTF-8字符边界，不留下半个汉字
+    while (desc_len > 0 && desc_len < alarm.description.size() &&
+           (static_cast<uint8_t>(alarm.description[desc_len]) & 0xC0) == 0x80) {
+        desc_len--;
+    }
+    std::vector<uint8_t> record(ALARM_RECORD_HEADER_SIZE + desc_len + 4);
+    
+    uint8_t weekdays = 0;
+    for (int weekday : alarm.weekdays) {
+        if (weekday >= 0 && weekday <= 6) {
+            weekdays |= 1 << weekday;
+        }
+    }
+    
+    record[0] = ALARM_RECORD_VERSION;
+    record[1] = alarm.enabled ? 0x01 : 0x00;
+    record[2] = alarm.hour;
+    record[3] = alarm.minute;
+    record[4] = weekdays;
+    record[5] = static_cast<uint8_t>(alarm.sound_type);
+    record[6] = desc_len & 0xff;
+    record[7] = desc_len >> 8;
+    int32_t id = alarm.id;
+    memcpy(&record[8], &id, 4);
+    memcpy(&record[ALARM_RECORD_HEADER_SIZE], alarm.description.data(), desc_len);
+    
+    uint32_t crc = esp_rom_crc32_le(0, record.data(), record.size() - 4);
+    memcpy(&record[record.size() - 4], &crc, 4);
+    return record;
+}
+
+bool AlarmManager::DecodeAlarmRecord(const uint8_t* data, size_t size, AlarmInfo* alarm) {
+    if (size < ALARM_RECORD_HEADER_SIZE + 4 || data[0] != ALARM_RECORD_VERSION) {
+        return false;
+    }
+    size_t desc_len = data[6] | (data[7] << 8);
+    if (size != ALARM_RECORD_HEADER_SIZE + desc_len + 4) {
+        return false;
+    }
+    if (data[5] > static_cast<uint8_t>(AlarmSoundType::AI_MUSIC)) {
+        return false;
+    }
+    uint32_t crc;
+    memcpy(&crc, data + size - 4, 4);
+    if (crc != esp_rom_crc32_le(0, data, size - 4)) {
+        return false;
+    }
+    
+    int32_t id;
+    memcpy(&id, data + 8, 4);
+    alarm->id = id;
+    alarm->enabled = (data[1] & 0x01) != 0;
+    alarm->hour = data[2];
+    alarm->minute = data[3];
+    alarm->sound_type = static_cast<AlarmSoundType>(data[5]);
+    alarm->description.assign(reinterpret_cast<const char*>(data + ALARM_RECORD_HEADER_SIZE), desc_len);
+    
+    // 按周一到周日的顺序还原，与语音解析生成的顺序一致
+    alarm->weekdays.clear();
+    static const int kWeekdayOrder[] = {1, 2, 3, 4, 5, 6, 0};
+    for (int weekday : kWeekdayOrder) {
+        if (data[4] & (1 << weekday)) {
+            alarm->weekdays.push_back(weekday);
+        }
+    }
+    return IsValidTime(alarm->hour, alarm->minute);
+}
+
 void AlarmManager::LoadAlarmsFromNVS() {
     nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
     if (err != ESP_OK) {
         ESP_LOGW(TAG, "NVS open failed: %s", esp_err_to_name(err));
         return;
     }
     
+    int64_t start_time = esp_timer_get_time();
+    
     // 加载下一个ID
     int32_t saved_next_id = 1;
     if (nvs_get_i32(nvs_handle, "next_id", &saved_next_id) == ESP_OK) {
         next_alarm_id_ = saved_next_id;
+        saved_next_id_ = saved_next_id;
         ESP_LOGI(TAG, "Loaded next alarm ID: %d", next_alarm_id_);
     }
     
-    // 从JSON格式加载闹钟数据
-    size_t required_size = 0;
-    err = nvs_get_str(nvs_handle, "alarms_json", nullptr, &required_size);
-    
-    if (err == ESP_OK && required_size > 0) {
-        char* json_str = (char*)malloc(required_size);
-        if (json_str) {
-            err = nvs_get_str(nvs_handle, "alarms_json", json_str, &required_size);
-            if (err == ESP_OK) {
-                cJSON* json_array = cJSON_Parse(json_str);
-                if (json_array && cJSON_IsArray(json_array)) {
-                    alarms_.clear();
-                    
-                    int array_size = cJSON_GetArraySize(json_array);
-                    for (int i = 0; i < array_size; i++) {
-                        cJSON* alarm_obj = cJSON_GetArrayItem(json_array, i);
-                        if (alarm_obj) {
-                            AlarmInfo alarm;
-                            
-                            cJSON* id = cJSON_GetObjectItem(alarm_obj, "id");
-                            if (id && cJSON_IsNumber(id)) alarm.id = id->valueint;
-                            
-                            cJSON* desc = cJSON_GetObjectItem(alarm_obj, "description");
-                            if (desc && cJSON_IsString(desc)) alarm.description = desc->valuestring;
-                            
-                            cJSON* enabled = cJSON_GetObjectItem(alarm_obj, "enabled");
-                            if (enabled && cJSON_IsBool(enabled)) alarm.enabled = cJSON_IsTrue(enabled);
-                            
-                            cJSON* hour = cJSON_GetObjectItem(alarm_obj, "hour");
-                            if (hour && cJSON_IsNumber(hour)) alarm.hour = hour->valueint;
-                            
-                            cJSON* minute = cJSON_GetObjectItem(alarm_obj, "minute");
-                            if (minute && cJSON_IsNumber(minute)) alarm.minute = minute->valueint;
-                            
-                            cJSON* sound_type = cJSON_GetObjectItem(alarm_obj, "sound_type");
-                            if (sound_type && cJSON_IsNumber(sound_type)) {
-                                alarm.sound_type = static_cast<AlarmSoundType>(sound_type->valueint);
-                            } else {
-                                // 默认为网络音乐
-                                alarm.sound_type = AlarmSoundType::NETWORK_MUSIC;
-                            }
-                            
-                            cJSON* weekdays_array = cJSON_GetObjectItem(alarm_obj, "weekdays");
-                            if (weekdays_array && cJSON_IsArray(weekdays_array)) {
-                                alarm.weekdays.clear();
-                                int weekdays_size = cJSON_GetArraySize(weekdays_array);
-                                for (int j = 0; j < weekdays_size; j++) {
-                                    cJSON* weekday_obj = cJSON_GetArrayItem(weekdays_array, j);
-                                    if (weekday_obj && cJSON_IsNumber(weekday_obj)) {
-                                        alarm.weekdays.push_back(weekday_obj->valueint);
-                                    }
-                                }
-                            }
-                            
-                            alarms_.push_back(alarm);
-                        }
-                    }
-                    
-                    ESP_LOGI(TAG, "Loaded %zu alarms from NVS JSON", alarms_.size());
+    alarms_.clear();
+    saved_records_.clear();
+    
+    // 逐条读取二进制记录，校验失败的记录直接丢弃
+    std::vector<std::string> corrupted_keys;
+    std::vector<uint8_t> record;
+    nvs_iterator_t it = nullptr;
+    esp_err_t res = nvs_entry_find(NVS_DEFAULT_PART_NAME, NVS_NAMESPACE, NVS_TYPE_BLOB, &it);
+    while (res == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        if (strncmp(info.key, ALARM_KEY_PREFIX, strlen(ALARM_KEY_PREFIX)) == 0) {
+            size_t size = 0;
+            AlarmInfo alarm;
+            if (nvs_get_blob(nvs_handle, info.key, nullptr, &size) == ESP_OK) {
+                record.resize(size);
+                if (nvs_get_blob(nvs_handle, info.key, record.data(), &size) == ESP_OK &&
+                    DecodeAlarmRecord(record.data(), size, &alarm) &&
+                    AlarmRecordKey(alarm.id) == info.key) {
+                    saved_records_[alarm.id] = record;
+                    alarms_.push_back(alarm);
+                    next_alarm_id_ = std::max(next_alarm_id_, alarm.id + 1);
                 } else {
-                    ESP_LOGE(TAG, "Invalid JSON format in NVS");
+                    corrupted_keys.push_back(info.key);
                 }
-                
-                if (json_array) cJSON_Delete(json_array);
-            } else {
-                ESP_LOGE(TAG, "Failed to read alarms JSON from NVS: %s", esp_err_to_name(err));
             }
-            free(json_str);
-        } else {
-            ESP_LOGE(TAG, "Failed to allocate memory for JSON string");
-            err = ESP_ERR_NO_MEM;
         }
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGI(TAG, "No alarms found in NVS, starting fresh");
-        err = ESP_OK;  // 没有数据是正常的
+        res = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+    
+    for (const auto& key : corrupted_keys) {
+        ESP_LOGW(TAG, "Dropping corrupted alarm record %s", key.c_str());
+        nvs_erase_key(nvs_handle, key.c_str());
     }
+    if (!corrupted_keys.empty()) {
+        nvs_commit(nvs_handle);
+    }
+    
+    std::sort(alarms_.begin(), alarms_.end(), [](const AlarmInfo& a, const AlarmInfo& b) {
+        return a.id < b.id;
+    });
     
+    // 旧版本以JSON整体保存，读出后迁移到逐条记录
+    bool migrate = LoadAlarmsFromJson(nvs_handle);
     nvs_close(nvs_handle);
+    
+    if (migrate && SaveAlarmsToNVS()) {
+        if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
+            nvs_erase_key(nvs_handle, "alarms_json");
+            nvs_commit(nvs_handle);
+            nvs_close(nvs_handle);
+        }
+        ESP_LOGI(TAG, "Migrated %zu alarms from JSON to binary records", alarms_.size());
+    }
+    
+    ESP_LOGI(TAG, "Loaded %zu alarms from NVS in %lld us", alarms_.size(), esp_timer_get_time() - start_time);
+}
+
+bool AlarmManager::LoadAlarmsFromJson(nvs_handle_t nvs_handle) {
+    size_t required_size = 0;
+    esp_err_t err = nvs_get_str(nvs_handle, "alarms_json", nullptr, &required_size);
+    if (err != ESP_OK || required_size == 0) {
+        return false;
+    }
+    
+    char* json_str = (char*)malloc(required_size);
+    if (json_str == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate memory for JSON string");
+        return false;
+    }
+    err = nvs_get_str(nvs_handle, "alarms_json", json_str, &required_size);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read alarms JSON from NVS: %s", esp_err_to_name(err));
+        free(json_str);
+        return false;
+    }
+    
+    cJSON* json_array = cJSON_Parse(json_str);
+    if (json_array == nullptr || !cJSON_IsArray(json_array)) {
+        // 改名保留原始内容，避免每次启动都重复解析失败
+        ESP_LOGE(TAG, "Invalid JSON format in NVS, moving it to alarms_json_bad");
+        cJSON_Delete(json_array);
+        nvs_set_str(nvs_handle, "alarms_json_bad", json_str);
+        nvs_erase_key(nvs_handle, "alarms_json");
+        nvs_commit(nvs_handle);
+        free(json_str);
+        return false;
+    }
+    free(json_str);
+    
+    int array_size = cJSON_GetArraySize(json_array);
+    for (int i = 0; i < array_size; i++) {
+        cJSON* alarm_obj = cJSON_GetArrayItem(json_array, i);
+        if (alarm_obj == nullptr) {
+            continue;
+        }
+        AlarmInfo alarm;
+        
+        cJSON* id = cJSON_GetObjectItem(alarm_obj, "id");
+        if (id && cJSON_IsNumber(id)) alarm.id = id->valueint;
+        
+        cJSON* desc = cJSON_GetObjectItem(alarm_obj, "description");
+        if (desc && cJSON_IsString(desc)) alarm.description = desc->valuestring;
+        
+        cJSON* enabled = cJSON_GetObjectItem(alarm_obj, "enabled");
+        if (enabled && cJSON_IsBool(enabled)) alarm.enabled = cJSON_IsTrue(enabled);
+        
+        cJSON* hour = cJSON_GetObjectItem(alarm_obj, "hour");
+        if (hour && cJSON_IsNumber(hour)) alarm.hour = hour->valueint;
+        
+        cJSON* minute = cJSON_GetObjectItem(alarm_obj, "minute");
+        if (minute && cJSON_IsNumber(minute)) alarm.minute = minute->valueint;
+        
+        cJSON* sound_type = cJSON_GetObjectItem(alarm_obj, "sound_type");
+        if (sound_type && cJSON_IsNumber(sound_type) && sound_type->valueint >= 0 &&
+            sound_type->valueint <= static_cast<int>(AlarmSoundType::AI_MUSIC)) {
+            alarm.sound_type = static_cast<AlarmSoundType>(sound_type->valueint);
+        } else {
+            // 默认为网络音乐
+            alarm.sound_type = AlarmSoundType::NETWORK_MUSIC;
+        }
+        
+        cJSON* weekdays_array = cJSON_GetObjectItem(alarm_obj, "weekdays");
+        if (weekdays_array && cJSON_IsArray(weekdays_array)) {
+            int weekdays_size = cJSON_GetArraySize(weekdays_array);
+            for (int j = 0; j < weekdays_size; j++) {
+                cJSON* weekday_obj = cJSON_GetArrayItem(weekdays_array, j);
+                if (weekday_obj && cJSON_IsNumber(weekday_obj)) {
+                    alarm.weekdays.push_back(weekday_obj->valueint);
+                }
+            }
+        }
+        
+        // 已存在同ID的二进制记录时以二进制记录为准
+        bool exists = std::any_of(alarms_.begin(), alarms_.end(), [&alarm](const AlarmInfo& a) {
+            return a.id == alarm.id;
+        });
+        if (!exists) {
+            alarms_.push_back(alarm);
+            next_alarm_id_ = std::max(next_alarm_id_, alarm.id + 1);
+        }
+    }
+    cJSON_Delete(json_array);
+    
+    ESP_LOGI(TAG, "Loaded %d alarms from legacy NVS JSON", array_size);
+    return true;
 }
 
 bool AlarmManager::SaveAlarmsToNVS() {
@@ -628,55 +678,65 @@ bool AlarmManager::SaveAlarmsToNVS() {
         return false;
     }
     
-    // 序列化闹钟数据为JSON格式存储（避免std::string的内存布局问题）
-    cJSON* json_array = cJSON_CreateArray();
-    
+    // 只写入内容有变化的记录，删除已不存在的记录
+    size_t written_bytes = 0;
+    int changed = 0;
+    std::map<int, std::vector<uint8_t>> records;
     for (const auto& alarm : alarms_) {
-        cJSON* alarm_obj = cJSON_CreateObject();
-        cJSON_AddNumberToObject(alarm_obj, "id", alarm.id);
-        cJSON_AddStringToObject(alarm_obj, "description", alarm.description.c_str());
-        cJSON_AddNumberToObject(alarm_obj, "hour", alarm.hour);
-        cJSON_AddNumberToObject(alarm_obj, "minute", alarm.minute);
-        cJSON_AddBoolToObject(alarm_obj, "enabled", alarm.enabled);
-        cJSON_AddNumberToObject(alarm_obj, "sound_type", static_cast<int>(alarm.sound_type));
-        
-        // 添加weekdays数组
-        cJSON* weekdays_array = cJSON_CreateArray();
-        for (int weekday : alarm.weekdays) {
-            cJSON_AddItemToArray(weekdays_array, cJSON_CreateNumber(weekday));
+        auto record = EncodeAlarmRecord(alarm);
+        auto saved = saved_records_.find(alarm.id);
+        if (saved == saved_records_.end() || saved->second != record) {
+            err = nvs_set_blob(nvs_handle, AlarmRecordKey(alarm.id).c_str(), record.data(), record.size());
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to save alarm %d to NVS: %s", alarm.id, esp_err_to_name(err));
+                break;
+            }
+            written_bytes += record.size();
+            changed++;
         }
-        cJSON_AddItemToObject(alarm_obj, "weekdays", weekdays_array);
-        
-        cJSON_AddItemToArray(json_array, alarm_obj);
+        records[alarm.id] = std::move(record);
     }
     
-    char* json_str = cJSON_PrintUnformatted(json_array);
-    if (json_str) {
-        err = nvs_set_str(nvs_handle, "alarms_json", json_str);
-        if (err == ESP_OK) {
-            err = nvs_commit(nvs_handle);
-            if (err == ESP_OK) {
-                ESP_LOGI(TAG, "Saved %zu alarms to NVS as JSON", alarms_.size());
+    if (err == ESP_OK) {
+        for (const auto& saved : saved_records_) {
+            if (records.find(saved.first) == records.end()) {
+                esp_err_t ret = nvs_erase_key(nvs_handle, AlarmRecordKey(saved.first).c_str());
+                if (ret != ESP_OK && ret != ESP_ERR_NVS_NOT_FOUND) {
+                    err = ret;
+                    break;
+                }
+                changed++;
             }
-        } else {
-            ESP_LOGE(TAG, "Failed to save alarms JSON to NVS: %s", esp_err_to_name(err));
         }
-        cJSON_free(json_str);
-    } else {
-        ESP_LOGE(TAG, "Failed to serialize alarms to JSON");
-        err = ESP_FAIL;
     }
     
-    cJSON_Delete(json_array);
-    
     // 同时保存下一个ID
-    if (err == ESP_OK) {
-        nvs_set_i32(nvs_handle, "next_id", next_alarm_id_);
-        nvs_commit(nvs_handle);
+    if (err == ESP_OK && next_alarm_id_ != saved_next_id_) {
+        err = nvs_set_i32(nvs_handle, "next_id", next_alarm_id_);
+        written_bytes += sizeof(int32_t);
+        changed++;
     }
     
+    if (err == ESP_OK && changed > 0) {
+        err = nvs_commit(nvs_handle);
+    }
     nvs_close(nvs_handle);
-    return err == ESP_OK;
+    
+    if (err != ESP_OK) {
+        // 下次保存时全部重写
+        saved_records_.clear();
+        saved_next_id_ = 0;
+        return false;
+    }
+    
+    saved_records_ = std::move(records);
+    saved_next_id_ = next_alarm_id_;
+    ESP_LOGI(TAG, "Saved %zu alarms to NVS: %d changes, %zu bytes written", alarms_.size(), changed, written_bytes);
+    return true;
+}
+
+std::string AlarmManager::AlarmRecordKey(int alarm_id) {
+    return ALARM_KEY_PREFIX + std::to_string(alarm_id);
 }
 
 bool AlarmManager::ParseVoiceCommand(const std::string& command, int& hour, int& minute, 
@@ -838,8 +898,8 @@ bool AlarmManager::ParseAbsoluteTime(const std::string& time_str, int& hour, int
     return false;
 }
 
-void AlarmManager::CheckTimerCallback(TimerHandle_t timer) {
-    AlarmManager* manager = static_cast<AlarmManager*>(pvTimerGetTimerID(timer));
+void AlarmManager::FireTimerCallback(void* arg) {
+    AlarmManager* manager = static_cast<AlarmManager*>(arg);
     if (manager) {
         manager->CheckAlarms();
     }
@@ -926,6 +986,7 @@ int AlarmManager::RemoveExpiredAlarms() {
             (it->hour < current_hour || (it->hour == current_hour && it->minute <= current_minute))) {
             ESP_LOGI(TAG, "Removing expired one-time alarm: ID=%d, time=%02d:%02d", 
                      it->id, it->hour, it->minute);
+            schedule_.Unschedule(it->id);
             it = alarms_.erase(it);
             removed_count++;
         } else {
@@ -4,13 +4,18 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <map>
+#include <utility>
 #include <time.h>
+#include <esp_timer.h>
+#include <nvs.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/timers.h>
 #include <freertos/semphr.h>
 #include "pcf8563_rtc.h"
 #include "alarm_info.h"
+#include "alarm_schedule.h"
 
 // 闹钟管理器类
 class AlarmManager {
@@ -48,14 +53,20 @@ public:
     // 获取下一个闹钟
     AlarmInfo GetNextAlarm();
     
+    // 距离下一个闹钟触发的秒数，没有闹钟时返回 -1
+    int GetSecondsToNextAlarm();
+    
     // 获取当前时间字符串
     std::string GetCurrentTimeString() const;
     
     // 闹钟回调设置
     void SetAlarmCallback(std::function<void(const AlarmInfo&)> callback);
     
-    // 检查闹钟触发（内部调用）
-    void CheckAlarms();
+    // 检查闹钟触发（内部调用），force_rebuild 时按当前时间重建触发索引
+    void CheckAlarms(bool force_rebuild = false);
+    
+    // 系统时间被NTP/RTC校准或时区变化后调用，重新计算所有闹钟的下次触发时间
+    void OnTimeChanged();
     
     // 处理触发的闹钟（异步调用）
     void ProcessTriggeredAlarms(const std::vector<int>& triggered_ids, time_t trigger_time);
@@ -93,15 +104,27 @@ private:
     bool initialized_;
     std::vector<AlarmInfo> alarms_;
     static int next_alarm_id_;
-    TimerHandle_t check_timer_;
+    esp_timer_handle_t fire_timer_;  // 单次定时器，只为最早的闹钟上弦
+    AlarmSchedule schedule_;         // 触发索引，受 alarms_mutex_ 保护
     std::function<void(const AlarmInfo&)> alarm_callback_;
     Pcf8563Rtc* rtc_;
     AlarmSoundType default_sound_type_;
     SemaphoreHandle_t alarms_mutex_;  // 保护alarms_容器的互斥锁
     
+    // 上次写入NVS的记录，用于只写入有变化的闹钟
+    std::map<int, std::vector<uint8_t>> saved_records_;
+    int32_t saved_next_id_ = 0;
+    
     // 内部辅助方法
     void LoadAlarmsFromNVS();
-    static void CheckTimerCallback(TimerHandle_t timer);
+    bool LoadAlarmsFromJson(nvs_handle_t nvs_handle);
+    static std::vector<uint8_t> EncodeAlarmRecord(const AlarmInfo& alarm);
+    bool DecodeAlarmRecord(const uint8_t* data, size_t size, AlarmInfo* alarm);
+    static std::string AlarmRecordKey(int alarm_id);
+    static void FireTimerCallback(void* arg);
+    time_t GetCurrentTimestamp();
+    void ScheduleAlarmLocked(const AlarmInfo& alarm, time_t after);
+    void ArmTimerLocked(time_t now);
     int GenerateAlarmId();
     time_t CalculateNextTriggerTime(int hour, int minute, bool is_tomorrow = false);
     bool IsValidTime(int hour, int minute);
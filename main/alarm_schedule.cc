@@ -0,0 +1,145 @@
+#include "alarm_schedule.h"
+
+#include <algorithm>
+#include <functional>
+
+#define ALARM_FIRE_GRACE_S 300          // 错过触发时间在此范围内仍补发
+#define TIME_JUMP_THRESHOLD_S 5         // 墙上时间与单调时钟偏差超过此值视为时间跳变
+
+time_t AlarmSchedule::ComputeNextFireTime(const AlarmInfo& alarm, time_t after) {
+    struct tm base_tm;
+    localtime_r(&after, &base_tm);
+
+    // 最多向后看8天，mktime 按目标日期的时区规则（含夏令时）换算
+    for (int days = 0; days <= 7; days++) {
+        struct tm alarm_tm = base_tm;
+        alarm_tm.tm_mday += days;
+        alarm_tm.tm_hour = alarm.hour;
+        alarm_tm.tm_min = alarm.minute;
+        alarm_tm.tm_sec = 0;
+        alarm_tm.tm_isdst = -1;
+
+        time_t candidate = mktime(&alarm_tm);
+        if (candidate == -1 || candidate <= after) {
+            continue;
+        }
+        if (alarm.weekdays.empty() ||
+            std::find(alarm.weekdays.begin(), alarm.weekdays.end(), alarm_tm.tm_wday) != alarm.weekdays.end()) {
+            return candidate;
+        }
+    }
+    return -1;
+}
+
+bool AlarmSchedule::Schedule(const AlarmInfo& alarm, time_t after) {
+    next_fire_times_.erase(alarm.id);
+    if (!alarm.enabled) {
+        return true;
+    }
+
+    time_t fire_time = ComputeNextFireTime(alarm, after);
+    if (fire_time == -1) {
+        return false;
+    }
+    next_fire_times_[alarm.id] = fire_time;
+    fire_heap_.emplace_back(fire_time, alarm.id);
+    std::push_heap(fire_heap_.begin(), fire_heap_.end(), std::greater<std::pair<time_t, int>>());
+    return true;
+}
+
+void AlarmSchedule::Unschedule(int alarm_id) {
+    // 堆中的条目留待弹出时丢弃
+    next_fire_times_.erase(alarm_id);
+    last_fired_times_.erase(alarm_id);
+}
+
+void AlarmSchedule::Rebuild(const std::vector<AlarmInfo>& alarms, time_t after) {
+    fire_heap_.clear();
+    next_fire_times_.clear();
+    for (const auto& alarm : alarms) {
+        Schedule(alarm, after);
+    }
+}
+
+bool AlarmSchedule::PeekNext(time_t* fire_time, int* alarm_id) {
+    while (!fire_heap_.empty()) {
+        const auto& top = fire_heap_.front();
+        auto it = next_fire_times_.find(top.second);
+        if (it != next_fire_times_.end() && it->second == top.first) {
+            *fire_time = top.first;
+            *alarm_id = top.second;
+            return true;
+        }
+        PopNext();
+    }
+    return false;
+}
+
+void AlarmSchedule::PopNext() {
+    std::pop_heap(fire_heap_.begin(), fire_heap_.end(), std::greater<std::pair<time_t, int>>());
+    fire_heap_.pop_back();
+}
+
+AlarmSchedule::CheckResult AlarmSchedule::Check(std::vector<AlarmInfo>& alarms, time_t now, int64_t mono_us, bool force_rebuild) {
+    CheckResult result;
+
+    // 用单调时钟检测墙上时间跳变（NTP/RTC校时、手动设置），跳变后重建触发索引
+    bool last_valid = last_check_wall_time_ >= MIN_VALID_TIMESTAMP;
+    time_t expected = last_check_wall_time_ + (time_t)((mono_us - last_check_mono_time_) / 1000000);
+    time_t drift = now - expected;
+    if (last_check_mono_time_ != 0 && (drift > TIME_JUMP_THRESHOLD_S || drift < -TIME_JUMP_THRESHOLD_S)) {
+        result.time_jump_s = drift;
+        force_rebuild = true;
+    }
+    if (force_rebuild) {
+        // 向前跳变时被跳过的闹钟在容错窗口内补发；未校时前的时间不参与补发
+        time_t after = now;
+        if (last_valid && drift > 0) {
+            after = std::max(expected, now - ALARM_FIRE_GRACE_S);
+        }
+        Rebuild(alarms, after);
+    }
+    last_check_wall_time_ = now;
+    last_check_mono_time_ = mono_us;
+
+    if (now < MIN_VALID_TIMESTAMP) {
+        // 时间尚未同步，不触发任何闹钟
+        return result;
+    }
+
+    // 依次弹出所有已到期的闹钟
+    time_t fire_time;
+    int alarm_id;
+    while (PeekNext(&fire_time, &alarm_id) && fire_time <= now) {
+        PopNext();
+        next_fire_times_.erase(alarm_id);
+
+        auto it = std::find_if(alarms.begin(), alarms.end(),
+            [alarm_id](const AlarmInfo& alarm) {
+                return alarm.id == alarm_id;
+            });
+        if (it == alarms.end() || !it->enabled) {
+            continue;
+        }
+
+        bool missed = now - fire_time > ALARM_FIRE_GRACE_S;
+        if (missed) {
+            result.missed.emplace_back(alarm_id, (int64_t)(now - fire_time));
+        } else if (last_fired_times_[alarm_id] == fire_time) {
+            result.duplicates.push_back(alarm_id);
+        } else {
+            last_fired_times_[alarm_id] = fire_time;
+            result.triggered.push_back(*it);
+        }
+
+        if (it->weekdays.empty()) {
+            // 一次性闹钟触发或过期后立即禁用，由调用者删除
+            it->enabled = false;
+            result.finished_ids.push_back(alarm_id);
+        } else {
+            // 重复闹钟：计算下一次触发时间重新入堆
+            Schedule(*it, missed ? now : fire_time);
+        }
+    }
+    return result;
+}
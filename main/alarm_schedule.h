@@ -0,0 +1,50 @@
+#ifndef ALARM_SCHEDULE_H
+#define ALARM_SCHEDULE_H
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+#include <time.h>
+#include "alarm_info.h"
+
+#define MIN_VALID_TIMESTAMP 1577836800  // 2020-01-01，早于此时间说明尚未校时
+
+// 闹钟触发索引，不访问定时器和NVS，可以在电脑上测试
+// 按下次触发时间维护最小堆，检测墙上时间跳变，并决定哪些到期的闹钟需要触发
+class AlarmSchedule {
+public:
+    struct CheckResult {
+        int64_t time_jump_s = 0;               // 检测到的时间跳变，0 表示没有
+        std::vector<AlarmInfo> triggered;      // 需要响铃的闹钟
+        std::vector<int> finished_ids;         // 触发或过期后已禁用的一次性闹钟，待删除
+        std::vector<std::pair<int, int64_t>> missed;  // 超出容错窗口未补发的闹钟及错过的秒数
+        std::vector<int> duplicates;           // 时间回拨后同一次触发被跳过的闹钟
+    };
+
+    // 下次触发时间 (晚于 after)，没有时返回 -1
+    static time_t ComputeNextFireTime(const AlarmInfo& alarm, time_t after);
+
+    // 计算闹钟下次触发时间并入堆，返回 false 表示没有有效的触发时间
+    bool Schedule(const AlarmInfo& alarm, time_t after);
+    void Unschedule(int alarm_id);
+    void Rebuild(const std::vector<AlarmInfo>& alarms, time_t after);
+    // 最早的有效条目，不弹出
+    bool PeekNext(time_t* fire_time, int* alarm_id);
+
+    // 用单调时钟 mono_us 检测墙上时间跳变，再弹出 now 之前到期的闹钟
+    // 一次性闹钟在 alarms 中被禁用，重复闹钟重新入堆
+    CheckResult Check(std::vector<AlarmInfo>& alarms, time_t now, int64_t mono_us, bool force_rebuild);
+
+private:
+    // 最小堆 (下次触发时间, 闹钟ID)；与 next_fire_times_ 不一致的条目视为失效，弹出时丢弃
+    std::vector<std::pair<time_t, int>> fire_heap_;
+    std::map<int, time_t> next_fire_times_;
+    std::map<int, time_t> last_fired_times_;  // 时间回拨时防止同一次闹钟重复触发
+    time_t last_check_wall_time_ = 0;
+    int64_t last_check_mono_time_ = 0;
+
+    void PopNext();
+};
+
+#endif // ALARM_SCHEDULE_H
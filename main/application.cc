@@ -2,18 +2,22 @@
 #include "board.h"
 #include "display.h"
 #include "system_info.h"
+#include "system_profiler.h"
 #include "ml307_ssl_transport.h"
 #include "audio_codec.h"
+#include "audio_channels.h"
 #include "mqtt_protocol.h"
 #include "websocket_protocol.h"
 #include "font_awesome_symbols.h"
 #include "iot/thing_manager.h"
 #include "assets/lang_config.h"
+#include "language_pack.h"
 // #include "camera_service.h"
 // #include "display/spi_lcd_anim_display.h"
 #include "mcp_server.h"
 #include "audio_debugger.h"
 #include "settings.h"
+#include "latency_tracer.h"
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "afe_audio_processor.h"
@@ -38,6 +42,11 @@
 
 #define TAG "Application"
 
+// Seconds to wait for `tts start` after the device reported the end of speech
+#define ENDPOINT_REPLY_TIMEOUT_S 5
+// A decoded packet counts as playing for this long, covering the codec output buffer
+#define BARGE_IN_PLAYBACK_HOLD_US (200 * 1000)
+
 
 static const char* const STATE_STRINGS[] = {
     "unknown",
@@ -122,6 +131,25 @@ Application::Application() {
     audio_processor_ = std::make_unique<NoAudioProcessor>();
 #endif
 
+#if CONFIG_USE_DEVICE_ENDPOINTING
+    EndpointDetectorConfig endpoint_config;
+    endpoint_config.hangover_ms = CONFIG_DEVICE_ENDPOINT_HANGOVER_MS;
+    endpoint_config.min_speech_ms = CONFIG_DEVICE_ENDPOINT_MIN_SPEECH_MS;
+    endpoint_config.energy_margin_db = CONFIG_DEVICE_ENDPOINT_ENERGY_MARGIN;
+#if !CONFIG_USE_AUDIO_PROCESSOR
+    // Only the AFE processor reports VAD states, rely on energy alone
+    endpoint_config.use_vad = false;
+#endif
+    endpoint_detector_ = EndpointDetector(endpoint_config);
+#endif
+
+#if CONFIG_USE_BARGE_IN
+    BargeInDetectorConfig barge_in_config;
+    barge_in_config.trigger_ms = CONFIG_BARGE_IN_TRIGGER_MS;
+    barge_in_config.echo_margin_db = CONFIG_BARGE_IN_ECHO_MARGIN;
+    barge_in_detector_ = BargeInDetector(barge_in_config);
+#endif
+
 #if CONFIG_USE_AFE_WAKE_WORD
     wake_word_ = std::make_unique<AfeWakeWord>();
 #elif CONFIG_USE_ESP_WAKE_WORD
@@ -329,8 +357,10 @@ void Application::PlaySound(const std::string_view& sound) {
     }
     background_task_->WaitForCompletion();
 
-    const char* data = sound.data();
-    size_t size = sound.size();
+    // 已加载语言包时播放语言包中的版本
+    auto clip = LanguagePack::GetInstance().FindSound(sound);
+    const char* data = clip ? clip->data() : sound.data();
+    size_t size = clip ? clip->size() : sound.size();
     for (const char* p = data; p < data + size; ) {
         auto p3 = (BinaryProtocol3*)p;
         p += sizeof(BinaryProtocol3);
@@ -360,6 +390,7 @@ void Application::ToggleChatState() {
     }
 
         if (device_state_ == kDeviceStateIdle) {
+        LatencyTracer::GetInstance().BeginTurn();
         Schedule([this]() {
             if (!protocol_->IsAudioChannelOpened()) {
                 SetDeviceState(kDeviceStateConnecting);
@@ -367,6 +398,7 @@ void Application::ToggleChatState() {
                     return;
                 }
             }
+            LatencyTracer::GetInstance().Mark(kLatencyStageChannelOpened);
 
             SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
         });
@@ -393,6 +425,7 @@ void Application::StartListening() {
     }
     
     if (device_state_ == kDeviceStateIdle) {
+        LatencyTracer::GetInstance().BeginTurn();
         Schedule([this]() {
             if (!protocol_->IsAudioChannelOpened()) {
                 SetDeviceState(kDeviceStateConnecting);
@@ -400,6 +433,7 @@ void Application::StartListening() {
                     return;
                 }
             }
+            LatencyTracer::GetInstance().Mark(kLatencyStageChannelOpened);
 
             SetListeningMode(kListeningModeManualStop);
         });
@@ -432,6 +466,8 @@ void Application::StopListening() {
 
 void Application::Start() {
     auto& board = Board::GetInstance();
+    // The board mounts the SD card, so the saved language pack can only be loaded after it
+    LanguagePack::GetInstance().Initialize();
     SetDeviceState(kDeviceStateStarting);
     
     /* Setup the display */
@@ -463,8 +499,11 @@ void Application::Start() {
     }
 
     if (codec->input_sample_rate() != 16000) {
-        input_resampler_.Configure(codec->input_sample_rate(), 16000);
-        reference_resampler_.Configure(codec->input_sample_rate(), 16000);
+        for (int i = 0; i < codec->input_channels(); i++) {
+            auto resampler = std::make_unique<OpusResampler>();
+            resampler->Configure(codec->input_sample_rate(), 16000);
+            input_resamplers_.push_back(std::move(resampler));
+        }
     }
     codec->Start();
 
@@ -562,6 +601,7 @@ void Application::Start() {
         if (strcmp(type->valuestring, "tts") == 0) {
             auto state = cJSON_GetObjectItem(root, "state");
             if (strcmp(state->valuestring, "start") == 0) {
+                LatencyTracer::GetInstance().Mark(kLatencyStageTtsStart);
                 Schedule([this]() {
                     aborted_ = false;
                     if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
@@ -685,7 +725,42 @@ void Application::Start() {
 
     audio_debugger_ = std::make_unique<AudioDebugger>();
     audio_processor_->Initialize(codec);
+#if CONFIG_USE_BARGE_IN
+    // Without a reference signal the AFE cannot remove the playback from the microphone
+    barge_in_available_ = codec->input_reference();
+    if (!barge_in_available_) {
+        ESP_LOGW(TAG, "Barge-in disabled, the codec has no reference input");
+    }
+#endif
     audio_processor_->OnOutput([this](std::vector<int16_t>&& data) {
+        audio_debugger_->Feed(kAudioDebugStreamProcessed, data, 1, 16000);
+        if (barge_in_armed_) {
+            if (barge_in_reset_.exchange(false)) {
+                barge_in_detector_.Reset();
+            }
+            bool playing = esp_timer_get_time() - playback_time_us_ < BARGE_IN_PLAYBACK_HOLD_US;
+            if (barge_in_detector_.Feed(data.data(), data.size(), playing ? playback_db_.load() : -100.0f)) {
+                barge_in_time_us_ = esp_timer_get_time();
+                Schedule([this]() {
+                    OnBargeIn();
+                });
+            }
+            // Nothing is uploaded while the device is speaking
+            return;
+        }
+#if CONFIG_USE_DEVICE_ENDPOINTING
+        if (endpoint_reset_.exchange(false)) {
+            endpoint_detector_.Reset();
+        }
+        bool endpoint = false;
+        if (listening_mode_ == kListeningModeAutoStop) {
+            // Audio after the endpoint is not uploaded, the turn is already closed
+            if (endpoint_detector_.IsEndpointReached()) {
+                return;
+            }
+            endpoint = endpoint_detector_.Feed(data.data(), data.size(), vad_speaking_);
+        }
+#endif
         {
             std::lock_guard<std::mutex> lock(mutex_);
             if (audio_send_queue_.size() >= MAX_AUDIO_PACKETS_IN_QUEUE) {
@@ -695,6 +770,7 @@ void Application::Start() {
         }
         background_task_->Schedule([this, data = std::move(data)]() mutable {
             opus_encoder_->Encode(std::move(data), [this](std::vector<uint8_t>&& opus) {
+                LatencyTracer::GetInstance().Mark(kLatencyStageFirstEncode);
                 AudioStreamPacket packet;
                 packet.payload = std::move(opus);
 #ifdef CONFIG_USE_SERVER_AEC
@@ -722,8 +798,20 @@ void Application::Start() {
                 xEventGroupSetBits(event_group_, SEND_AUDIO_EVENT);
             });
         });
+#if CONFIG_USE_DEVICE_ENDPOINTING
+        if (endpoint) {
+            // Queued behind the encoding of the last frame, so the main loop sends
+            // the remaining audio before the stop message
+            background_task_->Schedule([this]() {
+                Schedule([this]() {
+                    OnEndpointDetected();
+                });
+            });
+        }
+#endif
     });
     audio_processor_->OnVadStateChange([this](bool speaking) {
+        vad_speaking_ = speaking;
         if (device_state_ == kDeviceStateListening) {
             Schedule([this, speaking]() {
                 if (speaking) {
@@ -738,7 +826,14 @@ void Application::Start() {
     });
 
     wake_word_->Initialize(codec);
+    wake_word_benchmark_ = std::make_unique<WakeWordBenchmark>(wake_word_.get(), codec);
     wake_word_->OnWakeWordDetected([this](const std::string& wake_word) {
+        if (wake_word_benchmark_->OnWakeWordDetected(wake_word)) {
+            return;
+        }
+        if (device_state_ == kDeviceStateIdle) {
+            LatencyTracer::GetInstance().BeginTurn();
+        }
         Schedule([this, &wake_word]() {
             if (!protocol_) {
                 return;
@@ -754,13 +849,18 @@ void Application::Start() {
                         return;
                     }
                 }
+                LatencyTracer::GetInstance().Mark(kLatencyStageChannelOpened);
 
                 ESP_LOGI(TAG, "Wake word detected: %s", wake_word.c_str());
 #if CONFIG_USE_AFE_WAKE_WORD
                 AudioStreamPacket packet;
                 // Encode and send the wake word data to the server
+                auto& tracer = LatencyTracer::GetInstance();
                 while (wake_word_->GetWakeWordOpus(packet.payload)) {
-                    protocol_->SendAudio(packet);
+                    tracer.Mark(kLatencyStageFirstEncode);
+                    if (protocol_->SendAudio(packet)) {
+                        tracer.Mark(kLatencyStageFirstSend);
+                    }
                 }
                 // Set the chat state to wake word detected
                 protocol_->SendWakeWordDetected(wake_word);
@@ -804,6 +904,7 @@ void Application::Start() {
 
     // Print heap stats
     SystemInfo::PrintHeapStats();
+    SystemProfiler::GetInstance().Start();
     
     // Enter the main event loop
     MainEventLoop();
@@ -817,6 +918,19 @@ void Application::OnClockTimer() {
     auto display = Board::GetInstance().GetDisplay();
     display->UpdateStatusBar();
 
+    // The server did not answer a device-side endpoint, keep listening instead of waiting forever
+    if (endpoint_wait_ticks_ > 0 && --endpoint_wait_ticks_ == 0) {
+        Schedule([this]() {
+            if (device_state_ == kDeviceStateListening && !audio_processor_->IsRunning()) {
+                ESP_LOGW(TAG, "No reply to the device endpoint, listening again");
+                protocol_->SendStartListening(listening_mode_);
+                opus_encoder_->ResetState();
+                endpoint_reset_ = true;
+                audio_processor_->Start();
+            }
+        });
+    }
+
     // Print the debug info every 10 seconds
     if (clock_ticks_ % 10 == 0) {
         // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
@@ -867,6 +981,7 @@ void Application::MainEventLoop() {
                 if (!protocol_->SendAudio(packet)) {
                     break;
                 }
+                LatencyTracer::GetInstance().Mark(kLatencyStageFirstSend);
             }
         }
 
@@ -941,7 +1056,19 @@ void Application::OnAudioOutput() {
             output_resampler_.Process(pcm.data(), pcm.size(), resampled.data());
             pcm = std::move(resampled);
         }
+        Board::GetInstance().GetLed()->OnOutputAudio(pcm);
         codec->OutputData(pcm);
+        if (barge_in_available_) {
+            playback_db_ = BargeInDetector::LevelDb(pcm.data(), pcm.size());
+            playback_time_us_ = esp_timer_get_time();
+        }
+        if (audio_debugger_) {
+            audio_debugger_->Feed(kAudioDebugStreamOutput, pcm, codec->output_channels(), codec->output_sample_rate());
+        }
+        // Local prompt sounds share this path, only server TTS ends a turn
+        if (device_state_ == kDeviceStateSpeaking) {
+            LatencyTracer::GetInstance().Mark(kLatencyStageFirstOutput);
+        }
 #ifdef CONFIG_USE_SERVER_AEC
         std::lock_guard<std::mutex> lock(timestamp_mutex_);
         timestamp_queue_.push_back(packet.timestamp);
@@ -951,8 +1078,9 @@ void Application::OnAudioOutput() {
 }
 
 void Application::OnAudioInput() {
-    if (wake_word_->IsDetectionRunning()) {
-        std::vector<int16_t> data;
+    auto& data = audio_input_buffer_;
+    // The benchmark feeds recorded audio instead of the microphone
+    if (wake_word_->IsDetectionRunning() && !wake_word_benchmark_->IsRunning()) {
         int samples = wake_word_->GetFeedSize();
         if (samples > 0) {
             if (ReadAudio(data, 16000, samples)) {
@@ -962,7 +1090,6 @@ void Application::OnAudioInput() {
         }
     }
     if (audio_processor_->IsRunning()) {
-        std::vector<int16_t> data;
         int samples = audio_processor_->GetFeedSize();
         if (samples > 0) {
             if (ReadAudio(data, 16000, samples)) {
@@ -986,27 +1113,25 @@ bool Application::ReadAudio(std::vector<int16_t>& data, int sample_rate, int sam
         if (!codec->InputData(data)) {
             return false;
         }
-        if (codec->input_channels() == 2) {
-            auto mic_channel = std::vector<int16_t>(data.size() / 2);
-            auto reference_channel = std::vector<int16_t>(data.size() / 2);
-            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
-                mic_channel[i] = data[j];
-                reference_channel[i] = data[j + 1];
-            }
-            auto resampled_mic = std::vector<int16_t>(input_resampler_.GetOutputSamples(mic_channel.size()));
-            auto resampled_reference = std::vector<int16_t>(reference_resampler_.GetOutputSamples(reference_channel.size()));
-            input_resampler_.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
-            reference_resampler_.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
-            data.resize(resampled_mic.size() + resampled_reference.size());
-            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
-                data[j] = resampled_mic[i];
-                data[j + 1] = resampled_reference[i];
-            }
+        int channels = codec->input_channels();
+        if (channels == 1) {
+            auto& resampler = *input_resamplers_[0];
+            resample_buffer_.resize(resampler.GetOutputSamples(data.size()));
+            resampler.Process(data.data(), data.size(), resample_buffer_.data());
         } else {
-            auto resampled = std::vector<int16_t>(input_resampler_.GetOutputSamples(data.size()));
-            input_resampler_.Process(data.data(), data.size(), resampled.data());
-            data = std::move(resampled);
+            // 逐通道拆分、重采样后重新交织
+            size_t frames = data.size() / channels;
+            size_t output_frames = input_resamplers_[0]->GetOutputSamples(frames);
+            channel_buffer_.resize(frames);
+            channel_resampled_buffer_.resize(output_frames);
+            resample_buffer_.resize(output_frames * channels);
+            for (int i = 0; i < channels; i++) {
+                DeinterleaveChannel(data.data(), channels, i, channel_buffer_.data(), frames);
+                input_resamplers_[i]->Process(channel_buffer_.data(), frames, channel_resampled_buffer_.data());
+                InterleaveChannel(channel_resampled_buffer_.data(), channels, i, resample_buffer_.data(), output_frames);
+            }
         }
+        data.swap(resample_buffer_);
     } else {
         data.resize(samples);
         if (!codec->InputData(data)) {
@@ -1016,7 +1141,7 @@ bool Application::ReadAudio(std::vector<int16_t>& data, int sample_rate, int sam
     
     // 音频调试：发送原始音频数据
     if (audio_debugger_) {
-        audio_debugger_->Feed(data);
+        audio_debugger_->Feed(kAudioDebugStreamInput, data, codec->input_channels(), sample_rate);
     }
     
     return true;
@@ -1033,12 +1158,38 @@ void Application::SetListeningMode(ListeningMode mode) {
     SetDeviceState(kDeviceStateListening);
 }
 
+void Application::OnEndpointDetected() {
+    if (device_state_ != kDeviceStateListening || listening_mode_ != kListeningModeAutoStop) {
+        return;
+    }
+    ESP_LOGI(TAG, "Endpoint detected on device after %d ms of silence, noise floor %.1f dB",
+        endpoint_detector_.endpoint_ms() - endpoint_detector_.speech_end_ms(), endpoint_detector_.noise_floor_db());
+    // Stay in listening until the server answers with `tts start`, as with server endpointing
+    protocol_->SendStopListening();
+    audio_processor_->Stop();
+    endpoint_wait_ticks_ = ENDPOINT_REPLY_TIMEOUT_S;
+}
+
+void Application::OnBargeIn() {
+    if (device_state_ != kDeviceStateSpeaking || !barge_in_armed_) {
+        return;
+    }
+    // Stop the local playback first, the server may keep sending audio until it handles the abort
+    ResetDecoder();
+    AbortSpeaking(kAbortReasonNone);
+    ESP_LOGI(TAG, "Barge-in after %d ms of playback, output stopped %d ms after detection",
+        barge_in_detector_.playback_trigger_ms(), (int)((esp_timer_get_time() - barge_in_time_us_) / 1000));
+    SetDeviceState(kDeviceStateListening);
+}
+
 void Application::SetDeviceState(DeviceState state) {
     if (device_state_ == state) {
         return;
     }
     
     clock_ticks_ = 0;
+    endpoint_wait_ticks_ = 0;
+    bool barge_in_armed = barge_in_armed_.exchange(false);
     auto previous_state = device_state_;
     device_state_ = state;
     ESP_LOGI(TAG, "STATE: %s", STATE_STRINGS[device_state_]);
@@ -1080,8 +1231,8 @@ void Application::SetDeviceState(DeviceState state) {
             
 #endif
 
-            // Make sure the audio processor is running
-            if (!audio_processor_->IsRunning()) {
+            // Make sure the audio processor is running, and uploading again after barge-in
+            if (!audio_processor_->IsRunning() || barge_in_armed) {
                 // Send the start listening command
                 protocol_->SendStartListening(listening_mode_);
                 if (previous_state == kDeviceStateSpeaking) {
@@ -1091,6 +1242,7 @@ void Application::SetDeviceState(DeviceState state) {
                     vTaskDelay(pdMS_TO_TICKS(120));
                 }
                 opus_encoder_->ResetState();
+                endpoint_reset_ = true;
                 audio_processor_->Start();
                 wake_word_->StopDetection();
             }
@@ -1102,7 +1254,13 @@ void Application::SetDeviceState(DeviceState state) {
             // 在说话状态隐藏时钟
             board.HideClock();
 
-            if (listening_mode_ != kListeningModeRealtime) {
+            if (barge_in_available_ && listening_mode_ == kListeningModeAutoStop) {
+                // Keep the AEC running to hear the user over the playback, replaces the wake word interruption
+                barge_in_reset_ = true;
+                barge_in_armed_ = true;
+                audio_processor_->Start();
+                wake_word_->StopDetection();
+            } else if (listening_mode_ != kListeningModeRealtime) {
                 audio_processor_->Stop();
                 // Only AFE wake word can be detected in speaking mode
 #if CONFIG_USE_AFE_WAKE_WORD
@@ -1155,6 +1313,33 @@ void Application::UpdateIotStates() {
 #endif
 }
 
+void Application::OnNetworkChanged() {
+    auto start_time = esp_timer_get_time();
+    Schedule([this, start_time]() {
+        if (!protocol_) {
+            return;
+        }
+        bool resume = device_state_ == kDeviceStateListening || device_state_ == kDeviceStateSpeaking;
+        ESP_LOGI(TAG, "Network changed, resume conversation: %d", resume);
+
+        // MQTT 控制连接绑定在旧链路上，需要在新链路上重建；WebSocket 的 Start 为空操作
+        protocol_->Start();
+        if (!resume) {
+            return;
+        }
+
+        // 已收到的语音继续在扬声器上播放完，同时在新链路上重新打开音频通道
+        if (!protocol_->OpenAudioChannel()) {
+            SetDeviceState(kDeviceStateIdle);
+            return;
+        }
+        if (device_state_ == kDeviceStateListening) {
+            protocol_->SendStartListening(listening_mode_);
+        }
+        ESP_LOGI(TAG, "Audio channel restored on the new network in %lld ms", (esp_timer_get_time() - start_time) / 1000);
+    });
+}
+
 void Application::Reboot() {
     ESP_LOGI(TAG, "Rebooting...");
     esp_restart();
@@ -12,6 +12,7 @@
 #include <vector>
 #include <condition_variable>
 #include <memory>
+#include <atomic>
 
 #include <opus_encoder.h>
 #include <opus_decoder.h>
@@ -23,6 +24,9 @@
 #include "audio_processor.h"
 #include "wake_word.h"
 #include "audio_debugger.h"
+#include "wake_word_benchmark.h"
+#include "endpoint_detector.h"
+#include "barge_in_detector.h"
 
 #define SCHEDULE_EVENT (1 << 0)
 #define SEND_AUDIO_EVENT (1 << 1)
@@ -78,6 +82,8 @@ public:
     void StopListening();
     void UpdateIotStates();
     void Reboot();
+    // The board switched to another network link; reconnect the protocol on it
+    void OnNetworkChanged();
     void WakeWordInvoke(const std::string& wake_word);
     void PlaySound(const std::string_view& sound);
     bool CanEnterSleepMode();
@@ -101,6 +107,20 @@ private:
     std::unique_ptr<WakeWord> wake_word_;
     std::unique_ptr<AudioProcessor> audio_processor_;
     std::unique_ptr<AudioDebugger> audio_debugger_;
+    std::unique_ptr<WakeWordBenchmark> wake_word_benchmark_;
+    // Used from the audio processor output callback only, reset through endpoint_reset_
+    EndpointDetector endpoint_detector_;
+    std::atomic<bool> endpoint_reset_ = false;
+    std::atomic<bool> vad_speaking_ = false;
+    std::atomic<int> endpoint_wait_ticks_ = 0;
+    // While speaking in auto-stop mode the audio processor keeps running for barge-in only
+    BargeInDetector barge_in_detector_;
+    bool barge_in_available_ = false;
+    std::atomic<bool> barge_in_armed_ = false;
+    std::atomic<bool> barge_in_reset_ = false;
+    std::atomic<int64_t> barge_in_time_us_ = 0;
+    std::atomic<float> playback_db_ = -100.0f;
+    std::atomic<int64_t> playback_time_us_ = 0;
     Ota ota_;
     std::mutex mutex_;
     std::list<std::function<void()>> main_tasks_;
@@ -133,9 +153,13 @@ private:
     std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
     std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
 
-    OpusResampler input_resampler_;
-    OpusResampler reference_resampler_;
+    std::vector<std::unique_ptr<OpusResampler>> input_resamplers_;  // 每个输入通道一个
     OpusResampler output_resampler_;
+    // 音频输入任务使用的缓冲区，在各帧之间复用
+    std::vector<int16_t> audio_input_buffer_;
+    std::vector<int16_t> resample_buffer_;
+    std::vector<int16_t> channel_buffer_;
+    std::vector<int16_t> channel_resampled_buffer_;
 
     void MainEventLoop();
     void OnAudioInput();
@@ -147,6 +171,8 @@ private:
     void ShowActivationCode();
     void OnClockTimer();
     void SetListeningMode(ListeningMode mode);
+    void OnEndpointDetected();
+    void OnBargeIn();
     void AudioLoop();
     
     // 新增：私有方法用于加载和保存AudioChannelClosed模式配置
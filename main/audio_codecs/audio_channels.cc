@@ -0,0 +1,80 @@
+#include "audio_channels.h"
+
+#include <algorithm>
+
+int CountAudioChannels(const std::string& format, char role) {
+    return std::count(format.begin(), format.end(), role);
+}
+
+int FindAudioChannel(const std::string& format, char role, int n) {
+    for (size_t i = 0; i < format.size(); i++) {
+        if (format[i] == role && n-- == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint16_t AudioChannelMask(const std::string& format, char role) {
+    uint16_t mask = 0;
+    for (size_t i = 0; i < format.size() && i < 16; i++) {
+        if (format[i] == role) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+}
+
+std::string DefaultAudioInputFormat(int channels, bool reference) {
+    int ref_num = reference ? 1 : 0;
+    std::string format(channels - ref_num, AUDIO_CHANNEL_MIC);
+    format.append(ref_num, AUDIO_CHANNEL_REFERENCE);
+    return format;
+}
+
+std::string AudioSlotsToInputFormat(const std::string& slots) {
+    std::string format;
+    for (char role : slots) {
+        if (role != AUDIO_CHANNEL_UNUSED) {
+            format.push_back(role);
+        }
+    }
+    return format;
+}
+
+bool IsValidAudioSlots(const std::string& slots, int max_slots) {
+    if (slots.empty() || (int)slots.size() > max_slots || CountAudioChannels(slots, AUDIO_CHANNEL_MIC) == 0) {
+        return false;
+    }
+    return std::all_of(slots.begin(), slots.end(), [](char role) {
+        return role == AUDIO_CHANNEL_MIC || role == AUDIO_CHANNEL_REFERENCE || role == AUDIO_CHANNEL_UNUSED;
+    });
+}
+
+void DeinterleaveChannel(const int16_t* src, int channels, int channel, int16_t* dst, size_t frames) {
+    src += channel;
+    if (channels == 2) {
+        for (size_t i = 0; i < frames; i++) {
+            dst[i] = src[i * 2];
+        }
+        return;
+    }
+    for (size_t i = 0; i < frames; i++) {
+        dst[i] = *src;
+        src += channels;
+    }
+}
+
+void InterleaveChannel(const int16_t* src, int channels, int channel, int16_t* dst, size_t frames) {
+    dst += channel;
+    if (channels == 2) {
+        for (size_t i = 0; i < frames; i++) {
+            dst[i * 2] = src[i];
+        }
+        return;
+    }
+    for (size_t i = 0; i < frames; i++) {
+        *dst = src[i];
+        dst += channels;
+    }
+}
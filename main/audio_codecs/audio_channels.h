@@ -0,0 +1,34 @@
+#ifndef _AUDIO_CHANNELS_H
+#define _AUDIO_CHANNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Interleaved input layouts are described with one letter per channel, the
+// same convention as the esp-sr AFE input_format:
+// 'M' microphone, 'R' playback reference, 'N' unused slot
+#define AUDIO_CHANNEL_MIC 'M'
+#define AUDIO_CHANNEL_REFERENCE 'R'
+#define AUDIO_CHANNEL_UNUSED 'N'
+
+int CountAudioChannels(const std::string& format, char role);
+// Index of the n-th channel with the given role, or -1
+int FindAudioChannel(const std::string& format, char role, int n = 0);
+// Bit i is set when channel i has the given role, same layout as ESP_CODEC_DEV_MAKE_CHANNEL_MASK
+uint16_t AudioChannelMask(const std::string& format, char role);
+
+// Layout of codecs that do not set one: mics first, then the reference if any
+std::string DefaultAudioInputFormat(int channels, bool reference);
+// Input format of a TDM slot assignment: the codec only returns the used
+// slots, in slot order, so the unused ones are dropped
+std::string AudioSlotsToInputFormat(const std::string& slots);
+// At most max_slots slots with at least one mic
+bool IsValidAudioSlots(const std::string& slots, int max_slots);
+
+// Copies one channel out of `frames` interleaved frames into dst
+void DeinterleaveChannel(const int16_t* src, int channels, int channel, int16_t* dst, size_t frames);
+// Writes src into one channel of `frames` interleaved frames in dst
+void InterleaveChannel(const int16_t* src, int channels, int channel, int16_t* dst, size_t frames);
+
+#endif // _AUDIO_CHANNELS_H
@@ -1,6 +1,7 @@
 #include "audio_codec.h"
 #include "board.h"
 #include "settings.h"
+#include "audio_channels.h"
 
 #include <esp_log.h>
 #include <cstring>
@@ -26,6 +27,13 @@ bool AudioCodec::InputData(std::vector<int16_t>& data) {
     return false;
 }
 
+std::string AudioCodec::input_format() const {
+    if (!input_format_.empty()) {
+        return input_format_;
+    }
+    return DefaultAudioInputFormat(input_channels_, input_reference_);
+}
+
 void AudioCodec::Start() {
     Settings settings("audio", false);
     output_volume_ = settings.GetInt("output_volume", output_volume_);
@@ -33,6 +33,8 @@ public:
     inline int input_sample_rate() const { return input_sample_rate_; }
     inline int output_sample_rate() const { return output_sample_rate_; }
     inline int input_channels() const { return input_channels_; }
+    // Layout of the interleaved input frames, see audio_channels.h
+    std::string input_format() const;
     inline int output_channels() const { return output_channels_; }
     inline int output_volume() const { return output_volume_; }
     inline bool input_enabled() const { return input_enabled_; }
@@ -49,6 +51,7 @@ protected:
     int input_sample_rate_ = 0;
     int output_sample_rate_ = 0;
     int input_channels_ = 1;
+    std::string input_format_;  // Empty means mics first, then the reference if any
     int output_channels_ = 1;
     int output_volume_ = 70;
 
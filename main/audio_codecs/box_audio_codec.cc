@@ -1,4 +1,5 @@
 #include "box_audio_codec.h"
+#include "audio_channels.h"
 
 #include <esp_log.h>
 #include <driver/i2c_master.h>
@@ -12,6 +13,7 @@ BoxAudioCodec::BoxAudioCodec(void* i2c_master_handle, int input_sample_rate, int
     duplex_ = true; // 是否双工
     input_reference_ = input_reference; // 是否使用参考输入，实现回声消除
     input_channels_ = input_reference_ ? 2 : 1; // 输入通道数
+    input_slots_ = input_reference_ ? "MR" : "M"; // 麦克风在 slot 0，参考信号在 slot 1
     input_sample_rate_ = input_sample_rate;
     output_sample_rate_ = output_sample_rate;
 
@@ -90,6 +92,18 @@ BoxAudioCodec::~BoxAudioCodec() {
     audio_codec_delete_data_if(data_if_);
 }
 
+void BoxAudioCodec::SetInputSlots(const std::string& slots) {
+    if (!IsValidAudioSlots(slots, 4)) {
+        ESP_LOGE(TAG, "Invalid input slots: %s", slots.c_str());
+        return;
+    }
+    input_slots_ = slots;
+    input_format_ = AudioSlotsToInputFormat(slots);
+    input_channels_ = input_format_.size();
+    input_reference_ = CountAudioChannels(input_format_, AUDIO_CHANNEL_REFERENCE) > 0;
+    ESP_LOGI(TAG, "Input slots %s, %d channels", input_slots_.c_str(), input_channels_);
+}
+
 void BoxAudioCodec::CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din) {
     assert(input_sample_rate_ == output_sample_rate_);
 
@@ -191,15 +205,14 @@ void BoxAudioCodec::EnableInput(bool enable) {
         esp_codec_dev_sample_info_t fs = {
             .bits_per_sample = 16,
             .channel = 4,
-            .channel_mask = ESP_CODEC_DEV_MAKE_CHANNEL_MASK(0),
+            .channel_mask = 0,
             .sample_rate = (uint32_t)output_sample_rate_,
             .mclk_multiple = 0,
         };
-        if (input_reference_) {
-            fs.channel_mask |= ESP_CODEC_DEV_MAKE_CHANNEL_MASK(1);
-        }
+        uint16_t mic_mask = AudioChannelMask(input_slots_, AUDIO_CHANNEL_MIC);
+        fs.channel_mask = mic_mask | AudioChannelMask(input_slots_, AUDIO_CHANNEL_REFERENCE);
         ESP_ERROR_CHECK(esp_codec_dev_open(input_dev_, &fs));
-        ESP_ERROR_CHECK(esp_codec_dev_set_in_channel_gain(input_dev_, ESP_CODEC_DEV_MAKE_CHANNEL_MASK(0), AUDIO_CODEC_DEFAULT_MIC_GAIN));
+        ESP_ERROR_CHECK(esp_codec_dev_set_in_channel_gain(input_dev_, mic_mask, AUDIO_CODEC_DEFAULT_MIC_GAIN));
     } else {
         ESP_ERROR_CHECK(esp_codec_dev_close(input_dev_));
     }
@@ -17,6 +17,7 @@ private:
 
     esp_codec_dev_handle_t output_dev_ = nullptr;
     esp_codec_dev_handle_t input_dev_ = nullptr;
+    std::string input_slots_;  // Role of each ES7210 TDM slot, see audio_channels.h
 
     void CreateDuplexChannels(gpio_num_t mclk, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din);
 
@@ -29,6 +30,10 @@ public:
         gpio_num_t pa_pin, uint8_t es8311_addr, uint8_t es7210_addr, bool input_reference);
     virtual ~BoxAudioCodec();
 
+    // Routes the four ES7210 TDM slots, e.g. "MRMM" for three mics plus the
+    // playback reference on slot 1. Must be called before Start().
+    void SetInputSlots(const std::string& slots);
+
     virtual void SetOutputVolume(int volume) override;
     virtual void EnableInput(bool enable) override;
     virtual void EnableOutput(bool enable) override;
@@ -6,8 +6,17 @@
 #include <driver/gpio.h>
 #include <driver/i2s_pdm.h>
 
+#include <vector>
+
 class NoAudioCodec : public AudioCodec {
 private:
+    // Scratch buffers are kept across frames; Read and Write run on different tasks
+    std::vector<int32_t> read_buffer_;
+    std::vector<int32_t> write_buffer_;
+    int gain_volume_ = -1;      // Volume the target gain was computed for
+    int32_t target_gain_ = 0;   // Q16
+    int32_t current_gain_ = 0;  // Q16, ramps towards target_gain_ over one write
+
     virtual int Write(const int16_t* data, int samples) override;
     virtual int Read(int16_t* dest, int samples) override;
 
@@ -0,0 +1,41 @@
+#include "sample_convert.h"
+
+#include <algorithm>
+
+void ScaleToInt32(const int16_t* src, int32_t* dst, int samples, int32_t gain) {
+    int i = 0;
+    for (; i + 4 <= samples; i += 4) {
+        dst[i] = src[i] * gain;
+        dst[i + 1] = src[i + 1] * gain;
+        dst[i + 2] = src[i + 2] * gain;
+        dst[i + 3] = src[i + 3] * gain;
+    }
+    for (; i < samples; i++) {
+        dst[i] = src[i] * gain;
+    }
+}
+
+void ScaleToInt32Ramp(const int16_t* src, int32_t* dst, int samples, int32_t gain, int32_t step) {
+    for (int i = 0; i < samples; i++) {
+        dst[i] = src[i] * gain;
+        gain += step;
+    }
+}
+
+// int32_t is `long` on newer toolchains, so the clamp type is spelled out
+static inline int16_t Narrow(int32_t sample) {
+    return std::clamp<int32_t>(sample >> 12, -INT16_MAX, INT16_MAX);
+}
+
+void NarrowToInt16(const int32_t* src, int16_t* dst, int samples) {
+    int i = 0;
+    for (; i + 4 <= samples; i += 4) {
+        dst[i] = Narrow(src[i]);
+        dst[i + 1] = Narrow(src[i + 1]);
+        dst[i + 2] = Narrow(src[i + 2]);
+        dst[i + 3] = Narrow(src[i + 3]);
+    }
+    for (; i < samples; i++) {
+        dst[i] = Narrow(src[i]);
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef _SAMPLE_CONVERT_H
+#define _SAMPLE_CONVERT_H
+
+#include <cstdint>
+
+// 16-bit samples scaled by a Q16 gain into 32-bit I2S slots. Gain is at most 65536,
+// so the product always fits in int32 and needs no saturation.
+void ScaleToInt32(const int16_t* src, int32_t* dst, int samples, int32_t gain);
+// Same as ScaleToInt32 with the gain moving linearly from `gain` by `step` per sample
+void ScaleToInt32Ramp(const int16_t* src, int32_t* dst, int samples, int32_t gain, int32_t step);
+// 32-bit I2S samples to 16-bit, keeping the top bits of the 20-bit microphone data
+void NarrowToInt16(const int32_t* src, int16_t* dst, int samples);
+
+#endif // _SAMPLE_CONVERT_H
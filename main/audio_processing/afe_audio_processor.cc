@@ -12,15 +12,8 @@ AfeAudioProcessor::AfeAudioProcessor()
 
 void AfeAudioProcessor::Initialize(AudioCodec* codec) {
     codec_ = codec;
-    int ref_num = codec_->input_reference() ? 1 : 0;
 
-    std::string input_format;
-    for (int i = 0; i < codec_->input_channels() - ref_num; i++) {
-        input_format.push_back('M');
-    }
-    for (int i = 0; i < ref_num; i++) {
-        input_format.push_back('R');
-    }
+    std::string input_format = codec_->input_format();
 
     srmodel_list_t *models = esp_srmodel_init("model");
     char* ns_model_name = esp_srmodel_filter(models, ESP_NSNET_PREFIX, NULL);
@@ -50,6 +43,10 @@ void AfeAudioProcessor::Initialize(AudioCodec* codec) {
     afe_config->aec_init = false;
     afe_config->vad_init = true;
 #endif
+#if CONFIG_USE_BARGE_IN
+    // Barge-in listens through the playback, which needs the echo removed
+    afe_config->aec_init = codec_->input_reference();
+#endif
 
     afe_iface_ = esp_afe_handle_from_config(afe_config);
     afe_data_ = afe_iface_->create_from_config(afe_config);
@@ -151,7 +148,10 @@ void AfeAudioProcessor::EnableDeviceAec(bool enable) {
         ESP_LOGE(TAG, "Device AEC is not supported");
 #endif
     } else {
+        // Barge-in keeps the AEC running with the AEC mode off, see USE_BARGE_IN in Kconfig
+#if !CONFIG_USE_BARGE_IN
         afe_iface_->disable_aec(afe_data_);
+#endif
         afe_iface_->enable_vad(afe_data_);
     }
 }
@@ -32,7 +32,6 @@ AfeWakeWord::~AfeWakeWord() {
 
 void AfeWakeWord::Initialize(AudioCodec* codec) {
     codec_ = codec;
-    int ref_num = codec_->input_reference() ? 1 : 0;
 
     srmodel_list_t *models = esp_srmodel_init("model");
     for (int i = 0; i < models->num; i++) {
@@ -49,13 +48,7 @@ void AfeWakeWord::Initialize(AudioCodec* codec) {
         }
     }
 
-    std::string input_format;
-    for (int i = 0; i < codec_->input_channels() - ref_num; i++) {
-        input_format.push_back('M');
-    }
-    for (int i = 0; i < ref_num; i++) {
-        input_format.push_back('R');
-    }
+    std::string input_format = codec_->input_format();
     afe_config_t* afe_config = afe_config_init(input_format.c_str(), models, AFE_TYPE_SR, AFE_MODE_HIGH_PERF);
     afe_config->aec_init = codec_->input_reference();
     afe_config->aec_mode = AEC_MODE_SR_HIGH_PERF;
@@ -99,6 +92,19 @@ void AfeWakeWord::Feed(const std::vector<int16_t>& data) {
     afe_iface_->feed(afe_data_, data.data());
 }
 
+bool AfeWakeWord::SetDetectionThreshold(float threshold) {
+    if (afe_data_ == nullptr) {
+        return false;
+    }
+    bool ok = true;
+    for (int i = 1; i <= (int)wake_words_.size(); i++) {
+        int ret = threshold > 0 ? afe_iface_->set_wakenet_threshold(afe_data_, i, threshold)
+                                : afe_iface_->reset_wakenet_threshold(afe_data_, i);
+        ok = ok && ret >= 0;
+    }
+    return ok;
+}
+
 size_t AfeWakeWord::GetFeedSize() {
     if (afe_data_ == nullptr) {
         return 0;
@@ -33,6 +33,8 @@ public:
     void EncodeWakeWordData();
     bool GetWakeWordOpus(std::vector<uint8_t>& opus);
     const std::string& GetLastDetectedWakeWord() const { return last_detected_wake_word_; }
+    bool SetDetectionThreshold(float threshold);
+    std::string GetModelName() const { return wakenet_model_ != nullptr ? wakenet_model_ : ""; }
 
 private:
     esp_afe_sr_iface_t* afe_iface_ = nullptr;
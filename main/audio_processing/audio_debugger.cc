@@ -3,11 +3,13 @@
 
 #if CONFIG_USE_AUDIO_DEBUGGER
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <errno.h>
 #include <cstring>
 #include <string>
+#include <algorithm>
 #endif
 
 #define TAG "AudioDebugger"
@@ -51,18 +53,43 @@ AudioDebugger::~AudioDebugger() {
 #endif
 }
 
-void AudioDebugger::Feed(const std::vector<int16_t>& data) {
+void AudioDebugger::Feed(AudioDebugStream stream, const std::vector<int16_t>& data, int channels, int sample_rate) {
 #if CONFIG_USE_AUDIO_DEBUGGER
-    if (udp_sockfd_ >= 0) {
-        ssize_t sent = sendto(udp_sockfd_, data.data(), data.size() * sizeof(int16_t), 0,
+    if (udp_sockfd_ < 0 || data.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Frames are fed right after they were read or written, so the first
+    // sample is one frame duration in the past
+    size_t total_frames = data.size() / channels;
+    int64_t start_time = esp_timer_get_time() - (int64_t)total_frames * 1000000 / sample_rate;
+    size_t frames_per_packet = AUDIO_DEBUG_MAX_PAYLOAD / (channels * sizeof(int16_t));
+
+    auto header = (AudioDebugHeader*)packet_;
+    header->magic = AUDIO_DEBUG_MAGIC;
+    header->version = AUDIO_DEBUG_VERSION;
+    header->stream = stream;
+    header->channels = channels;
+    header->reserved = 0;
+    header->sample_rate = sample_rate;
+
+    for (size_t offset = 0; offset < total_frames; offset += frames_per_packet) {
+        size_t frames = std::min(frames_per_packet, total_frames - offset);
+        size_t payload_size = frames * channels * sizeof(int16_t);
+        header->sequence = sequence_[stream]++;
+        header->timestamp_us = start_time + (int64_t)offset * 1000000 / sample_rate;
+        memcpy(packet_ + sizeof(AudioDebugHeader), data.data() + offset * channels, payload_size);
+
+        ssize_t sent = sendto(udp_sockfd_, packet_, sizeof(AudioDebugHeader) + payload_size, 0,
                              (struct sockaddr*)&udp_server_addr_, sizeof(udp_server_addr_));
         if (sent < 0) {
-            ESP_LOGW(TAG, "Failed to send audio data to %s: %d", CONFIG_AUDIO_DEBUG_UDP_SERVER, errno);
-        } else {
-            ESP_LOGD(TAG, "Sent %d bytes audio data to %s", sent, CONFIG_AUDIO_DEBUG_UDP_SERVER);
+            // The receiver sees the gap in the sequence numbers
+            if (send_failures_++ % 100 == 0) {
+                ESP_LOGW(TAG, "Failed to send audio data to %s: %d, %lu failures", CONFIG_AUDIO_DEBUG_UDP_SERVER,
+                    errno, (unsigned long)send_failures_);
+            }
         }
     }
 #endif
 }
-
- 
\ No newline at end of file
@@ -3,20 +3,49 @@
 
 #include <vector>
 #include <cstdint>
+#include <mutex>
 
 #include <sys/socket.h>
 #include <netinet/in.h>
 
+enum AudioDebugStream : uint8_t {
+    kAudioDebugStreamInput = 0,     // Codec input, mics and reference interleaved
+    kAudioDebugStreamProcessed = 1, // Audio processor output sent to the encoder
+    kAudioDebugStreamOutput = 2,    // Decoded audio written to the codec
+};
+
+#define AUDIO_DEBUG_MAGIC 0x47424441  // "ADBG"
+#define AUDIO_DEBUG_VERSION 1
+#define AUDIO_DEBUG_MAX_PAYLOAD 1400
+
+// Every UDP packet starts with this header, followed by 16-bit little endian
+// interleaved PCM. Frames larger than AUDIO_DEBUG_MAX_PAYLOAD are split, so the
+// receiver can detect loss from gaps in the per-stream sequence numbers.
+struct __attribute__((packed)) AudioDebugHeader {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t stream;
+    uint8_t channels;
+    uint8_t reserved;
+    uint32_t sequence;      // Per stream, increments by one per packet
+    uint32_t sample_rate;
+    int64_t timestamp_us;   // esp_timer time of the first sample in the packet
+};
+
 class AudioDebugger {
 public:
     AudioDebugger();
     ~AudioDebugger();
 
-    void Feed(const std::vector<int16_t>& data);
+    void Feed(AudioDebugStream stream, const std::vector<int16_t>& data, int channels, int sample_rate);
 
 private:
     int udp_sockfd_ = -1;
     struct sockaddr_in udp_server_addr_;
+    std::mutex mutex_;
+    uint32_t sequence_[3] = {};
+    uint32_t send_failures_ = 0;
+    uint8_t packet_[sizeof(AudioDebugHeader) + AUDIO_DEBUG_MAX_PAYLOAD];
 };
 
-#endif 
\ No newline at end of file
+#endif 
@@ -0,0 +1,122 @@
+#include "barge_in_detector.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define BARGE_IN_FRAME_MS 10
+
+// The playback level is measured when audio is decoded, ahead of the speaker
+// and the AFE; holding the peak covers that delay and the echo tail
+#define PLAYBACK_RELEASE_DB_PER_FRAME 1.0f
+#define PLAYBACK_ACTIVE_DB -60.0f
+
+// Residual echo gain: learn a stronger leak quickly during the holdoff, then
+// only slowly, since the user's first syllables also look like a stronger leak
+#define ECHO_GAIN_HOLDOFF_ATTACK 0.1f
+#define ECHO_GAIN_ATTACK 0.005f
+#define ECHO_GAIN_RELEASE 0.01f
+
+#define NOISE_FLOOR_RELEASE 0.3f
+#define NOISE_FLOOR_ATTACK 0.02f
+
+// Non-speech frames take back half a frame of score, so speech with short
+// pauses still adds up while isolated frames never do
+#define SCORE_DECAY_MS (BARGE_IN_FRAME_MS / 2)
+
+BargeInDetector::BargeInDetector(const BargeInDetectorConfig& config)
+    : config_(config), frame_samples_(config.sample_rate * BARGE_IN_FRAME_MS / 1000) {
+    Reset();
+}
+
+void BargeInDetector::Reset() {
+    frame_energy_ = 0;
+    frame_fill_ = 0;
+    elapsed_ms_ = 0;
+    playback_start_ms_ = -1;
+    score_ms_ = 0;
+    trigger_ms_ = -1;
+    noise_floor_valid_ = false;
+    echo_gain_db_ = config_.initial_echo_gain_db;
+    playback_db_ = -100.0f;
+    triggered_ = false;
+}
+
+float BargeInDetector::LevelDb(const int16_t* samples, size_t count) {
+    if (count == 0) {
+        return -100.0f;
+    }
+    int64_t energy = 0;
+    for (size_t i = 0; i < count; i++) {
+        energy += (int32_t)samples[i] * samples[i];
+    }
+    return 10.0f * log10f((float)energy / count / (32768.0f * 32768.0f) + 1e-10f);
+}
+
+bool BargeInDetector::Feed(const int16_t* samples, size_t count, float playback_db) {
+    if (triggered_) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        frame_energy_ += (int32_t)samples[i] * samples[i];
+        if (++frame_fill_ < frame_samples_) {
+            continue;
+        }
+        float mean_square = (float)frame_energy_ / frame_fill_ / (32768.0f * 32768.0f);
+        frame_energy_ = 0;
+        frame_fill_ = 0;
+        if (ProcessFrame(10.0f * log10f(mean_square + 1e-10f), playback_db)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BargeInDetector::ProcessFrame(float energy_db, float playback_db) {
+    elapsed_ms_ += BARGE_IN_FRAME_MS;
+    playback_db_ = std::max(playback_db, playback_db_ - PLAYBACK_RELEASE_DB_PER_FRAME);
+    bool playing = playback_db_ > PLAYBACK_ACTIVE_DB;
+    if (playing && playback_start_ms_ < 0) {
+        playback_start_ms_ = elapsed_ms_;
+    }
+    if (!noise_floor_valid_) {
+        noise_floor_db_ = energy_db;
+        noise_floor_valid_ = true;
+    }
+
+    float echo_db = playback_db_ + echo_gain_db_;
+    bool speech = energy_db > std::max(noise_floor_db_ + config_.energy_margin_db, config_.min_energy_db)
+        && (!playing || energy_db > echo_db + config_.echo_margin_db);
+
+    // Assume the user lets the first words play, so the holdoff only trains the estimates.
+    // The device is already speaking while it waits for the first audio, so the
+    // holdoff is counted from the first played frame rather than from Reset
+    bool holdoff = playback_start_ms_ < 0 || elapsed_ms_ - playback_start_ms_ < config_.holdoff_ms;
+    if (!speech || holdoff) {
+        if (playing) {
+            float gain = energy_db - playback_db_;
+            float attack = holdoff ? ECHO_GAIN_HOLDOFF_ATTACK : ECHO_GAIN_ATTACK;
+            echo_gain_db_ += (gain - echo_gain_db_) * (gain > echo_gain_db_ ? attack : ECHO_GAIN_RELEASE);
+        }
+        // Residual echo must not raise the noise floor, but pauses in the playback may lower it
+        if (energy_db < noise_floor_db_) {
+            noise_floor_db_ += (energy_db - noise_floor_db_) * NOISE_FLOOR_RELEASE;
+        } else if (!playing) {
+            noise_floor_db_ += (energy_db - noise_floor_db_) * NOISE_FLOOR_ATTACK;
+        }
+    }
+    if (holdoff) {
+        return false;
+    }
+
+    if (speech) {
+        score_ms_ += BARGE_IN_FRAME_MS;
+    } else {
+        score_ms_ = std::max(0, score_ms_ - SCORE_DECAY_MS);
+    }
+    if (score_ms_ >= config_.trigger_ms) {
+        triggered_ = true;
+        trigger_ms_ = elapsed_ms_;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,66 @@
+#ifndef BARGE_IN_DETECTOR_H
+#define BARGE_IN_DETECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+struct BargeInDetectorConfig {
+    int sample_rate = 16000;
+    int trigger_ms = 240;           // Speech needed to interrupt, short gaps only slow it down
+    int holdoff_ms = 300;           // Ignored from the first played frame while the AEC adapts to it
+    float energy_margin_db = 12.0f; // Above the noise floor
+    float echo_margin_db = 6.0f;    // Above the estimated residual echo of the playback
+    float min_energy_db = -45.0f;   // dBFS, quieter frames are never speech
+    float initial_echo_gain_db = -20.0f;
+};
+
+// Spots the user talking over TTS playback in the AEC-cleaned microphone
+// signal. Besides the noise floor, every 10ms frame is compared against the
+// residual echo expected from the playback level: the detector learns how
+// much of the playback leaks through the AEC from frames that are not speech,
+// so loud TTS passages do not read as an interruption. Like EndpointDetector
+// it has no platform dependencies and is evaluated with scripts/audio_eval.
+class BargeInDetector {
+public:
+    explicit BargeInDetector(const BargeInDetectorConfig& config = BargeInDetectorConfig());
+
+    void Reset();
+    // playback_db is the level of the audio being played, -100 when silent.
+    // Returns true once, for the chunk in which the user is considered speaking
+    bool Feed(const int16_t* samples, size_t count, float playback_db);
+
+    bool IsTriggered() const { return triggered_; }
+    // Time from Reset to the trigger, -1 if not triggered; the holdoff only
+    // starts with the first frame of playback, so the trigger is at least
+    // holdoff_ms + trigger_ms after it
+    int trigger_ms() const { return trigger_ms_; }
+    // Time from the first played frame to the trigger, -1 if not triggered
+    int playback_trigger_ms() const {
+        return trigger_ms_ >= 0 && playback_start_ms_ >= 0 ? trigger_ms_ - playback_start_ms_ : -1;
+    }
+    float echo_gain_db() const { return echo_gain_db_; }
+    const BargeInDetectorConfig& config() const { return config_; }
+
+    // Level of a block of samples in dBFS
+    static float LevelDb(const int16_t* samples, size_t count);
+
+private:
+    BargeInDetectorConfig config_;
+    int frame_samples_;
+    int64_t frame_energy_ = 0;
+    int frame_fill_ = 0;
+
+    int elapsed_ms_ = 0;
+    int playback_start_ms_ = -1;    // elapsed_ms_ of the first played frame
+    int score_ms_ = 0;
+    int trigger_ms_ = -1;
+    float noise_floor_db_ = 0;
+    bool noise_floor_valid_ = false;
+    float echo_gain_db_ = 0;
+    float playback_db_ = -100.0f;
+    bool triggered_ = false;
+
+    bool ProcessFrame(float energy_db, float playback_db);
+};
+
+#endif
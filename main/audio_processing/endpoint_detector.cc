@@ -0,0 +1,89 @@
+#include "endpoint_detector.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define ENDPOINT_FRAME_MS 10
+
+// Noise floor tracking: follow quieter frames quickly and louder ones slowly.
+// Loud frames still move the floor, very slowly, so a steady noise that was
+// mistaken for speech is eventually absorbed instead of holding the turn open
+#define NOISE_FLOOR_RELEASE 0.3f
+#define NOISE_FLOOR_ATTACK 0.05f
+#define NOISE_FLOOR_SPEECH_ATTACK 0.002f
+
+EndpointDetector::EndpointDetector(const EndpointDetectorConfig& config)
+    : config_(config), frame_samples_(config.sample_rate * ENDPOINT_FRAME_MS / 1000) {
+}
+
+void EndpointDetector::Reset() {
+    frame_energy_ = 0;
+    frame_fill_ = 0;
+    elapsed_ms_ = 0;
+    speech_ms_ = 0;
+    silence_ms_ = 0;
+    speech_end_ms_ = -1;
+    endpoint_ms_ = -1;
+    noise_floor_valid_ = false;
+    speech_started_ = false;
+    endpoint_reached_ = false;
+}
+
+bool EndpointDetector::Feed(const int16_t* samples, size_t count, bool vad_speech) {
+    if (endpoint_reached_) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        frame_energy_ += (int32_t)samples[i] * samples[i];
+        if (++frame_fill_ < frame_samples_) {
+            continue;
+        }
+        float mean_square = (float)frame_energy_ / frame_fill_ / (32768.0f * 32768.0f);
+        frame_energy_ = 0;
+        frame_fill_ = 0;
+        if (ProcessFrame(10.0f * log10f(mean_square + 1e-10f), vad_speech)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool EndpointDetector::ProcessFrame(float energy_db, bool vad_speech) {
+    elapsed_ms_ += ENDPOINT_FRAME_MS;
+    if (!noise_floor_valid_) {
+        noise_floor_db_ = energy_db;
+        noise_floor_valid_ = true;
+    }
+
+    float speech_level = std::max(noise_floor_db_ + config_.energy_margin_db, config_.min_energy_db);
+    bool loud = energy_db > speech_level;
+    bool speech = loud && (vad_speech || !config_.use_vad);
+    float rate = energy_db < noise_floor_db_ ? NOISE_FLOOR_RELEASE
+        : (loud ? NOISE_FLOOR_SPEECH_ATTACK : NOISE_FLOOR_ATTACK);
+    noise_floor_db_ += (energy_db - noise_floor_db_) * rate;
+
+    if (speech) {
+        speech_ms_ += ENDPOINT_FRAME_MS;
+        silence_ms_ = 0;
+        speech_end_ms_ = elapsed_ms_;
+        if (speech_ms_ >= config_.min_speech_ms) {
+            speech_started_ = true;
+        }
+        return false;
+    }
+
+    silence_ms_ += ENDPOINT_FRAME_MS;
+    if (!speech_started_) {
+        // Clicks and short noises separated by a full hangover do not add up to speech
+        if (silence_ms_ >= config_.hangover_ms) {
+            speech_ms_ = 0;
+        }
+        return false;
+    }
+    if (silence_ms_ >= config_.hangover_ms) {
+        endpoint_reached_ = true;
+        endpoint_ms_ = elapsed_ms_;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,57 @@
+#ifndef ENDPOINT_DETECTOR_H
+#define ENDPOINT_DETECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+struct EndpointDetectorConfig {
+    int sample_rate = 16000;
+    int hangover_ms = 800;          // Trailing silence that ends the turn
+    int min_speech_ms = 300;        // Speech needed before an endpoint can be reported
+    float energy_margin_db = 9.0f;  // Frames this far above the noise floor count as speech
+    float min_energy_db = -55.0f;   // dBFS, quieter frames are always silence
+    bool use_vad = true;            // Require the VAD flag as well as the energy check
+};
+
+// Finds the end of the user's turn from the processed microphone signal.
+// Audio is evaluated in 10ms frames: a frame is speech when its energy is
+// above the tracked noise floor and, with use_vad, the AFE VAD reports speech.
+// Once enough speech has been heard, hangover_ms of continuous silence is the
+// endpoint. Has no platform dependencies so it can be evaluated on a host
+// with scripts/audio_eval.
+class EndpointDetector {
+public:
+    explicit EndpointDetector(const EndpointDetectorConfig& config = EndpointDetectorConfig());
+
+    void Reset();
+    // Returns true once, for the chunk in which the endpoint is reached
+    bool Feed(const int16_t* samples, size_t count, bool vad_speech);
+
+    bool IsSpeechStarted() const { return speech_started_; }
+    bool IsEndpointReached() const { return endpoint_reached_; }
+    // Time from Reset to the end of the last speech frame, and to the endpoint
+    int speech_end_ms() const { return speech_end_ms_; }
+    int endpoint_ms() const { return endpoint_ms_; }
+    float noise_floor_db() const { return noise_floor_db_; }
+    const EndpointDetectorConfig& config() const { return config_; }
+
+private:
+    EndpointDetectorConfig config_;
+    int frame_samples_;
+    int64_t frame_energy_ = 0;
+    int frame_fill_ = 0;
+
+    int elapsed_ms_ = 0;
+    int speech_ms_ = 0;
+    int silence_ms_ = 0;
+    int speech_end_ms_ = -1;
+    int endpoint_ms_ = -1;
+    float noise_floor_db_ = 0;
+    bool noise_floor_valid_ = false;
+    bool speech_started_ = false;
+    bool endpoint_reached_ = false;
+
+    bool ProcessFrame(float energy_db, bool vad_speech);
+};
+
+#endif
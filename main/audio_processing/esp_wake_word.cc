@@ -37,6 +37,7 @@ void EspWakeWord::Initialize(AudioCodec* codec) {
     char *model_name = wakenet_model_->model_name[0];
     wakenet_iface_ = (esp_wn_iface_t*)esp_wn_handle_from_name(model_name);
     wakenet_data_ = wakenet_iface_->create(model_name, DET_MODE_95);
+    model_name_ = model_name;
 
     int frequency = wakenet_iface_->get_samp_rate(wakenet_data_);
     int audio_chunksize = wakenet_iface_->get_samp_chunksize(wakenet_data_);
@@ -71,6 +72,22 @@ void EspWakeWord::Feed(const std::vector<int16_t>& data) {
     }
 }
 
+bool EspWakeWord::SetDetectionThreshold(float threshold) {
+    if (wakenet_data_ == nullptr) {
+        return false;
+    }
+    int words = wakenet_iface_->get_word_num(wakenet_data_);
+    if (default_thresholds_.empty()) {
+        for (int i = 1; i <= words; i++) {
+            default_thresholds_.push_back(wakenet_iface_->get_det_threshold(wakenet_data_, i));
+        }
+    }
+    for (int i = 1; i <= words; i++) {
+        wakenet_iface_->set_det_threshold(wakenet_data_, threshold > 0 ? threshold : default_thresholds_[i - 1], i);
+    }
+    return true;
+}
+
 size_t EspWakeWord::GetFeedSize() {
     if (wakenet_data_ == nullptr) {
         return 0;
@@ -34,6 +34,8 @@ public:
     void EncodeWakeWordData();
     bool GetWakeWordOpus(std::vector<uint8_t>& opus);
     const std::string& GetLastDetectedWakeWord() const { return last_detected_wake_word_; }
+    bool SetDetectionThreshold(float threshold);
+    std::string GetModelName() const { return model_name_; }
 
 private:
     esp_wn_iface_t *wakenet_iface_ = nullptr;
@@ -44,6 +46,8 @@ private:
 
     std::function<void(const std::string& wake_word)> wake_word_detected_callback_;
     std::string last_detected_wake_word_;
+    std::string model_name_;
+    std::vector<float> default_thresholds_;
 };
 
 #endif
@@ -1,5 +1,7 @@
 #include "no_audio_processor.h"
+#include "audio_channels.h"
 #include <esp_log.h>
+#include <algorithm>
 
 #define TAG "NoAudioProcessor"
 
@@ -11,8 +13,17 @@ void NoAudioProcessor::Feed(const std::vector<int16_t>& data) {
     if (!is_running_ || !output_callback_) {
         return;
     }
-    // 直接将输入数据传递给输出回调
-    output_callback_(std::vector<int16_t>(data));
+    int channels = codec_->input_channels();
+    if (channels == 1) {
+        // 直接将输入数据传递给输出回调
+        output_callback_(std::vector<int16_t>(data));
+        return;
+    }
+    // 多通道输入只输出第一个麦克风通道
+    int mic_channel = std::max(FindAudioChannel(codec_->input_format(), AUDIO_CHANNEL_MIC), 0);
+    std::vector<int16_t> mic(data.size() / channels);
+    DeinterleaveChannel(data.data(), channels, mic_channel, mic.data(), mic.size());
+    output_callback_(std::move(mic));
 }
 
 void NoAudioProcessor::Start() {
@@ -40,7 +51,7 @@ size_t NoAudioProcessor::GetFeedSize() {
         return 0;
     }
     // 返回一个固定的帧大小，比如 30ms 的数据
-    return 30 * codec_->input_sample_rate() / 1000;
+    return 30 * codec_->input_sample_rate() / 1000 * codec_->input_channels();
 }
 
 void NoAudioProcessor::EnableDeviceAec(bool enable) {
@@ -21,6 +21,10 @@ public:
     virtual void EncodeWakeWordData() = 0;
     virtual bool GetWakeWordOpus(std::vector<uint8_t>& opus) = 0;
     virtual const std::string& GetLastDetectedWakeWord() const = 0;
+
+    // Threshold for every wake word of the model, 0 restores the defaults
+    virtual bool SetDetectionThreshold(float threshold) { return false; }
+    virtual std::string GetModelName() const { return ""; }
 };
 
 #endif
@@ -0,0 +1,206 @@
+#include "wake_word_benchmark.h"
+#include "sdkconfig.h"
+
+#include <cstring>
+
+#if CONFIG_USE_WAKE_WORD_BENCHMARK
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_app_desc.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstddef>
+#include <algorithm>
+#endif
+
+#define TAG "WakeWordBenchmark"
+
+// Without packets for this long the benchmark ends and the microphone is fed again
+#define BENCHMARK_IDLE_TIMEOUT_US (10 * 1000 * 1000)
+
+WakeWordBenchmark::WakeWordBenchmark(WakeWord* wake_word, AudioCodec* codec)
+    : wake_word_(wake_word), codec_(codec) {
+#if CONFIG_USE_WAKE_WORD_BENCHMARK
+    sockfd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd_ < 0) {
+        ESP_LOGW(TAG, "Failed to create UDP socket: %d", errno);
+        return;
+    }
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(CONFIG_WAKE_WORD_BENCHMARK_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(sockfd_, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        ESP_LOGW(TAG, "Failed to bind UDP port %d: %d", CONFIG_WAKE_WORD_BENCHMARK_PORT, errno);
+        close(sockfd_);
+        sockfd_ = -1;
+        return;
+    }
+    struct timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
+    setsockopt(sockfd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    xTaskCreate([](void* arg) {
+        static_cast<WakeWordBenchmark*>(arg)->ServerTask();
+        vTaskDelete(NULL);
+    }, "wake_word_bench", 4096 * 2, this, 2, nullptr);
+    ESP_LOGI(TAG, "Listening on UDP port %d", CONFIG_WAKE_WORD_BENCHMARK_PORT);
+#endif
+}
+
+WakeWordBenchmark::~WakeWordBenchmark() {
+#if CONFIG_USE_WAKE_WORD_BENCHMARK
+    if (sockfd_ >= 0) {
+        close(sockfd_);
+    }
+#endif
+}
+
+bool WakeWordBenchmark::OnWakeWordDetected(const std::string& wake_word) {
+    if (!running_) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ack_.detections++;
+        ack_.detection_sample = samples_fed_;
+        strncpy(ack_.wake_word, wake_word.c_str(), sizeof(ack_.wake_word) - 1);
+    }
+    // Both implementations stop after a detection, keep going through the corpus
+    wake_word_->StartDetection();
+    return true;
+}
+
+void WakeWordBenchmark::ServerTask() {
+#if CONFIG_USE_WAKE_WORD_BENCHMARK
+    std::vector<uint8_t> packet(sizeof(WakeWordBenchmarkHeader) + WAKE_WORD_BENCHMARK_MAX_SAMPLES * sizeof(int16_t));
+    std::vector<uint8_t> reply;
+    int64_t last_packet_time = 0;
+
+    while (true) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int len = recvfrom(sockfd_, packet.data(), packet.size(), 0, (struct sockaddr*)&from, &from_len);
+        if (len < (int)sizeof(WakeWordBenchmarkHeader)) {
+            if (running_ && esp_timer_get_time() - last_packet_time > BENCHMARK_IDLE_TIMEOUT_US) {
+                Stop();
+            }
+            continue;
+        }
+        auto header = reinterpret_cast<const WakeWordBenchmarkHeader*>(packet.data());
+        if (header->magic != WAKE_WORD_BENCHMARK_MAGIC) {
+            continue;
+        }
+        last_packet_time = esp_timer_get_time();
+
+        // Lost reply, send it again without processing the packet twice
+        if (header->sequence == last_sequence_ && !last_reply_.empty()) {
+            sendto(sockfd_, last_reply_.data(), last_reply_.size(), 0, (struct sockaddr*)&from, from_len);
+            continue;
+        }
+
+        const uint8_t* payload = packet.data() + sizeof(WakeWordBenchmarkHeader);
+        size_t payload_size = len - sizeof(WakeWordBenchmarkHeader);
+        if (header->type == kWakeWordBenchmarkStart && payload_size >= sizeof(float)) {
+            float threshold;
+            memcpy(&threshold, payload, sizeof(threshold));
+            Start(threshold, reply);
+        } else if (header->type == kWakeWordBenchmarkAudio && running_) {
+            FeedAudio(reinterpret_cast<const int16_t*>(payload), payload_size / sizeof(int16_t), reply);
+        } else {
+            continue;
+        }
+
+        auto reply_header = reinterpret_cast<WakeWordBenchmarkHeader*>(reply.data());
+        reply_header->magic = WAKE_WORD_BENCHMARK_MAGIC;
+        reply_header->sequence = header->sequence;
+        sendto(sockfd_, reply.data(), reply.size(), 0, (struct sockaddr*)&from, from_len);
+        last_sequence_ = header->sequence;
+        last_reply_ = reply;
+    }
+#endif
+}
+
+void WakeWordBenchmark::Start(float threshold, std::vector<uint8_t>& reply) {
+#if CONFIG_USE_WAKE_WORD_BENCHMARK
+    // Stopping also clears the AFE buffers, so nothing carries over from the previous file
+    wake_word_->StopDetection();
+    bool threshold_set = wake_word_->SetDetectionThreshold(threshold);
+    size_t feed_size = wake_word_->GetFeedSize();
+    feed_samples_ = feed_size / codec_->input_channels();
+    feed_buffer_.clear();
+    feed_buffer_.reserve(feed_size);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        samples_fed_ = 0;
+        ack_ = {};
+    }
+    if (!running_) {
+        ESP_LOGI(TAG, "Benchmark started, feed %u samples x %d channels",
+                 (unsigned)feed_samples_, codec_->input_channels());
+    }
+    running_ = feed_size > 0;
+    wake_word_->StartDetection();
+
+    WakeWordBenchmarkInfo info = {};
+    info.feed_samples = feed_samples_;
+    info.channels = codec_->input_channels();
+    info.threshold_set = threshold_set;
+    info.sample_rate = 16000;
+    strncpy(info.input_format, codec_->input_format().c_str(), sizeof(info.input_format) - 1);
+    strncpy(info.model, wake_word_->GetModelName().c_str(), sizeof(info.model) - 1);
+    strncpy(info.version, esp_app_get_description()->version, sizeof(info.version) - 1);
+
+    reply.assign(sizeof(WakeWordBenchmarkHeader) + sizeof(info), 0);
+    reply[offsetof(WakeWordBenchmarkHeader, type)] = kWakeWordBenchmarkInfo;
+    memcpy(reply.data() + sizeof(WakeWordBenchmarkHeader), &info, sizeof(info));
+#endif
+}
+
+void WakeWordBenchmark::FeedAudio(const int16_t* samples, size_t count, std::vector<uint8_t>& reply) {
+#if CONFIG_USE_WAKE_WORD_BENCHMARK
+    size_t feed_size = feed_samples_ * codec_->input_channels();
+    uint32_t feed_us = 0;
+    while (count > 0) {
+        size_t n = std::min(count, feed_size - feed_buffer_.size());
+        feed_buffer_.insert(feed_buffer_.end(), samples, samples + n);
+        samples += n;
+        count -= n;
+        if (feed_buffer_.size() == feed_size) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                samples_fed_ += feed_samples_;
+                ack_.frames++;
+            }
+            auto start_time = esp_timer_get_time();
+            wake_word_->Feed(feed_buffer_);
+            feed_us += esp_timer_get_time() - start_time;
+            feed_buffer_.clear();
+        }
+    }
+
+    WakeWordBenchmarkAck ack;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ack = ack_;
+    }
+    ack.feed_us = feed_us;
+    reply.assign(sizeof(WakeWordBenchmarkHeader) + sizeof(ack), 0);
+    reply[offsetof(WakeWordBenchmarkHeader, type)] = kWakeWordBenchmarkAck;
+    memcpy(reply.data() + sizeof(WakeWordBenchmarkHeader), &ack, sizeof(ack));
+#endif
+}
+
+void WakeWordBenchmark::Stop() {
+#if CONFIG_USE_WAKE_WORD_BENCHMARK
+    ESP_LOGI(TAG, "Benchmark finished, restoring microphone input");
+    running_ = false;
+    last_sequence_ = UINT32_MAX;
+    last_reply_.clear();
+    wake_word_->SetDetectionThreshold(0);
+    wake_word_->StartDetection();
+#endif
+}
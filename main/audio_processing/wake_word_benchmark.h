@@ -0,0 +1,83 @@
+#ifndef WAKE_WORD_BENCHMARK_H
+#define WAKE_WORD_BENCHMARK_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "audio_codec.h"
+#include "wake_word.h"
+
+enum WakeWordBenchmarkPacket : uint8_t {
+    kWakeWordBenchmarkStart = 1,    // Host: reset detection, payload is a float threshold (0 = default)
+    kWakeWordBenchmarkInfo = 2,     // Device: reply to start, WakeWordBenchmarkInfo
+    kWakeWordBenchmarkAudio = 3,    // Host: interleaved PCM in the codec input layout
+    kWakeWordBenchmarkAck = 4,      // Device: reply to audio, WakeWordBenchmarkAck
+};
+
+#define WAKE_WORD_BENCHMARK_MAGIC 0x42575757  // "WWWB"
+#define WAKE_WORD_BENCHMARK_MAX_SAMPLES 640
+
+// Every packet is answered, the host waits for the reply before sending the
+// next one and resends on timeout. Replies to a repeated sequence number are
+// sent again without feeding the audio twice.
+struct __attribute__((packed)) WakeWordBenchmarkHeader {
+    uint32_t magic;
+    uint8_t type;
+    uint8_t reserved[3];
+    uint32_t sequence;
+};
+
+struct __attribute__((packed)) WakeWordBenchmarkInfo {
+    uint16_t feed_samples;      // Per channel, the chunk passed to WakeWord::Feed
+    uint8_t channels;
+    uint8_t threshold_set;
+    uint32_t sample_rate;
+    char input_format[8];
+    char model[32];
+    char version[32];
+};
+
+struct __attribute__((packed)) WakeWordBenchmarkAck {
+    uint32_t frames;            // Chunks fed since start
+    uint32_t feed_us;           // Time spent in Feed for this packet, 0 if no chunk completed
+    uint32_t detections;        // Detections since start
+    uint32_t detection_sample;  // Samples per channel fed when the last detection was reported
+    char wake_word[32];
+};
+
+// Replays audio streamed by scripts/wake_word_benchmark.py through the wake word
+// feed path with the device chunk size. While a benchmark is running the
+// microphone is not fed and detections are reported to the host only.
+class WakeWordBenchmark {
+public:
+    WakeWordBenchmark(WakeWord* wake_word, AudioCodec* codec);
+    ~WakeWordBenchmark();
+
+    bool IsRunning() const { return running_; }
+    // Returns true when the detection belongs to the benchmark
+    bool OnWakeWordDetected(const std::string& wake_word);
+
+private:
+    WakeWord* wake_word_;
+    AudioCodec* codec_;
+    int sockfd_ = -1;
+    std::atomic<bool> running_ = false;
+    std::mutex mutex_;
+
+    std::vector<int16_t> feed_buffer_;
+    size_t feed_samples_ = 0;           // Per channel
+    uint32_t last_sequence_ = UINT32_MAX;
+    std::vector<uint8_t> last_reply_;
+    uint32_t samples_fed_ = 0;          // Per channel, since start
+    WakeWordBenchmarkAck ack_ = {};
+
+    void ServerTask();
+    void Start(float threshold, std::vector<uint8_t>& reply);
+    void FeedAudio(const int16_t* samples, size_t count, std::vector<uint8_t>& reply);
+    void Stop();
+};
+
+#endif
@@ -4,19 +4,45 @@
 #include "assets/lang_config.h"
 #include "settings.h"
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <wifi_station.h>
+#include <ssid_manager.h>
 
 static const char *TAG = "DualNetworkBoard";
 
-DualNetworkBoard::DualNetworkBoard(gpio_num_t ml307_tx_pin, gpio_num_t ml307_rx_pin, size_t ml307_rx_buffer_size, int32_t default_net_type) 
-    : Board(), 
-      ml307_tx_pin_(ml307_tx_pin), 
-      ml307_rx_pin_(ml307_rx_pin), 
+#define LINK_PROBE_INTERVAL_MS 3000
+#define LINK_PROBE_TIMEOUT_MS 1000
+// 连续探测失败次数达到后认为链路故障
+#define LINK_FAILURE_THRESHOLD 3
+// 首选链路恢复后需连续探测成功的次数，避免来回切换
+#define LINK_RECOVERY_THRESHOLD 10
+// 两次自动切换之间的最小间隔
+#define LINK_MIN_DWELL_MS 30000
+// ML307 信号低于该值时视为不可用
+#define LINK_MIN_CSQ 5
+
+#define DEFAULT_PROBE_HOST "223.5.5.5"
+#define PROBE_PORT 53
+
+#define PROBE_RESPONSE_EVENT (1 << 0)
+#define SWITCH_REQUEST_EVENT (1 << 1)
+
+static NetworkType OtherNetwork(NetworkType type) {
+    return type == NetworkType::WIFI ? NetworkType::ML307 : NetworkType::WIFI;
+}
+
+DualNetworkBoard::DualNetworkBoard(gpio_num_t ml307_tx_pin, gpio_num_t ml307_rx_pin, size_t ml307_rx_buffer_size, int32_t default_net_type)
+    : Board(),
+      ml307_tx_pin_(ml307_tx_pin),
+      ml307_rx_pin_(ml307_rx_pin),
       ml307_rx_buffer_size_(ml307_rx_buffer_size) {
-    
+
     // 从Settings加载网络类型
     network_type_ = LoadNetworkTypeFromSettings(default_net_type);
-    
-    // 只初始化当前网络类型对应的板卡
+    preferred_type_ = network_type_.load();
+    event_group_ = xEventGroupCreate();
+
+    // 只初始化当前网络类型对应的板卡，备用链路在网络启动后再初始化
     InitializeCurrentBoard();
 }
 
@@ -33,73 +59,281 @@ void DualNetworkBoard::SaveNetworkTypeToSettings(NetworkType type) {
 }
 
 void DualNetworkBoard::InitializeCurrentBoard() {
-    if (network_type_ == NetworkType::ML307) {
-        ESP_LOGI(TAG, "Initialize ML307 board");
-        current_board_ = std::make_unique<Ml307Board>(ml307_tx_pin_, ml307_rx_pin_, ml307_rx_buffer_size_);
-    } else {
+    current_board_ = GetBoard(network_type_);
+}
+
+Board* DualNetworkBoard::GetBoard(NetworkType type) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (type == NetworkType::ML307) {
+        if (ml307_board_ == nullptr) {
+            ESP_LOGI(TAG, "Initialize ML307 board");
+            ml307_board_ = std::make_unique<Ml307Board>(ml307_tx_pin_, ml307_rx_pin_, ml307_rx_buffer_size_);
+        }
+        return ml307_board_.get();
+    }
+    if (wifi_board_ == nullptr) {
         ESP_LOGI(TAG, "Initialize WiFi board");
-        current_board_ = std::make_unique<WifiBoard>();
+        wifi_board_ = std::make_unique<WifiBoard>();
     }
+    return wifi_board_.get();
 }
 
 void DualNetworkBoard::SwitchNetworkType() {
     auto display = GetDisplay();
-    if (network_type_ == NetworkType::WIFI) {    
-        SaveNetworkTypeToSettings(NetworkType::ML307);
-        display->ShowNotification(Lang::Strings::SWITCH_TO_4G_NETWORK);
-    } else {
-        SaveNetworkTypeToSettings(NetworkType::WIFI);
-        display->ShowNotification(Lang::Strings::SWITCH_TO_WIFI_NETWORK);
-    }
-    vTaskDelay(pdMS_TO_TICKS(1000));
     auto& app = Application::GetInstance();
-    app.Reboot();
+    auto target = OtherNetwork(network_type_);
+    SaveNetworkTypeToSettings(target);
+    display->ShowNotification(target == NetworkType::ML307 ? Lang::Strings::SWITCH_TO_4G_NETWORK : Lang::Strings::SWITCH_TO_WIFI_NETWORK);
+
+    // 启动或配网阶段网络尚未就绪，未配置WiFi时需要进入配网模式，这些情况仍通过重启切换
+    auto device_state = app.GetDeviceState();
+    bool no_wifi = target == NetworkType::WIFI && SsidManager::GetInstance().GetSsidList().empty();
+    if (monitor_task_ == nullptr || no_wifi ||
+        device_state == kDeviceStateStarting || device_state == kDeviceStateWifiConfiguring) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        app.Reboot();
+        return;
+    }
+
+    // 由监测任务在目标链路就绪后热切换
+    preferred_type_ = target;
+    switch_requested_ = true;
+    xEventGroupSetBits(event_group_, SWITCH_REQUEST_EVENT);
 }
 
- 
+
 std::string DualNetworkBoard::GetBoardType() {
-    return current_board_->GetBoardType();
+    return current_board_.load()->GetBoardType();
 }
 
 void DualNetworkBoard::StartNetwork() {
     auto display = Board::GetInstance().GetDisplay();
-    
+
     if (network_type_ == NetworkType::WIFI) {
         display->SetStatus(Lang::Strings::CONNECTING);
     } else {
         display->SetStatus(Lang::Strings::DETECTING_MODULE);
     }
-    current_board_->StartNetwork();
+    current_board_.load()->StartNetwork();
+    started_[(int)network_type_.load()] = true;
+    last_switch_time_ = esp_timer_get_time();
+
+    Settings settings("network");
+    if (settings.GetInt("failover", 1) == 0) {
+        ESP_LOGI(TAG, "Network failover is disabled");
+        return;
+    }
+    probe_host_ = settings.GetString("probe_host", DEFAULT_PROBE_HOST);
+
+    xTaskCreate([](void* arg) {
+        auto board = (DualNetworkBoard*)arg;
+        board->MonitorTask();
+        vTaskDelete(NULL);
+    }, "net_monitor", 4096, this, 2, &monitor_task_);
+}
+
+void DualNetworkBoard::StartStandbyNetwork() {
+    auto standby = OtherNetwork(network_type_);
+    if (standby == NetworkType::WIFI) {
+        // 备用WiFi只在后台连接已保存的网络，不进入配网模式
+        if (SsidManager::GetInstance().GetSsidList().empty()) {
+            ESP_LOGI(TAG, "No WiFi configured, failover to WiFi is unavailable");
+            return;
+        }
+        GetBoard(NetworkType::WIFI);
+        WifiStation::GetInstance().Start();
+    } else {
+        // 只注册和附着网络，不改状态栏、不弹错误、不改设备状态，注册后模组进入休眠直到切换
+        GetBoard(NetworkType::ML307);
+        if (!ml307_board_->StartStandby()) {
+            return;
+        }
+    }
+    started_[(int)standby] = true;
+    ESP_LOGI(TAG, "Standby %s network started", standby == NetworkType::WIFI ? "WiFi" : "ML307");
+}
+
+bool DualNetworkBoard::ProbeWifi(int& rtt_ms) {
+    if (probe_udp_ == nullptr) {
+        probe_udp_ = wifi_board_->CreateUdp();
+        probe_udp_->OnMessage([this](const std::string& data) {
+            if (data.size() >= 2 && (((uint8_t)data[0] << 8) | (uint8_t)data[1]) == probe_id_) {
+                xEventGroupSetBits(event_group_, PROBE_RESPONSE_EVENT);
+            }
+        });
+        if (!probe_udp_->Connect(probe_host_, PROBE_PORT)) {
+            delete probe_udp_;
+            probe_udp_ = nullptr;
+            return false;
+        }
+    }
+
+    // 最小的DNS查询 (根域 NS 记录)，任何DNS服务器都会应答
+    uint16_t id = ++probe_id_;
+    std::string query = {
+        (char)(id >> 8), (char)(id & 0xFF), 0x01, 0x00,     // id, flags: recursion desired
+        0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,     // 1 question
+        0x00, 0x00, 0x02, 0x00, 0x01,                       // root, type NS, class IN
+    };
+    xEventGroupClearBits(event_group_, PROBE_RESPONSE_EVENT);
+    auto start_time = esp_timer_get_time();
+    if (probe_udp_->Send(query) <= 0) {
+        delete probe_udp_;
+        probe_udp_ = nullptr;
+        return false;
+    }
+    auto bits = xEventGroupWaitBits(event_group_, PROBE_RESPONSE_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(LINK_PROBE_TIMEOUT_MS));
+    if (!(bits & PROBE_RESPONSE_EVENT)) {
+        return false;
+    }
+    rtt_ms = (esp_timer_get_time() - start_time) / 1000;
+    return true;
+}
+
+void DualNetworkBoard::UpdateLinkHealth(NetworkType type) {
+    auto& health = health_[(int)type];
+    bool success = false;
+    int rtt_ms = -1;
+    if (!started_[(int)type]) {
+        health.ready = false;
+    } else if (type == NetworkType::WIFI) {
+        health.ready = WifiStation::GetInstance().IsConnected();
+        if (health.ready) {
+            success = ProbeWifi(rtt_ms);
+        }
+    } else if (network_type_ != NetworkType::ML307) {
+        // 备用模组处于休眠，不发AT命令唤醒它，只看注册状态
+        health.ready = ml307_board_->IsNetworkReady();
+        success = health.ready;
+    } else {
+        // ML307 的 UDP 连接号与音频通道共用，不能额外探测，只根据注册状态和信号质量判断
+        int csq = ml307_board_->GetSignalQuality();
+        health.ready = csq >= 0;
+        success = csq >= LINK_MIN_CSQ && csq <= 31;
+    }
+
+    if (success) {
+        health.consecutive_failures = 0;
+        health.consecutive_successes++;
+        health.loss_percent = health.loss_percent * 7 / 8;
+        if (rtt_ms >= 0) {
+            health.rtt_ms = health.rtt_ms < 0 ? rtt_ms : (health.rtt_ms * 7 + rtt_ms) / 8;
+        }
+    } else {
+        health.consecutive_successes = 0;
+        health.consecutive_failures++;
+        health.loss_percent = (health.loss_percent * 7 + 100) / 8;
+        // 连续失败后重建探测socket，链路重连后旧socket可能已失效
+        if (type == NetworkType::WIFI && health.consecutive_failures >= LINK_FAILURE_THRESHOLD && probe_udp_ != nullptr) {
+            delete probe_udp_;
+            probe_udp_ = nullptr;
+        }
+    }
+}
+
+bool DualNetworkBoard::IsHealthy(NetworkType type) const {
+    auto& health = health_[(int)type];
+    return health.ready && health.consecutive_failures < LINK_FAILURE_THRESHOLD;
+}
+
+void DualNetworkBoard::ActivateNetwork(NetworkType type) {
+    if (type == network_type_) {
+        return;
+    }
+    auto& from = health_[(int)network_type_.load()];
+    auto& to = health_[(int)type];
+    ESP_LOGW(TAG, "Switch network to %s (rtt %d ms, loss %d%%), previous link rtt %d ms, loss %d%%",
+        type == NetworkType::WIFI ? "WiFi" : "ML307", to.rtt_ms, to.loss_percent, from.rtt_ms, from.loss_percent);
+
+    // 切换前唤醒备用模组，切走后让它重新休眠
+    if (type == NetworkType::ML307) {
+        ml307_board_->SetStandby(false);
+    } else if (started_[(int)NetworkType::ML307]) {
+        ml307_board_->SetStandby(true);
+    }
+
+    // 已建立的连接仍属于旧板卡，新的连接从新板卡创建
+    current_board_ = GetBoard(type);
+    network_type_ = type;
+    last_switch_time_ = esp_timer_get_time();
+
+    auto display = GetDisplay();
+    display->ShowNotification(type == NetworkType::ML307 ? Lang::Strings::SWITCH_TO_4G_NETWORK : Lang::Strings::SWITCH_TO_WIFI_NETWORK);
+    Application::GetInstance().OnNetworkChanged();
+}
+
+void DualNetworkBoard::MonitorTask() {
+    // 备用链路注册可能需要几十秒，不阻塞对当前链路的监测
+    xTaskCreate([](void* arg) {
+        ((DualNetworkBoard*)arg)->StartStandbyNetwork();
+        vTaskDelete(NULL);
+    }, "net_standby", 4096, this, 2, nullptr);
+
+    while (true) {
+        xEventGroupWaitBits(event_group_, SWITCH_REQUEST_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(LINK_PROBE_INTERVAL_MS));
+        UpdateLinkHealth(NetworkType::WIFI);
+        UpdateLinkHealth(NetworkType::ML307);
+
+        auto active = network_type_.load();
+        auto standby = OtherNetwork(active);
+        auto preferred = preferred_type_.load();
+        ESP_LOGD(TAG, "WiFi: ready %d rtt %d loss %d%%, ML307: ready %d loss %d%%",
+            health_[0].ready, health_[0].rtt_ms, health_[0].loss_percent, health_[1].ready, health_[1].loss_percent);
+
+        // 用户手动切换，目标链路就绪即切换
+        if (switch_requested_) {
+            if (preferred == active) {
+                switch_requested_ = false;
+            } else if (health_[(int)preferred].ready) {
+                switch_requested_ = false;
+                ActivateNetwork(preferred);
+                continue;
+            }
+        }
+
+        // 当前链路故障，立即切换到可用的备用链路
+        if (!IsHealthy(active) && IsHealthy(standby)) {
+            ActivateNetwork(standby);
+            continue;
+        }
+
+        // 首选链路恢复稳定后切回
+        int64_t dwell_ms = (esp_timer_get_time() - last_switch_time_) / 1000;
+        if (active != preferred && health_[(int)preferred].consecutive_successes >= LINK_RECOVERY_THRESHOLD &&
+            dwell_ms >= LINK_MIN_DWELL_MS) {
+            ActivateNetwork(preferred);
+        }
+    }
 }
 
 Http* DualNetworkBoard::CreateHttp() {
-    return current_board_->CreateHttp();
+    return current_board_.load()->CreateHttp();
 }
 
 WebSocket* DualNetworkBoard::CreateWebSocket() {
-    return current_board_->CreateWebSocket();
+    return current_board_.load()->CreateWebSocket();
 }
 
 Mqtt* DualNetworkBoard::CreateMqtt() {
-    return current_board_->CreateMqtt();
+    return current_board_.load()->CreateMqtt();
 }
 
 Udp* DualNetworkBoard::CreateUdp() {
-    return current_board_->CreateUdp();
+    return current_board_.load()->CreateUdp();
 }
 
 const char* DualNetworkBoard::GetNetworkStateIcon() {
-    return current_board_->GetNetworkStateIcon();
+    return current_board_.load()->GetNetworkStateIcon();
 }
 
 void DualNetworkBoard::SetPowerSaveMode(bool enabled) {
-    current_board_->SetPowerSaveMode(enabled);
+    current_board_.load()->SetPowerSaveMode(enabled);
 }
 
-std::string DualNetworkBoard::GetBoardJson() {   
-    return current_board_->GetBoardJson();
+std::string DualNetworkBoard::GetBoardJson() {
+    return current_board_.load()->GetBoardJson();
 }
 
 std::string DualNetworkBoard::GetDeviceStatusJson() {
-    return current_board_->GetDeviceStatusJson();
+    return current_board_.load()->GetDeviceStatusJson();
 }
@@ -5,6 +5,11 @@
 #include "wifi_board.h"
 #include "ml307_board.h"
 #include <memory>
+#include <mutex>
+#include <atomic>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
 
 //enum NetworkType
 enum class NetworkType {
@@ -13,39 +18,73 @@ enum class NetworkType {
 };
 
 // 双网络板卡类，可以在WiFi和ML307之间切换
+// 启动后两条链路同时在线，后台任务持续探测链路质量，当前链路故障时热切换到备用链路，
+// 首选链路恢复并稳定一段时间后再切回，无需重启
 class DualNetworkBoard : public Board {
 private:
-    // 使用基类指针存储当前活动的板卡
-    std::unique_ptr<Board> current_board_;
-    NetworkType network_type_ = NetworkType::ML307;  // Default to ML307
+    // 链路质量统计
+    struct LinkHealth {
+        bool ready = false;             // 链路已注册/已连接
+        int rtt_ms = -1;                // 探测往返时延 (滑动平均)
+        int loss_percent = 0;           // 探测丢包率 (滑动平均)
+        int consecutive_failures = 0;
+        int consecutive_successes = 0;
+    };
+
+    // 两块板卡按需创建，创建后不再销毁，已创建的连接对象始终有效
+    std::unique_ptr<WifiBoard> wifi_board_;
+    std::unique_ptr<Ml307Board> ml307_board_;
+    std::atomic<Board*> current_board_ = nullptr;
+    std::atomic<NetworkType> network_type_ = NetworkType::ML307;  // Default to ML307
+    std::atomic<NetworkType> preferred_type_ = NetworkType::ML307;
+    std::mutex mutex_;
 
     // ML307的引脚配置
     gpio_num_t ml307_tx_pin_;
     gpio_num_t ml307_rx_pin_;
     size_t ml307_rx_buffer_size_;
-    
+
+    // 链路监测
+    TaskHandle_t monitor_task_ = nullptr;
+    EventGroupHandle_t event_group_ = nullptr;
+    LinkHealth health_[2];
+    std::atomic<bool> started_[2] = {};     // 备用链路在单独的任务中启动
+    std::atomic<bool> switch_requested_ = false;
+    int64_t last_switch_time_ = 0;
+    Udp* probe_udp_ = nullptr;
+    std::atomic<uint16_t> probe_id_ = 0;
+    std::string probe_host_;
+
     // 从Settings加载网络类型
     NetworkType LoadNetworkTypeFromSettings(int32_t default_net_type);
-    
+
     // 保存网络类型到Settings
     void SaveNetworkTypeToSettings(NetworkType type);
 
     // 初始化当前网络类型对应的板卡
     void InitializeCurrentBoard();
- 
+    Board* GetBoard(NetworkType type);
+
+    void MonitorTask();
+    void StartStandbyNetwork();
+    void UpdateLinkHealth(NetworkType type);
+    bool ProbeWifi(int& rtt_ms);
+    bool IsHealthy(NetworkType type) const;
+    void ActivateNetwork(NetworkType type);
+
 public:
     DualNetworkBoard(gpio_num_t ml307_tx_pin, gpio_num_t ml307_rx_pin, size_t ml307_rx_buffer_size = 4096, int32_t default_net_type = 1);
     virtual ~DualNetworkBoard() = default;
- 
+
     // 切换网络类型
     void SwitchNetworkType();
-    
+
     // 获取当前网络类型
     NetworkType GetNetworkType() const { return network_type_; }
-    
+
     // 获取当前活动的板卡引用
-    Board& GetCurrentBoard() const { return *current_board_; }
-    
+    Board& GetCurrentBoard() const { return *current_board_.load(); }
+
     // 重写Board接口
     virtual std::string GetBoardType() override;
     virtual void StartNetwork() override;
@@ -59,4 +98,4 @@ public:
     virtual std::string GetDeviceStatusJson() override;
 };
 
-#endif // DUAL_NETWORK_BOARD_H 
\ No newline at end of file
+#endif // DUAL_NETWORK_BOARD_H
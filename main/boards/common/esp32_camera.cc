@@ -7,11 +7,54 @@
 #include <esp_log.h>
 #include <esp_heap_caps.h>
 #include <img_converters.h>
+#include <esp_timer.h>
 #include <cstring>
+#include <algorithm>
 
 #define TAG "Esp32Camera"
 
-Esp32Camera::Esp32Camera(const camera_config_t& config) {
+// JPEG 数据按固定大小的块在编码线程和上传线程之间流转，在途块数量有上限
+#define JPEG_CHUNK_SIZE 4096
+#define JPEG_MAX_INFLIGHT_CHUNKS 4
+#define JPEG_DEFAULT_QUALITY 80
+// 期望单张图片的上传耗时
+#define EXPLAIN_UPLOAD_BUDGET_MS 1500
+
+// 可自动降级的分辨率，从高到低，只包含4:3的尺寸 (HVGA为3:2、HQVGA为15:11，降级会改变画面比例)
+static const framesize_t kAdaptiveFrameSizes[] = {
+    FRAMESIZE_SVGA, FRAMESIZE_VGA, FRAMESIZE_QVGA, FRAMESIZE_QQVGA,
+};
+
+// 各JPEG质量下每像素的大致压缩字节数 (x1000)，用于估算上传大小
+static const struct {
+    int quality;
+    int bytes_per_kilo_pixel;
+} kJpegQualityLevels[] = {
+    { 80, 160 },
+    { 60, 110 },
+    { 45, 85 },
+    { 30, 65 },
+};
+
+static size_t EstimateJpegSize(int width, int height, int bytes_per_kilo_pixel) {
+    return (size_t)width * height * bytes_per_kilo_pixel / 1000;
+}
+
+struct JpegEncoder {
+    QueueHandle_t free_queue;
+    QueueHandle_t full_queue;
+    JpegChunk current;
+    size_t total;
+};
+
+static void SubmitJpegChunk(JpegEncoder* encoder) {
+    xQueueSend(encoder->full_queue, &encoder->current, portMAX_DELAY);
+    encoder->current.data = nullptr;
+    encoder->current.len = 0;
+}
+
+Esp32Camera::Esp32Camera(const camera_config_t& config)
+    : max_frame_size_(config.frame_size), frame_size_(config.frame_size) {
     // camera init
     esp_err_t err = esp_camera_init(&config); // 配置上面定义的参数
     if (err != ESP_OK) {
@@ -81,6 +124,7 @@ Esp32Camera::Esp32Camera(const camera_config_t& config) {
         ESP_LOGE(TAG, "Failed to allocate memory for preview image");
         return;
     }
+    preview_capacity_ = preview_image_.data_size;
 }
 
 Esp32Camera::~Esp32Camera() {
@@ -100,11 +144,69 @@ void Esp32Camera::SetExplainUrl(const std::string& url, const std::string& token
     explain_token_ = token;
 }
 
+framesize_t Esp32Camera::SelectFrameSize() const {
+    bool adaptive = false;
+    for (auto frame_size : kAdaptiveFrameSizes) {
+        adaptive |= frame_size == max_frame_size_;
+    }
+    if (!adaptive || uplink_bytes_per_sec_ == 0) {
+        return max_frame_size_;
+    }
+
+    // 选择以最低JPEG质量也能在预算时间内上传完成的最高分辨率
+    size_t budget = (size_t)uplink_bytes_per_sec_ * EXPLAIN_UPLOAD_BUDGET_MS / 1000;
+    int lowest_rate = kJpegQualityLevels[sizeof(kJpegQualityLevels) / sizeof(kJpegQualityLevels[0]) - 1].bytes_per_kilo_pixel;
+    framesize_t selected = max_frame_size_;
+    for (auto frame_size : kAdaptiveFrameSizes) {
+        if (frame_size > max_frame_size_) {
+            continue;
+        }
+        selected = frame_size;
+        if (EstimateJpegSize(resolution[frame_size].width, resolution[frame_size].height, lowest_rate) <= budget) {
+            break;
+        }
+    }
+    return selected;
+}
+
+int Esp32Camera::SelectJpegQuality(int width, int height) const {
+    if (uplink_bytes_per_sec_ == 0) {
+        return JPEG_DEFAULT_QUALITY;
+    }
+    size_t budget = (size_t)uplink_bytes_per_sec_ * EXPLAIN_UPLOAD_BUDGET_MS / 1000;
+    for (auto& level : kJpegQualityLevels) {
+        if (EstimateJpegSize(width, height, level.bytes_per_kilo_pixel) <= budget) {
+            return level.quality;
+        }
+    }
+    return kJpegQualityLevels[sizeof(kJpegQualityLevels) / sizeof(kJpegQualityLevels[0]) - 1].quality;
+}
+
+void Esp32Camera::UpdateUplinkEstimate(size_t bytes, int64_t elapsed_us) {
+    if (bytes < JPEG_CHUNK_SIZE || elapsed_us <= 0) {
+        return;
+    }
+    uint32_t measured = (uint32_t)(bytes * 1000000ULL / elapsed_us);
+    // 指数滑动平均，新样本权重 1/2，既能快速跟随网络变化又不至于抖动
+    uplink_bytes_per_sec_ = uplink_bytes_per_sec_ == 0 ? measured : (uplink_bytes_per_sec_ + measured) / 2;
+}
+
 bool Esp32Camera::Capture() {
     if (encoder_thread_.joinable()) {
         encoder_thread_.join();
     }
 
+    auto start_time = esp_timer_get_time();
+    framesize_t frame_size = SelectFrameSize();
+    if (frame_size != frame_size_) {
+        sensor_t* s = esp_camera_sensor_get();
+        if (s != nullptr && s->set_framesize(s, frame_size) == 0) {
+            ESP_LOGI(TAG, "Frame size changed to %dx%d, uplink %lu B/s", resolution[frame_size].width,
+                resolution[frame_size].height, uplink_bytes_per_sec_);
+            frame_size_ = frame_size;
+        }
+    }
+
     int frames_to_get = 2;
     // Try to get a stable frame
     for (int i = 0; i < frames_to_get; i++) {
@@ -117,6 +219,7 @@ bool Esp32Camera::Capture() {
             return false;
         }
     }
+    capture_time_us_ = esp_timer_get_time() - start_time;
 
     // 如果预览图片 buffer 为空，则跳过预览
     // 但仍返回 true，因为此时图像可以上传至服务器
@@ -130,7 +233,12 @@ bool Esp32Camera::Capture() {
     }
     // 显示预览图片
     auto display = Board::GetInstance().GetDisplay();
-    if (display != nullptr) {
+    if (display != nullptr && fb_->len <= preview_capacity_) {
+        // 分辨率可能已自适应降低，预览尺寸跟随实际帧
+        preview_image_.header.w = fb_->width;
+        preview_image_.header.h = fb_->height;
+        preview_image_.header.stride = fb_->width * 2;
+        preview_image_.data_size = fb_->len;
         auto src = (uint16_t*)fb_->buf;
         auto dst = (uint16_t*)preview_image_.data;
         size_t pixel_count = fb_->len / 2;
@@ -186,7 +294,9 @@ bool Esp32Camera::SetVFlip(bool enabled) {
  * 实现特点：
  * - 使用独立线程编码JPEG，与主线程分离
  * - 采用分块传输编码(chunked transfer encoding)优化内存使用
- * - 通过队列机制实现编码线程和发送线程的数据同步
+ * - 通过固定大小的块池实现编码线程和发送线程的数据同步，限制在途数据量
+ * - 根据测得的上行带宽自适应选择JPEG质量，下一次Capture()据此调整分辨率
+ * - 分别统计拍摄、编码和上传耗时
  * - 支持设备ID、客户端ID和认证令牌的HTTP头部配置
  * 
  * @param question 要向AI提出的关于图像的问题，将作为表单字段发送
@@ -203,28 +313,83 @@ std::string Esp32Camera::Explain(const std::string& question) {
     if (explain_url_.empty()) {
         return "{\"success\": false, \"message\": \"Image explain URL or token is not set\"}";
     }
+    if (fb_ == nullptr) {
+        return "{\"success\": false, \"message\": \"No image captured\"}";
+    }
 
-    // 创建局部的 JPEG 队列, 40 entries is about to store 512 * 40 = 20480 bytes of JPEG data
-    QueueHandle_t jpeg_queue = xQueueCreate(40, sizeof(JpegChunk));
-    if (jpeg_queue == nullptr) {
-        ESP_LOGE(TAG, "Failed to create JPEG queue");
+    // 固定大小的块池: 空闲块在 free_queue，待上传块在 full_queue
+    // 编码线程在没有空闲块时阻塞，在途数据不超过 JPEG_MAX_INFLIGHT_CHUNKS * JPEG_CHUNK_SIZE
+    JpegEncoder encoder = {};
+    encoder.free_queue = xQueueCreate(JPEG_MAX_INFLIGHT_CHUNKS, sizeof(JpegChunk));
+    encoder.full_queue = xQueueCreate(JPEG_MAX_INFLIGHT_CHUNKS + 1, sizeof(JpegChunk));
+    uint8_t* chunk_pool = (uint8_t*)heap_caps_aligned_alloc(16, JPEG_CHUNK_SIZE * JPEG_MAX_INFLIGHT_CHUNKS, MALLOC_CAP_SPIRAM);
+    auto cleanup = [&]() {
+        if (encoder.free_queue != nullptr) {
+            vQueueDelete(encoder.free_queue);
+        }
+        if (encoder.full_queue != nullptr) {
+            vQueueDelete(encoder.full_queue);
+        }
+        if (chunk_pool != nullptr) {
+            heap_caps_free(chunk_pool);
+        }
+    };
+    if (encoder.free_queue == nullptr || encoder.full_queue == nullptr || chunk_pool == nullptr) {
+        ESP_LOGE(TAG, "Failed to create JPEG pipeline");
+        cleanup();
         return "{\"success\": false, \"message\": \"Failed to create JPEG queue\"}";
     }
+    for (int i = 0; i < JPEG_MAX_INFLIGHT_CHUNKS; i++) {
+        JpegChunk chunk = {
+            .data = chunk_pool + i * JPEG_CHUNK_SIZE,
+            .len = 0
+        };
+        xQueueSend(encoder.free_queue, &chunk, 0);
+    }
+
+    int quality = SelectJpegQuality(fb_->width, fb_->height);
+    int64_t encode_time_us = 0;
 
     // We spawn a thread to encode the image to JPEG
-    encoder_thread_ = std::thread([this, jpeg_queue]() {
-        frame2jpg_cb(fb_, 80, [](void* arg, size_t index, const void* data, size_t len) -> unsigned int {
-            auto jpeg_queue = (QueueHandle_t)arg;
-            JpegChunk chunk = {
-                .data = (uint8_t*)heap_caps_aligned_alloc(16, len, MALLOC_CAP_SPIRAM),
-                .len = len
-            };
-            memcpy(chunk.data, data, len);
-            xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
+    encoder_thread_ = std::thread([this, &encoder, quality, &encode_time_us]() {
+        auto start_time = esp_timer_get_time();
+        frame2jpg_cb(fb_, quality, [](void* arg, size_t index, const void* data, size_t len) -> unsigned int {
+            auto encoder = (JpegEncoder*)arg;
+            auto src = (const uint8_t*)data;
+            size_t remaining = len;
+            while (remaining > 0) {
+                if (encoder->current.data == nullptr) {
+                    xQueueReceive(encoder->free_queue, &encoder->current, portMAX_DELAY);
+                    encoder->current.len = 0;
+                }
+                size_t n = std::min(remaining, JPEG_CHUNK_SIZE - encoder->current.len);
+                memcpy(encoder->current.data + encoder->current.len, src, n);
+                encoder->current.len += n;
+                src += n;
+                remaining -= n;
+                if (encoder->current.len == JPEG_CHUNK_SIZE) {
+                    SubmitJpegChunk(encoder);
+                }
+            }
+            encoder->total += len;
             return len;
-        }, jpeg_queue);
+        }, &encoder);
+        if (encoder.current.data != nullptr) {
+            SubmitJpegChunk(&encoder);
+        }
+        // 空块表示编码结束
+        SubmitJpegChunk(&encoder);
+        encode_time_us = esp_timer_get_time() - start_time;
     });
 
+    // 丢弃剩余的块，直到编码线程结束
+    auto drain = [&encoder]() {
+        JpegChunk chunk;
+        while (xQueueReceive(encoder.full_queue, &chunk, portMAX_DELAY) == pdPASS && chunk.data != nullptr) {
+            xQueueSend(encoder.free_queue, &chunk, portMAX_DELAY);
+        }
+    };
+
     auto http = Board::GetInstance().CreateHttp();
     // 构造multipart/form-data请求体
     std::string boundary = "----ESP32_CAMERA_BOUNDARY";
@@ -248,6 +413,7 @@ std::string Esp32Camera::Explain(const std::string& question) {
     multipart_footer += "\r\n--" + boundary + "--\r\n";
 
     // 配置HTTP客户端，使用分块传输编码
+    auto upload_start_time = esp_timer_get_time();
     http->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
     http->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
     if (!explain_token_.empty()) {
@@ -257,63 +423,77 @@ std::string Esp32Camera::Explain(const std::string& question) {
     http->SetHeader("Transfer-Encoding", "chunked");
     if (!http->Open("POST", explain_url_)) {
         ESP_LOGE(TAG, "Failed to connect to explain URL");
-        // Clear the queue
+        drain();
         encoder_thread_.join();
-        JpegChunk chunk;
-        while (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) == pdPASS) {
-            if (chunk.data != nullptr) {
-                heap_caps_free(chunk.data);
-            } else {
-                break;
-            }
-        }
-        vQueueDelete(jpeg_queue);
+        cleanup();
         return "{\"success\": false, \"message\": \"Failed to connect to explain URL\"}";
     }
     
+    // 上行带宽按整个请求体计算，从开始写入到结束块写完为止；
+    // 单次Write的耗时只反映数据进入socket缓冲区的速度，服务器的推理时间也不应计入
+    auto body_start_time = esp_timer_get_time();
+    size_t body_size = question_field.size() + file_header.size() + multipart_footer.size();
+
     // 第一块：question字段
     http->Write(question_field.c_str(), question_field.size());
     
     // 第二块：文件字段头部
     http->Write(file_header.c_str(), file_header.size());
     
-    // 第三块：JPEG数据
+    // 第三块：JPEG数据，与编码并行进行
     size_t total_sent = 0;
+    bool write_failed = false;
     while (true) {
         JpegChunk chunk;
-        if (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) != pdPASS) {
+        if (xQueueReceive(encoder.full_queue, &chunk, portMAX_DELAY) != pdPASS) {
             ESP_LOGE(TAG, "Failed to receive JPEG chunk");
             break;
         }
         if (chunk.data == nullptr) {
             break; // The last chunk
         }
-        http->Write((const char*)chunk.data, chunk.len);
-        total_sent += chunk.len;
-        heap_caps_free(chunk.data);
+        if (!write_failed) {
+            if (http->Write((const char*)chunk.data, chunk.len) < 0) {
+                ESP_LOGE(TAG, "Failed to write JPEG chunk");
+                write_failed = true;
+            } else {
+                total_sent += chunk.len;
+            }
+        }
+        xQueueSend(encoder.free_queue, &chunk, portMAX_DELAY);
     }
     // Wait for the encoder thread to finish
     encoder_thread_.join();
-    // 清理队列
-    vQueueDelete(jpeg_queue);
+    cleanup();
+
+    if (write_failed) {
+        http->Close();
+        return "{\"success\": false, \"message\": \"Failed to upload photo\"}";
+    }
 
     // 第四块：multipart尾部
     http->Write(multipart_footer.c_str(), multipart_footer.size());
     
     // 结束块
     http->Write("", 0);
+    auto upload_end_time = esp_timer_get_time();
+    auto upload_time_us = upload_end_time - upload_start_time;
+    UpdateUplinkEstimate(body_size + total_sent, upload_end_time - body_start_time);
 
     if (http->GetStatusCode() != 200) {
         ESP_LOGE(TAG, "Failed to upload photo, status code: %d", http->GetStatusCode());
+        http->Close();
         return "{\"success\": false, \"message\": \"Failed to upload photo\"}";
     }
-
     std::string result = http->ReadAll();
     http->Close();
+    auto response_time_us = esp_timer_get_time() - upload_end_time;
 
     // Get remain task stack size
     size_t remain_stack_size = uxTaskGetStackHighWaterMark(nullptr);
-    ESP_LOGI(TAG, "Explain image size=%dx%d, compressed size=%d, remain stack size=%d, question=%s\n%s",
-        fb_->width, fb_->height, total_sent, remain_stack_size, question.c_str(), result.c_str());
+    ESP_LOGI(TAG, "Explain image size=%dx%d, quality=%d, compressed size=%d, capture=%lldms, encode=%lldms, upload=%lldms, "
+        "response=%lldms, uplink=%luB/s, remain stack size=%d, question=%s\n%s",
+        fb_->width, fb_->height, quality, total_sent, capture_time_us_ / 1000, encode_time_us / 1000, upload_time_us / 1000,
+        response_time_us / 1000, uplink_bytes_per_sec_, remain_stack_size, question.c_str(), result.c_str());
     return result;
 }
@@ -20,10 +20,21 @@ class Esp32Camera : public Camera {
 private:
     camera_fb_t* fb_ = nullptr;
     lv_img_dsc_t preview_image_;
+    size_t preview_capacity_ = 0;
     std::string explain_url_;
     std::string explain_token_;
     std::thread encoder_thread_;
 
+    // 根据上行带宽自适应选择分辨率和JPEG质量
+    framesize_t max_frame_size_;
+    framesize_t frame_size_;
+    uint32_t uplink_bytes_per_sec_ = 0;
+    int64_t capture_time_us_ = 0;
+
+    framesize_t SelectFrameSize() const;
+    int SelectJpegQuality(int width, int height) const;
+    void UpdateUplinkEstimate(size_t bytes, int64_t elapsed_us);
+
 public:
     Esp32Camera(const camera_config_t& config);
     ~Esp32Camera();
@@ -4,6 +4,7 @@
 #include "display.h"
 #include "font_awesome_symbols.h"
 #include "assets/lang_config.h"
+#include "system_profiler.h"
 
 #include <esp_log.h>
 #include <esp_timer.h>
@@ -29,19 +30,54 @@ void Ml307Board::StartNetwork() {
     modem_.SetDebug(false);
     modem_.SetBaudRate(921600);
 
-    auto& application = Application::GetInstance();
     // If low power, the material ready event will be triggered by the modem because of a reset
-    modem_.OnMaterialReady([this, &application]() {
-        ESP_LOGI(TAG, "ML307 material ready");
-        application.Schedule([this, &application]() {
-            application.SetDeviceState(kDeviceStateIdle);
-            WaitForNetworkReady();
-        });
+    modem_.OnMaterialReady([this]() {
+        OnModemReset();
     });
 
     WaitForNetworkReady();
 }
 
+void Ml307Board::OnModemReset() {
+    ESP_LOGI(TAG, "ML307 material ready");
+    if (standby_) {
+        // The modem registers again by itself, a standby link must not disturb the active one
+        return;
+    }
+    auto& application = Application::GetInstance();
+    application.Schedule([this, &application]() {
+        application.SetDeviceState(kDeviceStateIdle);
+        WaitForNetworkReady();
+    });
+}
+
+bool Ml307Board::StartStandby() {
+    standby_ = true;
+    modem_.SetDebug(false);
+    modem_.SetBaudRate(921600);
+    modem_.OnMaterialReady([this]() {
+        OnModemReset();
+    });
+
+    int result = modem_.WaitForNetworkReady();
+    if (result < 0) {
+        ESP_LOGW(TAG, "Standby ML307 failed to register: %s", result == -1 ? "PIN error" : "registration error");
+        return false;
+    }
+    ESP_LOGI(TAG, "Standby ML307 registered, ICCID: %s", modem_.GetIccid().c_str());
+    modem_.ResetConnections();
+    SetStandby(true);
+    return true;
+}
+
+void Ml307Board::SetStandby(bool standby) {
+    standby_ = standby;
+    // Sleep mode 2: the module sleeps while the UART is idle and stays registered
+    if (!modem_.Command(standby ? "AT+MLPMCFG=\"sleepmode\",2,0" : "AT+MLPMCFG=\"sleepmode\",0,0")) {
+        ESP_LOGW(TAG, "Failed to %s module sleep mode", standby ? "enable" : "disable");
+    }
+}
+
 void Ml307Board::WaitForNetworkReady() {
     auto& application = Application::GetInstance();
     auto display = Board::GetInstance().GetDisplay();
@@ -83,6 +119,13 @@ Udp* Ml307Board::CreateUdp() {
     return new Ml307Udp(modem_, 0);
 }
 
+int Ml307Board::GetSignalQuality() {
+    if (!modem_.network_ready()) {
+        return -1;
+    }
+    return modem_.GetCsq();
+}
+
 const char* Ml307Board::GetNetworkStateIcon() {
     if (!modem_.network_ready()) {
         return FONT_AWESOME_SIGNAL_OFF;
@@ -142,6 +185,12 @@ std::string Ml307Board::GetDeviceStatusJson() {
      *         "type": "cellular",
      *         "carrier": "CHINA MOBILE",
      *         "csq": 10
+     *     },
+     *     "system": {
+     *         "cpu_load": 35,
+     *         "free_internal_heap": 60000,
+     *         "largest_internal_block": 30000,
+     *         "free_psram": 4000000
      *     }
      * }
      */
@@ -197,6 +246,9 @@ std::string Ml307Board::GetDeviceStatusJson() {
     }
     cJSON_AddItemToObject(root, "network", network);
 
+    // System
+    cJSON_AddItemToObject(root, "system", SystemProfiler::GetInstance().GetStatusJson());
+
     auto json_str = cJSON_PrintUnformatted(root);
     std::string json(json_str);
     cJSON_free(json_str);
@@ -7,8 +7,10 @@
 class Ml307Board : public Board {
 protected:
     Ml307AtModem modem_;
+    bool standby_ = false;
     virtual std::string GetBoardJson() override;
     void WaitForNetworkReady();
+    void OnModemReset();
 
 public:
     Ml307Board(gpio_num_t tx_pin, gpio_num_t rx_pin, size_t rx_buffer_size = 4096);
@@ -22,6 +24,14 @@ public:
     virtual void SetPowerSaveMode(bool enabled) override;
     virtual AudioCodec* GetAudioCodec() override { return nullptr; }
     virtual std::string GetDeviceStatusJson() override;
+    // CSQ of the registered network, -1 if not registered
+    int GetSignalQuality();
+    bool IsNetworkReady() { return modem_.network_ready(); }
+    // Brings the modem up as a standby link: registers and attaches without
+    // touching the display or the application state
+    bool StartStandby();
+    // A standby modem sleeps between AT commands until it carries traffic
+    void SetStandby(bool standby);
 };
 
 #endif // ML307_BOARD_H
@@ -26,8 +26,19 @@
 
 #define MOTOR_ENABLE_PIN     GPIO_NUM_33    // 电机开关引脚
 #include "i2c_device.h" // Ensure this header defines the I2cDevice class
+#include "stepper_scheduler.h"
 #include "esp_log.h"    // Include ESP-IDF logging header for ESP_LOGI
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h" // Include FreeRTOS header for pdMS_TO_TICKS
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <mutex>
+#include <functional>
+#include <algorithm>
+
+// 电机调度任务，I2C写入在该任务中进行，不阻塞调用者
+#define STEPPER_TASK_PRIORITY 6
+#define STEPPER_MIN_DELAY_US 100
 
 class Pcf8574 : public I2cDevice
 {
@@ -45,12 +56,20 @@ public:
         io_expander_=io_expander;
         InitializeTca9554_2();
         // InitializeTca9554();
+        InitializeStepper();
         ESP_LOGI(PCF8574_TAG, "PCF8574+tca2 initialized successfully");
     }
 
     ~Pcf8574()
     {
         // delete[] read_buffer_;
+        if (step_timer_ != nullptr) {
+            esp_timer_stop(step_timer_);
+            esp_timer_delete(step_timer_);
+        }
+        if (step_task_ != nullptr) {
+            vTaskDelete(step_task_);
+        }
         ESP_LOGI(PCF8574_TAG, "PCF8574 deinitialized successfully");
     }
 
@@ -71,22 +90,59 @@ public:
          ESP_ERROR_CHECK(esp_io_expander_set_level(io_expander_,IO_EXPANDER_PIN_NUM_7, level));
     }
 
-    void control_motor(uint8_t motor, int steps, bool direction)
+    // 非阻塞运动：加入该电机的队列后立即返回，完成后在调度任务中回调实际步数
+    // 反向 (direction == false) 运动到达霍尔限位时提前停止
+    void MoveAsync(uint8_t motor, int steps, bool direction, std::function<void(int)> on_complete = nullptr)
     {
-        ESP_LOGI(PCF8574_TAG, "Control motor %d, steps %d, direction %d", motor, steps, direction);
-        motor_enable();
-        // void stepMotor(uint8_t in1, uint8_t in2, uint8_t in3, uint8_t in4, int steps, bool direction, uint8_t motor)
-        if (motor == 0)
+        StepperScheduler::Move move;
+        move.steps = steps;
+        move.direction = direction;
+        if (direction == false) {
+            move.stop_condition = [this, motor]() {
+                return hallread(motor);
+            };
+        }
+        move.on_complete = std::move(on_complete);
         {
-            stepMotor(MOTOR1_IN1, MOTOR1_IN2, MOTOR1_IN3, MOTOR1_IN4, steps, direction, motor);
+            std::lock_guard<std::recursive_mutex> lock(scheduler_mutex_);
+            scheduler_.Enqueue(motor == 0 ? 0 : 1, std::move(move));
         }
-        else
+        xTaskNotifyGive(step_task_);
+    }
+
+    void StopMotor(uint8_t motor)
+    {
         {
-            stepMotor(MOTOR2_IN1, MOTOR2_IN2, MOTOR2_IN3, MOTOR2_IN4, steps, direction, motor);
+            std::lock_guard<std::recursive_mutex> lock(scheduler_mutex_);
+            scheduler_.Stop(motor == 0 ? 0 : 1);
         }
+        xTaskNotifyGive(step_task_);
+    }
+
+    // 两个电机同时运动，全部完成后返回
+    void MoveBoth(int steps1, bool direction1, int steps2, bool direction2)
+    {
+        SemaphoreHandle_t done = xSemaphoreCreateCounting(2, 0);
+        auto on_complete = [done](int) {
+            xSemaphoreGive(done);
+        };
+        MoveAsync(0, steps1, direction1, on_complete);
+        MoveAsync(1, steps2, direction2, on_complete);
+        xSemaphoreTake(done, portMAX_DELAY);
+        xSemaphoreTake(done, portMAX_DELAY);
+        vSemaphoreDelete(done);
+    }
 
-        stopMotors();
-        motor_disable();
+    // 阻塞运动，完成后返回
+    void control_motor(uint8_t motor, int steps, bool direction)
+    {
+        ESP_LOGI(PCF8574_TAG, "Control motor %d, steps %d, direction %d", motor, steps, direction);
+        SemaphoreHandle_t done = xSemaphoreCreateBinary();
+        MoveAsync(motor, steps, direction, [done](int) {
+            xSemaphoreGive(done);
+        });
+        xSemaphoreTake(done, portMAX_DELAY);
+        vSemaphoreDelete(done);
     }
     void motor_reset()
     {
@@ -100,21 +156,19 @@ public:
     {
         // i2c_master_init();
         ESP_LOGI(PCF8574_TAG, "I2C initialized successfully");
-        // motor_en_init();
-        motor_enable();
 
         // 示例：控制第一个步进电机旋转
-        stepMotor(MOTOR1_IN1, MOTOR1_IN2, MOTOR1_IN3, MOTOR1_IN4, 50, 1, 0);
+        control_motor(0, 50, 1);
         ESP_LOGI(PCF8574_TAG, "Motor1 done");
         vTaskDelay(pdMS_TO_TICKS(200));
-        // stopMotors();
 
         // 示例：控制第二个步进电机旋转
-        stepMotor(MOTOR2_IN1, MOTOR2_IN2, MOTOR2_IN3, MOTOR2_IN4, 50, 0, 1);
+        control_motor(1, 50, 0);
         ESP_LOGI(PCF8574_TAG, "Motor2 done");
         vTaskDelay(pdMS_TO_TICKS(100));
-        stopMotors();
-        motor_disable();
+
+        // 示例：两个电机同时旋转
+        MoveBoth(50, 0, 50, 1);
         ESP_LOGI(PCF8574_TAG, "Motor test done");
 
         // vTaskDelete(NULL);
@@ -122,6 +176,65 @@ public:
 
 private:
     uint8_t reg = 0x00;
+    StepperScheduler scheduler_{2};
+    std::recursive_mutex scheduler_mutex_;
+    esp_timer_handle_t step_timer_ = nullptr;
+    TaskHandle_t step_task_ = nullptr;
+    uint8_t last_output_ = 0;
+    bool motor_enabled_ = false;
+
+    void InitializeStepper()
+    {
+        xTaskCreate([](void* arg) {
+            auto pcf8574 = (Pcf8574*)arg;
+            while (true) {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                pcf8574->RunStepper();
+            }
+        }, "stepper", 3072, this, STEPPER_TASK_PRIORITY, &step_task_);
+
+        // 定时器按下一次换相时间单次触发，不受 FreeRTOS tick 精度限制
+        esp_timer_create_args_t timer_args = {
+            .callback = [](void* arg) {
+                auto pcf8574 = (Pcf8574*)arg;
+                xTaskNotifyGive(pcf8574->step_task_);
+            },
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "stepper",
+            .skip_unhandled_events = true,
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &step_timer_));
+    }
+
+    // 推进调度器，两台电机的线圈状态合并为一次I2C写入
+    void RunStepper()
+    {
+        std::lock_guard<std::recursive_mutex> lock(scheduler_mutex_);
+        if (!motor_enabled_ && !scheduler_.IsIdle()) {
+            motor_enable();
+            motor_enabled_ = true;
+        }
+
+        uint8_t output;
+        int64_t now = esp_timer_get_time();
+        int64_t next = scheduler_.Poll(now, &output);
+        if (output != last_output_) {
+            pcf8574_write(output);
+            last_output_ = output;
+        }
+
+        esp_timer_stop(step_timer_);
+        if (next >= 0) {
+            esp_timer_start_once(step_timer_, std::max<int64_t>(next - esp_timer_get_time(), STEPPER_MIN_DELAY_US));
+        } else if (motor_enabled_) {
+            motor_disable();
+            motor_enabled_ = false;
+            auto stats = scheduler_.GetStats();
+            ESP_LOGI(PCF8574_TAG, "Motors idle, %lu updates, max jitter %lld us", stats.polls, stats.max_jitter_us);
+            scheduler_.ResetStats();
+        }
+    }
     void InitializeTca9554() {
         esp_err_t ret = esp_io_expander_new_i2c_tca9554(i2c_bus_, ESP_IO_EXPANDER_I2C_TCA9554_ADDRESS_000, &io_expander_);
         if(ret != ESP_OK) {
@@ -216,48 +329,11 @@ private:
         // gpio_set_level(MOTOR_ENABLE_PIN, 0);
         ESP_ERROR_CHECK(esp_io_expander_set_level(io_expander2_, IO_EXPANDER_PIN_NUM_7, 0));
     }
-    void stopMotors()
-    {
-        // 初始化步进电机引脚为输出
-        for (int i = 0; i < 8; i++)
-        {
-            pcf8574_write(0x00);
-        }
-        //   motor_disable();
-    }
     void pcf8574_write(uint8_t data)
     {
         WriteReg(reg, data);
     }
 
-    void stepMotor(uint8_t in1, uint8_t in2, uint8_t in3, uint8_t in4, int steps, bool direction, uint8_t motor)
-    {
-        uint8_t stepsForward[4][4] = {
-            {1, 0, 0, 0},
-            {0, 1, 0, 0},
-            {0, 0, 1, 0},
-            {0, 0, 0, 1}};
-
-        uint8_t stepsReverse[4][4] = {
-            {0, 0, 0, 1},
-            {0, 0, 1, 0},
-            {0, 1, 0, 0},
-            {1, 0, 0, 0}};
-
-        uint8_t(*stepsArray)[4] = (direction == false) ? stepsForward : stepsReverse;
-
-        for (int i = 0; i < steps; i++)
-        {
-            if (direction == false && hallread(motor))
-            break;
-            for (int j = 0; j < 4; j++)
-            {
-                uint8_t data = (stepsArray[j][0] << in1) | (stepsArray[j][1] << in2) | (stepsArray[j][2] << in3) | (stepsArray[j][3] << in4);
-                pcf8574_write(data);
-                vTaskDelay(pdMS_TO_TICKS(10));
-            }
-        }
-    }
     // uint8_t *read_buffer_ = nullptr;
     // TouchPoint_t tp_;
 };
@@ -1,10 +1,20 @@
 #include "power_save_timer.h"
 #include "application.h"
+#include "board.h"
+#include "settings.h"
+#include "alarm_manager.h"
 
 #include <esp_log.h>
+#include <esp_sleep.h>
+#include <algorithm>
 
 #define TAG "PowerSaveTimer"
 
+// Backlight level in the idle-dim state, as a share of the current brightness
+#define DIM_BRIGHTNESS_PERCENT 30
+// Wake from deep sleep this long before the next alarm, to boot and sync the time
+#define SHUTDOWN_ALARM_LEAD_SECONDS 60
+
 
 PowerSaveTimer::PowerSaveTimer(int cpu_max_freq, int seconds_to_sleep, int seconds_to_shutdown)
     : cpu_max_freq_(cpu_max_freq), seconds_to_sleep_(seconds_to_sleep), seconds_to_shutdown_(seconds_to_shutdown) {
@@ -19,6 +29,7 @@ PowerSaveTimer::PowerSaveTimer(int cpu_max_freq, int seconds_to_sleep, int secon
         .skip_unhandled_events = true,
     };
     ESP_ERROR_CHECK(esp_timer_create(&timer_args, &power_save_timer_));
+    state_entered_us_ = esp_timer_get_time();
 }
 
 PowerSaveTimer::~PowerSaveTimer() {
@@ -26,6 +37,11 @@ PowerSaveTimer::~PowerSaveTimer() {
     esp_timer_delete(power_save_timer_);
 }
 
+const char* PowerSaveTimer::GetStateName(PowerState state) {
+    static const char* const names[kPowerStateCount] = {"active", "idle_dim", "sleep", "shutdown"};
+    return state < kPowerStateCount ? names[state] : "unknown";
+}
+
 void PowerSaveTimer::SetEnabled(bool enabled) {
     if (enabled && !enabled_) {
         ticks_ = 0;
@@ -40,6 +56,14 @@ void PowerSaveTimer::SetEnabled(bool enabled) {
     }
 }
 
+void PowerSaveTimer::SetDimTimeout(int seconds_to_dim) {
+    seconds_to_dim_ = seconds_to_dim;
+}
+
+void PowerSaveTimer::SetShutdownWakeup(int seconds) {
+    shutdown_wakeup_seconds_ = seconds;
+}
+
 void PowerSaveTimer::OnEnterSleepMode(std::function<void()> callback) {
     on_enter_sleep_mode_ = callback;
 }
@@ -54,40 +78,43 @@ void PowerSaveTimer::OnShutdownRequest(std::function<void()> callback) {
 
 void PowerSaveTimer::PowerSaveCheck() {
     auto& app = Application::GetInstance();
-    if (!in_sleep_mode_ && !app.CanEnterSleepMode()) {
+    if (state_ < kPowerStateSleep && !app.CanEnterSleepMode()) {
+        if (state_ == kPowerStateIdleDim) {
+            WakeUp();
+        }
         ticks_ = 0;
         return;
     }
 
     ticks_++;
-    if (seconds_to_sleep_ != -1 && ticks_ >= seconds_to_sleep_) {
-        if (!in_sleep_mode_) {
-            in_sleep_mode_ = true;
-            if (on_enter_sleep_mode_) {
-                on_enter_sleep_mode_();
-            }
-
-            if (cpu_max_freq_ != -1) {
-                esp_pm_config_t pm_config = {
-                    .max_freq_mhz = cpu_max_freq_,
-                    .min_freq_mhz = 40,
-                    .light_sleep_enable = true,
-                };
-                esp_pm_configure(&pm_config);
-            }
-        }
+    if (state_ == kPowerStateActive && seconds_to_dim_ != -1 && ticks_ >= seconds_to_dim_) {
+        SetState(kPowerStateIdleDim);
+    }
+    if (state_ < kPowerStateSleep && seconds_to_sleep_ != -1 && ticks_ >= seconds_to_sleep_) {
+        SetState(kPowerStateSleep);
     }
     if (seconds_to_shutdown_ != -1 && ticks_ >= seconds_to_shutdown_ && on_shutdown_request_) {
+        SetState(kPowerStateShutdown);
         on_shutdown_request_();
     }
 }
 
 void PowerSaveTimer::WakeUp() {
     ticks_ = 0;
-    if (in_sleep_mode_) {
-        in_sleep_mode_ = false;
+    SetState(kPowerStateActive);
+}
 
-        if (cpu_max_freq_ != -1) {
+void PowerSaveTimer::SetState(PowerState state) {
+    if (state == state_) {
+        return;
+    }
+    PowerState from = state_;
+    auto start_time = esp_timer_get_time();
+    auto backlight = Board::GetInstance().GetBacklight();
+
+    switch (state) {
+    case kPowerStateActive:
+        if (in_sleep_mode_ && cpu_max_freq_ != -1) {
             esp_pm_config_t pm_config = {
                 .max_freq_mhz = cpu_max_freq_,
                 .min_freq_mhz = cpu_max_freq_,
@@ -95,9 +122,77 @@ void PowerSaveTimer::WakeUp() {
             };
             esp_pm_configure(&pm_config);
         }
+        if (dimmed_) {
+            dimmed_ = false;
+            if (backlight != nullptr) {
+                backlight->RestoreBrightness();
+            }
+        }
+        if (in_sleep_mode_) {
+            in_sleep_mode_ = false;
+            if (on_exit_sleep_mode_) {
+                on_exit_sleep_mode_();
+            }
+        }
+        break;
+
+    case kPowerStateIdleDim:
+        if (backlight != nullptr) {
+            dimmed_ = true;
+            backlight->SetBrightness(backlight->brightness() * DIM_BRIGHTNESS_PERCENT / 100);
+        }
+        break;
+
+    case kPowerStateSleep:
+        in_sleep_mode_ = true;
+        if (on_enter_sleep_mode_) {
+            on_enter_sleep_mode_();
+        }
+        if (cpu_max_freq_ != -1) {
+            esp_pm_config_t pm_config = {
+                .max_freq_mhz = cpu_max_freq_,
+                .min_freq_mhz = 40,
+                .light_sleep_enable = true,
+            };
+            esp_pm_configure(&pm_config);
+        }
+        break;
 
-        if (on_exit_sleep_mode_) {
-            on_exit_sleep_mode_();
+    case kPowerStateShutdown: {
+        // The shutdown callbacks deep sleep or power off through the PMIC,
+        // neither of which runs the shutdown handler that flushes settings
+        SettingsStore::GetInstance().Flush();
+        // The alarm timer does not run in deep sleep, so wake up in time for the next alarm
+        int wakeup_seconds = shutdown_wakeup_seconds_;
+        int alarm_seconds = AlarmManager::GetInstance().GetSecondsToNextAlarm();
+        if (alarm_seconds >= 0) {
+            alarm_seconds = std::max(alarm_seconds - SHUTDOWN_ALARM_LEAD_SECONDS, 1);
+            if (wakeup_seconds <= 0 || alarm_seconds < wakeup_seconds) {
+                wakeup_seconds = alarm_seconds;
+            }
+        }
+        if (wakeup_seconds > 0) {
+            ESP_LOGI(TAG, "Waking up from deep sleep in %d s", wakeup_seconds);
+            esp_sleep_enable_timer_wakeup((uint64_t)wakeup_seconds * 1000000);
         }
+        break;
     }
+
+    default:
+        break;
+    }
+
+    auto now = esp_timer_get_time();
+    auto& stats = stats_[state];
+    stats_[from].residency_us += start_time - state_entered_us_;
+    stats.enter_count++;
+    stats.last_transition_us = now - start_time;
+    stats.max_transition_us = std::max(stats.max_transition_us, stats.last_transition_us);
+    state_entered_us_ = now;
+    state_ = state;
+
+    ESP_LOGI(TAG, "Power state %s -> %s in %lld us (%s: total %lld s; %s: entered %d times, max %lld us)",
+        GetStateName(from), GetStateName(state), stats.last_transition_us,
+        GetStateName(from), stats_[from].residency_us / 1000000,
+        GetStateName(state), stats.enter_count, stats.max_transition_us);
 }
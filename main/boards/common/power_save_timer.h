@@ -5,27 +5,59 @@
 #include <esp_timer.h>
 #include <esp_pm.h>
 
+enum PowerState {
+    kPowerStateActive,
+    kPowerStateIdleDim,     // Backlight dimmed, everything else running
+    kPowerStateSleep,       // Board sleep callbacks, light sleep when cpu_max_freq is set; wake word keeps running
+    kPowerStateShutdown,    // Shutdown requested, optionally with an RTC timer wakeup from deep sleep
+    kPowerStateCount,
+};
+
+// Moves the device through the power states as it stays idle. Each
+// transition is timed and the time spent in every state is accumulated.
 class PowerSaveTimer {
 public:
     PowerSaveTimer(int cpu_max_freq, int seconds_to_sleep = 20, int seconds_to_shutdown = -1);
     ~PowerSaveTimer();
 
     void SetEnabled(bool enabled);
+    // Dim the backlight after this many idle seconds, before sleeping. Disabled by default.
+    void SetDimTimeout(int seconds_to_dim);
+    // Wake from deep sleep after this many seconds once shutdown is requested. Disabled by default;
+    // the next alarm always programs a wakeup shortly before it fires.
+    void SetShutdownWakeup(int seconds);
     void OnEnterSleepMode(std::function<void()> callback);
     void OnExitSleepMode(std::function<void()> callback);
     void OnShutdownRequest(std::function<void()> callback);
     void WakeUp();
 
+    inline PowerState state() const { return state_; }
+    static const char* GetStateName(PowerState state);
+
 private:
+    struct StateStats {
+        int enter_count;
+        int64_t residency_us;       // Time spent in the state, not counting the current stay
+        int64_t last_transition_us; // Time taken by the last transition into the state
+        int64_t max_transition_us;
+    };
+
     void PowerSaveCheck();
+    void SetState(PowerState state);
 
     esp_timer_handle_t power_save_timer_ = nullptr;
     bool enabled_ = false;
+    PowerState state_ = kPowerStateActive;
     bool in_sleep_mode_ = false;
+    bool dimmed_ = false;
     int ticks_ = 0;
     int cpu_max_freq_;
+    int seconds_to_dim_ = -1;
     int seconds_to_sleep_;
     int seconds_to_shutdown_;
+    int shutdown_wakeup_seconds_ = -1;
+    int64_t state_entered_us_ = 0;
+    StateStats stats_[kPowerStateCount] = {};
 
     std::function<void()> on_enter_sleep_mode_;
     std::function<void()> on_exit_sleep_mode_;
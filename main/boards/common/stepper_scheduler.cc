@@ -0,0 +1,117 @@
+#include "stepper_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define PHASES_PER_STEP 4
+
+StepperScheduler::StepperScheduler(int axis_count) : axes_(axis_count) {
+}
+
+void StepperScheduler::Enqueue(int axis, Move move) {
+    axes_[axis].queue.push_back(std::move(move));
+}
+
+void StepperScheduler::Stop(int axis) {
+    auto& a = axes_[axis];
+    a.queue.clear();
+    if (a.active) {
+        a.stop_requested = true;
+    }
+}
+
+bool StepperScheduler::IsIdle() const {
+    for (auto& axis : axes_) {
+        if (axis.active || !axis.queue.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void StepperScheduler::StartNext(Axis& axis, int64_t now_us) {
+    while (!axis.queue.empty()) {
+        axis.move = std::move(axis.queue.front());
+        axis.queue.pop_front();
+        if (axis.move.steps > 0) {
+            axis.active = true;
+            axis.stop_requested = false;
+            axis.phase_index = 0;
+            axis.total_phases = axis.move.steps * PHASES_PER_STEP;
+            axis.next_time_us = now_us;
+            return;
+        }
+        if (axis.move.on_complete) {
+            axis.move.on_complete(0);
+        }
+    }
+}
+
+void StepperScheduler::Finish(Axis& axis, int64_t now_us) {
+    axis.active = false;
+    axis.coils = 0;
+    auto on_complete = std::move(axis.move.on_complete);
+    int steps_done = axis.phase_index / PHASES_PER_STEP;
+    axis.move = Move();
+    if (on_complete) {
+        on_complete(steps_done);
+    }
+    StartNext(axis, now_us);
+}
+
+int64_t StepperScheduler::PhaseInterval(const Axis& axis) const {
+    // 梯形加减速: v = min(v_max, sqrt(v0^2 + 2as), sqrt(v0^2 + 2a * 剩余))
+    const auto& move = axis.move;
+    float v0 = std::max(move.start_speed, 1);
+    float v_max = std::max(move.max_speed, move.start_speed);
+    float a2 = 2.0f * std::max(move.acceleration, 0);
+    float v_accel = std::sqrt(v0 * v0 + a2 * axis.phase_index);
+    float v_decel = std::sqrt(v0 * v0 + a2 * (axis.total_phases - axis.phase_index));
+    float v = std::max(v0, std::min({v_max, v_accel, v_decel}));
+    return (int64_t)(1000000.0f / v);
+}
+
+int64_t StepperScheduler::Poll(int64_t now_us, uint8_t* output) {
+    int64_t next_time_us = -1;
+    uint8_t coils = 0;
+
+    for (size_t i = 0; i < axes_.size(); i++) {
+        auto& axis = axes_[i];
+        if (!axis.active) {
+            StartNext(axis, now_us);
+        }
+
+        // 每次最多推进一个线圈切换，延迟过大时重新对齐而不是连续补步，避免丢步
+        while (axis.active && axis.next_time_us <= now_us) {
+            if (axis.stop_requested || axis.phase_index == axis.total_phases) {
+                Finish(axis, now_us);
+                continue;
+            }
+            if (axis.phase_index % PHASES_PER_STEP == 0 && axis.move.stop_condition && axis.move.stop_condition()) {
+                Finish(axis, now_us);
+                continue;
+            }
+
+            stats_.max_jitter_us = std::max(stats_.max_jitter_us, now_us - axis.next_time_us);
+            int phase = axis.phase_index % PHASES_PER_STEP;
+            axis.coils = 1 << (axis.move.direction ? PHASES_PER_STEP - 1 - phase : phase);
+            axis.phase_index++;
+
+            int64_t interval = PhaseInterval(axis);
+            axis.next_time_us += interval;
+            if (axis.next_time_us <= now_us) {
+                axis.next_time_us = now_us + interval;
+            }
+            break;
+        }
+
+        if (axis.active && (next_time_us < 0 || axis.next_time_us < next_time_us)) {
+            next_time_us = axis.next_time_us;
+        }
+        coils |= axis.coils << (i * PHASES_PER_STEP);
+    }
+
+    *output = coils;
+    stats_.polls++;
+    return next_time_us;
+}
@@ -0,0 +1,68 @@
+#ifndef STEPPER_SCHEDULER_H
+#define STEPPER_SCHEDULER_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+// 多轴步进电机调度器，只负责计算时序，不访问硬件
+// 每个轴占用输出字节中的4位 (单相励磁, 每步依次驱动4个线圈)，多个轴的输出合并为一次写入
+// 速度按梯形曲线加减速，单位为线圈切换次数/秒
+class StepperScheduler {
+public:
+    struct Move {
+        int steps = 0;              // 步数，每步4次线圈切换
+        bool direction = false;
+        int start_speed = 100;      // 起始/结束速度
+        // 默认与原来每相10ms的固定速度相同，提速前需重新标定步数与行程
+        int max_speed = 100;
+        int acceleration = 400;     // 每秒速度增量
+        // 每步开始前调用，返回 true 时提前结束 (如到达限位)
+        std::function<bool()> stop_condition;
+        // 运动结束后调用，参数为实际完成的步数
+        std::function<void(int steps_done)> on_complete;
+    };
+
+    struct Stats {
+        uint32_t polls = 0;
+        int64_t max_jitter_us = 0;  // 实际写入时间相对计划时间的最大延迟
+    };
+
+    StepperScheduler(int axis_count);
+
+    // 将运动加入该轴的队列，前一个运动完成后自动开始
+    void Enqueue(int axis, Move move);
+    // 清空该轴的队列并在下一次调度时停止当前运动
+    void Stop(int axis);
+
+    // 推进所有到期的轴，`output` 为合并后的线圈输出
+    // 返回下一次需要调度的时间，全部空闲时返回 -1
+    // 回调在调用者的上下文中执行，可能修改队列
+    int64_t Poll(int64_t now_us, uint8_t* output);
+
+    bool IsIdle() const;
+    Stats GetStats() const { return stats_; }
+    void ResetStats() { stats_ = {}; }
+
+private:
+    struct Axis {
+        std::deque<Move> queue;
+        bool active = false;
+        bool stop_requested = false;
+        Move move;
+        int phase_index = 0;        // 已完成的线圈切换次数
+        int total_phases = 0;
+        int64_t next_time_us = 0;
+        uint8_t coils = 0;
+    };
+
+    std::vector<Axis> axes_;
+    Stats stats_;
+
+    void StartNext(Axis& axis, int64_t now_us);
+    void Finish(Axis& axis, int64_t now_us);
+    int64_t PhaseInterval(const Axis& axis) const;
+};
+
+#endif // STEPPER_SCHEDULER_H
@@ -3,6 +3,7 @@
 #include "display.h"
 #include "application.h"
 #include "system_info.h"
+#include "system_profiler.h"
 #include "font_awesome_symbols.h"
 #include "settings.h"
 #include "assets/lang_config.h"
@@ -204,6 +205,12 @@ std::string WifiBoard::GetDeviceStatusJson() {
      *         "ssid": "Xiaozhi",
      *         "rssi": -60
      *     },
+     *     "system": {
+     *         "cpu_load": 35,
+     *         "free_internal_heap": 60000,
+     *         "largest_internal_block": 30000,
+     *         "free_psram": 4000000
+     *     },
      *     "chip": {
      *         "temperature": 25
      *     }
@@ -258,6 +265,9 @@ std::string WifiBoard::GetDeviceStatusJson() {
     }
     cJSON_AddItemToObject(root, "network", network);
 
+    // System
+    cJSON_AddItemToObject(root, "system", SystemProfiler::GetInstance().GetStatusJson());
+
     // Chip
     float esp32temp = 0.0f;
     if (board.GetTemperature(esp32temp)) {
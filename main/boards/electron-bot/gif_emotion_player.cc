@@ -0,0 +1,316 @@
+#include "gif_emotion_player.h"
+
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "GifEmotionPlayer"
+
+// GIF 未指定帧间隔时使用
+#define GIF_DEFAULT_DELAY_MS 100
+// 一次刷新最多追赶的帧数，落后更多时直接从当前时间继续
+#define GIF_MAX_CATCHUP_FRAMES 4
+
+static bool IsEmpty(const lv_area_t& area) {
+    return area.x2 < area.x1 || area.y2 < area.y1;
+}
+
+static void JoinArea(lv_area_t& dst, const lv_area_t& area) {
+    if (IsEmpty(area)) {
+        return;
+    }
+    if (IsEmpty(dst)) {
+        dst = area;
+        return;
+    }
+    dst.x1 = std::min(dst.x1, area.x1);
+    dst.y1 = std::min(dst.y1, area.y1);
+    dst.x2 = std::max(dst.x2, area.x2);
+    dst.y2 = std::max(dst.y2, area.y2);
+}
+
+// 在两个 ARGB8888 缓冲区之间复制矩形区域
+static void CopyRect(uint8_t* dst, int dst_stride, int dst_x, int dst_y, const uint8_t* src,
+                     int src_stride, int src_x, int src_y, int width, int height) {
+    for (int y = 0; y < height; y++) {
+        memcpy(dst + (dst_y + y) * dst_stride + dst_x * 4, src + (src_y + y) * src_stride + src_x * 4,
+               width * 4);
+    }
+}
+
+GifEmotionPlayer::GifEmotionPlayer(lv_obj_t* parent, size_t cache_budget)
+    : cache_budget_(cache_budget) {
+    image_ = lv_image_create(parent);
+    timer_ = lv_timer_create(
+        [](lv_timer_t* timer) {
+            static_cast<GifEmotionPlayer*>(lv_timer_get_user_data(timer))->OnTimer();
+        },
+        LV_DEF_REFR_PERIOD, this);
+    lv_timer_pause(timer_);
+}
+
+GifEmotionPlayer::~GifEmotionPlayer() {
+    lv_timer_delete(timer_);
+    CloseDecoder();
+    for (auto& gif : cache_) {
+        DropFrames(gif);
+    }
+    heap_caps_free(canvas_);
+}
+
+bool GifEmotionPlayer::PrepareCanvas(int width, int height) {
+    size_t size = width * height * 4;
+    if (size > canvas_size_) {
+        heap_caps_free(canvas_);
+        canvas_ = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+        if (canvas_ == nullptr) {
+            ESP_LOGE(TAG, "无法分配 %dx%d 显示缓冲区", width, height);
+            canvas_size_ = 0;
+            return false;
+        }
+        canvas_size_ = size;
+    }
+
+    image_dsc_.header.magic = LV_IMAGE_HEADER_MAGIC;
+    image_dsc_.header.cf = LV_COLOR_FORMAT_ARGB8888;
+    image_dsc_.header.w = width;
+    image_dsc_.header.h = height;
+    image_dsc_.header.stride = width * 4;
+    image_dsc_.data = canvas_;
+    image_dsc_.data_size = size;
+    lv_image_cache_drop(&image_dsc_);
+    lv_image_set_src(image_, &image_dsc_);
+    return true;
+}
+
+bool GifEmotionPlayer::OpenDecoder(const lv_image_dsc_t* gif) {
+    decoder_ = gd_open_gif_data(gif->data);
+    if (decoder_ == nullptr) {
+        ESP_LOGE(TAG, "无法解析GIF %p", gif);
+        return false;
+    }
+    return true;
+}
+
+void GifEmotionPlayer::CloseDecoder() {
+    if (decoder_ != nullptr) {
+        gd_close_gif(decoder_);
+        decoder_ = nullptr;
+    }
+}
+
+void GifEmotionPlayer::Play(const lv_image_dsc_t* gif) {
+    if (gif == playing_) {
+        return;
+    }
+
+    auto it = std::find_if(cache_.begin(), cache_.end(),
+                           [gif](const CachedGif& cached) { return cached.src == gif; });
+    if (it == cache_.end()) {
+        cache_.emplace_front();
+        cache_.front().src = gif;
+    } else {
+        cache_.splice(cache_.begin(), cache_, it);
+    }
+
+    CloseDecoder();
+    lv_timer_pause(timer_);
+    playing_ = nullptr;
+
+    auto& entry = cache_.front();
+    if (!entry.complete) {
+        // 上次未播放完的记录不完整，重新开始
+        DropFrames(entry);
+        if (!OpenDecoder(gif)) {
+            return;
+        }
+        entry.width = decoder_->width;
+        entry.height = decoder_->height;
+        decode_time_us_ = 0;
+    }
+    if (!PrepareCanvas(entry.width, entry.height)) {
+        CloseDecoder();
+        return;
+    }
+
+    playing_ = gif;
+    frame_index_ = 0;
+    next_frame_tick_ = lv_tick_get();
+    OnTimer();
+    lv_timer_resume(timer_);
+}
+
+void GifEmotionPlayer::OnTimer() {
+    uint32_t now = lv_tick_get();
+    lv_area_t dirty = {0, 0, -1, -1};
+    for (int i = 0; i < GIF_MAX_CATCHUP_FRAMES && (int32_t)(now - next_frame_tick_) >= 0; i++) {
+        lv_area_t area;
+        uint32_t delay = NextFrame(area);
+        if (delay == 0) {
+            lv_timer_pause(timer_);
+            break;
+        }
+        JoinArea(dirty, area);
+        next_frame_tick_ += delay;
+    }
+    if ((int32_t)(now - next_frame_tick_) > 0) {
+        next_frame_tick_ = now;
+    }
+
+    if (!IsEmpty(dirty)) {
+        // 只重绘变化的区域
+        lv_image_cache_drop(&image_dsc_);
+        lv_area_t coords;
+        lv_obj_get_coords(image_, &coords);
+        lv_area_move(&dirty, coords.x1, coords.y1);
+        lv_obj_invalidate_area(image_, &dirty);
+    }
+}
+
+uint32_t GifEmotionPlayer::NextFrame(lv_area_t& dirty) {
+    auto& gif = cache_.front();
+    if (!gif.complete) {
+        return DecodeFrame(gif, dirty);
+    }
+
+    if (gif.frames.empty()) {
+        return 0;
+    }
+    if (frame_index_ >= gif.frames.size()) {
+        frame_index_ = 0;
+    }
+    const auto& frame = gif.frames[frame_index_++];
+    dirty = frame.area;
+    if (!IsEmpty(frame.area)) {
+        int width = lv_area_get_width(&frame.area);
+        CopyRect(canvas_, image_dsc_.header.stride, frame.area.x1, frame.area.y1, frame.pixels,
+                 width * 4, 0, 0, width, lv_area_get_height(&frame.area));
+    }
+    return frame.delay_ms;
+}
+
+uint32_t GifEmotionPlayer::DecodeFrame(CachedGif& gif, lv_area_t& dirty) {
+    if (decoder_ == nullptr) {
+        return 0;
+    }
+
+    auto start_time = esp_timer_get_time();
+    int ret = gd_get_frame(decoder_);
+    if (ret == 0) {
+        // 一轮播放结束，记录完整时之后直接回放缓存
+        if (gif.cacheable && !gif.frames.empty()) {
+            gif.complete = true;
+            CloseDecoder();
+            ESP_LOGI(TAG, "GIF %p 已缓存: %u 帧, %u 字节, 平均解码 %lld us/帧, 缓存共 %u 字节",
+                     gif.src, (unsigned)gif.frames.size(), (unsigned)gif.bytes,
+                     decode_time_us_ / (int64_t)gif.frames.size(), (unsigned)cache_bytes_);
+            EvictCache();
+            frame_index_ = 0;
+            return NextFrame(dirty);
+        }
+        gd_rewind(decoder_);
+        frame_index_ = 0;
+        ret = gd_get_frame(decoder_);
+    }
+    if (ret < 0) {
+        ESP_LOGE(TAG, "GIF %p 解码失败", gif.src);
+        return 0;
+    }
+    // 循环次数在第一帧之前的扩展块中读取，改为只播放一轮以便检测结尾
+    decoder_->loop_count = 1;
+    gd_render_frame(decoder_, decoder_->canvas);
+
+    uint32_t delay = decoder_->gce.delay * 10;
+    if (delay == 0) {
+        delay = GIF_DEFAULT_DELAY_MS;
+    }
+
+    // 与当前显示的帧比较得到变化区域，第一帧总是完整的
+    int width = decoder_->width;
+    int height = decoder_->height;
+    int stride = width * 4;
+    lv_area_t area = {0, 0, -1, -1};
+    if (frame_index_ == 0) {
+        area = {0, 0, width - 1, height - 1};
+    } else {
+        auto* current = (const uint32_t*)decoder_->canvas;
+        auto* shown = (const uint32_t*)canvas_;
+        for (int y = 0; y < height; y++) {
+            const uint32_t* a = current + y * width;
+            const uint32_t* b = shown + y * width;
+            if (memcmp(a, b, stride) == 0) {
+                continue;
+            }
+            int x1 = 0, x2 = width - 1;
+            while (a[x1] == b[x1]) {
+                x1++;
+            }
+            while (a[x2] == b[x2]) {
+                x2--;
+            }
+            JoinArea(area, lv_area_t{x1, y, x2, y});
+        }
+    }
+
+    if (!IsEmpty(area)) {
+        CopyRect(canvas_, stride, area.x1, area.y1, decoder_->canvas, stride, area.x1, area.y1,
+                 lv_area_get_width(&area), lv_area_get_height(&area));
+    }
+    if (gif.cacheable) {
+        RecordFrame(gif, area, delay);
+    }
+    frame_index_++;
+    decode_time_us_ += esp_timer_get_time() - start_time;
+    dirty = area;
+    return delay;
+}
+
+void GifEmotionPlayer::RecordFrame(CachedGif& gif, const lv_area_t& area, uint32_t delay_ms) {
+    Frame frame = {area, delay_ms, nullptr};
+    if (!IsEmpty(area)) {
+        int width = lv_area_get_width(&area);
+        int height = lv_area_get_height(&area);
+        size_t size = width * height * 4;
+        if (gif.bytes + size > cache_budget_) {
+            ESP_LOGW(TAG, "GIF %p 超出缓存预算，改为实时解码", gif.src);
+            DropFrames(gif);
+            gif.cacheable = false;
+            return;
+        }
+        frame.pixels = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+        if (frame.pixels == nullptr) {
+            ESP_LOGW(TAG, "GIF %p 缓存分配失败，改为实时解码", gif.src);
+            DropFrames(gif);
+            gif.cacheable = false;
+            return;
+        }
+        CopyRect(frame.pixels, width * 4, 0, 0, canvas_, image_dsc_.header.stride, area.x1, area.y1,
+                 width, height);
+        gif.bytes += size;
+        cache_bytes_ += size;
+    }
+    gif.frames.push_back(frame);
+}
+
+void GifEmotionPlayer::DropFrames(CachedGif& gif) {
+    for (auto& frame : gif.frames) {
+        heap_caps_free(frame.pixels);
+    }
+    gif.frames.clear();
+    cache_bytes_ -= gif.bytes;
+    gif.bytes = 0;
+    gif.complete = false;
+}
+
+// 从最久未使用的表情开始释放，直到总大小回到预算内
+void GifEmotionPlayer::EvictCache() {
+    for (auto it = cache_.rbegin(); it != cache_.rend() && cache_bytes_ > cache_budget_; ++it) {
+        if (it->src != playing_ && it->bytes > 0) {
+            ESP_LOGI(TAG, "释放GIF %p 的缓存 %u 字节", it->src, (unsigned)it->bytes);
+            DropFrames(*it);
+        }
+    }
+}
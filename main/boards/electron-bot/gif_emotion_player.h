@@ -0,0 +1,71 @@
+#pragma once
+
+#include <lvgl.h>
+#include <libs/gif/gifdec.h>
+
+#include <cstdint>
+#include <list>
+#include <vector>
+
+/**
+ * @brief 带帧缓存的GIF表情播放器
+ *
+ * 第一次播放某个GIF时逐帧解码，同时记录每帧相对上一帧变化的矩形区域(帧差)；
+ * 完整播放一遍后关闭解码器，之后的循环和再次切换到该表情时直接回放帧差，不再做LZW解码。
+ * 所有表情共用一块显示缓冲区，最近使用的表情按LRU保留在PSRAM中，超出预算的GIF退回实时解码。
+ * 帧率不超过屏幕刷新率，落后的帧在同一次刷新中合并，动画速度保持不变。
+ *
+ * 所有方法都需要在持有LVGL锁时调用
+ */
+class GifEmotionPlayer {
+public:
+    GifEmotionPlayer(lv_obj_t* parent, size_t cache_budget = 2 * 1024 * 1024);
+    ~GifEmotionPlayer();
+
+    lv_obj_t* obj() const { return image_; }
+
+    void Play(const lv_image_dsc_t* gif);
+
+private:
+    struct Frame {
+        lv_area_t area;
+        uint32_t delay_ms;
+        uint8_t* pixels;  ///< area 内的 ARGB8888 像素
+    };
+
+    struct CachedGif {
+        const lv_image_dsc_t* src = nullptr;
+        int width = 0;
+        int height = 0;
+        std::vector<Frame> frames;
+        size_t bytes = 0;
+        bool complete = false;   ///< 已记录完整的一轮
+        bool cacheable = true;   ///< 超出预算后只实时解码
+    };
+
+    lv_obj_t* image_;
+    lv_timer_t* timer_;
+    lv_image_dsc_t image_dsc_ = {};
+    uint8_t* canvas_ = nullptr;      ///< 当前显示的帧，所有表情共用
+    size_t canvas_size_ = 0;
+    size_t cache_budget_;
+    size_t cache_bytes_ = 0;
+    std::list<CachedGif> cache_;     ///< 按最近使用排序，最前面为当前播放
+
+    const lv_image_dsc_t* playing_ = nullptr;
+    gd_GIF* decoder_ = nullptr;      ///< 尚未缓存完成时的实时解码器
+    size_t frame_index_ = 0;
+    uint32_t next_frame_tick_ = 0;
+    int64_t decode_time_us_ = 0;
+
+    bool PrepareCanvas(int width, int height);
+    bool OpenDecoder(const lv_image_dsc_t* gif);
+    void CloseDecoder();
+    void OnTimer();
+    // 推进一帧，返回该帧的显示时长，失败返回 0
+    uint32_t NextFrame(lv_area_t& dirty);
+    uint32_t DecodeFrame(CachedGif& gif, lv_area_t& dirty);
+    void RecordFrame(CachedGif& gif, const lv_area_t& area, uint32_t delay_ms);
+    void DropFrames(CachedGif& gif);
+    void EvictCache();
+};
@@ -1,6 +1,8 @@
 #include <cstring>
 #include "display/lcd_display.h"
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
 #include "mmap_generate_emoji.h"
 #include "emoji_display.h"
 
@@ -12,6 +14,8 @@
 
 static const char *TAG = "emoji";
 
+#define FRAME_STATS_INTERVAL_US (10 * 1000 * 1000)
+
 namespace anim {
 
 bool EmojiPlayer::OnFlushIoReady(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
@@ -23,13 +27,47 @@ bool EmojiPlayer::OnFlushIoReady(esp_lcd_panel_io_handle_t panel_io, esp_lcd_pan
 
 void EmojiPlayer::OnFlush(anim_player_handle_t handle, int x_start, int y_start, int x_end, int y_end, const void *color_data)
 {
-    auto* panel = static_cast<esp_lcd_panel_handle_t>(anim_player_get_user_data(handle));
-    esp_lcd_panel_draw_bitmap(panel, x_start, y_start, x_end, y_end, color_data);
+    auto* player = static_cast<EmojiPlayer*>(anim_player_get_user_data(handle));
+    player->UpdateFrameStats(y_start);
+    esp_lcd_panel_draw_bitmap(player->panel_, x_start, y_start, x_end, y_end, color_data);
+}
+
+// 每帧按从上到下的顺序分块刷新，起始行回到上方即为新的一帧
+void EmojiPlayer::UpdateFrameStats(int y_start)
+{
+    int aaf, fps, frames;
+    int64_t elapsed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool new_frame = y_start <= last_y_start_;
+        last_y_start_ = y_start;
+        if (!new_frame) {
+            return;
+        }
+
+        window_frames_++;
+        int64_t now = esp_timer_get_time();
+        elapsed = now - window_start_us_;
+        if (elapsed < FRAME_STATS_INTERVAL_US) {
+            return;
+        }
+        aaf = current_aaf_;
+        fps = current_fps_;
+        frames = window_frames_;
+        window_frames_ = 0;
+        window_start_us_ = now;
+    }
+
+    int expected = fps * elapsed / 1000000;
+    int achieved_x10 = frames * 10000000LL / elapsed;
+    ESP_LOGI(TAG, "aaf %d: %d.%d fps (target %d), dropped %d frames", aaf,
+        achieved_x10 / 10, achieved_x10 % 10, fps, std::max<int>(expected - frames, 0));
 }
 
 EmojiPlayer::EmojiPlayer(esp_lcd_panel_handle_t panel, esp_lcd_panel_io_handle_t panel_io)
 {
     ESP_LOGI(TAG, "Create EmojiPlayer, panel: %p, panel_io: %p", panel, panel_io);
+    panel_ = panel;
     const mmap_assets_config_t assets_cfg = {
         .partition_label = "assets_A",
         .max_files = MMAP_EMOJI_FILES,
@@ -39,10 +77,16 @@ EmojiPlayer::EmojiPlayer(esp_lcd_panel_handle_t panel, esp_lcd_panel_io_handle_t
 
     mmap_assets_new(&assets_cfg, &assets_handle_);
 
+    // 资源在分区中只读映射，地址查找一次后复用
+    for (int i = 0; i < MMAP_EMOJI_FILES; i++) {
+        assets_[i].data = mmap_assets_get_mem(assets_handle_, i);
+        assets_[i].size = mmap_assets_get_size(assets_handle_, i);
+    }
+
     anim_player_config_t player_cfg = {
         .flush_cb = OnFlush,
         .update_cb = NULL,
-        .user_data = panel,
+        .user_data = this,
         .flags = {.swap = true},
         .task = ANIM_PLAYER_INIT_CONFIG()
     };
@@ -73,19 +117,27 @@ EmojiPlayer::~EmojiPlayer()
 void EmojiPlayer::StartPlayer(int aaf, bool repeat, int fps)
 {
     if (player_handle_) {
-        uint32_t start, end;
-        const void *src_data;
-        size_t src_len;
-
-        src_data = mmap_assets_get_mem(assets_handle_, aaf);
-        src_len = mmap_assets_get_size(assets_handle_, aaf);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // 多个表情共用同一个动画，切换时继续播放而不是重新解码第一帧
+            if (aaf == current_aaf_ && fps == current_fps_ && repeat && current_repeat_) {
+                return;
+            }
+            current_aaf_ = aaf;
+            current_fps_ = fps;
+            current_repeat_ = repeat;
+            last_y_start_ = -1;
+            window_frames_ = 0;
+            window_start_us_ = esp_timer_get_time();
+        }
 
-        anim_player_set_src_data(player_handle_, src_data, src_len);
+        uint32_t start, end;
+        anim_player_set_src_data(player_handle_, assets_[aaf].data, assets_[aaf].size);
         anim_player_get_segment(player_handle_, &start, &end);
         if(MMAP_EMOJI_WAKE_AAF == aaf){
             start = 7;
         }
-        anim_player_set_segment(player_handle_, start, end, fps, true);
+        anim_player_set_segment(player_handle_, start, end, fps, repeat);
         anim_player_update(player_handle_, PLAYER_ACTION_START);
     }
 }
@@ -94,6 +146,8 @@ void EmojiPlayer::StopPlayer()
 {
     if (player_handle_) {
         anim_player_update(player_handle_, PLAYER_ACTION_STOP);
+        std::lock_guard<std::mutex> lock(mutex_);
+        current_aaf_ = -1;
     }
 }
 
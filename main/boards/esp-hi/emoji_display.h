@@ -2,6 +2,7 @@
 
 #include "display/lcd_display.h"
 #include <memory>
+#include <mutex>
 #include <functional>
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
@@ -20,15 +21,37 @@ public:
     EmojiPlayer(esp_lcd_panel_handle_t panel, esp_lcd_panel_io_handle_t panel_io);
     ~EmojiPlayer();
 
+    // 同一动画正在播放时不会从第一帧重新开始
     void StartPlayer(int aaf, bool repeat, int fps);
     void StopPlayer();
 
 private:
+    struct Asset {
+        const void* data;
+        size_t size;
+    };
+
     static bool OnFlushIoReady(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx);
     static void OnFlush(anim_player_handle_t handle, int x_start, int y_start, int x_end, int y_end, const void *color_data);
+    void UpdateFrameStats(int y_start);
 
     anim_player_handle_t player_handle_;
     mmap_assets_handle_t assets_handle_;
+    esp_lcd_panel_handle_t panel_;
+    Asset assets_[MMAP_EMOJI_FILES] = {};
+
+    // 保护下面的字段：StartPlayer 在调用者任务中修改，帧率统计在播放任务中读写
+    std::mutex mutex_;
+
+    // 当前播放的动画
+    int current_aaf_ = -1;
+    int current_fps_ = 0;
+    bool current_repeat_ = false;
+
+    // 帧率统计
+    int last_y_start_ = -1;
+    uint32_t window_frames_ = 0;
+    int64_t window_start_us_ = 0;
 };
 
 class EmojiWidget : public Display {
@@ -0,0 +1,127 @@
+#include "motion_planner.h"
+
+#include <algorithm>
+#include <cmath>
+
+// 三次缓入缓出，起点和终点的速度都为0
+static float EaseInOut(float t) {
+    t = std::min(std::max(t, 0.0f), 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+MotionPlanner::MotionPlanner(int servo_count, int blend_ms)
+    : servo_count_(servo_count), blend_ms_(blend_ms) {
+    start_angles_.resize(servo_count_, 90.0f);
+    angles_.resize(servo_count_, 90.0f);
+}
+
+void MotionPlanner::MoveTo(const int* target, int duration_ms) {
+    Segment segment = {kSegmentPose, std::max(duration_ms, 0), 0};
+    segment.target.assign(target, target + servo_count_);
+    queue_.push_back(std::move(segment));
+}
+
+void MotionPlanner::Oscillate(const int* amplitude, const int* offset, const double* phase,
+                              int period_ms, float cycles) {
+    if (period_ms <= 0 || cycles <= 0) {
+        return;
+    }
+    Segment segment = {kSegmentOscillate, (int)(period_ms * cycles), period_ms};
+    segment.amplitude.assign(amplitude, amplitude + servo_count_);
+    segment.offset.assign(offset, offset + servo_count_);
+    segment.phase.assign(phase, phase + servo_count_);
+    queue_.push_back(std::move(segment));
+}
+
+void MotionPlanner::Hold(int duration_ms) {
+    if (duration_ms > 0) {
+        queue_.push_back(Segment{kSegmentHold, duration_ms, 0});
+    }
+}
+
+void MotionPlanner::Interrupt() {
+    queue_.clear();
+    active_ = false;
+}
+
+void MotionPlanner::SetAngles(const int* angles) {
+    for (int i = 0; i < servo_count_; i++) {
+        if (angles[i] != kKeepPosition) {
+            angles_[i] = angles[i];
+        }
+    }
+}
+
+int MotionPlanner::GetRemainingMs(int64_t now_ms) const {
+    int64_t remaining = 0;
+    if (active_) {
+        remaining = std::max<int64_t>(start_ms_ + current_.duration_ms - now_ms, 0);
+    }
+    for (auto& segment : queue_) {
+        remaining += segment.duration_ms;
+    }
+    return (int)remaining;
+}
+
+void MotionPlanner::StartNext(int64_t start_ms) {
+    current_ = std::move(queue_.front());
+    queue_.pop_front();
+    active_ = true;
+    start_ms_ = start_ms;
+    start_angles_ = angles_;
+
+    if (current_.type == kSegmentPose) {
+        for (int i = 0; i < servo_count_; i++) {
+            if (current_.target[i] == kKeepPosition) {
+                current_.target[i] = std::lround(angles_[i]);
+            }
+        }
+    }
+}
+
+void MotionPlanner::Sample(int64_t elapsed_ms) {
+    switch (current_.type) {
+        case kSegmentPose: {
+            float k = current_.duration_ms > 0
+                          ? EaseInOut((float)elapsed_ms / current_.duration_ms)
+                          : 1.0f;
+            for (int i = 0; i < servo_count_; i++) {
+                angles_[i] = start_angles_[i] + (current_.target[i] - start_angles_[i]) * k;
+            }
+            break;
+        }
+        case kSegmentOscillate: {
+            float k = blend_ms_ > 0 ? EaseInOut((float)elapsed_ms / blend_ms_) : 1.0f;
+            double omega = 2 * M_PI * elapsed_ms / current_.period_ms;
+            for (int i = 0; i < servo_count_; i++) {
+                float angle = 90 + current_.offset[i] +
+                              current_.amplitude[i] * std::sin(omega + current_.phase[i]);
+                angles_[i] = start_angles_[i] + (angle - start_angles_[i]) * k;
+            }
+            break;
+        }
+        case kSegmentHold:
+            break;
+    }
+}
+
+bool MotionPlanner::Update(int64_t now_ms) {
+    if (!active_) {
+        if (queue_.empty()) {
+            return false;
+        }
+        StartNext(now_ms);
+    }
+
+    // 到期的运动段按计划的结束时间衔接下一段，不会因调度延迟累积误差
+    while (now_ms - start_ms_ >= current_.duration_ms) {
+        Sample(current_.duration_ms);
+        if (queue_.empty()) {
+            active_ = false;
+            return true;
+        }
+        StartNext(start_ms_ + current_.duration_ms);
+    }
+    Sample(now_ms - start_ms_);
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef __MOTION_PLANNER_H__
+#define __MOTION_PLANNER_H__
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// 舵机运动规划器，只根据时间计算每个舵机的角度，不访问硬件
+// 动作被拆分为若干运动段依次执行，每段都从上一段结束(或被打断)时的实际角度出发，
+// 通过缓动曲线过渡到新的轨迹，因此动作之间以及打断后都不会出现角度跳变
+class MotionPlanner {
+public:
+    // 目标角度取该值时保持该舵机当前角度
+    static constexpr int kKeepPosition = -1;
+
+    MotionPlanner(int servo_count, int blend_ms = 300);
+
+    // 在 duration_ms 内缓动到目标角度 (0-180度)
+    void MoveTo(const int* target, int duration_ms);
+    // 正弦振荡: angle = 90 + offset + amplitude * sin(2π * t / period + phase)
+    // 开始的 blend_ms 内从当前角度渐入振荡轨迹
+    void Oscillate(const int* amplitude, const int* offset, const double* phase, int period_ms,
+                   float cycles);
+    // 保持当前姿态
+    void Hold(int duration_ms);
+
+    // 清空队列并结束当前运动段，之后加入的运动从当前角度开始过渡
+    void Interrupt();
+    // 同步舵机的实际角度，只在空闲时调用，取 kKeepPosition 的舵机不变
+    void SetAngles(const int* angles);
+
+    // 计算 now_ms 时刻的角度，返回 false 表示没有正在执行的运动
+    bool Update(int64_t now_ms);
+
+    bool IsIdle() const { return !active_ && queue_.empty(); }
+    // 当前运动段和队列中运动段的剩余时间
+    int GetRemainingMs(int64_t now_ms) const;
+    const std::vector<float>& angles() const { return angles_; }
+
+private:
+    enum SegmentType {
+        kSegmentPose,
+        kSegmentOscillate,
+        kSegmentHold,
+    };
+
+    struct Segment {
+        SegmentType type;
+        int duration_ms;
+        int period_ms;
+        std::vector<int> target;     // kSegmentPose: 目标角度
+        std::vector<int> amplitude;  // kSegmentOscillate: 振幅、偏移、初始相位
+        std::vector<int> offset;
+        std::vector<double> phase;
+    };
+
+    int servo_count_;
+    int blend_ms_;
+    std::deque<Segment> queue_;
+    Segment current_;
+    bool active_ = false;
+    int64_t start_ms_ = 0;
+    std::vector<float> start_angles_;
+    std::vector<float> angles_;
+
+    void StartNext(int64_t start_ms);
+    void Sample(int64_t elapsed_ms);
+};
+
+#endif  // __MOTION_PLANNER_H__
@@ -16,6 +16,9 @@
 
 #define TAG "OttoController"
 
+// 当前动作剩余时间小于该值时取出下一个动作，使两个动作首尾衔接而不回到初始位置
+#define ACTION_LOOKAHEAD_MS 100
+
 class OttoController {
 private:
     Otto otto_;
@@ -54,10 +57,20 @@ private:
     static void ActionTask(void* arg) {
         OttoController* controller = static_cast<OttoController*>(arg);
         OttoActionParams params;
+        bool hands_down = true;
         controller->otto_.AttachServos();
 
+        // 动作函数只负责规划，舵机由运动规划器按固定周期刷新
         while (true) {
-            if (xQueueReceive(controller->action_queue_, &params, pdMS_TO_TICKS(1000)) == pdTRUE) {
+            int remaining = controller->otto_.GetMotionRemainingMs();
+            if (remaining > ACTION_LOOKAHEAD_MS) {
+                vTaskDelay(pdMS_TO_TICKS(remaining - ACTION_LOOKAHEAD_MS));
+                continue;
+            }
+
+            TickType_t wait = controller->is_action_in_progress_ ? pdMS_TO_TICKS(remaining + 20)
+                                                                 : pdMS_TO_TICKS(1000);
+            if (xQueueReceive(controller->action_queue_, &params, wait) == pdTRUE) {
                 ESP_LOGI(TAG, "执行动作: %d", params.action_type);
                 controller->is_action_in_progress_ = true;
 
@@ -122,10 +135,12 @@ private:
                         }
                         break;
                 }
-                controller->otto_.Home(params.action_type < ACTION_HANDS_UP);
+                hands_down = params.action_type < ACTION_HANDS_UP;
+            } else if (controller->is_action_in_progress_ && !controller->otto_.IsMoving()) {
+                // 没有后续动作，回到初始位置
+                controller->otto_.Home(hands_down);
                 controller->is_action_in_progress_ = false;
             }
-            vTaskDelay(pdMS_TO_TICKS(20));
         }
     }
 
@@ -332,19 +347,18 @@ public:
         // 系统工具
         mcp_server.AddTool("self.otto.stop", "立即停止", PropertyList(),
                            [this](const PropertyList& properties) -> ReturnValue {
-                               if (action_task_handle_ != nullptr) {
-                                   vTaskDelete(action_task_handle_);
-                                   action_task_handle_ = nullptr;
-                               }
-                               is_action_in_progress_ = false;
+                               // 打断当前动作，从当前姿态平滑回到初始位置
                                xQueueReset(action_queue_);
+                               otto_.Interrupt();
+                               otto_.SetRestState(false);
                                otto_.Home(true);
+                               is_action_in_progress_ = false;
                                return true;
                            });
 
         mcp_server.AddTool("self.otto.get_status", "获取机器人状态，返回 moving 或 idle",
                            PropertyList(), [this](const PropertyList& properties) -> ReturnValue {
-                               return is_action_in_progress_ ? "moving" : "idle";
+                               return is_action_in_progress_ || otto_.IsMoving() ? "moving" : "idle";
                            });
 
         mcp_server.AddTool("self.battery.get_level", "获取机器人电池电量和充电状态", PropertyList(),
@@ -1,6 +1,7 @@
 #include "otto_movements.h"
 
 #include <algorithm>
+#include <cmath>
 
 #include "oscillator.h"
 
@@ -8,17 +9,34 @@ static const char* TAG = "OttoMovements";
 
 #define HAND_HOME_POSITION 45
 
-Otto::Otto() {
+Otto::Otto() : planner_(SERVO_COUNT) {
     is_otto_resting_ = false;
     has_hands_ = false;
     // 初始化所有舵机管脚为-1（未连接）
     for (int i = 0; i < SERVO_COUNT; i++) {
         servo_pins_[i] = -1;
         servo_trim_[i] = 0;
-    }
+        last_written_[i] = -1;
+    }
+
+    // 所有舵机在同一个定时器回调中刷新，角度只由时间决定，错过的周期可以直接跳过
+    esp_timer_create_args_t motion_timer_args = {
+        .callback = [](void* arg) {
+            auto otto = static_cast<Otto*>(arg);
+            std::lock_guard<std::mutex> lock(otto->planner_mutex_);
+            otto->OnMotionTick();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "otto_motion",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&motion_timer_args, &motion_timer_));
 }
 
 Otto::~Otto() {
+    esp_timer_stop(motion_timer_);
+    esp_timer_delete(motion_timer_);
     DetachServos();
 }
 
@@ -84,60 +102,80 @@ void Otto::SetTrims(int left_leg, int right_leg, int left_foot, int right_foot,
 }
 
 ///////////////////////////////////////////////////////////////////
-//-- BASIC MOTION FUNCTIONS -------------------------------------//
+//-- MOTION PLANNER ---------------------------------------------//
 ///////////////////////////////////////////////////////////////////
-void Otto::MoveServos(int time, int servo_target[]) {
-    if (GetRestState() == true) {
-        SetRestState(false);
-    }
+// Must be called with planner_mutex_ held
+void Otto::OnMotionTick() {
+    auto start_time = esp_timer_get_time();
+    bool moving = planner_.Update(start_time / 1000);
 
-    final_time_ = millis() + time;
-    if (time > 10) {
-        for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1) {
-                increment_[i] = (servo_target[i] - servo_[i].GetPosition()) / (time / 10.0);
-            }
+    auto& angles = planner_.angles();
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        int angle = std::lround(angles[i]);
+        if (servo_pins_[i] != -1 && angle != last_written_[i]) {
+            servo_[i].SetPosition(angle);
+            last_written_[i] = angle;
         }
+    }
 
-        for (int iteration = 1; millis() < final_time_; iteration++) {
-            partial_time_ = millis() + 10;
-            for (int i = 0; i < SERVO_COUNT; i++) {
-                if (servo_pins_[i] != -1) {
-                    servo_[i].SetPosition(servo_[i].GetPosition() + increment_[i]);
-                }
-            }
-            vTaskDelay(pdMS_TO_TICKS(10));
-        }
-    } else {
-        for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1) {
-                servo_[i].SetPosition(servo_target[i]);
-            }
-        }
-        vTaskDelay(pdMS_TO_TICKS(time));
+    auto tick_time = esp_timer_get_time() - start_time;
+    tick_time_us_ += tick_time;
+    max_tick_time_us_ = std::max(max_tick_time_us_, tick_time);
+    if (++tick_count_ % MOTION_STATS_INTERVAL_TICKS == 0) {
+        ESP_LOGD(TAG, "Motion tick cost avg %lld us, max %lld us",
+                 tick_time_us_ / MOTION_STATS_INTERVAL_TICKS, max_tick_time_us_);
+        tick_time_us_ = 0;
+        max_tick_time_us_ = 0;
     }
 
-    // final adjustment to the target.
-    bool f = true;
-    int adjustment_count = 0;
-    while (f && adjustment_count < 10) {
-        f = false;
+    if (!moving || planner_.IsIdle()) {
+        esp_timer_stop(motion_timer_);
+    }
+}
+
+// Must be called with planner_mutex_ held
+void Otto::StartMotion() {
+    if (!esp_timer_is_active(motion_timer_)) {
+        // 规划器空闲时从舵机的实际角度出发，而不是假设停在90度
+        int positions[SERVO_COUNT];
         for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1 && servo_target[i] != servo_[i].GetPosition()) {
-                f = true;
-                break;
-            }
-        }
-        if (f) {
-            for (int i = 0; i < SERVO_COUNT; i++) {
-                if (servo_pins_[i] != -1) {
-                    servo_[i].SetPosition(servo_target[i]);
-                }
-            }
-            vTaskDelay(pdMS_TO_TICKS(10));
-            adjustment_count++;
+            positions[i] = servo_pins_[i] != -1 ? servo_[i].GetPosition() : MotionPlanner::kKeepPosition;
         }
-    };
+        planner_.SetAngles(positions);
+        OnMotionTick();
+        esp_timer_start_periodic(motion_timer_, MOTION_TICK_MS * 1000);
+    }
+}
+
+void Otto::Hold(int time) {
+    std::lock_guard<std::mutex> lock(planner_mutex_);
+    planner_.Hold(time);
+    StartMotion();
+}
+
+void Otto::Interrupt() {
+    std::lock_guard<std::mutex> lock(planner_mutex_);
+    planner_.Interrupt();
+}
+
+bool Otto::IsMoving() {
+    std::lock_guard<std::mutex> lock(planner_mutex_);
+    return !planner_.IsIdle();
+}
+
+int Otto::GetMotionRemainingMs() {
+    std::lock_guard<std::mutex> lock(planner_mutex_);
+    return planner_.GetRemainingMs(esp_timer_get_time() / 1000);
+}
+
+///////////////////////////////////////////////////////////////////
+//-- BASIC MOTION FUNCTIONS -------------------------------------//
+///////////////////////////////////////////////////////////////////
+void Otto::MoveServos(int time, int servo_target[]) {
+    std::lock_guard<std::mutex> lock(planner_mutex_);
+    SetRestState(false);
+    planner_.MoveTo(servo_target, time);
+    StartMotion();
 }
 
 void Otto::MoveSingle(int position, int servo_number) {
@@ -146,56 +184,26 @@ void Otto::MoveSingle(int position, int servo_number) {
     if (position < 0)
         position = 90;
 
-    if (GetRestState() == true) {
-        SetRestState(false);
-    }
-
     if (servo_number >= 0 && servo_number < SERVO_COUNT && servo_pins_[servo_number] != -1) {
-        servo_[servo_number].SetPosition(position);
+        int target[SERVO_COUNT];
+        std::fill(target, target + SERVO_COUNT, MotionPlanner::kKeepPosition);
+        target[servo_number] = position;
+        MoveServos(0, target);
     }
 }
 
 void Otto::OscillateServos(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
                            double phase_diff[SERVO_COUNT], float cycle = 1) {
-    for (int i = 0; i < SERVO_COUNT; i++) {
-        if (servo_pins_[i] != -1) {
-            servo_[i].SetO(offset[i]);
-            servo_[i].SetA(amplitude[i]);
-            servo_[i].SetT(period);
-            servo_[i].SetPh(phase_diff[i]);
-        }
-    }
-
-    double ref = millis();
-    double end_time = period * cycle + ref;
-
-    while (millis() < end_time) {
-        for (int i = 0; i < SERVO_COUNT; i++) {
-            if (servo_pins_[i] != -1) {
-                servo_[i].Refresh();
-            }
-        }
-        vTaskDelay(5);
-    }
-    vTaskDelay(pdMS_TO_TICKS(10));
+    std::lock_guard<std::mutex> lock(planner_mutex_);
+    SetRestState(false);
+    planner_.Oscillate(amplitude, offset, phase_diff, period, cycle);
+    StartMotion();
 }
 
 void Otto::Execute(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
                    double phase_diff[SERVO_COUNT], float steps = 1.0) {
-    if (GetRestState() == true) {
-        SetRestState(false);
-    }
-
-    int cycles = (int)steps;
-
-    //-- Execute complete cycles
-    if (cycles >= 1)
-        for (int i = 0; i < cycles; i++)
-            OscillateServos(amplitude, offset, period, phase_diff);
-
-    //-- Execute the final not complete cycle
-    OscillateServos(amplitude, offset, period, phase_diff, (float)steps - cycles);
-    vTaskDelay(pdMS_TO_TICKS(10));
+    //-- 完整周期和最后不完整的周期合并为一段连续的振荡
+    OscillateServos(amplitude, offset, period, phase_diff, steps);
 }
 
 ///////////////////////////////////////////////////////////////////
@@ -216,7 +224,7 @@ void Otto::Home(bool hands_down) {
                     }
                 } else {
                     // 如果不需要复位手部，保持当前位置
-                    homes[i] = servo_[i].GetPosition();
+                    homes[i] = MotionPlanner::kKeepPosition;
                 }
             } else {
                 // 腿部和脚部舵机始终复位
@@ -225,10 +233,11 @@ void Otto::Home(bool hands_down) {
         }
 
         MoveServos(500, homes);
+        // 保持姿态不会清除休息状态，运动和振荡才会
         is_otto_resting_ = true;
     }
 
-    vTaskDelay(pdMS_TO_TICKS(200));
+    Hold(200);
 }
 
 bool Otto::GetRestState() {
@@ -366,7 +375,7 @@ void Otto::Bend(int steps, int period, int dir) {
     for (int i = 0; i < steps; i++) {
         MoveServos(T2 / 2, bend1);
         MoveServos(T2 / 2, bend2);
-        vTaskDelay(pdMS_TO_TICKS(period * 0.8));
+        Hold(period * 0.8);
         MoveServos(500, homes);
     }
 }
@@ -417,7 +426,7 @@ void Otto::ShakeLeg(int steps, int period, int dir) {
         MoveServos(500, homes);  // Return to home position
     }
 
-    vTaskDelay(pdMS_TO_TICKS(period));
+    Hold(period);
 }
 
 //---------------------------------------------------------
@@ -607,10 +616,10 @@ void Otto::HandsUp(int period, int dir) {
         target[RIGHT_HAND] = 10;
     } else if (dir == 1) {
         target[LEFT_HAND] = 170;
-        target[RIGHT_HAND] = servo_[RIGHT_HAND].GetPosition();
+        target[RIGHT_HAND] = MotionPlanner::kKeepPosition;
     } else if (dir == -1) {
         target[RIGHT_HAND] = 10;
-        target[LEFT_HAND] = servo_[LEFT_HAND].GetPosition();
+        target[LEFT_HAND] = MotionPlanner::kKeepPosition;
     }
 
     MoveServos(period, target);
@@ -630,9 +639,9 @@ void Otto::HandsDown(int period, int dir) {
     int target[SERVO_COUNT] = {90, 90, 90, 90, HAND_HOME_POSITION, 180 - HAND_HOME_POSITION};
 
     if (dir == 1) {
-        target[RIGHT_HAND] = servo_[RIGHT_HAND].GetPosition();
+        target[RIGHT_HAND] = MotionPlanner::kKeepPosition;
     } else if (dir == -1) {
-        target[LEFT_HAND] = servo_[LEFT_HAND].GetPosition();
+        target[LEFT_HAND] = MotionPlanner::kKeepPosition;
     }
 
     MoveServos(period, target);
@@ -657,13 +666,7 @@ void Otto::HandWave(int period, int dir) {
     int servo_index = (dir == LEFT) ? LEFT_HAND : RIGHT_HAND;
 
     int current_positions[SERVO_COUNT];
-    for (int i = 0; i < SERVO_COUNT; i++) {
-        if (servo_pins_[i] != -1) {
-            current_positions[i] = servo_[i].GetPosition();
-        } else {
-            current_positions[i] = 90;
-        }
-    }
+    std::fill(current_positions, current_positions + SERVO_COUNT, MotionPlanner::kKeepPosition);
 
     int position;
     if (servo_index == LEFT_HAND) {
@@ -674,24 +677,24 @@ void Otto::HandWave(int period, int dir) {
 
     current_positions[servo_index] = position;
     MoveServos(300, current_positions);
-    vTaskDelay(pdMS_TO_TICKS(300));
+    Hold(300);
 
     // 左右摆动5次
     for (int i = 0; i < 5; i++) {
         if (servo_index == LEFT_HAND) {
             current_positions[servo_index] = position - 30;
             MoveServos(period / 10, current_positions);
-            vTaskDelay(pdMS_TO_TICKS(period / 10));
+            Hold(period / 10);
             current_positions[servo_index] = position + 30;
             MoveServos(period / 10, current_positions);
         } else {
             current_positions[servo_index] = position + 30;
             MoveServos(period / 10, current_positions);
-            vTaskDelay(pdMS_TO_TICKS(period / 10));
+            Hold(period / 10);
             current_positions[servo_index] = position - 30;
             MoveServos(period / 10, current_positions);
         }
-        vTaskDelay(pdMS_TO_TICKS(period / 10));
+        Hold(period / 10);
     }
 
     if (servo_index == LEFT_HAND) {
@@ -713,13 +716,7 @@ void Otto::HandWaveBoth(int period) {
     }
 
     int current_positions[SERVO_COUNT];
-    for (int i = 0; i < SERVO_COUNT; i++) {
-        if (servo_pins_[i] != -1) {
-            current_positions[i] = servo_[i].GetPosition();
-        } else {
-            current_positions[i] = 90;
-        }
-    }
+    std::fill(current_positions, current_positions + SERVO_COUNT, MotionPlanner::kKeepPosition);
 
     int left_position = 170;
     int right_position = 10;
@@ -6,8 +6,11 @@
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "motion_planner.h"
 #include "oscillator.h"
 
+#include <mutex>
+
 //-- Constants
 #define FORWARD 1
 #define BACKWARD -1
@@ -21,6 +24,10 @@
 // -- Servo delta limit default. degree / sec
 #define SERVO_LIMIT_DEFAULT 240
 
+// -- 运动规划周期，舵机PWM为50Hz，更快的刷新没有意义
+#define MOTION_TICK_MS 20
+#define MOTION_STATS_INTERVAL_TICKS 500
+
 // -- Servo indexes for easy access
 #define LEFT_LEG 0
 #define RIGHT_LEG 1
@@ -47,6 +54,7 @@ public:
                   int right_hand = 0);
 
     //-- Predetermined Motion Functions
+    //-- 以下动作函数只把运动段加入规划器后立即返回，由定时器按固定周期刷新所有舵机
     void MoveServos(int time, int servo_target[]);
     void MoveSingle(int position, int servo_number);
     void OscillateServos(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
@@ -57,6 +65,11 @@ public:
     bool GetRestState();
     void SetRestState(bool state);
 
+    //-- 运动控制
+    void Interrupt();             // 立即打断当前动作，之后的动作从当前姿态平滑过渡
+    bool IsMoving();
+    int GetMotionRemainingMs();   // 已规划动作的剩余时间
+
     //-- Predetermined Motion Functions
     void Jump(float steps = 1, int period = 2000);
 
@@ -91,13 +104,20 @@ private:
     int servo_pins_[SERVO_COUNT];
     int servo_trim_[SERVO_COUNT];
 
-    unsigned long final_time_;
-    unsigned long partial_time_;
-    float increment_[SERVO_COUNT];
+    MotionPlanner planner_;
+    std::mutex planner_mutex_;
+    esp_timer_handle_t motion_timer_ = nullptr;
+    int last_written_[SERVO_COUNT];
+    int64_t tick_time_us_ = 0;
+    int64_t max_tick_time_us_ = 0;
+    uint32_t tick_count_ = 0;
 
     bool is_otto_resting_;
     bool has_hands_;  // 是否有手部舵机
 
+    void OnMotionTick();
+    void StartMotion();
+    void Hold(int time);
     void Execute(int amplitude[SERVO_COUNT], int offset[SERVO_COUNT], int period,
                  double phase_diff[SERVO_COUNT], float steps);
 };
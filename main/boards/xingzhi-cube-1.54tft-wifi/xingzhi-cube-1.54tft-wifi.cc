@@ -66,6 +66,7 @@ private:
         rtc_gpio_set_level(GPIO_NUM_21, 1);
 
         power_save_timer_ = new PowerSaveTimer(-1, 60, 300);
+        power_save_timer_->SetDimTimeout(30);
         power_save_timer_->OnEnterSleepMode([this]() {
             ESP_LOGI(TAG, "Enabling sleep mode");
             display_->SetChatMessage("system", "");
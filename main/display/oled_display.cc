@@ -7,10 +7,20 @@
 
 #include <esp_log.h>
 #include <esp_err.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
 #include <esp_lvgl_port.h>
+#include <cstring>
 
 #define TAG "OledDisplay"
 
+// 同一页内两段变化之间相隔不超过该列数时合并发送，重新寻址的开销大于发送这些字节
+#define OLED_DIFF_MERGE_GAP 8
+// 每次局部发送的寻址开销：列地址、页地址命令及控制字节
+#define OLED_ADDRESS_OVERHEAD 8
+// 刷新统计的输出间隔
+#define OLED_STATS_INTERVAL_US (10 * 1000 * 1000)
+
 LV_FONT_DECLARE(font_awesome_30_1);
 
 OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
@@ -26,35 +36,49 @@ OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handl
     lvgl_port_init(&port_cfg);
 
     ESP_LOGI(TAG, "Adding OLED display");
-    const lvgl_port_display_cfg_t display_cfg = {
-        .io_handle = panel_io_,
-        .panel_handle = panel_,
-        .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_ * height_),
-        .double_buffer = false,
-        .trans_size = 0,
-        .hres = static_cast<uint32_t>(width_),
-        .vres = static_cast<uint32_t>(height_),
-        .monochrome = true,
-        .rotation = {
-            .swap_xy = false,
-            .mirror_x = mirror_x,
-            .mirror_y = mirror_y,
-        },
-        .flags = {
-            .buff_dma = 1,
-            .buff_spiram = 0,
-            .sw_rotate = 0,
-            .full_refresh = 0,
-            .direct_mode = 0,
-        },
-    };
-
-    display_ = lvgl_port_add_disp(&display_cfg);
+    // 不使用lvgl_port_add_disp的整区转换刷新，改为与屏幕内容比较后只发送变化的字节
+    esp_lcd_panel_mirror(panel_, mirror_x, mirror_y);
+    size_t frame_size = width_ * height_ / 8;
+    size_t draw_buffer_size = lv_draw_buf_width_to_stride(width_, LV_COLOR_FORMAT_I1) * height_ + 8;
+    draw_buffer_ = (uint8_t*)heap_caps_malloc(draw_buffer_size, MALLOC_CAP_DMA);
+    frame_ = (uint8_t*)heap_caps_calloc(1, frame_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    panel_frame_ = (uint8_t*)heap_caps_calloc(1, frame_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (draw_buffer_ == nullptr || frame_ == nullptr || panel_frame_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate display buffers");
+        return;
+    }
+
+    // 清屏，之后panel_frame_与屏幕内容一致
+    for (int page = 0; page < height_ / 8; page++) {
+        SendPageRun(page, 0, width_ - 1);
+    }
+    stats_ = {};
+
+    lvgl_port_lock(0);
+    display_ = lv_display_create(width_, height_);
     if (display_ == nullptr) {
+        lvgl_port_unlock();
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
+    lv_display_set_user_data(display_, this);
+    lv_display_set_color_format(display_, LV_COLOR_FORMAT_I1);
+    lv_display_set_buffers(display_, draw_buffer_, nullptr, draw_buffer_size, LV_DISPLAY_RENDER_MODE_PARTIAL);
+    lv_display_set_flush_cb(display_, [](lv_display_t* disp, const lv_area_t* area, uint8_t* px_map) {
+        auto self = static_cast<OledDisplay*>(lv_display_get_user_data(disp));
+        self->Flush(area, px_map);
+        lv_display_flush_ready(disp);
+    });
+    // 刷新区域对齐到整页和整字节
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto disp = static_cast<lv_display_t*>(lv_event_get_target(e));
+        auto area = static_cast<lv_area_t*>(lv_event_get_param(e));
+        area->x1 &= ~7;
+        area->x2 = std::min<int32_t>(area->x2 | 7, lv_display_get_horizontal_resolution(disp) - 1);
+        area->y1 &= ~7;
+        area->y2 = std::min<int32_t>(area->y2 | 7, lv_display_get_vertical_resolution(disp) - 1);
+    }, LV_EVENT_INVALIDATE_AREA, nullptr);
+    lvgl_port_unlock();
 
     if (height_ == 64) {
         SetupUI_128x64();
@@ -84,6 +108,9 @@ OledDisplay::~OledDisplay() {
         esp_lcd_panel_io_del(panel_io_);
     }
     lvgl_port_deinit();
+    heap_caps_free(draw_buffer_);
+    heap_caps_free(frame_);
+    heap_caps_free(panel_frame_);
 }
 
 bool OledDisplay::Lock(int timeout_ms) {
@@ -94,6 +121,89 @@ void OledDisplay::Unlock() {
     lvgl_port_unlock();
 }
 
+void OledDisplay::Flush(const lv_area_t* area, const uint8_t* px_map) {
+    // I1格式的绘制缓冲前8字节是调色板
+    px_map += 8;
+    int stride = lv_draw_buf_width_to_stride(lv_area_get_width(area), LV_COLOR_FORMAT_I1);
+
+    // 转换为按页排列的格式，与esp_lvgl_port一致：LVGL中为1（白色）的像素不点亮
+    for (int y = area->y1; y <= area->y2; y++) {
+        const uint8_t* src = px_map + (y - area->y1) * stride;
+        uint8_t* dst = frame_ + (y / 8) * width_;
+        uint8_t mask = 1 << (y % 8);
+        for (int x = area->x1; x <= area->x2; x++) {
+            int i = x - area->x1;
+            if (src[i / 8] & (0x80 >> (i % 8))) {
+                dst[x] &= ~mask;
+            } else {
+                dst[x] |= mask;
+            }
+        }
+    }
+
+    // 逐页与屏幕内容比较，只发送变化的列
+    stats_.flushes++;
+    uint32_t bus_bytes = stats_.bus_bytes;
+    for (int page = area->y1 / 8; page <= area->y2 / 8; page++) {
+        const uint8_t* current = frame_ + page * width_;
+        const uint8_t* shown = panel_frame_ + page * width_;
+        stats_.full_bus_bytes += lv_area_get_width(area) + OLED_ADDRESS_OVERHEAD;
+
+        int x = area->x1;
+        while (x <= area->x2) {
+            if (current[x] == shown[x]) {
+                x++;
+                continue;
+            }
+            int start = x, end = x;
+            for (x = x + 1; x <= area->x2 && x - end <= OLED_DIFF_MERGE_GAP; x++) {
+                if (current[x] != shown[x]) {
+                    end = x;
+                }
+            }
+            SendPageRun(page, start, end);
+            x = end + 1;
+        }
+    }
+    if (stats_.bus_bytes != bus_bytes) {
+        stats_.frames++;
+    }
+    ReportFlushStats();
+}
+
+bool OledDisplay::SendPageRun(int page, int x1, int x2) {
+    const uint8_t* data = frame_ + page * width_ + x1;
+    esp_err_t ret = esp_lcd_panel_draw_bitmap(panel_, x1, page * 8, x2 + 1, page * 8 + 8, data);
+    if (ret != ESP_OK) {
+        // panel_frame_未更新，下次刷新该区域时会重新发送
+        ESP_LOGE(TAG, "Failed to draw page %d: %s", page, esp_err_to_name(ret));
+        return false;
+    }
+    memcpy(panel_frame_ + page * width_ + x1, data, x2 - x1 + 1);
+    stats_.bus_bytes += x2 - x1 + 1 + OLED_ADDRESS_OVERHEAD;
+    return true;
+}
+
+void OledDisplay::ReportFlushStats() {
+    int64_t now = esp_timer_get_time();
+    if (last_report_time_ == 0) {
+        last_report_time_ = now;
+        return;
+    }
+    int64_t elapsed = now - last_report_time_;
+    if (elapsed < OLED_STATS_INTERVAL_US) {
+        return;
+    }
+    uint32_t frames = stats_.frames - reported_stats_.frames;
+    uint32_t bus_bytes = stats_.bus_bytes - reported_stats_.bus_bytes;
+    uint32_t full_bus_bytes = stats_.full_bus_bytes - reported_stats_.full_bus_bytes;
+    ESP_LOGD(TAG, "%.1f fps, %lu bytes/s on bus, %lu bytes/s without diff",
+             frames * 1000000.0f / elapsed, (unsigned long)(bus_bytes * 1000000LL / elapsed),
+             (unsigned long)(full_bus_bytes * 1000000LL / elapsed));
+    reported_stats_ = stats_;
+    last_report_time_ = now;
+}
+
 void OledDisplay::SetChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
     if (chat_message_label_ == nullptr) {
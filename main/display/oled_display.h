@@ -6,11 +6,27 @@
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
 
+// OLED刷新统计，用于评估总线占用
+struct OledFlushStats {
+    uint32_t flushes = 0;           // LVGL刷新次数
+    uint32_t frames = 0;            // 实际有数据发送的刷新次数
+    uint32_t bus_bytes = 0;         // 发送到总线的字节数（含寻址命令）
+    uint32_t full_bus_bytes = 0;    // 不做差分时需要发送的字节数
+};
+
 class OledDisplay : public Display {
 private:
     esp_lcd_panel_io_handle_t panel_io_ = nullptr;
     esp_lcd_panel_handle_t panel_ = nullptr;
 
+    // 按页（8行）排列的帧缓冲：frame_为LVGL渲染结果，panel_frame_为屏幕上已显示的内容
+    uint8_t* draw_buffer_ = nullptr;
+    uint8_t* frame_ = nullptr;
+    uint8_t* panel_frame_ = nullptr;
+    OledFlushStats stats_;
+    OledFlushStats reported_stats_;
+    int64_t last_report_time_ = 0;
+
     lv_obj_t* status_bar_ = nullptr;
     lv_obj_t* content_ = nullptr;
     lv_obj_t* content_left_ = nullptr;
@@ -26,12 +42,18 @@ private:
     void SetupUI_128x64();
     void SetupUI_128x32();
 
+    void Flush(const lv_area_t* area, const uint8_t* px_map);
+    bool SendPageRun(int page, int x1, int x2);
+    void ReportFlushStats();
+
 public:
     OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel, int width, int height, bool mirror_x, bool mirror_y,
                 DisplayFonts fonts);
     ~OledDisplay();
 
     virtual void SetChatMessage(const char* role, const char* content) override;
+
+    OledFlushStats GetFlushStats() const { return stats_; }
 };
 
 #endif // OLED_DISPLAY_H
@@ -0,0 +1,326 @@
+#include "language_pack.h"
+#include "settings.h"
+#include "assets/lang_config.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <cJSON.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#define TAG "LanguagePack"
+
+#define LANGUAGE_PACK_PARTITION "lang"
+#define LANGUAGE_PACK_FILE "/sdcard/lang.bin"
+#define LANGUAGE_PACK_VERSION 1
+#define LANGUAGE_PACK_MAX_LANGUAGES 32
+
+// On-flash layout, see scripts/pack_lang.py
+struct __attribute__((packed)) PackDirectory {
+    char magic[4];          // "LPKD"
+    uint16_t version;
+    uint16_t count;
+};
+
+struct __attribute__((packed)) PackDirectoryEntry {
+    char code[8];
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct __attribute__((packed)) PackHeader {
+    char magic[4];          // "LPK1"
+    uint16_t string_count;
+    uint16_t sound_count;
+    uint32_t pool_size;
+};
+
+struct __attribute__((packed)) PackString {
+    uint32_t key;
+    uint32_t value;
+};
+
+struct __attribute__((packed)) PackSound {
+    uint32_t name;
+    uint32_t offset;
+    uint32_t size;
+};
+
+void LanguagePack::Initialize() {
+    Settings settings("language");
+    auto code = settings.GetString("code");
+    if (!code.empty() && code != Lang::BUILTIN_CODE) {
+        Load(code, false);
+    }
+}
+
+bool LanguagePack::Read(const Source& source, uint32_t offset, void* buffer, size_t size) {
+    if (source.partition != nullptr) {
+        return esp_partition_read(source.partition, offset, buffer, size) == ESP_OK;
+    }
+    FILE* file = fopen(source.path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = fseek(file, offset, SEEK_SET) == 0 && fread(buffer, 1, size, file) == size;
+    fclose(file);
+    return ok;
+}
+
+// Lists the languages in `source`, and finds `code` when it is not empty
+bool LanguagePack::ReadDirectory(const Source& source, std::vector<std::string>* codes, const std::string& code,
+                                 uint32_t* offset, uint32_t* size) {
+    PackDirectory directory;
+    if (!Read(source, 0, &directory, sizeof(directory)) || memcmp(directory.magic, "LPKD", 4) != 0 ||
+        directory.version != LANGUAGE_PACK_VERSION || directory.count > LANGUAGE_PACK_MAX_LANGUAGES) {
+        return false;
+    }
+    std::vector<PackDirectoryEntry> entries(directory.count);
+    if (!Read(source, sizeof(directory), entries.data(), entries.size() * sizeof(PackDirectoryEntry))) {
+        return false;
+    }
+    for (auto& entry : entries) {
+        std::string entry_code(entry.code, strnlen(entry.code, sizeof(entry.code)));
+        if (codes != nullptr) {
+            codes->push_back(entry_code);
+        }
+        if (!code.empty() && entry_code == code) {
+            *offset = entry.offset;
+            *size = entry.size;
+            return true;
+        }
+    }
+    return codes != nullptr;
+}
+
+bool LanguagePack::FindPack(const std::string& code, Source* source, uint32_t* offset, uint32_t* size) {
+    source->partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                 LANGUAGE_PACK_PARTITION);
+    if (source->partition != nullptr && ReadDirectory(*source, nullptr, code, offset, size)) {
+        return true;
+    }
+    source->partition = nullptr;
+    source->path = LANGUAGE_PACK_FILE;
+    return ReadDirectory(*source, nullptr, code, offset, size);
+}
+
+std::vector<std::string> LanguagePack::GetAvailableLanguages() {
+    std::vector<std::string> codes = { Lang::BUILTIN_CODE };
+    Source partition;
+    partition.partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                   LANGUAGE_PACK_PARTITION);
+    if (partition.partition != nullptr) {
+        ReadDirectory(partition, &codes, "", nullptr, nullptr);
+    }
+    Source file;
+    file.path = LANGUAGE_PACK_FILE;
+    ReadDirectory(file, &codes, "", nullptr, nullptr);
+
+    std::sort(codes.begin(), codes.end());
+    codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+    return codes;
+}
+
+void LanguagePack::RestoreBuiltin() {
+    for (auto& entry : Lang::STRING_TABLE) {
+        *entry.value = entry.builtin;
+    }
+    Lang::CODE = Lang::BUILTIN_CODE;
+    sounds_.clear();
+    cache_.clear();
+    cache_bytes_ = 0;
+}
+
+bool LanguagePack::Load(const std::string& code, bool save) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto start_time = esp_timer_get_time();
+
+    if (code == Lang::BUILTIN_CODE) {
+        RestoreBuiltin();
+        previous_pool_ = std::move(pool_);
+        pool_size_ = 0;
+    } else {
+        Source source;
+        uint32_t base, size;
+        if (!FindPack(code, &source, &base, &size)) {
+            ESP_LOGW(TAG, "Language %s not found", code.c_str());
+            return false;
+        }
+
+        PackHeader header;
+        if (!Read(source, base, &header, sizeof(header)) || memcmp(header.magic, "LPK1", 4) != 0) {
+            ESP_LOGE(TAG, "Invalid language pack %s", code.c_str());
+            return false;
+        }
+        size_t strings_size = header.string_count * sizeof(PackString);
+        size_t sounds_size = header.sound_count * sizeof(PackSound);
+        size_t index_size = strings_size + sounds_size + header.pool_size;
+        if (header.pool_size == 0 || sizeof(header) + index_size > size) {
+            ESP_LOGE(TAG, "Invalid language pack %s", code.c_str());
+            return false;
+        }
+
+        // The index is only needed while resolving, the pool and the language code stay resident
+        auto index = std::make_unique<char[]>(index_size + code.size() + 1);
+        if (!Read(source, base + sizeof(header), index.get(), index_size)) {
+            ESP_LOGE(TAG, "Failed to read language pack %s", code.c_str());
+            return false;
+        }
+        const char* pool = index.get() + strings_size + sounds_size;
+        if (pool[header.pool_size - 1] != '\0') {
+            ESP_LOGE(TAG, "Invalid language pack %s", code.c_str());
+            return false;
+        }
+        auto strings = reinterpret_cast<const PackString*>(index.get());
+        auto sounds = reinterpret_cast<const PackSound*>(index.get() + strings_size);
+        for (int i = 0; i < header.string_count; i++) {
+            if (strings[i].key >= header.pool_size || strings[i].value >= header.pool_size) {
+                ESP_LOGE(TAG, "Invalid language pack %s", code.c_str());
+                return false;
+            }
+        }
+        std::vector<SoundIndex> sound_index;
+        for (int i = 0; i < header.sound_count; i++) {
+            if (sounds[i].name >= header.pool_size || sounds[i].offset + (uint64_t)sounds[i].size > size) {
+                ESP_LOGE(TAG, "Invalid language pack %s", code.c_str());
+                return false;
+            }
+            sound_index.push_back({pool + sounds[i].name, base + sounds[i].offset, sounds[i].size});
+        }
+
+        // Keys are sorted by the packer
+        int missing = 0;
+        for (auto& entry : Lang::STRING_TABLE) {
+            auto it = std::lower_bound(strings, strings + header.string_count, entry.key,
+                [pool](const PackString& s, const char* key) { return strcmp(pool + s.key, key) < 0; });
+            if (it != strings + header.string_count && strcmp(pool + it->key, entry.key) == 0) {
+                *entry.value = pool + it->value;
+            } else {
+                *entry.value = entry.builtin;
+                missing++;
+            }
+        }
+        char* code_copy = index.get() + index_size;
+        memcpy(code_copy, code.c_str(), code.size() + 1);
+        Lang::CODE = code_copy;
+
+        source_ = source;
+        sounds_ = std::move(sound_index);
+        cache_.clear();
+        cache_bytes_ = 0;
+        previous_pool_ = std::move(pool_);
+        pool_ = std::move(index);
+        pool_size_ = index_size + code.size() + 1;
+        if (missing > 0) {
+            ESP_LOGW(TAG, "%d strings missing in %s, using %s", missing, code.c_str(), Lang::BUILTIN_CODE);
+        }
+    }
+
+    load_time_us_ = esp_timer_get_time() - start_time;
+    clip_hits_ = 0;
+    clip_misses_ = 0;
+    clip_load_time_us_ = 0;
+    ESP_LOGI(TAG, "Language %s loaded in %lld us, %u bytes resident, %u sounds",
+             Lang::CODE, load_time_us_, (unsigned)pool_size_, (unsigned)sounds_.size());
+
+    if (save) {
+        Settings settings("language", true);
+        settings.SetString("code", code);
+    }
+    return true;
+}
+
+LanguagePack::Clip LanguagePack::FindSound(const std::string_view& sound) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sounds_.empty()) {
+        return nullptr;
+    }
+
+    // Built-in clips are identified by their embedded data
+    const char* name = nullptr;
+    for (auto& entry : Lang::SOUND_TABLE) {
+        if (entry.data == sound.data()) {
+            name = entry.name;
+            break;
+        }
+    }
+    if (name == nullptr) {
+        return nullptr;
+    }
+    auto it = std::lower_bound(sounds_.begin(), sounds_.end(), name,
+        [](const SoundIndex& s, const char* key) { return strcmp(s.name, key) < 0; });
+    if (it == sounds_.end() || strcmp(it->name, name) != 0) {
+        return nullptr;
+    }
+
+    for (auto cached = cache_.begin(); cached != cache_.end(); ++cached) {
+        if (cached->sound == &*it) {
+            cache_.splice(cache_.begin(), cache_, cached);
+            clip_hits_++;
+            return cached->data;
+        }
+    }
+
+    auto start_time = esp_timer_get_time();
+    auto data = std::make_shared<std::vector<char>>(it->size);
+    if (!Read(source_, it->offset, data->data(), it->size)) {
+        ESP_LOGE(TAG, "Failed to read sound %s", name);
+        return nullptr;
+    }
+    clip_misses_++;
+    clip_load_time_us_ += esp_timer_get_time() - start_time;
+
+    cache_.push_front({&*it, data});
+    cache_bytes_ += it->size;
+    EvictCache();
+    return data;
+}
+
+void LanguagePack::SetCacheBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_budget_ = bytes;
+    EvictCache();
+}
+
+// Drops least recently used clips, the newest one is kept even when it is over budget
+void LanguagePack::EvictCache() {
+    while (cache_bytes_ > cache_budget_ && cache_.size() > 1) {
+        cache_bytes_ -= cache_.back().data->size();
+        cache_.pop_back();
+    }
+}
+
+std::string LanguagePack::GetStatusJson() {
+    auto languages = GetAvailableLanguages();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "language", Lang::CODE);
+    cJSON_AddStringToObject(root, "builtin", Lang::BUILTIN_CODE);
+    auto available = cJSON_CreateArray();
+    for (auto& code : languages) {
+        cJSON_AddItemToArray(available, cJSON_CreateString(code.c_str()));
+    }
+    cJSON_AddItemToObject(root, "available", available);
+    cJSON_AddStringToObject(root, "source", pool_ == nullptr ? "builtin" :
+                            source_.partition != nullptr ? "partition" : source_.path.c_str());
+    cJSON_AddNumberToObject(root, "load_us", load_time_us_);
+    cJSON_AddNumberToObject(root, "resident_bytes", pool_size_ + sounds_.size() * sizeof(SoundIndex));
+
+    auto cache = cJSON_CreateObject();
+    cJSON_AddNumberToObject(cache, "clips", cache_.size());
+    cJSON_AddNumberToObject(cache, "bytes", cache_bytes_);
+    cJSON_AddNumberToObject(cache, "budget", cache_budget_);
+    cJSON_AddNumberToObject(cache, "hits", clip_hits_);
+    cJSON_AddNumberToObject(cache, "misses", clip_misses_);
+    cJSON_AddNumberToObject(cache, "avg_miss_us", clip_misses_ > 0 ? clip_load_time_us_ / clip_misses_ : 0);
+    cJSON_AddItemToObject(root, "cache", cache);
+
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
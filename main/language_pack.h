@@ -0,0 +1,84 @@
+#ifndef _LANGUAGE_PACK_H_
+#define _LANGUAGE_PACK_H_
+
+#include <esp_partition.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Language packs built by scripts/pack_lang.py, read from the `lang` data
+// partition (16m and 32m tables) or /sdcard/lang.bin on boards that mount
+// the SD card in their constructor. Loading a pack points Lang::Strings at the
+// pack's string pool; P3 clips are read on first use into an LRU cache. The
+// compiled-in language is the fallback for anything a pack does not contain.
+class LanguagePack {
+public:
+    typedef std::shared_ptr<const std::vector<char>> Clip;
+
+    static LanguagePack& GetInstance() {
+        static LanguagePack instance;
+        return instance;
+    }
+    LanguagePack(const LanguagePack&) = delete;
+    LanguagePack& operator=(const LanguagePack&) = delete;
+
+    // Load the language saved in settings, if it is not the compiled-in one
+    void Initialize();
+    // Switch language; the compiled-in code restores the built-in strings
+    bool Load(const std::string& code, bool save = true);
+    std::vector<std::string> GetAvailableLanguages();
+
+    // Pack version of a Lang::Sounds clip, or nullptr to play the built-in one.
+    // The returned clip stays valid after it is evicted from the cache.
+    Clip FindSound(const std::string_view& sound);
+    void SetCacheBudget(size_t bytes);
+
+    // Loaded language, footprint and clip cache statistics
+    std::string GetStatusJson();
+
+private:
+    struct Source {
+        const esp_partition_t* partition = nullptr;
+        std::string path;
+    };
+
+    struct SoundIndex {
+        const char* name;   // In the string pool
+        uint32_t offset;    // From the start of the source
+        uint32_t size;
+    };
+
+    struct CachedClip {
+        const SoundIndex* sound;
+        Clip data;
+    };
+
+    std::mutex mutex_;
+    Source source_;
+    std::unique_ptr<char[]> pool_;           // Index and strings of the loaded pack
+    std::unique_ptr<char[]> previous_pool_;  // Kept until the next switch, strings may still be in use
+    size_t pool_size_ = 0;
+    std::vector<SoundIndex> sounds_;
+    std::list<CachedClip> cache_;            // Most recently used first
+    size_t cache_budget_ = 64 * 1024;
+    size_t cache_bytes_ = 0;
+
+    int64_t load_time_us_ = 0;
+    uint32_t clip_hits_ = 0;
+    uint32_t clip_misses_ = 0;
+    int64_t clip_load_time_us_ = 0;
+
+    LanguagePack() = default;
+    bool FindPack(const std::string& code, Source* source, uint32_t* offset, uint32_t* size);
+    bool ReadDirectory(const Source& source, std::vector<std::string>* codes, const std::string& code,
+                       uint32_t* offset, uint32_t* size);
+    static bool Read(const Source& source, uint32_t offset, void* buffer, size_t size);
+    void RestoreBuiltin();
+    void EvictCache();
+};
+
+#endif // _LANGUAGE_PACK_H_
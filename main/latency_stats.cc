@@ -0,0 +1,97 @@
+#include "latency_stats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+static const char* const kStageNames[kLatencyStageCount] = {
+    "wake",
+    "open_audio_channel",
+    "opus_encode",
+    "protocol_send",
+    "tts_start",
+    "first_audio_output",
+};
+
+const char* LatencyStats::StageName(int stage) {
+    return kStageNames[stage];
+}
+
+void LatencyStats::Add(const Turn& turn) {
+    turns_[turn_head_] = turn;
+    turn_head_ = (turn_head_ + 1) % kMaxTurns;
+    turn_count_ = std::min(turn_count_ + 1, kMaxTurns);
+}
+
+int64_t LatencyStats::StageDuration(const Turn& turn, int stage) {
+    if (turn.time_us[stage] == 0) {
+        return -1;
+    }
+    // Stages may overlap, e.g. the wake word audio is encoded before the
+    // channel opens, so measure from the latest stage recorded before it
+    int64_t previous = turn.time_us[kLatencyStageWake];
+    for (int i = 1; i < stage; i++) {
+        if (turn.time_us[i] != 0 && turn.time_us[i] <= turn.time_us[stage]) {
+            previous = std::max(previous, turn.time_us[i]);
+        }
+    }
+    return std::max<int64_t>(turn.time_us[stage] - previous, 0);
+}
+
+std::string LatencyStats::GetChromeTraceJson() const {
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    char event[160];
+    bool first = true;
+    for (int n = 0; n < turn_count_; n++) {
+        const auto& turn = turns_[(turn_head_ - turn_count_ + n + kMaxTurns) % kMaxTurns];
+        // One row per turn, one slice per stage ending at the stage timestamp
+        for (int i = 1; i < kLatencyStageCount; i++) {
+            int64_t duration = StageDuration(turn, i);
+            if (duration < 0) {
+                continue;
+            }
+            snprintf(event, sizeof(event),
+                "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%lld,\"dur\":%lld}",
+                first ? "" : ",", kStageNames[i], (unsigned long)turn.id,
+                (long long)(turn.time_us[i] - duration), (long long)duration);
+            json += event;
+            first = false;
+        }
+    }
+    json += "]}";
+    return json;
+}
+
+std::string LatencyStats::GetSummaryJson() const {
+    std::string json = "{\"turns\":" + std::to_string(turn_count_) + ",\"stages\":{";
+    std::vector<int64_t> samples;
+    samples.reserve(kMaxTurns);
+    char entry[128];
+    // Index kLatencyStageCount stands for the whole turn
+    for (int i = 1; i <= kLatencyStageCount; i++) {
+        samples.clear();
+        for (int n = 0; n < turn_count_; n++) {
+            const auto& turn = turns_[n];
+            int64_t duration = i < kLatencyStageCount ? StageDuration(turn, i)
+                : turn.time_us[kLatencyStageFirstOutput] - turn.time_us[kLatencyStageWake];
+            if (duration >= 0) {
+                samples.push_back(duration);
+            }
+        }
+        if (samples.empty()) {
+            continue;
+        }
+        std::sort(samples.begin(), samples.end());
+        // Nearest-rank percentiles
+        auto percentile = [&samples](int p) {
+            size_t rank = (samples.size() * p + 99) / 100;
+            return (long long)(samples[std::max<size_t>(rank, 1) - 1] / 1000);
+        };
+        snprintf(entry, sizeof(entry), "%s\"%s\":{\"p50\":%lld,\"p95\":%lld,\"p99\":%lld}",
+            json.back() == '{' ? "" : ",", i < kLatencyStageCount ? kStageNames[i] : "total",
+            percentile(50), percentile(95), percentile(99));
+        json += entry;
+    }
+    json += "}}";
+    return json;
+}
@@ -0,0 +1,48 @@
+#ifndef _LATENCY_STATS_H_
+#define _LATENCY_STATS_H_
+
+#include <cstdint>
+#include <string>
+
+// Stages of a voice turn, in the order they are expected to happen
+enum LatencyStage {
+    kLatencyStageWake,              // Wake word detected or chat started by a button
+    kLatencyStageChannelOpened,     // Audio channel opened (or already open)
+    kLatencyStageFirstEncode,       // First Opus packet encoded
+    kLatencyStageFirstSend,         // First audio packet handed to the protocol
+    kLatencyStageTtsStart,          // Server sent `tts start`
+    kLatencyStageFirstOutput,       // First decoded TTS packet written to the codec
+    kLatencyStageCount,
+};
+
+// Ring of recently finished turns behind LatencyTracer, with the stage
+// breakdown and percentile math. Plain C++ so recorded turns can be replayed
+// on a host. Not thread-safe, the tracer serializes access.
+class LatencyStats {
+public:
+    static constexpr int kMaxTurns = 16;
+
+    struct Turn {
+        uint32_t id;
+        int64_t time_us[kLatencyStageCount];   // 0 when the stage was not recorded
+    };
+
+    void Add(const Turn& turn);
+    int count() const { return turn_count_; }
+
+    // Recent turns as Chrome trace JSON (chrome://tracing, Perfetto)
+    std::string GetChromeTraceJson() const;
+    // Nearest-rank p50/p95/p99 of every stage over the kept turns, in milliseconds
+    std::string GetSummaryJson() const;
+
+    static const char* StageName(int stage);
+    // Time spent in `stage` since the previous recorded stage, or -1 if not recorded
+    static int64_t StageDuration(const Turn& turn, int stage);
+
+private:
+    Turn turns_[kMaxTurns];
+    int turn_count_ = 0;
+    int turn_head_ = 0;
+};
+
+#endif // _LATENCY_STATS_H_
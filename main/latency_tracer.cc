@@ -0,0 +1,61 @@
+#include "latency_tracer.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "LatencyTracer"
+
+void LatencyTracer::BeginTurn() {
+    for (int i = 1; i < kLatencyStageCount; i++) {
+        current_[i] = 0;
+    }
+    current_[kLatencyStageWake] = esp_timer_get_time();
+    turn_id_++;
+}
+
+void LatencyTracer::Mark(LatencyStage stage) {
+    // Only stages of a started turn are recorded, and only their first occurrence
+    if (current_[kLatencyStageWake].load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    int64_t expected = 0;
+    if (!current_[stage].compare_exchange_strong(expected, esp_timer_get_time())) {
+        return;
+    }
+    if (stage == kLatencyStageFirstOutput) {
+        FinishTurn();
+    }
+}
+
+void LatencyTracer::FinishTurn() {
+    LatencyStats::Turn turn;
+    turn.id = turn_id_;
+    for (int i = 0; i < kLatencyStageCount; i++) {
+        turn.time_us[i] = current_[i].exchange(0);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.Add(turn);
+    }
+
+    std::string breakdown;
+    for (int i = 1; i < kLatencyStageCount; i++) {
+        int64_t duration = LatencyStats::StageDuration(turn, i);
+        if (duration >= 0) {
+            breakdown += " " + std::string(LatencyStats::StageName(i)) + "=" + std::to_string(duration / 1000);
+        }
+    }
+    ESP_LOGI(TAG, "Turn %lu: total %lld ms,%s", (unsigned long)turn.id,
+        (turn.time_us[kLatencyStageFirstOutput] - turn.time_us[kLatencyStageWake]) / 1000, breakdown.c_str());
+}
+
+std::string LatencyTracer::GetChromeTraceJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_.GetChromeTraceJson();
+}
+
+std::string LatencyTracer::GetSummaryJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_.GetSummaryJson();
+}
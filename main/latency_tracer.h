@@ -0,0 +1,43 @@
+#ifndef _LATENCY_TRACER_H_
+#define _LATENCY_TRACER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "latency_stats.h"
+
+// Records the first timestamp of every stage of the current turn. Marking a
+// stage is a single atomic compare-and-swap, so it can be called from the
+// audio and network tasks on every packet. A turn is closed when its first
+// TTS audio is played and kept in a small ring of recent turns.
+class LatencyTracer {
+public:
+    static LatencyTracer& GetInstance() {
+        static LatencyTracer instance;
+        return instance;
+    }
+    LatencyTracer(const LatencyTracer&) = delete;
+    LatencyTracer& operator=(const LatencyTracer&) = delete;
+
+    // Start a new turn at kLatencyStageWake, dropping an unfinished one
+    void BeginTurn();
+    void Mark(LatencyStage stage);
+
+    // Recent turns as Chrome trace JSON (chrome://tracing, Perfetto)
+    std::string GetChromeTraceJson();
+    // p50/p95/p99 of every stage over the last LatencyStats::kMaxTurns turns, in milliseconds
+    std::string GetSummaryJson();
+
+private:
+    std::atomic<uint32_t> turn_id_ = 0;
+    std::atomic<int64_t> current_[kLatencyStageCount] = {};
+    std::mutex mutex_;
+    LatencyStats stats_;
+
+    LatencyTracer() = default;
+    void FinishTurn();
+};
+
+#endif // _LATENCY_TRACER_H_
@@ -1,12 +1,15 @@
 #include "circular_strip.h"
 #include "application.h"
 #include <esp_log.h>
+#include <algorithm>
+#include <cmath>
 
 #define TAG "CircularStrip"
 
-#define BLINK_INFINITE -1
+#define LED_FRAME_INTERVAL_MS 20
+#define LED_STATS_INTERVAL_FRAMES 500
 
-CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_leds) {
+CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_leds), compositor_(max_leds) {
     // If the gpio is not connected, you should use NoLed class
     assert(gpio != GPIO_NUM_NC);
 
@@ -24,156 +27,159 @@ CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_
     ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip_));
     led_strip_clear(led_strip_);
 
+    // Effects are computed from elapsed time, so late ticks can be skipped without drifting
     esp_timer_create_args_t strip_timer_args = {
         .callback = [](void *arg) {
             auto strip = static_cast<CircularStrip*>(arg);
             std::lock_guard<std::mutex> lock(strip->mutex_);
-            if (strip->strip_callback_ != nullptr) {
-                strip->strip_callback_();
-            }
+            strip->RenderFrame();
         },
         .arg = this,
         .dispatch_method = ESP_TIMER_TASK,
         .name = "strip_timer",
-        .skip_unhandled_events = false,
+        .skip_unhandled_events = true,
     };
     ESP_ERROR_CHECK(esp_timer_create(&strip_timer_args, &strip_timer_));
 }
 
 CircularStrip::~CircularStrip() {
     esp_timer_stop(strip_timer_);
+    esp_timer_delete(strip_timer_);
     if (led_strip_ != nullptr) {
         led_strip_del(led_strip_);
     }
 }
 
+// Must be called with mutex_ held
+void CircularStrip::RenderFrame() {
+    auto start_time = esp_timer_get_time();
+    if (compositor_.Render(start_time / 1000)) {
+        auto& frame = compositor_.frame();
+        for (int i = 0; i < max_leds_; i++) {
+            led_strip_set_pixel(led_strip_, i, frame[i].red, frame[i].green, frame[i].blue);
+        }
+        led_strip_refresh(led_strip_);
+    }
+
+    auto render_time = esp_timer_get_time() - start_time;
+    render_time_us_ += render_time;
+    max_render_time_us_ = std::max(max_render_time_us_, render_time);
+    if (++frame_count_ % LED_STATS_INTERVAL_FRAMES == 0) {
+        ESP_LOGD(TAG, "%d LEDs, frame cost avg %lld us, max %lld us", max_leds_,
+            render_time_us_ / LED_STATS_INTERVAL_FRAMES, max_render_time_us_);
+        render_time_us_ = 0;
+        max_render_time_us_ = 0;
+    }
+
+    if (!compositor_.IsAnimated()) {
+        esp_timer_stop(strip_timer_);
+    }
+}
+
+void CircularStrip::SetEffect(std::unique_ptr<LedEffect> effect) {
+    if (led_strip_ == nullptr) {
+        return;
+    }
 
-void CircularStrip::SetAllColor(StripColor color) {
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
+    compositor_.SetLayer(kLayerBase, std::move(effect), esp_timer_get_time() / 1000);
+    RenderFrame();
+    if (compositor_.IsAnimated() && !esp_timer_is_active(strip_timer_)) {
+        esp_timer_start_periodic(strip_timer_, LED_FRAME_INTERVAL_MS * 1000);
+    }
+}
+
+void CircularStrip::SetAllColor(StripColor color) {
     for (int i = 0; i < max_leds_; i++) {
         colors_[i] = color;
-        led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
     }
-    led_strip_refresh(led_strip_);
+    SetEffect(std::make_unique<StaticEffect>(colors_));
 }
 
 void CircularStrip::SetSingleColor(uint8_t index, StripColor color) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
     colors_[index] = color;
-    led_strip_set_pixel(led_strip_, index, color.red, color.green, color.blue);
-    led_strip_refresh(led_strip_);
+    SetEffect(std::make_unique<StaticEffect>(colors_));
 }
 
 void CircularStrip::Blink(StripColor color, int interval_ms) {
     for (int i = 0; i < max_leds_; i++) {
         colors_[i] = color;
     }
-    StartStripTask(interval_ms, [this]() {
-        static bool on = true;
-        if (on) {
-            for (int i = 0; i < max_leds_; i++) {
-                led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-            }
-            led_strip_refresh(led_strip_);
-        } else {
-            led_strip_clear(led_strip_);
-        }
-        on = !on;
-    });
+    std::vector<KeyframeEffect::Keyframe> keyframes = {
+        { 0, color, 255 },
+        { interval_ms, StripColor{}, 255 },
+        { interval_ms * 2, color, 255 },
+    };
+    SetEffect(std::make_unique<KeyframeEffect>(std::move(keyframes), true, true));
 }
 
 void CircularStrip::FadeOut(int interval_ms) {
-    StartStripTask(interval_ms, [this]() {
-        bool all_off = true;
-        for (int i = 0; i < max_leds_; i++) {
-            colors_[i].red /= 2;
-            colors_[i].green /= 2;
-            colors_[i].blue /= 2;
-            if (colors_[i].red != 0 || colors_[i].green != 0 || colors_[i].blue != 0) {
-                all_off = false;
-            }
-            led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-        }
-        if (all_off) {
-            led_strip_clear(led_strip_);
-            esp_timer_stop(strip_timer_);
-        } else {
-            led_strip_refresh(led_strip_);
-        }
-    });
+    std::vector<StripColor> colors;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        colors = compositor_.linear_frame();
+        compositor_.ClearLayer(kLayerAudio);
+    }
+    SetEffect(std::make_unique<FadeOutEffect>(colors, interval_ms));
 }
 
 void CircularStrip::Breathe(StripColor low, StripColor high, int interval_ms) {
-    StartStripTask(interval_ms, [this, low, high]() {
-        static bool increase = true;
-        static StripColor color = low;
-        if (increase) {
-            if (color.red < high.red) {
-                color.red++;
-            }
-            if (color.green < high.green) {
-                color.green++;
-            }
-            if (color.blue < high.blue) {
-                color.blue++;
-            }
-            if (color.red == high.red && color.green == high.green && color.blue == high.blue) {
-                increase = false;
-            }
-        } else {
-            if (color.red > low.red) {
-                color.red--;
-            }
-            if (color.green > low.green) {
-                color.green--;
-            }
-            if (color.blue > low.blue) {
-                color.blue--;
-            }
-            if (color.red == low.red && color.green == low.green && color.blue == low.blue) {
-                increase = true;
-            }
-        }
-        for (int i = 0; i < max_leds_; i++) {
-            led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
-        }
-        led_strip_refresh(led_strip_);
-    });
+    // One brightness step per interval, as far as the widest channel needs
+    int steps = std::max({ std::abs(high.red - low.red), std::abs(high.green - low.green), std::abs(high.blue - low.blue), 1 });
+    int half_period = steps * interval_ms;
+    std::vector<KeyframeEffect::Keyframe> keyframes = {
+        { 0, low, 255 },
+        { half_period, high, 255 },
+        { half_period * 2, low, 255 },
+    };
+    SetEffect(std::make_unique<KeyframeEffect>(std::move(keyframes), true));
 }
 
 void CircularStrip::Scroll(StripColor low, StripColor high, int length, int interval_ms) {
     for (int i = 0; i < max_leds_; i++) {
         colors_[i] = low;
     }
-    StartStripTask(interval_ms, [this, low, high, length]() {
-        static int offset = 0;
-        for (int i = 0; i < max_leds_; i++) {
-            colors_[i] = low;
-        }
-        for (int j = 0; j < length; j++) {
-            int i = (offset + j) % max_leds_;
-            colors_[i] = high;
-        }
-        for (int i = 0; i < max_leds_; i++) {
-            led_strip_set_pixel(led_strip_, i, colors_[i].red, colors_[i].green, colors_[i].blue);
-        }
-        led_strip_refresh(led_strip_);
-        offset = (offset + 1) % max_leds_;
-    });
+    SetEffect(std::make_unique<ScrollEffect>(low, high, length, interval_ms));
 }
 
-void CircularStrip::StartStripTask(int interval_ms, std::function<void()> cb) {
+void CircularStrip::ShowAudioLevel(bool enabled, StripColor color) {
     if (led_strip_ == nullptr) {
         return;
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    
-    strip_callback_ = cb;
-    esp_timer_start_periodic(strip_timer_, interval_ms * 1000);
+    if (enabled) {
+        audio_level_ = 0;
+        compositor_.SetLayer(kLayerAudio, std::make_unique<AudioLevelEffect>(audio_level_, color),
+            esp_timer_get_time() / 1000, kLedBlendAdd);
+        if (!esp_timer_is_active(strip_timer_)) {
+            esp_timer_start_periodic(strip_timer_, LED_FRAME_INTERVAL_MS * 1000);
+        }
+    } else {
+        compositor_.ClearLayer(kLayerAudio);
+    }
+    RenderFrame();
+}
+
+void CircularStrip::OnOutputAudio(const std::vector<int16_t>& pcm) {
+    if (pcm.empty()) {
+        return;
+    }
+    int64_t sum = 0;
+    for (auto sample : pcm) {
+        sum += (int32_t)sample * sample;
+    }
+    // Map the RMS level from -48 dBFS .. 0 dBFS onto 0 .. 255
+    float rms = std::sqrt((float)sum / pcm.size()) / 32768.0f;
+    float db = rms > 0 ? 20.0f * std::log10(rms) : -96.0f;
+    int level = (int)((db + 48.0f) * 255.0f / 48.0f);
+    audio_level_ = std::clamp(level, 0, 255);
+}
+
+void CircularStrip::SetGamma(float gamma) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    compositor_.SetGamma(gamma);
+    RenderFrame();
 }
 
 void CircularStrip::SetBrightness(uint8_t default_brightness, uint8_t low_brightness) {
@@ -213,7 +219,8 @@ void CircularStrip::OnStateChanged() {
         case kDeviceStateSpeaking: {
             StripColor color = { low_brightness_, default_brightness_, low_brightness_ };
             SetAllColor(color);
-            break;
+            ShowAudioLevel(true, StripColor{ 0, default_brightness_, 0 });
+            return;
         }
         case kDeviceStateUpgrading: {
             StripColor color = { low_brightness_, default_brightness_, low_brightness_ };
@@ -229,4 +236,5 @@ void CircularStrip::OnStateChanged() {
             ESP_LOGW(TAG, "Unknown led strip event: %d", device_state);
             return;
     }
+    ShowAudioLevel(false);
 }
@@ -2,6 +2,7 @@
 #define _CIRCULAR_STRIP_H_
 
 #include "led.h"
+#include "led_effect.h"
 #include <driver/gpio.h>
 #include <led_strip.h>
 #include <esp_timer.h>
@@ -12,39 +13,48 @@
 #define DEFAULT_BRIGHTNESS 32
 #define LOW_BRIGHTNESS 4
 
-struct StripColor {
-    uint8_t red = 0, green = 0, blue = 0;
-};
-
 class CircularStrip : public Led {
 public:
     CircularStrip(gpio_num_t gpio, uint8_t max_leds);
     virtual ~CircularStrip();
 
     void OnStateChanged() override;
+    void OnOutputAudio(const std::vector<int16_t>& pcm) override;
     void SetBrightness(uint8_t default_brightness, uint8_t low_brightness);
+    void SetGamma(float gamma);
     void SetAllColor(StripColor color);
     void SetSingleColor(uint8_t index, StripColor color);
     void Blink(StripColor color, int interval_ms);
     void Breathe(StripColor low, StripColor high, int interval_ms);
     void Scroll(StripColor low, StripColor high, int length, int interval_ms);
 
+    // Show the playback level on top of the current effect, or remove it
+    void ShowAudioLevel(bool enabled, StripColor color = {});
+
 private:
+    enum Layer {
+        kLayerBase,
+        kLayerAudio,
+    };
+
     std::mutex mutex_;
-    TaskHandle_t blink_task_ = nullptr;
     led_strip_handle_t led_strip_ = nullptr;
     int max_leds_ = 0;
     std::vector<StripColor> colors_;
-    int blink_counter_ = 0;
-    int blink_interval_ms_ = 0;
     esp_timer_handle_t strip_timer_ = nullptr;
-    std::function<void()> strip_callback_ = nullptr;
+    LedCompositor compositor_;
+    std::atomic<uint8_t> audio_level_ = 0;
+
+    // Render cost, logged periodically
+    uint32_t frame_count_ = 0;
+    int64_t render_time_us_ = 0;
+    int64_t max_render_time_us_ = 0;
 
     uint8_t default_brightness_ = DEFAULT_BRIGHTNESS;
     uint8_t low_brightness_ = LOW_BRIGHTNESS;
 
-    void StartStripTask(int interval_ms, std::function<void()> cb);
-    void Rainbow(StripColor low, StripColor high, int interval_ms);
+    void SetEffect(std::unique_ptr<LedEffect> effect);
+    void RenderFrame();
     void FadeOut(int interval_ms);
 };
 
@@ -1,11 +1,16 @@
 #ifndef _LED_H_
 #define _LED_H_
 
+#include <cstdint>
+#include <vector>
+
 class Led {
 public:
     virtual ~Led() = default;
     // Set the led state based on the device state
     virtual void OnStateChanged() = 0;
+    // Called with every block of decoded PCM sent to the speaker
+    virtual void OnOutputAudio(const std::vector<int16_t>& pcm) {}
 };
 
 
@@ -0,0 +1,203 @@
+#include "led_effect.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Smoothing of the audio level meter
+#define AUDIO_LEVEL_ATTACK_MS 30
+#define AUDIO_LEVEL_RELEASE_MS 300
+
+static uint8_t Lerp(uint8_t a, uint8_t b, int64_t pos, int64_t span) {
+    return a + (int)(((int64_t)b - a) * pos / span);
+}
+
+bool StaticEffect::Render(int64_t time_ms, std::vector<LedPixel>& pixels) {
+    for (size_t i = 0; i < pixels.size() && i < colors_.size(); i++) {
+        pixels[i].color = colors_[i];
+        pixels[i].alpha = 255;
+    }
+    return true;
+}
+
+bool KeyframeEffect::Render(int64_t time_ms, std::vector<LedPixel>& pixels) {
+    if (keyframes_.empty()) {
+        return false;
+    }
+
+    int64_t duration = keyframes_.back().time_ms;
+    bool running = true;
+    if (loop_ && duration > 0) {
+        time_ms %= duration;
+    } else if (time_ms >= duration) {
+        time_ms = duration;
+        running = false;
+    }
+
+    // Find the segment [from, to] containing time_ms
+    size_t to = 0;
+    while (to < keyframes_.size() - 1 && keyframes_[to].time_ms <= time_ms) {
+        to++;
+    }
+    size_t from = to > 0 ? to - 1 : 0;
+    if (keyframes_[to].time_ms <= time_ms) {
+        from = to;
+    }
+
+    const auto& a = keyframes_[from];
+    const auto& b = keyframes_[to];
+    LedPixel pixel;
+    int64_t span = b.time_ms - a.time_ms;
+    if (step_ || span <= 0) {
+        pixel.color = a.color;
+        pixel.alpha = a.alpha;
+    } else {
+        int64_t pos = time_ms - a.time_ms;
+        pixel.color.red = Lerp(a.color.red, b.color.red, pos, span);
+        pixel.color.green = Lerp(a.color.green, b.color.green, pos, span);
+        pixel.color.blue = Lerp(a.color.blue, b.color.blue, pos, span);
+        pixel.alpha = Lerp(a.alpha, b.alpha, pos, span);
+    }
+    std::fill(pixels.begin(), pixels.end(), pixel);
+    return running;
+}
+
+bool ScrollEffect::Render(int64_t time_ms, std::vector<LedPixel>& pixels) {
+    int count = pixels.size();
+    if (count == 0) {
+        return true;
+    }
+    for (auto& pixel : pixels) {
+        pixel.color = low_;
+        pixel.alpha = 255;
+    }
+    int offset = step_ms_ > 0 ? (time_ms / step_ms_) % count : 0;
+    for (int j = 0; j < length_; j++) {
+        pixels[(offset + j) % count].color = high_;
+    }
+    return true;
+}
+
+bool FadeOutEffect::Render(int64_t time_ms, std::vector<LedPixel>& pixels) {
+    int shift = half_life_ms_ > 0 ? std::min<int64_t>(time_ms / half_life_ms_, 8) : 8;
+    bool all_off = true;
+    for (size_t i = 0; i < pixels.size() && i < colors_.size(); i++) {
+        auto& color = pixels[i].color;
+        color.red = colors_[i].red >> shift;
+        color.green = colors_[i].green >> shift;
+        color.blue = colors_[i].blue >> shift;
+        pixels[i].alpha = 255;
+        if (color.red != 0 || color.green != 0 || color.blue != 0) {
+            all_off = false;
+        }
+    }
+    return !all_off;
+}
+
+bool AudioLevelEffect::Render(int64_t time_ms, std::vector<LedPixel>& pixels) {
+    int target = level_.load() << 8;
+    int64_t elapsed = last_time_ms_ < 0 ? 0 : time_ms - last_time_ms_;
+    last_time_ms_ = time_ms;
+    int time_constant = target > smoothed_ ? AUDIO_LEVEL_ATTACK_MS : AUDIO_LEVEL_RELEASE_MS;
+    if (elapsed >= time_constant) {
+        smoothed_ = target;
+    } else {
+        smoothed_ += (target - smoothed_) * elapsed / time_constant;
+    }
+
+    // Number of lit LEDs in 8.8 fixed point, the last one partially
+    int lit = (int64_t)smoothed_ * pixels.size() / 255;
+    for (size_t i = 0; i < pixels.size(); i++) {
+        int remaining = lit - ((int)i << 8);
+        pixels[i].color = color_;
+        pixels[i].alpha = remaining >= 256 ? 255 : (remaining > 0 ? remaining : 0);
+    }
+    return true;
+}
+
+LedCompositor::LedCompositor(int count) : count_(count) {
+    pixels_.resize(count);
+    linear_.resize(count);
+    frame_.resize(count);
+    SetGamma(1.0f);
+}
+
+void LedCompositor::SetLayer(int layer, std::unique_ptr<LedEffect> effect, int64_t now_ms, LedBlendMode mode) {
+    layers_[layer] = Layer{std::move(effect), mode, now_ms, false};
+    dirty_ = true;
+}
+
+void LedCompositor::ClearLayer(int layer) {
+    if (layers_.erase(layer) > 0) {
+        dirty_ = true;
+    }
+}
+
+void LedCompositor::Clear() {
+    layers_.clear();
+    dirty_ = true;
+}
+
+void LedCompositor::SetGamma(float gamma) {
+    for (int i = 0; i < 256; i++) {
+        gamma_table_[i] = (uint8_t)std::lround(std::pow(i / 255.0f, gamma) * 255.0f);
+    }
+    dirty_ = true;
+}
+
+bool LedCompositor::IsAnimated() const {
+    for (auto& [index, layer] : layers_) {
+        if (!layer.finished && layer.effect->IsAnimated()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LedCompositor::Render(int64_t now_ms) {
+    if (!dirty_ && !IsAnimated()) {
+        return false;
+    }
+    dirty_ = false;
+
+    std::fill(linear_.begin(), linear_.end(), StripColor{});
+    for (auto& [index, layer] : layers_) {
+        std::fill(pixels_.begin(), pixels_.end(), LedPixel{});
+        if (!layer.effect->Render(now_ms - layer.start_ms, pixels_)) {
+            // Finished effects keep showing their last frame
+            layer.finished = true;
+        }
+
+        for (int i = 0; i < count_; i++) {
+            const auto& src = pixels_[i];
+            auto& dst = linear_[i];
+            if (src.alpha == 0) {
+                continue;
+            }
+            if (layer.mode == kLedBlendAdd) {
+                dst.red = std::min(255, dst.red + src.color.red * src.alpha / 255);
+                dst.green = std::min(255, dst.green + src.color.green * src.alpha / 255);
+                dst.blue = std::min(255, dst.blue + src.color.blue * src.alpha / 255);
+            } else if (src.alpha == 255) {
+                dst = src.color;
+            } else {
+                dst.red = Lerp(dst.red, src.color.red, src.alpha, 255);
+                dst.green = Lerp(dst.green, src.color.green, src.alpha, 255);
+                dst.blue = Lerp(dst.blue, src.color.blue, src.alpha, 255);
+            }
+        }
+    }
+
+    bool changed = false;
+    for (int i = 0; i < count_; i++) {
+        StripColor color = {
+            gamma_table_[linear_[i].red],
+            gamma_table_[linear_[i].green],
+            gamma_table_[linear_[i].blue],
+        };
+        if (color.red != frame_[i].red || color.green != frame_[i].green || color.blue != frame_[i].blue) {
+            frame_[i] = color;
+            changed = true;
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,149 @@
+#ifndef _LED_EFFECT_H_
+#define _LED_EFFECT_H_
+
+#include <cstdint>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+// The effect engine is plain C++ without ESP-IDF dependencies, so frames
+// can also be rendered on a host for inspection and timing.
+
+struct StripColor {
+    uint8_t red = 0, green = 0, blue = 0;
+};
+
+struct LedPixel {
+    StripColor color;
+    uint8_t alpha = 0;
+};
+
+class LedEffect {
+public:
+    virtual ~LedEffect() = default;
+    // Render the effect `time_ms` after it started, one pixel per LED.
+    // Returns false once the final frame is reached; it is held from then on.
+    virtual bool Render(int64_t time_ms, std::vector<LedPixel>& pixels) = 0;
+    // Effects that never change after the first frame do not need the frame timer
+    virtual bool IsAnimated() const { return true; }
+};
+
+// Fixed per-LED colors
+class StaticEffect : public LedEffect {
+public:
+    StaticEffect(const std::vector<StripColor>& colors) : colors_(colors) {}
+    bool Render(int64_t time_ms, std::vector<LedPixel>& pixels) override;
+    bool IsAnimated() const override { return false; }
+
+private:
+    std::vector<StripColor> colors_;
+};
+
+// A color/alpha timeline applied to every LED, interpolated between keyframes
+class KeyframeEffect : public LedEffect {
+public:
+    struct Keyframe {
+        int time_ms;
+        StripColor color;
+        uint8_t alpha;
+    };
+
+    // Keyframes must be sorted by time. With `step` set the color jumps at each
+    // keyframe instead of fading; with `loop` set the timeline repeats from the
+    // start after the last keyframe.
+    KeyframeEffect(std::vector<Keyframe> keyframes, bool loop, bool step = false)
+        : keyframes_(std::move(keyframes)), loop_(loop), step_(step) {}
+    bool Render(int64_t time_ms, std::vector<LedPixel>& pixels) override;
+
+private:
+    std::vector<Keyframe> keyframes_;
+    bool loop_;
+    bool step_;
+};
+
+// A band of `length` LEDs moving one position every `step_ms`
+class ScrollEffect : public LedEffect {
+public:
+    ScrollEffect(StripColor low, StripColor high, int length, int step_ms)
+        : low_(low), high_(high), length_(length), step_ms_(step_ms) {}
+    bool Render(int64_t time_ms, std::vector<LedPixel>& pixels) override;
+
+private:
+    StripColor low_, high_;
+    int length_;
+    int step_ms_;
+};
+
+// Halves the brightness of the starting colors every `half_life_ms` until black
+class FadeOutEffect : public LedEffect {
+public:
+    FadeOutEffect(const std::vector<StripColor>& colors, int half_life_ms) : colors_(colors), half_life_ms_(half_life_ms) {}
+    bool Render(int64_t time_ms, std::vector<LedPixel>& pixels) override;
+
+private:
+    std::vector<StripColor> colors_;
+    int half_life_ms_;
+};
+
+// Level meter around the ring driven by the playback volume. The level is
+// written from the audio path and smoothed here with a fast attack and a
+// slow release so the ring follows speech without flickering.
+class AudioLevelEffect : public LedEffect {
+public:
+    AudioLevelEffect(const std::atomic<uint8_t>& level, StripColor color) : level_(level), color_(color) {}
+    bool Render(int64_t time_ms, std::vector<LedPixel>& pixels) override;
+
+private:
+    const std::atomic<uint8_t>& level_;
+    StripColor color_;
+    int smoothed_ = 0;      // 8.8 fixed point
+    int64_t last_time_ms_ = -1;
+};
+
+enum LedBlendMode {
+    kLedBlendNormal,    // Alpha blend over the layers below
+    kLedBlendAdd,       // Add the color scaled by alpha, saturating
+};
+
+// Composes a stack of effect layers into one gamma corrected frame
+class LedCompositor {
+public:
+    LedCompositor(int count);
+
+    // Place `effect` on `layer`, replacing what was there. Higher layers draw on top.
+    void SetLayer(int layer, std::unique_ptr<LedEffect> effect, int64_t now_ms, LedBlendMode mode = kLedBlendNormal);
+    void ClearLayer(int layer);
+    void Clear();
+
+    // 1.0 leaves the colors untouched
+    void SetGamma(float gamma);
+
+    // Compose all layers at `now_ms` into the output frame.
+    // Returns true if the frame differs from the previous one.
+    bool Render(int64_t now_ms);
+    // True while any layer needs further frames
+    bool IsAnimated() const;
+
+    const std::vector<StripColor>& frame() const { return frame_; }
+    // Colors before gamma correction, e.g. to start a fade from
+    const std::vector<StripColor>& linear_frame() const { return linear_; }
+
+private:
+    struct Layer {
+        std::unique_ptr<LedEffect> effect;
+        LedBlendMode mode;
+        int64_t start_ms;
+        bool finished;
+    };
+
+    int count_;
+    std::map<int, Layer> layers_;
+    std::vector<LedPixel> pixels_;
+    std::vector<StripColor> linear_;
+    std::vector<StripColor> frame_;
+    uint8_t gamma_table_[256];
+    bool dirty_ = true;
+};
+
+#endif // _LED_EFFECT_H_
@@ -21,6 +21,9 @@
 #include "display/spi_lcd_anim_display.h"
 #include "alarm_mcp_tools.h"
 #include "time_sync_manager.h"
+#include "latency_tracer.h"
+#include "system_profiler.h"
+#include "language_pack.h"
 #include <esp_heap_caps.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -406,6 +409,37 @@ void McpServer::AddCommonTools() {
             return board.GetDeviceStatusJson();
         });
 
+    AddTool("self.get_system_stats",
+        "Get the runtime statistics of the device sampled every few seconds: CPU load and per-task CPU share, "
+        "task stack high-water marks, internal and PSRAM heap usage, largest free block and fragmentation.\n"
+        "Args:\n"
+        "  `history`: true also returns the sampled time series (oldest first).",
+        PropertyList({
+            Property("history", kPropertyTypeBoolean, false)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            return SystemProfiler::GetInstance().GetStatsJson(properties["history"].value<bool>());
+        });
+
+    AddTool("self.language.get_info",
+        "Get the current display and prompt language of the device, the languages available to switch to, "
+        "and the language pack load time, memory footprint and sound cache statistics.",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return LanguagePack::GetInstance().GetStatusJson();
+        });
+
+    AddTool("self.language.set",
+        "Switch the display and prompt language of the device. Call `self.language.get_info` first to get the available language codes.\n"
+        "Args:\n"
+        "  `language`: A language code such as `zh-CN` or `en-US`.",
+        PropertyList({
+            Property("language", kPropertyTypeString)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            return LanguagePack::GetInstance().Load(properties["language"].value<std::string>());
+        });
+
     AddTool("self.audio_speaker.set_volume", 
         "Set the volume of the audio speaker. If the current volume is unknown, you must call `self.get_device_status` tool first and then call this tool.",
         PropertyList({
@@ -464,6 +498,22 @@ void McpServer::AddCommonTools() {
             });
     }
 
+    AddTool("self.debug.get_voice_latency",
+        "Get the latency breakdown of recent voice turns, from wake word to the first TTS audio played.\n"
+        "Args:\n"
+        "  `chrome_trace`: true returns the per-turn stages as Chrome trace JSON, false returns p50/p95/p99 per stage in milliseconds.\n"
+        "Only the last " + std::to_string(LatencyStats::kMaxTurns) + " turns are kept, so with few turns p95/p99 are close to the maximum.",
+        PropertyList({
+            Property("chrome_trace", kPropertyTypeBoolean, false)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& tracer = LatencyTracer::GetInstance();
+            if (properties["chrome_trace"].value<bool>()) {
+                return tracer.GetChromeTraceJson();
+            }
+            return tracer.GetSummaryJson();
+        });
+
    
 
     // Add Image Display related tools
@@ -3,11 +3,27 @@
 #include <esp_sntp.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <lwip/sockets.h>
+#include <lwip/netdb.h>
 #include <time.h>
 #include <sys/time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
 
 #define TAG "NTP_SYNC"
 
+#define NTP_PORT 123
+#define NTP_PACKET_SIZE 48
+// 1900年到1970年的秒数
+#define NTP_UNIX_OFFSET 2208988800ULL
+// 每个服务器的请求次数，取往返延迟最小的一次
+#define NTP_QUERIES_PER_SERVER 4
+#define NTP_RECEIVE_TIMEOUT_MS 1000
+// 超过该偏差直接设置时间，否则用adjtime平滑调整
+#define NTP_STEP_THRESHOLD_US 500000
+
 // 中国NTP服务器列表
 static const char* ntp_servers[] = {
     "ntp.aliyun.com",        // 阿里云NTP服务器
@@ -16,6 +32,32 @@ static const char* ntp_servers[] = {
     "pool.ntp.org"           // 全球NTP池（备用）
 };
 
+static int64_t GetTimeUs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void WriteTimestamp(uint8_t* p, int64_t unix_us) {
+    uint32_t seconds = (uint32_t)(unix_us / 1000000 + NTP_UNIX_OFFSET);
+    uint32_t fraction = (uint32_t)(((unix_us % 1000000) << 32) / 1000000);
+    for (int i = 0; i < 4; i++) {
+        p[i] = seconds >> (24 - i * 8);
+        p[4 + i] = fraction >> (24 - i * 8);
+    }
+}
+
+static int64_t ReadTimestamp(const uint8_t* p) {
+    uint32_t seconds = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    uint32_t fraction = ((uint32_t)p[4] << 24) | ((uint32_t)p[5] << 16) | ((uint32_t)p[6] << 8) | p[7];
+    // NTP时间戳在2036年回绕，最高位为0时按下一个纪元处理
+    int64_t unix_seconds = (int64_t)seconds - (int64_t)NTP_UNIX_OFFSET;
+    if (!(seconds & 0x80000000)) {
+        unix_seconds += 0x100000000LL;
+    }
+    return unix_seconds * 1000000 + (((uint64_t)fraction * 1000000) >> 32);
+}
+
 NtpSync::NtpSync() 
     : rtc_(nullptr), is_synced_(false), last_sync_time_(0) {
 }
@@ -55,8 +97,8 @@ void NtpSync::ConfigureSntp() {
     // 设置操作模式为轮询模式
     esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
     
-    // 设置同步模式为立即更新
-    esp_sntp_set_sync_mode(SNTP_SYNC_MODE_IMMED);
+    // 首次同步已经由SyncTime完成，之后的周期同步平滑调整，避免时间跳变
+    esp_sntp_set_sync_mode(SNTP_SYNC_MODE_SMOOTH);
     
     // 添加NTP服务器
     for (int i = 0; i < sizeof(ntp_servers) / sizeof(ntp_servers[0]); i++) {
@@ -74,132 +116,172 @@ void NtpSync::ConfigureSntp() {
     ESP_LOGI(TAG, "Timezone re-confirmed after SNTP configuration: CST-8 (UTC+8)");
 }
 
+bool NtpSync::QueryServer(const char* server, NtpSample* sample) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo* res = nullptr;
+    if (getaddrinfo(server, "123", &hints, &res) != 0 || res == nullptr) {
+        ESP_LOGW(TAG, "Failed to resolve %s", server);
+        return false;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        freeaddrinfo(res);
+        return false;
+    }
+    struct timeval timeout = { .tv_sec = NTP_RECEIVE_TIMEOUT_MS / 1000, .tv_usec = (NTP_RECEIVE_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    bool found = false;
+    uint8_t packet[NTP_PACKET_SIZE];
+    for (int i = 0; i < NTP_QUERIES_PER_SERVER; i++) {
+        // LI=0, VN=4, Mode=3（客户端），发送时间戳放在Transmit字段，服务器会原样放回Originate字段
+        memset(packet, 0, sizeof(packet));
+        packet[0] = 0x23;
+        int64_t t1 = GetTimeUs();
+        WriteTimestamp(packet + 40, t1);
+        uint8_t request_timestamp[8];
+        memcpy(request_timestamp, packet + 40, sizeof(request_timestamp));
+        if (sendto(sock, packet, sizeof(packet), 0, res->ai_addr, res->ai_addrlen) != sizeof(packet)) {
+            continue;
+        }
+
+        int len = recv(sock, packet, sizeof(packet), 0);
+        int64_t t4 = GetTimeUs();
+        if (len < NTP_PACKET_SIZE) {
+            ESP_LOGD(TAG, "No response from %s", server);
+            continue;
+        }
+        int mode = packet[0] & 0x07;
+        int stratum = packet[1];
+        if (mode != 4 || stratum < 1 || stratum > 15 || memcmp(packet + 24, request_timestamp, 8) != 0) {
+            ESP_LOGD(TAG, "Invalid response from %s: mode %d stratum %d", server, mode, stratum);
+            continue;
+        }
+
+        int64_t t2 = ReadTimestamp(packet + 32);
+        int64_t t3 = ReadTimestamp(packet + 40);
+        NtpSample current = {
+            .offset_us = ((t2 - t1) + (t3 - t4)) / 2,
+            .delay_us = (t4 - t1) - (t3 - t2),
+        };
+        if (current.delay_us < 0) {
+            continue;
+        }
+        // 往返延迟最小的一次受网络排队影响最小，偏差也最准确
+        if (!found || current.delay_us < sample->delay_us) {
+            *sample = current;
+            found = true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
+
+    close(sock);
+    freeaddrinfo(res);
+    if (found) {
+        ESP_LOGI(TAG, "%s: offset %lld us, delay %lld us", server, sample->offset_us, sample->delay_us);
+    }
+    return found;
+}
+
+bool NtpSync::MeasureOffset(NtpSample* sample) {
+    std::vector<NtpSample> samples;
+    for (int i = 0; i < sizeof(ntp_servers) / sizeof(ntp_servers[0]); i++) {
+        NtpSample server_sample;
+        if (QueryServer(ntp_servers[i], &server_sample)) {
+            samples.push_back(server_sample);
+        }
+    }
+    if (samples.empty()) {
+        return false;
+    }
+
+    // 中位数可以排除个别时间错误的服务器
+    std::sort(samples.begin(), samples.end(), [](const NtpSample& a, const NtpSample& b) {
+        return a.offset_us < b.offset_us;
+    });
+    *sample = samples[samples.size() / 2];
+    ESP_LOGI(TAG, "Selected offset %lld us (delay %lld us) from %d servers",
+             sample->offset_us, sample->delay_us, (int)samples.size());
+    return true;
+}
+
+bool NtpSync::ApplyOffset(int64_t offset_us) {
+    time_t now;
+    time(&now);
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+    if (llabs(offset_us) < NTP_STEP_THRESHOLD_US && timeinfo.tm_year + 1900 >= 2025) {
+        // 偏差较小时平滑调整，避免时间倒退或跳变
+        struct timeval delta = { .tv_sec = (time_t)(offset_us / 1000000), .tv_usec = (suseconds_t)(offset_us % 1000000) };
+        if (adjtime(&delta, nullptr) == 0) {
+            ESP_LOGI(TAG, "Slewing system clock by %lld us", offset_us);
+            return true;
+        }
+        ESP_LOGW(TAG, "adjtime failed, stepping instead");
+    }
+
+    // 取消尚未完成的平滑调整后直接设置
+    struct timeval zero = {};
+    adjtime(&zero, nullptr);
+    int64_t target_us = GetTimeUs() + offset_us;
+    struct timeval tv = { .tv_sec = (time_t)(target_us / 1000000), .tv_usec = (suseconds_t)(target_us % 1000000) };
+    if (settimeofday(&tv, nullptr) != 0) {
+        ESP_LOGE(TAG, "Failed to set system time");
+        return false;
+    }
+    ESP_LOGI(TAG, "Stepped system clock by %lld ms", offset_us / 1000);
+    return true;
+}
+
 bool NtpSync::SyncTime(NtpSyncCallback callback) {
     ESP_LOGI(TAG, "Starting NTP time sync");
     
-    // 配置SNTP（首次或重新配置）
-    ConfigureSntp();
-    
-    // 关键修复：启动SNTP前再次确认时区设置
+    // 确认时区设置
     setenv("TZ", "CST-8", 1);
     tzset();
-    ESP_LOGI(TAG, "Timezone confirmed before SNTP start: CST-8 (UTC+8)");
     
-    // 启动SNTP
-    esp_sntp_init();
-    
-    // 等待时间同步 - 使用更可靠的同步状态检查
-    int retry = 0;
-    const int retry_count = 10;
-    sntp_sync_status_t sync_status = SNTP_SYNC_STATUS_RESET;
-    
-    while (sync_status != SNTP_SYNC_STATUS_COMPLETED && ++retry < retry_count) {
-        ESP_LOGI(TAG, "Waiting for NTP sync... (%d/%d)", retry, retry_count);
-        vTaskDelay(2000 / portTICK_PERIOD_MS);
-        
-        sync_status = esp_sntp_get_sync_status();
-        ESP_LOGI(TAG, "SNTP sync status: %d", (int)sync_status);
-        
-        // 检查当前时间是否合理
-        time_t now;
-        time(&now);
-        struct tm timeinfo;
-        
-        // 关键修复：每次获取时间前确认时区设置
-        setenv("TZ", "CST-8", 1);
-        tzset();
-        
-        localtime_r(&now, &timeinfo);
-        
-        // 调试：输出详细的时间信息
-        ESP_LOGD(TAG, "Sync attempt %d: Raw timestamp=%lld, converted time=%04d-%02d-%02d %02d:%02d:%02d", 
-                 retry, (long long)now,
-                 timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
-                 timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-        
-        // 如果同步状态显示已完成，验证时间的合理性
-        if (sync_status == SNTP_SYNC_STATUS_COMPLETED) {
-            // 验证年份是否合理（2025年）
-            if (timeinfo.tm_year + 1900 >= 2025 && timeinfo.tm_year + 1900 <= 2026) {
-                // 验证月份是否合理（1月前后）
-                if (timeinfo.tm_mon >= 0 && timeinfo.tm_mon <= 11) {
-                    ESP_LOGI(TAG, "NTP sync completed with reasonable time");
-                    break;
-                } else {
-                    ESP_LOGW(TAG, "NTP sync completed but month (%d) seems unreasonable", timeinfo.tm_mon + 1);
-                }
-            } else {
-                ESP_LOGW(TAG, "NTP sync completed but year (%d) seems unreasonable", timeinfo.tm_year + 1900);
-                // 强制重新同步
-                esp_sntp_stop();
-                vTaskDelay(1000 / portTICK_PERIOD_MS);
-                esp_sntp_init();
-                sync_status = SNTP_SYNC_STATUS_RESET;
-            }
-        }
-    }
-    
-    if (sync_status != SNTP_SYNC_STATUS_COMPLETED) {
-        ESP_LOGE(TAG, "Failed to sync time from NTP servers after %d attempts", retry_count);
+    // 测量本地时钟偏差：每个服务器多次请求取最优，再在服务器之间取中位数
+    NtpSample sample;
+    if (!MeasureOffset(&sample)) {
+        ESP_LOGE(TAG, "Failed to sync time from NTP servers");
         if (callback) {
             callback(false, "NTP同步失败：无法连接到NTP服务器");
         }
         return false;
     }
     
-    // 关键修复：同步成功后最后一次确认时区设置
-    setenv("TZ", "CST-8", 1);
-    tzset();
-    
-    // 详细调试：检查最终同步后的时间
-    time_t now;
-    time(&now);
-    ESP_LOGI(TAG, "Final NTP sync - Raw UTC timestamp: %lld", (long long)now);
-    
-    // 分别用UTC和本地时间转换来验证
-    struct tm* utc_tm = gmtime(&now);
-    struct tm* local_tm = localtime(&now);
-    
-    if (utc_tm) {
-        ESP_LOGI(TAG, "UTC time: %04d-%02d-%02d %02d:%02d:%02d", 
-                 utc_tm->tm_year + 1900, utc_tm->tm_mon + 1, utc_tm->tm_mday,
-                 utc_tm->tm_hour, utc_tm->tm_min, utc_tm->tm_sec);
-    }
-    
-    if (local_tm) {
-        ESP_LOGI(TAG, "Local time (CST-8): %04d-%02d-%02d %02d:%02d:%02d", 
-                 local_tm->tm_year + 1900, local_tm->tm_mon + 1, local_tm->tm_mday,
-                 local_tm->tm_hour, local_tm->tm_min, local_tm->tm_sec);
-    }
-    
-    // 最终时间验证和显示
+    // 用当前时间加偏差验证合理性，确认后才修改系统时间
+    time_t now = (GetTimeUs() + sample.offset_us) / 1000000;
     struct tm timeinfo;
     localtime_r(&now, &timeinfo);
-    
     char time_str[64];
     strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &timeinfo);
-    
-    // 最后一次验证时间合理性
-    if (timeinfo.tm_year + 1900 < 2025 || timeinfo.tm_year + 1900 > 2026) {
-        ESP_LOGE(TAG, "Final synced time year (%d) is unreasonable - possible timezone issue", timeinfo.tm_year + 1900);
+    if (timeinfo.tm_year + 1900 < 2025) {
+        ESP_LOGE(TAG, "NTP time %s is unreasonable", time_str);
         if (callback) {
             callback(false, "NTP同步失败：获取到的时间不合理");
         }
         return false;
     }
     
-    if (timeinfo.tm_mon < 0 || timeinfo.tm_mon > 11) {
-        ESP_LOGE(TAG, "Final synced time month (%d) is invalid", timeinfo.tm_mon + 1);
+    if (!ApplyOffset(sample.offset_us)) {
         if (callback) {
-            callback(false, "NTP同步失败：获取到的月份无效");
+            callback(false, "NTP同步失败：无法设置系统时间");
         }
         return false;
     }
+    last_offset_us_ = sample.offset_us;
+    last_delay_us_ = sample.delay_us;
     
-    ESP_LOGI(TAG, "NTP time synced (with timezone CST-8): %s", time_str);
+    ESP_LOGI(TAG, "NTP time synced (with timezone CST-8): %s, offset %lld ms, delay %lld ms",
+             time_str, sample.offset_us / 1000, sample.delay_us / 1000);
     
-    // 同步到RTC
+    // 同步到RTC：先用准确的系统时间测量RTC漂移，再重新对齐
     if (rtc_) {
+        rtc_->UpdateDrift();
         if (rtc_->SyncSystemTimeToRtc()) {
             ESP_LOGI(TAG, "System time synced to RTC successfully");
         } else {
@@ -207,6 +289,10 @@ bool NtpSync::SyncTime(NtpSyncCallback callback) {
         }
     }
     
+    // 之后由SNTP每小时平滑校准一次
+    ConfigureSntp();
+    esp_sntp_init();
+    
     // 更新状态
     is_synced_ = true;
     last_sync_time_ = now;
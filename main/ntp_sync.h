@@ -35,14 +35,33 @@ public:
     // 获取当前时区偏移（秒）
     int GetTimezoneOffset() const;
 
+    // 上次同步测得的本地时钟偏差和往返延迟（微秒）
+    int64_t GetLastOffsetUs() const { return last_offset_us_; }
+    int64_t GetLastDelayUs() const { return last_delay_us_; }
+
 private:
+    // 一次NTP测量：本地时钟相对服务器的偏差和网络往返延迟（微秒）
+    struct NtpSample {
+        int64_t offset_us;
+        int64_t delay_us;
+    };
+
     Pcf8563Rtc* rtc_;
     bool is_synced_;
     time_t last_sync_time_;
+    int64_t last_offset_us_ = 0;
+    int64_t last_delay_us_ = 0;
     
     // SNTP配置
     void ConfigureSntp();
     
+    // 向一个服务器发送多次请求，取往返延迟最小的一次
+    bool QueryServer(const char* server, NtpSample* sample);
+    // 汇总所有服务器的测量结果，取偏差的中位数
+    bool MeasureOffset(NtpSample* sample);
+    // 偏差较小时平滑调整，较大时直接设置
+    bool ApplyOffset(int64_t offset_us);
+    
     // 同步任务
     static void SyncTask(void* parameters);
     
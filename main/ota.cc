@@ -1,6 +1,7 @@
 #include "ota.h"
 #include "system_info.h"
 #include "settings.h"
+#include "ota_patch.h"
 #include "assets/lang_config.h"
 
 #include <cJSON.h>
@@ -10,6 +11,12 @@
 #include <esp_app_format.h>
 #include <esp_efuse.h>
 #include <esp_efuse_table.h>
+#include <spi_flash_mmap.h>
+#include <esp_heap_caps.h>
+#include <mbedtls/sha256.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
 #ifdef SOC_HMAC_SUPPORTED
 #include <esp_hmac.h>
 #endif
@@ -18,6 +25,8 @@
 #include <vector>
 #include <sstream>
 #include <algorithm>
+#include <atomic>
+#include <memory>
 
 #define TAG "Ota"
 
@@ -208,6 +217,23 @@ bool Ota::CheckVersion() {
         if (cJSON_IsString(url)) {
             firmware_url_ = url->valuestring;
         }
+        // Optional delta patch from the running version, see scripts/gen_ota_patch.py
+        patch_url_.clear();
+        cJSON *patch = cJSON_GetObjectItem(firmware, "patch");
+        if (cJSON_IsObject(patch)) {
+            cJSON *patch_url = cJSON_GetObjectItem(patch, "url");
+            cJSON *patch_from = cJSON_GetObjectItem(patch, "from");
+            if (cJSON_IsString(patch_url) && cJSON_IsString(patch_from) && current_version_ == patch_from->valuestring) {
+                patch_url_ = patch_url->valuestring;
+            }
+        }
+        // Optional hex encoded SHA-256 of the whole image, verified while downloading
+        firmware_sha256_.clear();
+        cJSON *sha256 = cJSON_GetObjectItem(firmware, "sha256");
+        if (cJSON_IsString(sha256)) {
+            firmware_sha256_ = sha256->valuestring;
+            std::transform(firmware_sha256_.begin(), firmware_sha256_.end(), firmware_sha256_.begin(), ::tolower);
+        }
 
         if (cJSON_IsString(version) && cJSON_IsString(url)) {
             // Check if the version is newer, for example, 0.1.0 is newer than 0.0.1
@@ -251,50 +277,272 @@ void Ota::MarkCurrentVersionValid() {
     }
 }
 
-void Ota::Upgrade(const std::string& firmware_url) {
-    ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
-    esp_ota_handle_t update_handle = 0;
-    auto update_partition = esp_ota_get_next_update_partition(NULL);
-    if (update_partition == NULL) {
-        ESP_LOGE(TAG, "Failed to get update partition");
-        return;
+#define OTA_BUFFER_SIZE SPI_FLASH_SEC_SIZE
+#define OTA_BUFFER_COUNT 2
+#define OTA_SAVE_INTERVAL (64 * 1024)
+#define OTA_PATCH_BUFFER_SIZE 1024
+
+struct OtaChunk {
+    int index;
+    size_t size;    // 0 marks the end of the stream
+};
+
+// Shared state between the HTTP reader and the flash writer task
+struct OtaWriter {
+    const esp_partition_t* partition = nullptr;
+    char* buffers[OTA_BUFFER_COUNT] = {};
+    QueueHandle_t free_queue = nullptr;
+    QueueHandle_t full_queue = nullptr;
+    SemaphoreHandle_t done = nullptr;
+    mbedtls_sha256_context sha256;
+    size_t erased_end = 0;
+    std::atomic<size_t> written{0};
+    std::atomic<esp_err_t> error{ESP_OK};
+};
+
+static void OtaWriterTask(void* arg) {
+    auto writer = static_cast<OtaWriter*>(arg);
+    OtaChunk chunk;
+    while (xQueueReceive(writer->full_queue, &chunk, portMAX_DELAY) == pdTRUE) {
+        if (chunk.size == 0) {
+            break;
+        }
+        if (writer->error == ESP_OK) {
+            size_t offset = writer->written;
+            esp_err_t err = ESP_OK;
+            // Erase lazily one sector ahead of the data, like OTA_WITH_SEQUENTIAL_WRITES does
+            while (err == ESP_OK && offset + chunk.size > writer->erased_end) {
+                err = esp_partition_erase_range(writer->partition, writer->erased_end, SPI_FLASH_SEC_SIZE);
+                writer->erased_end += SPI_FLASH_SEC_SIZE;
+            }
+            if (err == ESP_OK) {
+                err = esp_partition_write(writer->partition, offset, writer->buffers[chunk.index], chunk.size);
+            }
+            if (err == ESP_OK) {
+                mbedtls_sha256_update(&writer->sha256, (const unsigned char*)writer->buffers[chunk.index], chunk.size);
+                writer->written = offset + chunk.size;
+            } else {
+                ESP_LOGE(TAG, "Failed to write OTA data at 0x%x: %s", offset, esp_err_to_name(err));
+                writer->error = err;
+            }
+        }
+        xQueueSend(writer->free_queue, &chunk.index, portMAX_DELAY);
     }
+    xSemaphoreGive(writer->done);
+    vTaskDelete(NULL);
+}
 
-    ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
-    bool image_header_checked = false;
-    std::string image_header;
+size_t Ota::LoadUpgradeOffset(const std::string& firmware_url) {
+    Settings settings("ota", false);
+    if (settings.GetString("url") != firmware_url || settings.GetString("sha256") != firmware_sha256_) {
+        return 0;
+    }
+    return settings.GetInt("offset");
+}
+
+void Ota::SaveUpgradeOffset(const std::string& firmware_url, size_t offset) {
+    Settings settings("ota", true);
+    settings.SetString("url", firmware_url);
+    settings.SetString("sha256", firmware_sha256_);
+    settings.SetInt("offset", offset);
+}
+
+void Ota::ClearUpgradeOffset() {
+    Settings settings("ota", true);
+    settings.EraseAll();
+}
+
+bool Ota::DownloadImage(const esp_partition_t* partition, const std::string& url, bool is_patch) {
+    ESP_LOGI(TAG, "Downloading %s from %s", is_patch ? "patch" : "firmware", url.c_str());
+
+    // The patch header names the image it applies to, compared before any output is written
+    uint8_t base_sha256[32];
+    if (is_patch && esp_partition_get_sha256(esp_ota_get_running_partition(), base_sha256) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to get SHA-256 of the running image");
+        return false;
+    }
+
+    OtaWriter writer;
+    writer.partition = partition;
+    mbedtls_sha256_init(&writer.sha256);
+    mbedtls_sha256_starts(&writer.sha256, 0);
+    for (int i = 0; i < OTA_BUFFER_COUNT; i++) {
+        writer.buffers[i] = (char*)heap_caps_malloc(OTA_BUFFER_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    writer.free_queue = xQueueCreate(OTA_BUFFER_COUNT, sizeof(int));
+    writer.full_queue = xQueueCreate(OTA_BUFFER_COUNT + 1, sizeof(OtaChunk));
+    writer.done = xSemaphoreCreateBinary();
+    bool writer_started = false;
+
+    std::unique_ptr<OtaPatcher> patcher;
+    std::unique_ptr<uint8_t[]> patch_buffer;
+    size_t patch_pos = 0, patch_size = 0;
+    if (is_patch) {
+        patcher = std::make_unique<OtaPatcher>(esp_ota_get_running_partition(), base_sha256);
+        patch_buffer = std::make_unique<uint8_t[]>(OTA_PATCH_BUFFER_SIZE);
+    }
+
+    // Releases everything above on any return path, after the writer task has drained
+    auto cleanup = [&writer, &writer_started]() {
+        if (writer_started) {
+            OtaChunk end = { -1, 0 };
+            xQueueSend(writer.full_queue, &end, portMAX_DELAY);
+            xSemaphoreTake(writer.done, portMAX_DELAY);
+        }
+        mbedtls_sha256_free(&writer.sha256);
+        for (int i = 0; i < OTA_BUFFER_COUNT; i++) {
+            heap_caps_free(writer.buffers[i]);
+        }
+        vQueueDelete(writer.free_queue);
+        vQueueDelete(writer.full_queue);
+        vSemaphoreDelete(writer.done);
+    };
+
+    if (writer.buffers[0] == nullptr || writer.buffers[1] == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate OTA buffers");
+        cleanup();
+        return false;
+    }
+
+    // Resume from the last sector aligned offset saved for the same image.
+    // Patches are small and cannot be resumed, and they overwrite any partial full image.
+    size_t offset = 0;
+    if (is_patch) {
+        ClearUpgradeOffset();
+    } else {
+        offset = LoadUpgradeOffset(url) & ~(SPI_FLASH_SEC_SIZE - 1);
+    }
+    if (offset > 0) {
+        ESP_LOGI(TAG, "Resuming download from offset %u", offset);
+        // Hash the bytes that are already in flash so the final digest covers the whole image
+        for (size_t pos = 0; pos < offset; pos += OTA_BUFFER_SIZE) {
+            if (esp_partition_read(partition, pos, writer.buffers[0], OTA_BUFFER_SIZE) != ESP_OK) {
+                ESP_LOGW(TAG, "Failed to read back partition, restarting download");
+                offset = 0;
+                mbedtls_sha256_starts(&writer.sha256, 0);
+                break;
+            }
+            mbedtls_sha256_update(&writer.sha256, (const unsigned char*)writer.buffers[0], OTA_BUFFER_SIZE);
+        }
+    }
 
     auto http = std::unique_ptr<Http>(Board::GetInstance().CreateHttp());
-    if (!http->Open("GET", firmware_url)) {
+    if (offset > 0) {
+        http->SetHeader("Range", "bytes=" + std::to_string(offset) + "-");
+    }
+    if (!http->Open("GET", url)) {
         ESP_LOGE(TAG, "Failed to open HTTP connection");
-        return;
+        cleanup();
+        return false;
     }
 
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", http->GetStatusCode());
-        return;
+    auto status_code = http->GetStatusCode();
+    if (offset > 0 && status_code == 200) {
+        ESP_LOGW(TAG, "Server does not support range requests, restarting download");
+        offset = 0;
+        mbedtls_sha256_starts(&writer.sha256, 0);
+    } else if (status_code != 200 && !(offset > 0 && status_code == 206)) {
+        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", status_code);
+        if (offset > 0) {
+            ClearUpgradeOffset();
+        }
+        cleanup();
+        return false;
     }
 
     size_t content_length = http->GetBodyLength();
     if (content_length == 0) {
         ESP_LOGE(TAG, "Failed to get content length");
-        return;
+        cleanup();
+        return false;
+    }
+    content_length += offset;
+    if (!is_patch && content_length > partition->size) {
+        ESP_LOGE(TAG, "Firmware size %u exceeds partition size %lu", content_length, partition->size);
+        cleanup();
+        return false;
     }
+    if (!is_patch && offset == 0) {
+        SaveUpgradeOffset(url, 0);
+    }
+
+    writer.written = offset;
+    writer.erased_end = offset;
+    for (int i = 0; i < OTA_BUFFER_COUNT; i++) {
+        xQueueSend(writer.free_queue, &i, 0);
+    }
+    xTaskCreate(OtaWriterTask, "ota_writer", 4096, &writer, 5, NULL);
+    writer_started = true;
 
-    char buffer[512];
-    size_t total_read = 0, recent_read = 0;
+    // Fill one buffer from the network while the writer task flashes the other one
+    bool image_header_checked = offset > 0;
+    size_t total_read = offset, recent_read = 0, last_saved = offset;
     auto last_calc_time = esp_timer_get_time();
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            return;
+    bool eof = false;
+    while (!eof) {
+        int index;
+        xQueueReceive(writer.free_queue, &index, portMAX_DELAY);
+        if (writer.error != ESP_OK) {
+            ClearUpgradeOffset();
+            cleanup();
+            return false;
+        }
+
+        char* buffer = writer.buffers[index];
+        size_t filled = 0;
+        while (filled < OTA_BUFFER_SIZE) {
+            if (patcher) {
+                // Expand the patch against the running partition straight into the write buffer
+                size_t consumed = 0;
+                int produced = patcher->Apply(patch_buffer.get() + patch_pos, patch_size - patch_pos, &consumed,
+                    (uint8_t*)buffer + filled, OTA_BUFFER_SIZE - filled);
+                if (produced < 0) {
+                    cleanup();
+                    return false;
+                }
+                patch_pos += consumed;
+                filled += produced;
+                if (produced > 0 || consumed > 0) {
+                    continue;
+                }
+                if (patcher->IsDone()) {
+                    eof = true;
+                    break;
+                }
+                if (patcher->HasHeader() && patcher->GetTargetSize() > partition->size) {
+                    ESP_LOGE(TAG, "Firmware size %u exceeds partition size %lu", patcher->GetTargetSize(), partition->size);
+                    cleanup();
+                    return false;
+                }
+            }
+
+            char* read_buffer = patcher ? (char*)patch_buffer.get() : buffer + filled;
+            size_t read_size = patcher ? OTA_PATCH_BUFFER_SIZE : OTA_BUFFER_SIZE - filled;
+            int ret = http->Read(read_buffer, read_size);
+            if (ret < 0) {
+                ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+                cleanup();
+                if (!is_patch) {
+                    SaveUpgradeOffset(url, writer.written);
+                }
+                return false;
+            }
+            if (ret == 0) {
+                eof = true;
+                break;
+            }
+            if (patcher) {
+                patch_pos = 0;
+                patch_size = ret;
+            } else {
+                filled += ret;
+            }
+            recent_read += ret;
+            total_read += ret;
         }
 
         // Calculate speed and progress every second
-        recent_read += ret;
-        total_read += ret;
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || ret == 0) {
+        if (esp_timer_get_time() - last_calc_time >= 1000000 || eof) {
             size_t progress = total_read * 100 / content_length;
             ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, total_read, content_length, recent_read);
             if (upgrade_callback_) {
@@ -304,55 +552,123 @@ void Ota::Upgrade(const std::string& firmware_url) {
             recent_read = 0;
         }
 
-        if (ret == 0) {
-            break;
-        }
-
-        if (!image_header_checked) {
-            image_header.append(buffer, ret);
-            if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-                esp_app_desc_t new_app_info;
-                memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
-                ESP_LOGI(TAG, "New firmware version: %s", new_app_info.version);
-
-                auto current_version = esp_app_get_description()->version;
-                if (memcmp(new_app_info.version, current_version, sizeof(new_app_info.version)) == 0) {
-                    ESP_LOGE(TAG, "Firmware version is the same, skipping upgrade");
-                    return;
-                }
+        if (!image_header_checked && filled > 0) {
+            if (filled < sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
+                ESP_LOGE(TAG, "Firmware image is too small");
+                cleanup();
+                return false;
+            }
+            auto image_header = reinterpret_cast<const esp_image_header_t*>(buffer);
+            if (image_header->magic != ESP_IMAGE_HEADER_MAGIC) {
+                ESP_LOGE(TAG, "Invalid image magic: 0x%02x", image_header->magic);
+                cleanup();
+                return false;
+            }
 
-                if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
-                    esp_ota_abort(update_handle);
-                    ESP_LOGE(TAG, "Failed to begin OTA");
-                    return;
-                }
+            esp_app_desc_t new_app_info;
+            memcpy(&new_app_info, buffer + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
+            ESP_LOGI(TAG, "New firmware version: %s", new_app_info.version);
 
-                image_header_checked = true;
-                std::string().swap(image_header);
+            auto current_version = esp_app_get_description()->version;
+            if (memcmp(new_app_info.version, current_version, sizeof(new_app_info.version)) == 0) {
+                ESP_LOGE(TAG, "Firmware version is the same, skipping upgrade");
+                ClearUpgradeOffset();
+                cleanup();
+                return false;
             }
+            image_header_checked = true;
+        }
+
+        if (filled > 0) {
+            OtaChunk chunk = { index, filled };
+            xQueueSend(writer.full_queue, &chunk, portMAX_DELAY);
+        } else {
+            xQueueSend(writer.free_queue, &index, 0);
         }
-        auto err = esp_ota_write(update_handle, buffer, ret);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
-            esp_ota_abort(update_handle);
-            return;
+
+        size_t written = writer.written;
+        if (!is_patch && written - last_saved >= OTA_SAVE_INTERVAL) {
+            SaveUpgradeOffset(url, written);
+            last_saved = written;
         }
     }
     http->Close();
 
-    esp_err_t err = esp_ota_end(update_handle);
-    if (err != ESP_OK) {
-        if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
-            ESP_LOGE(TAG, "Image validation failed, image is corrupted");
+    // Wait for the writer task to flush the last buffer
+    OtaChunk end = { -1, 0 };
+    xQueueSend(writer.full_queue, &end, portMAX_DELAY);
+    xSemaphoreTake(writer.done, portMAX_DELAY);
+    writer_started = false;
+
+    size_t image_size = patcher ? patcher->GetTargetSize() : content_length;
+    if (writer.error != ESP_OK || writer.written != image_size || (patcher && !patcher->IsDone())) {
+        ESP_LOGE(TAG, "Firmware download incomplete (%u/%u)", (size_t)writer.written, image_size);
+        if (writer.error == ESP_OK && !is_patch) {
+            SaveUpgradeOffset(url, writer.written);
         } else {
-            ESP_LOGE(TAG, "Failed to end OTA: %s", esp_err_to_name(err));
+            ClearUpgradeOffset();
         }
+        cleanup();
+        return false;
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&writer.sha256, digest);
+    cleanup();
+    ClearUpgradeOffset();
+
+    char digest_hex[65];
+    for (int i = 0; i < 32; i++) {
+        snprintf(digest_hex + i * 2, sizeof(digest_hex) - i * 2, "%02x", digest[i]);
+    }
+    // A patched image is only as good as the base it was applied to, so its digest is always checked
+    if (patcher && memcmp(digest, patcher->GetTargetSha256(), sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Patched image SHA-256 mismatch, got %s", digest_hex);
+        return false;
+    }
+    if (!firmware_sha256_.empty()) {
+        if (firmware_sha256_ != digest_hex) {
+            ESP_LOGE(TAG, "Firmware SHA-256 mismatch, expected %s, got %s", firmware_sha256_.c_str(), digest_hex);
+            return false;
+        }
+        ESP_LOGI(TAG, "Firmware SHA-256 verified");
+    }
+    if (is_patch) {
+        ESP_LOGI(TAG, "Patch of %u bytes produced a %u bytes image", content_length, image_size);
+    }
+    return true;
+}
+
+void Ota::Upgrade(const std::string& firmware_url) {
+    ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
+    auto update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) {
+        ESP_LOGE(TAG, "Failed to get update partition");
         return;
     }
 
-    err = esp_ota_set_boot_partition(update_partition);
+    ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
+
+    // Prefer the delta patch against the running image, fall back to the full image
+    bool downloaded = false;
+    if (!patch_url_.empty()) {
+        downloaded = DownloadImage(update_partition, patch_url_, true);
+        if (!downloaded) {
+            ESP_LOGW(TAG, "Delta upgrade failed, falling back to the full image");
+        }
+    }
+    if (!downloaded && !DownloadImage(update_partition, firmware_url, false)) {
+        return;
+    }
+
+    // esp_ota_set_boot_partition() validates the image before switching to it
+    esp_err_t err = esp_ota_set_boot_partition(update_partition);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set boot partition: %s", esp_err_to_name(err));
+        if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
+            ESP_LOGE(TAG, "Image validation failed, image is corrupted");
+        } else {
+            ESP_LOGE(TAG, "Failed to set boot partition: %s", esp_err_to_name(err));
+        }
         return;
     }
 
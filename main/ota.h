@@ -5,6 +5,7 @@
 #include <string>
 
 #include <esp_err.h>
+#include <esp_partition.h>
 #include "board.h"
 
 class Ota {
@@ -42,11 +43,17 @@ private:
     std::string current_version_;
     std::string firmware_version_;
     std::string firmware_url_;
+    std::string firmware_sha256_;
+    std::string patch_url_;
     std::string activation_challenge_;
     std::string serial_number_;
     int activation_timeout_ms_ = 30000;
 
     void Upgrade(const std::string& firmware_url);
+    bool DownloadImage(const esp_partition_t* partition, const std::string& url, bool is_patch);
+    size_t LoadUpgradeOffset(const std::string& firmware_url);
+    void SaveUpgradeOffset(const std::string& firmware_url, size_t offset);
+    void ClearUpgradeOffset();
     std::function<void(int progress, size_t speed)> upgrade_callback_;
     std::vector<int> ParseVersion(const std::string& version);
     bool IsNewVersionAvailable(const std::string& currentVersion, const std::string& newVersion);
@@ -0,0 +1,215 @@
+#include "ota_patch.h"
+
+#include <esp_log.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "OtaPatcher"
+
+#define PATCH_MAGIC "XZP2"
+
+OtaPatcher::OtaPatcher(const esp_partition_t* base_partition, const uint8_t base_sha256[32])
+    : base_partition_(base_partition) {
+    memcpy(base_sha256_, base_sha256, sizeof(base_sha256_));
+}
+
+bool OtaPatcher::ReadVarint(uint8_t byte) {
+    if (varint_shift_ > 63) {
+        state_ = kStateError;
+        return false;
+    }
+    varint_ |= (uint64_t)(byte & 0x7f) << varint_shift_;
+    varint_shift_ += 7;
+    return (byte & 0x80) == 0;
+}
+
+bool OtaPatcher::ReadBase(uint8_t* value) {
+    if (base_pos_ < 0 || base_pos_ >= (int64_t)base_size_) {
+        ESP_LOGE(TAG, "Base offset %lld out of range", base_pos_);
+        return false;
+    }
+    if (base_pos_ < window_start_ || base_pos_ >= window_start_ + (int64_t)window_size_) {
+        window_start_ = base_pos_;
+        window_size_ = std::min(sizeof(window_), base_size_ - (size_t)base_pos_);
+        if (esp_partition_read(base_partition_, window_start_, window_, window_size_) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to read base partition at 0x%llx", window_start_);
+            window_start_ = -1;
+            return false;
+        }
+    }
+    *value = window_[base_pos_ - window_start_];
+    base_pos_++;
+    return true;
+}
+
+void OtaPatcher::NextRecord() {
+    state_ = produced_ == target_size_ ? kStateDone : kStateAddLength;
+}
+
+int OtaPatcher::Apply(const uint8_t* in, size_t in_size, size_t* consumed, uint8_t* out, size_t out_size) {
+    size_t in_pos = 0, out_pos = 0;
+    int64_t value;
+
+    while (out_pos < out_size && state_ != kStateDone && state_ != kStateError) {
+        switch (state_) {
+        case kStateHeader: {
+            if (in_pos == in_size) {
+                goto need_input;
+            }
+            header_[header_size_++] = in[in_pos++];
+            if (header_size_ == sizeof(header_)) {
+                if (memcmp(header_, PATCH_MAGIC, 4) != 0) {
+                    ESP_LOGE(TAG, "Invalid patch magic");
+                    state_ = kStateError;
+                    break;
+                }
+                uint32_t base_size, target_size;
+                memcpy(&base_size, header_ + 4, 4);
+                memcpy(&target_size, header_ + 8, 4);
+                base_size_ = base_size;
+                target_size_ = target_size;
+                if (base_size_ > base_partition_->size) {
+                    ESP_LOGE(TAG, "Base size %u exceeds partition %s", base_size_, base_partition_->label);
+                    state_ = kStateError;
+                    break;
+                }
+                // A patch made from another build would produce a corrupt image
+                if (memcmp(header_ + 12, base_sha256_, sizeof(base_sha256_)) != 0) {
+                    ESP_LOGE(TAG, "Patch was not made from the running image");
+                    state_ = kStateError;
+                    break;
+                }
+                ESP_LOGI(TAG, "Patch base size: %u, target size: %u", base_size_, target_size_);
+                NextRecord();
+            }
+            break;
+        }
+
+        case kStateAddLength:
+        case kStateExtraLength:
+        case kStateSeek:
+        case kStateZeroRun:
+        case kStateLiteralLength:
+            if (in_pos == in_size) {
+                goto need_input;
+            }
+            if (!ReadVarint(in[in_pos++])) {
+                break;
+            }
+            value = (int64_t)varint_;
+            varint_ = 0;
+            varint_shift_ = 0;
+
+            if (state_ == kStateAddLength) {
+                add_remaining_ = value;
+                state_ = kStateExtraLength;
+            } else if (state_ == kStateExtraLength) {
+                extra_remaining_ = value;
+                state_ = kStateSeek;
+            } else if (state_ == kStateSeek) {
+                seek_ = (int64_t)((uint64_t)value >> 1) ^ -(value & 1);
+                if (produced_ + add_remaining_ + extra_remaining_ > target_size_) {
+                    ESP_LOGE(TAG, "Patch record overflows target image");
+                    state_ = kStateError;
+                } else if (add_remaining_ > 0) {
+                    state_ = kStateZeroRun;
+                } else {
+                    FinishAdd();
+                }
+            } else if (state_ == kStateZeroRun) {
+                zero_run_ = value;
+                state_ = zero_run_ <= add_remaining_ ? kStateCopy : kStateError;
+            } else {
+                literal_remaining_ = value;
+                if (literal_remaining_ > add_remaining_) {
+                    state_ = kStateError;
+                } else if (literal_remaining_ > 0) {
+                    state_ = kStateLiteral;
+                } else if (add_remaining_ > 0) {
+                    state_ = kStateZeroRun;
+                } else {
+                    FinishAdd();
+                }
+            }
+            break;
+
+        case kStateCopy:
+            while (zero_run_ > 0 && out_pos < out_size) {
+                if (!ReadBase(&out[out_pos])) {
+                    state_ = kStateError;
+                    break;
+                }
+                out_pos++;
+                produced_++;
+                zero_run_--;
+                add_remaining_--;
+            }
+            if (state_ == kStateCopy && zero_run_ == 0) {
+                state_ = kStateLiteralLength;
+            }
+            break;
+
+        case kStateLiteral:
+            while (literal_remaining_ > 0 && out_pos < out_size && in_pos < in_size) {
+                uint8_t base;
+                if (!ReadBase(&base)) {
+                    state_ = kStateError;
+                    break;
+                }
+                out[out_pos++] = base + in[in_pos++];
+                produced_++;
+                literal_remaining_--;
+                add_remaining_--;
+            }
+            if (state_ != kStateLiteral) {
+                break;
+            }
+            if (literal_remaining_ == 0) {
+                if (add_remaining_ > 0) {
+                    state_ = kStateZeroRun;
+                } else {
+                    FinishAdd();
+                }
+            } else if (in_pos == in_size) {
+                goto need_input;
+            }
+            break;
+
+        case kStateExtra: {
+            size_t n = std::min({extra_remaining_, out_size - out_pos, in_size - in_pos});
+            memcpy(out + out_pos, in + in_pos, n);
+            out_pos += n;
+            in_pos += n;
+            produced_ += n;
+            extra_remaining_ -= n;
+            if (extra_remaining_ == 0) {
+                base_pos_ += seek_;
+                NextRecord();
+            } else if (in_pos == in_size) {
+                goto need_input;
+            }
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+
+need_input:
+    *consumed = in_pos;
+    if (state_ == kStateError) {
+        ESP_LOGE(TAG, "Malformed patch at output offset %u", produced_);
+        return -1;
+    }
+    return out_pos;
+}
+
+void OtaPatcher::FinishAdd() {
+    if (extra_remaining_ > 0) {
+        state_ = kStateExtra;
+    } else {
+        base_pos_ += seek_;
+        NextRecord();
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef _OTA_PATCH_H
+#define _OTA_PATCH_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include <esp_partition.h>
+
+/*
+ * Streaming applier for the delta patches produced by scripts/gen_ota_patch.py.
+ *
+ * The patch is a bsdiff control/diff/extra stream interleaved per record so it
+ * can be applied front to back while it is downloaded:
+ *
+ *   header:  "XZP2" | u32 base_size | u32 target_size        (little endian)
+ *            | base_sha256[32] | target_sha256[32]
+ *   record:  varint add_len | varint extra_len | zigzag varint seek
+ *            add data, as (varint zero_run, varint literal_len, literal bytes)
+ *            groups until add_len bytes are covered; each output byte is
+ *            base[pos] + diff, zero runs copy the base unchanged
+ *            extra_len raw bytes
+ *
+ * Base bytes are read from the running partition through a small window, so
+ * memory use is fixed regardless of the image size. The patch is rejected at
+ * the header unless base_sha256 matches the running image as reported by
+ * esp_partition_get_sha256(); target_sha256 is the SHA-256 of the whole
+ * target image file, which the caller verifies once the image is written.
+ */
+class OtaPatcher {
+public:
+    // `base_sha256` is the digest of the running image from esp_partition_get_sha256()
+    OtaPatcher(const esp_partition_t* base_partition, const uint8_t base_sha256[32]);
+
+    // Consume patch bytes from `in` and write decoded image bytes into `out`.
+    // Returns the number of bytes written to `out`, or -1 on a malformed patch.
+    // `consumed` is set to the number of input bytes used. Returns 0 with
+    // nothing consumed when more input is needed.
+    int Apply(const uint8_t* in, size_t in_size, size_t* consumed, uint8_t* out, size_t out_size);
+
+    bool IsDone() const { return state_ == kStateDone; }
+    bool HasHeader() const { return state_ > kStateHeader; }
+    size_t GetTargetSize() const { return target_size_; }
+    // Valid once HasHeader() is true
+    const uint8_t* GetTargetSha256() const { return header_ + 12 + 32; }
+
+private:
+    enum State {
+        kStateHeader,
+        kStateAddLength,
+        kStateExtraLength,
+        kStateSeek,
+        kStateZeroRun,
+        kStateCopy,
+        kStateLiteralLength,
+        kStateLiteral,
+        kStateExtra,
+        kStateDone,
+        kStateError,
+    };
+
+    const esp_partition_t* base_partition_;
+    State state_ = kStateHeader;
+    uint8_t base_sha256_[32];
+    uint8_t header_[12 + 32 + 32];
+    size_t header_size_ = 0;
+    size_t base_size_ = 0;
+    size_t target_size_ = 0;
+    size_t produced_ = 0;
+
+    uint64_t varint_ = 0;
+    int varint_shift_ = 0;
+
+    size_t add_remaining_ = 0;
+    size_t extra_remaining_ = 0;
+    size_t zero_run_ = 0;
+    size_t literal_remaining_ = 0;
+    int64_t seek_ = 0;
+    int64_t base_pos_ = 0;
+
+    uint8_t window_[256];
+    int64_t window_start_ = -1;
+    size_t window_size_ = 0;
+
+    bool ReadVarint(uint8_t byte);
+    bool ReadBase(uint8_t* value);
+    void FinishAdd();
+    void NextRecord();
+};
+
+#endif // _OTA_PATCH_H
@@ -1,11 +1,36 @@
 #include "pcf8563_rtc.h"
+#include "settings.h"
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_rom_sys.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <string.h>
+#include <stdlib.h>
 #include <sstream>
 #include <iomanip>
 
 #define TAG "PCF8563_RTC"
 
+// 释放STOP位后第一次秒进位发生在 0.507813~0.507935 秒之后（数据手册）
+#define PCF8563_STOP_RELEASE_US 507874
+// 两次同步间隔太短时测得的漂移率不可靠
+#define DRIFT_MIN_INTERVAL_S (6 * 3600)
+// 误差超过该值说明RTC被其他方式改过，不用于学习
+#define DRIFT_MAX_ERROR_US (120LL * 1000000)
+
+// 参考时间：系统时间加上adjtime尚未完成的调整量
+static int64_t GetReferenceTimeUs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    int64_t now = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    struct timeval pending;
+    if (adjtime(nullptr, &pending) == 0) {
+        now += (int64_t)pending.tv_sec * 1000000 + pending.tv_usec;
+    }
+    return now;
+}
+
 Pcf8563Rtc::Pcf8563Rtc(i2c_master_bus_handle_t i2c_bus) 
     : i2c_bus_(i2c_bus), i2c_dev_(nullptr) {
 }
@@ -48,6 +73,13 @@ bool Pcf8563Rtc::Initialize() {
     // 清除控制寄存器中的中断标志
     WriteRegister(PCF8563_REG_CONTROL2, 0x00);
     
+    // 加载漂移校准数据
+    Settings settings("rtc", false);
+    calibration_base_ = settings.GetInt("base", 0);
+    drift_ppb_ = settings.GetInt("drift_ppb", 0);
+    drift_samples_ = settings.GetInt("drift_n", 0);
+    ESP_LOGI(TAG, "RTC drift %ld ppb from %ld samples", (long)drift_ppb_, (long)drift_samples_);
+    
     ESP_LOGI(TAG, "PCF8563 RTC initialized successfully");
     return true;
 }
@@ -81,6 +113,13 @@ bool Pcf8563Rtc::SetTime(const struct tm* time_tm) {
              time_tm->tm_year + 1900, time_tm->tm_mon + 1, time_tm->tm_mday,
              time_tm->tm_hour, time_tm->tm_min, time_tm->tm_sec);
     
+    // 未对齐的写入无法作为漂移测量的起点
+    if (calibration_base_ != 0) {
+        calibration_base_ = 0;
+        Settings settings("rtc", true);
+        settings.SetInt("base", 0);
+    }
+    
     return true;
 }
 
@@ -210,27 +249,134 @@ bool Pcf8563Rtc::StopClock() {
 }
 
 bool Pcf8563Rtc::SyncSystemTimeToRtc() {
-    time_t now;
-    time(&now);
-    return SetTime(now);
+    // 停止分频链后写入时间，在合适的时刻释放STOP位，使RTC的秒进位与系统时间的整秒对齐
+    if (!StopClock()) {
+        return false;
+    }
+    time_t rtc_second = GetReferenceTimeUs() / 1000000 + 1;
+    if (!SetTime(rtc_second)) {
+        StartClock();
+        return false;
+    }
+
+    int64_t release_us = ((int64_t)rtc_second + 1) * 1000000 - PCF8563_STOP_RELEASE_US;
+    int64_t wait_ms = (release_us - GetReferenceTimeUs()) / 1000 - 2 * portTICK_PERIOD_MS;
+    if (wait_ms > 0) {
+        vTaskDelay(pdMS_TO_TICKS(wait_ms));
+    }
+    while (GetReferenceTimeUs() < release_us) {
+        esp_rom_delay_us(50);
+    }
+    if (!StartClock()) {
+        return false;
+    }
+
+    calibration_base_ = rtc_second;
+    Settings settings("rtc", true);
+    settings.SetInt("base", calibration_base_);
+    ESP_LOGI(TAG, "RTC aligned to system time at %lld", (long long)rtc_second);
+    return true;
 }
 
 bool Pcf8563Rtc::SyncRtcToSystemTime() {
+    // 启动时只做粗略的跳变检测（一个tick的精度），最多等待一秒
     time_t rtc_time;
-    if (!GetTime(&rtc_time)) {
+    int64_t reference_us;
+    if (!WaitForSecondEdge(&rtc_time, &reference_us, false)) {
         return false;
     }
-    
-    struct timeval tv = { .tv_sec = rtc_time, .tv_usec = 0 };
+
+    int64_t now_us = (int64_t)rtc_time * 1000000 - GetDriftUs(rtc_time);
+    struct timeval tv = { .tv_sec = (time_t)(now_us / 1000000), .tv_usec = (suseconds_t)(now_us % 1000000) };
     if (settimeofday(&tv, nullptr) != 0) {
         ESP_LOGE(TAG, "Failed to set system time");
         return false;
     }
     
-    ESP_LOGI(TAG, "System time synced from RTC: %s", GetTimeString().c_str());
+    ESP_LOGI(TAG, "System time synced from RTC: %s, drift correction %lld ms", GetTimeString().c_str(),
+             GetDriftUs(rtc_time) / 1000);
+    return true;
+}
+
+bool Pcf8563Rtc::UpdateDrift() {
+    if (calibration_base_ == 0) {
+        ESP_LOGI(TAG, "No aligned RTC write to measure drift from");
+        return false;
+    }
+
+    time_t rtc_time;
+    int64_t reference_us;
+    if (!WaitForSecondEdge(&rtc_time, &reference_us, true)) {
+        return false;
+    }
+    int64_t elapsed_us = reference_us - (int64_t)calibration_base_ * 1000000;
+    int64_t error_us = (int64_t)rtc_time * 1000000 - reference_us;
+    if (elapsed_us < (int64_t)DRIFT_MIN_INTERVAL_S * 1000000 || llabs(error_us) > DRIFT_MAX_ERROR_US) {
+        ESP_LOGI(TAG, "RTC error %lld ms after %lld s, not used for drift", error_us / 1000, elapsed_us / 1000000);
+        return false;
+    }
+
+    int32_t measured_ppb = error_us * 1000000000 / elapsed_us;
+    int64_t residual_us = error_us - GetDriftUs(rtc_time);
+    // 新测量与历史结果平均，减小单次测量的抖动
+    drift_ppb_ = drift_samples_ == 0 ? measured_ppb : (drift_ppb_ + measured_ppb) / 2;
+    drift_samples_++;
+    Settings settings("rtc", true);
+    settings.SetInt("drift_ppb", drift_ppb_);
+    settings.SetInt("drift_n", drift_samples_);
+    ESP_LOGI(TAG, "RTC error %lld ms after %lld h, measured %ld ppb, drift %ld ppb (residual with old estimate %lld ms)",
+             error_us / 1000, elapsed_us / 3600000000LL, (long)measured_ppb, (long)drift_ppb_,
+             residual_us / 1000);
     return true;
 }
 
+bool Pcf8563Rtc::WaitForSecondEdge(time_t* rtc_time, int64_t* reference_us, bool precise) {
+    uint8_t first, current;
+    if (!ReadRegister(PCF8563_REG_SECONDS, &first)) {
+        return false;
+    }
+
+    // 每个tick读一次秒寄存器，找到跳变
+    int64_t deadline = esp_timer_get_time() + 1100000;
+    do {
+        vTaskDelay(1);
+        if (!ReadRegister(PCF8563_REG_SECONDS, &current)) {
+            return false;
+        }
+        if (esp_timer_get_time() > deadline) {
+            ESP_LOGE(TAG, "RTC seconds not advancing");
+            return false;
+        }
+    } while ((current & 0x7F) == (first & 0x7F));
+
+    if (precise) {
+        // 已知跳变相位，睡到下一次跳变前再忙等，精度约为一次I2C读取的时间
+        int64_t edge_us = esp_timer_get_time();
+        vTaskDelay(pdMS_TO_TICKS(1000) - 3);
+        first = current;
+        deadline = edge_us + 1100000;
+        do {
+            if (!ReadRegister(PCF8563_REG_SECONDS, &current)) {
+                return false;
+            }
+            if (esp_timer_get_time() > deadline) {
+                ESP_LOGE(TAG, "RTC seconds not advancing");
+                return false;
+            }
+        } while ((current & 0x7F) == (first & 0x7F));
+    }
+
+    *reference_us = GetReferenceTimeUs();
+    return GetTime(rtc_time);
+}
+
+int64_t Pcf8563Rtc::GetDriftUs(time_t rtc_time) const {
+    if (calibration_base_ == 0) {
+        return 0;
+    }
+    return ((int64_t)rtc_time - calibration_base_) * drift_ppb_ / 1000;
+}
+
 bool Pcf8563Rtc::WriteRegister(uint8_t reg, uint8_t data) {
     uint8_t write_buf[2] = {reg, data};
     esp_err_t ret = i2c_master_transmit(i2c_dev_, write_buf, 2, 1000);
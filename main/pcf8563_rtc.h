@@ -56,15 +56,29 @@ public:
     bool StartClock();
     bool StopClock();
     
-    // 同步系统时间到RTC
+    // 同步系统时间到RTC（对齐到秒边界），并作为漂移测量的起点
     bool SyncSystemTimeToRtc();
     
-    // 从RTC同步到系统时间
+    // 从RTC同步到系统时间，按学习到的漂移率修正
     bool SyncRtcToSystemTime();
+    
+    // 用已校准的系统时间测量RTC自上次同步以来的误差，更新漂移率
+    bool UpdateDrift();
+    
+    // 学习到的漂移率（十亿分之一），正值表示RTC走快
+    int32_t GetDriftPpb() const { return drift_ppb_; }
 
 private:
     i2c_master_bus_handle_t i2c_bus_;
     i2c_master_dev_handle_t i2c_dev_;
+    int32_t calibration_base_ = 0;  // RTC最后一次对齐写入的时间戳，0表示未知
+    int32_t drift_ppb_ = 0;
+    int32_t drift_samples_ = 0;
+    
+    // 等待秒寄存器跳变，返回跳变后的RTC时间和同一时刻的参考时间（微秒）
+    bool WaitForSecondEdge(time_t* rtc_time, int64_t* reference_us, bool precise);
+    // 相对校准起点累计的漂移量（微秒）
+    int64_t GetDriftUs(time_t rtc_time) const;
     
     // I2C读写函数
     bool WriteRegister(uint8_t reg, uint8_t data);
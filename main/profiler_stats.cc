@@ -0,0 +1,72 @@
+#include "profiler_stats.h"
+
+#include <cstring>
+
+ProfilerStats::ProfilerStats(int num_cores) : num_cores_(num_cores) {
+    tasks_.reserve(kMaxTasks);
+}
+
+int ProfilerStats::Fragmentation(uint32_t free, uint32_t largest) {
+    return free > 0 ? 100 - (int)((uint64_t)largest * 100 / free) : 0;
+}
+
+bool ProfilerStats::AddSample(const TaskSnapshot* snapshots, int task_count, uint32_t total_run_time, const HeapSample& heap) {
+    bool has_baseline = has_baseline_;
+    uint64_t elapsed = (uint64_t)(uint32_t)(total_run_time - last_total_run_time_) * num_cores_;
+    last_total_run_time_ = total_run_time;
+    has_baseline_ = true;
+
+    for (auto& task : tasks_) {
+        task.seen = false;
+    }
+
+    int idle_percent = 0;
+    for (int i = 0; i < task_count; i++) {
+        const auto& status = snapshots[i];
+        auto it = std::find_if(tasks_.begin(), tasks_.end(), [&status](const TaskRecord& task) {
+            return task.handle == status.handle;
+        });
+        if (it == tasks_.end()) {
+            if (tasks_.size() >= kMaxTasks) {
+                continue;
+            }
+            TaskRecord task = {};
+            task.handle = status.handle;
+            strncpy(task.name, status.name, sizeof(task.name) - 1);
+            task.last_run_time = status.run_time;
+            task.min_stack_free = status.stack_free;
+            tasks_.push_back(task);
+            it = tasks_.end() - 1;
+        }
+
+        auto& task = *it;
+        task.seen = true;
+        task.priority = status.priority;
+        task.min_stack_free = std::min(task.min_stack_free, status.stack_free);
+        int percent = 0;
+        if (has_baseline && elapsed > 0) {
+            percent = (uint64_t)(uint32_t)(status.run_time - task.last_run_time) * 100 / elapsed;
+        }
+        task.last_run_time = status.run_time;
+        task.cpu_percent[head_] = std::min(percent, 100);
+        if (strncmp(task.name, "IDLE", 4) == 0) {
+            idle_percent += percent;
+        }
+    }
+
+    // Forget deleted tasks
+    tasks_.erase(std::remove_if(tasks_.begin(), tasks_.end(), [](const TaskRecord& task) {
+        return !task.seen;
+    }), tasks_.end());
+
+    if (!has_baseline) {
+        return false;
+    }
+
+    heap_[head_] = heap;
+    cpu_load_[head_] = 100 - std::min(idle_percent, 100);
+
+    head_ = (head_ + 1) % kHistorySize;
+    count_ = std::min(count_ + 1, kHistorySize);
+    return true;
+}
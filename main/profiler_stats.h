@@ -0,0 +1,104 @@
+#ifndef _PROFILER_STATS_H_
+#define _PROFILER_STATS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Platform-free aggregation behind SystemProfiler: turns task run-time counters
+// and heap readings into per-sample CPU shares and fixed-size history rings.
+// Run-time counters are taken modulo 2^32, so deltas stay correct across a
+// counter wrap and with 64-bit FreeRTOS counters alike.
+class ProfilerStats {
+public:
+    static constexpr int kMaxTasks = 32;
+    static constexpr int kHistorySize = 60;
+    static constexpr int kNameLength = 16;
+
+    struct TaskSnapshot {
+        const void* handle;
+        const char* name;
+        uint32_t priority;
+        uint32_t run_time;
+        uint32_t stack_free;
+    };
+
+    struct HeapSample {
+        uint32_t internal_free;
+        uint32_t internal_largest;
+        uint32_t psram_free;
+        uint32_t psram_largest;
+    };
+
+    struct TaskRecord {
+        const void* handle;
+        char name[kNameLength];
+        uint32_t priority;
+        uint32_t last_run_time;
+        uint32_t min_stack_free;           // Lowest stack high-water mark seen, bytes
+        uint8_t cpu_percent[kHistorySize];
+        bool seen;
+    };
+
+    struct SeriesStats {
+        int64_t min;
+        int64_t avg;
+        int64_t max;
+    };
+
+    explicit ProfilerStats(int num_cores = 1);
+
+    // Records one snapshot. The first call only sets the run time baselines and
+    // returns false; later calls append to the rings and return true.
+    bool AddSample(const TaskSnapshot* tasks, int task_count, uint32_t total_run_time, const HeapSample& heap);
+
+    int count() const { return count_; }
+    const std::vector<TaskRecord>& tasks() const { return tasks_; }
+    // Newest entries, only valid when count() > 0
+    int cpu_load() const { return cpu_load_[Latest()]; }
+    const HeapSample& heap() const { return heap_[Latest()]; }
+    int cpu_percent(const TaskRecord& task) const { return task.cpu_percent[Latest()]; }
+
+    const uint8_t* cpu_load_ring() const { return cpu_load_; }
+    const HeapSample* heap_ring() const { return heap_; }
+
+    // min/avg/max over the kept history of `ring`
+    template <typename T, typename F>
+    SeriesStats Stats(const T* ring, F value) const {
+        int64_t sum = 0, min = INT64_MAX, max = 0;
+        for (int i = 0; i < count_; i++) {
+            int64_t v = value(ring[(head_ - 1 - i + kHistorySize) % kHistorySize]);
+            sum += v;
+            min = std::min(min, v);
+            max = std::max(max, v);
+        }
+        if (count_ == 0) {
+            return { 0, 0, 0 };
+        }
+        return { min, sum / count_, max };
+    }
+
+    // Calls fn for the kept history of `ring`, oldest to newest
+    template <typename T, typename F>
+    void ForEach(const T* ring, F fn) const {
+        for (int i = count_; i > 0; i--) {
+            fn(ring[(head_ - i + kHistorySize) % kHistorySize]);
+        }
+    }
+
+    static int Fragmentation(uint32_t free, uint32_t largest);
+
+private:
+    int num_cores_;
+    bool has_baseline_ = false;
+    uint32_t last_total_run_time_ = 0;
+    std::vector<TaskRecord> tasks_;
+    HeapSample heap_[kHistorySize] = {};
+    uint8_t cpu_load_[kHistorySize] = {};
+    int head_ = 0;      // Next slot to write
+    int count_ = 0;     // Valid samples in the rings
+
+    int Latest() const { return (head_ - 1 + kHistorySize) % kHistorySize; }
+};
+
+#endif // _PROFILER_STATS_H_
@@ -1,10 +1,17 @@
 #include "protocol.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
 #include <mbedtls/base64.h>
+#include <memory>
+#include <algorithm>
 
 #define TAG "Protocol"
 
+// 每个分片编码的原始字节数，必须是3的倍数
+#define PHOTO_FRAGMENT_RAW_SIZE (3 * 1024)
+
 void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
     on_incoming_json_ = callback;
 }
@@ -117,39 +124,66 @@ void Protocol::SendIotCameraPhoto(const std::vector<uint8_t>& photo_data, int wi
         return;
     }
 
-    // 计算Base64编码后的大小
-    size_t base64_len;
-    mbedtls_base64_encode(nullptr, 0, &base64_len, photo_data.data(), photo_data.size());
-    
-    // 分配内存
-    unsigned char* base64_buf = new unsigned char[base64_len];
-    if (base64_buf == nullptr) {
-        ESP_LOGE(TAG, "无法分配内存进行Base64编码");
-        return;
-    }
-    
-    // 执行Base64编码
-    int ret = mbedtls_base64_encode(base64_buf, base64_len, &base64_len, photo_data.data(), photo_data.size());
-    if (ret != 0) {
-        ESP_LOGE(TAG, "Base64编码失败: %d", ret);
-        delete[] base64_buf;
-        return;
+    auto start_time = esp_timer_get_time();
+    size_t free_heap_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+
+    // 构建JSON消息的头尾，Base64数据夹在中间
+    std::string prefix = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"iot\",\"update\":true,\"camera_photo\":{";
+    prefix += "\"width\":" + std::to_string(width) + ",";
+    prefix += "\"height\":" + std::to_string(height) + ",";
+    prefix += "\"format\":\"" + format + "\",";
+    prefix += "\"data\":\"";
+    const std::string suffix = "\"}}";
+
+    size_t base64_len = (photo_data.size() + 2) / 3 * 4;
+    size_t working_size = 0;
+    bool success;
+    if (SupportsTextFragments()) {
+        // 分片发送同一条文本消息，只需一个固定大小的编码缓冲区
+        working_size = PHOTO_FRAGMENT_RAW_SIZE / 3 * 4 + 1;
+        auto encoded = std::make_unique<unsigned char[]>(working_size);
+        std::lock_guard<std::recursive_mutex> lock(send_mutex_);
+        success = SendTextFragment(prefix.data(), prefix.size(), false);
+        for (size_t offset = 0; success && offset < photo_data.size(); offset += PHOTO_FRAGMENT_RAW_SIZE) {
+            size_t chunk_size = std::min<size_t>(PHOTO_FRAGMENT_RAW_SIZE, photo_data.size() - offset);
+            size_t encoded_len = 0;
+            int ret = mbedtls_base64_encode(encoded.get(), working_size, &encoded_len, photo_data.data() + offset, chunk_size);
+            if (ret != 0) {
+                ESP_LOGE(TAG, "Base64编码失败: %d", ret);
+                success = false;
+                break;
+            }
+            success = SendTextFragment(reinterpret_cast<const char*>(encoded.get()), encoded_len, false);
+        }
+        // 出错时也要结束当前消息，避免连接停留在分片状态
+        success = SendTextFragment(suffix.data(), suffix.size(), true) && success;
+    } else {
+        // 直接编码进最终消息，避免额外的Base64缓冲区和拷贝
+        working_size = prefix.size() + base64_len + suffix.size() + 1;
+        std::string message;
+        message.reserve(working_size);
+        message = prefix;
+        size_t offset = message.size();
+        message.resize(offset + base64_len + 1);
+        size_t encoded_len = 0;
+        int ret = mbedtls_base64_encode(reinterpret_cast<unsigned char*>(&message[offset]), base64_len + 1, &encoded_len,
+            photo_data.data(), photo_data.size());
+        if (ret != 0) {
+            ESP_LOGE(TAG, "Base64编码失败: %d", ret);
+            return;
+        }
+        message.resize(offset + encoded_len);
+        message += suffix;
+        success = SendText(message);
     }
-    
-    // 构建JSON消息
-    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"iot\",\"update\":true,\"camera_photo\":{";
-    message += "\"width\":" + std::to_string(width) + ",";
-    message += "\"height\":" + std::to_string(height) + ",";
-    message += "\"format\":\"" + format + "\",";
-    message += "\"data\":\"" + std::string(reinterpret_cast<char*>(base64_buf), base64_len) + "\"";
-    message += "}}";
-    
-    // 释放内存
-    delete[] base64_buf;
-    
-    // 发送消息
-    ESP_LOGI(TAG, "正在发送照片数据到服务器，大小: %zu 字节", photo_data.size());
-    SendText(message);
+
+    auto elapsed_ms = (esp_timer_get_time() - start_time) / 1000;
+    ESP_LOGI(TAG, "照片发送%s: %zu 字节, 编码后 %zu 字节, 工作缓冲区 %zu 字节, 发送前空闲堆 %zu 字节, 耗时 %lld ms",
+        success ? "完成" : "失败", photo_data.size(), base64_len, working_size, free_heap_before, elapsed_ms);
+}
+
+bool Protocol::SendTextFragment(const char* data, size_t size, bool fin) {
+    return false;
 }
 
 void Protocol::SendIotStates(const std::string& states) {
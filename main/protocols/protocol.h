@@ -6,6 +6,7 @@
 #include <functional>
 #include <chrono>
 #include <vector>
+#include <mutex>
 
 struct AudioStreamPacket {
     int sample_rate = 0;
@@ -87,8 +88,14 @@ protected:
     bool error_occurred_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
+    // Held by senders for a whole message, so audio and other text cannot be
+    // interleaved with the fragments of a streamed text message
+    std::recursive_mutex send_mutex_;
 
     virtual bool SendText(const std::string& text) = 0;
+    // Streams one text message in fragments; only valid when SupportsTextFragments() is true
+    virtual bool SupportsTextFragments() const { return false; }
+    virtual bool SendTextFragment(const char* data, size_t size, bool fin);
     virtual void SetError(const std::string& message);
     virtual bool IsTimeout() const;
 };
@@ -29,6 +29,7 @@ bool WebsocketProtocol::Start() {
 }
 
 bool WebsocketProtocol::SendAudio(const AudioStreamPacket& packet) {
+    std::lock_guard<std::recursive_mutex> lock(send_mutex_);
     if (websocket_ == nullptr) {
         return false;
     }
@@ -61,6 +62,7 @@ bool WebsocketProtocol::SendAudio(const AudioStreamPacket& packet) {
 }
 
 bool WebsocketProtocol::SendText(const std::string& text) {
+    std::lock_guard<std::recursive_mutex> lock(send_mutex_);
     if (websocket_ == nullptr) {
         return false;
     }
@@ -74,6 +76,21 @@ bool WebsocketProtocol::SendText(const std::string& text) {
     return true;
 }
 
+bool WebsocketProtocol::SendTextFragment(const char* data, size_t size, bool fin) {
+    std::lock_guard<std::recursive_mutex> lock(send_mutex_);
+    if (websocket_ == nullptr) {
+        return false;
+    }
+
+    if (!websocket_->Send(data, size, false, fin)) {
+        ESP_LOGE(TAG, "Failed to send text fragment of %u bytes", size);
+        SetError(Lang::Strings::SERVER_ERROR);
+        return false;
+    }
+
+    return true;
+}
+
 bool WebsocketProtocol::IsAudioChannelOpened() const {
     return websocket_ != nullptr && websocket_->IsConnected() && !error_occurred_ && !IsTimeout();
 }
@@ -28,6 +28,8 @@ private:
 
     void ParseServerHello(const cJSON* root);
     bool SendText(const std::string& text) override;
+    bool SupportsTextFragments() const override { return true; }
+    bool SendTextFragment(const char* data, size_t size, bool fin) override;
     std::string GetHelloMessage();
 };
 
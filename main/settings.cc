@@ -1,67 +1,266 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_system.h>
 #include <nvs_flash.h>
+#include <vector>
 
 #define TAG "Settings"
 
-Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
-    nvs_open(ns.c_str(), read_write_ ? NVS_READWRITE : NVS_READONLY, &nvs_handle_);
+#define SETTINGS_COMMIT_DELAY_MS 1000
+
+SettingsStore::SettingsStore() {
+    esp_timer_create_args_t commit_timer_args = {
+        .callback = [](void* arg) {
+            SettingsStore* store = (SettingsStore*)arg;
+            store->Flush();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "settings_commit",
+        .skip_unhandled_events = true
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&commit_timer_args, &commit_timer_));
+
+    // Pending values must reach flash before esp_restart()
+    esp_register_shutdown_handler([]() {
+        SettingsStore::GetInstance().Flush();
+    });
 }
 
-Settings::~Settings() {
-    if (nvs_handle_ != 0) {
-        if (read_write_ && dirty_) {
-            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
+SettingsStore::~SettingsStore() {
+    Flush();
+    if (commit_timer_ != nullptr) {
+        esp_timer_stop(commit_timer_);
+        esp_timer_delete(commit_timer_);
+    }
+}
+
+SettingsStore::Entry* SettingsStore::Load(const std::string& ns, const std::string& key, EntryType type) {
+    auto& entry = cache_[ns][key];
+    if (entry.type != kEntryMissing || (entry.probed & (1 << type))) {
+        stats_.cache_hits++;
+        return entry.type == type ? &entry : nullptr;
+    }
+
+    nvs_handle_t nvs_handle;
+    entry.probed |= 1 << type;
+    if (nvs_open(ns.c_str(), NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return nullptr;
+    }
+
+    stats_.nvs_reads++;
+    if (type == kEntryString) {
+        size_t length = 0;
+        if (nvs_get_str(nvs_handle, key.c_str(), nullptr, &length) == ESP_OK) {
+            std::string value;
+            value.resize(length);
+            ESP_ERROR_CHECK(nvs_get_str(nvs_handle, key.c_str(), value.data(), &length));
+            while (!value.empty() && value.back() == '\0') {
+                value.pop_back();
+            }
+            entry.type = kEntryString;
+            entry.string_value = std::move(value);
+        }
+    } else if (type == kEntryInt) {
+        int32_t value;
+        if (nvs_get_i32(nvs_handle, key.c_str(), &value) == ESP_OK) {
+            entry.type = kEntryInt;
+            entry.int_value = value;
         }
-        nvs_close(nvs_handle_);
     }
+    nvs_close(nvs_handle);
+    return entry.type == type ? &entry : nullptr;
 }
 
-std::string Settings::GetString(const std::string& key, const std::string& default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
+void SettingsStore::Store(const std::string& ns, const std::string& key, Entry entry) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto cached = Load(ns, key, entry.type);
+        if (cached != nullptr && cached->string_value == entry.string_value && cached->int_value == entry.int_value) {
+            return;
+        }
+        entry.dirty = true;
+        cache_[ns][key] = std::move(entry);
+        if (!esp_timer_is_active(commit_timer_)) {
+            esp_timer_start_once(commit_timer_, SETTINGS_COMMIT_DELAY_MS * 1000);
+        }
+    }
+    Notify(ns, key);
+}
+
+std::string SettingsStore::GetString(const std::string& ns, const std::string& key, const std::string& default_value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto entry = Load(ns, key, kEntryString);
+    return entry != nullptr ? entry->string_value : default_value;
+}
+
+void SettingsStore::SetString(const std::string& ns, const std::string& key, const std::string& value) {
+    Entry entry;
+    entry.type = kEntryString;
+    entry.string_value = value;
+    Store(ns, key, std::move(entry));
+}
+
+int32_t SettingsStore::GetInt(const std::string& ns, const std::string& key, int32_t default_value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto entry = Load(ns, key, kEntryInt);
+    return entry != nullptr ? entry->int_value : default_value;
+}
+
+void SettingsStore::SetInt(const std::string& ns, const std::string& key, int32_t value) {
+    Entry entry;
+    entry.type = kEntryInt;
+    entry.int_value = value;
+    Store(ns, key, std::move(entry));
+}
+
+void SettingsStore::EraseKey(const std::string& ns, const std::string& key) {
+    {
+        std::lock_guard<std::mutex> nvs_lock(nvs_mutex_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        nvs_handle_t nvs_handle;
+        ESP_ERROR_CHECK(nvs_open(ns.c_str(), NVS_READWRITE, &nvs_handle));
+        auto ret = nvs_erase_key(nvs_handle, key.c_str());
+        if (ret != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_ERROR_CHECK(ret);
+            ESP_ERROR_CHECK(nvs_commit(nvs_handle));
+            stats_.nvs_writes++;
+            stats_.nvs_commits++;
+        }
+        nvs_close(nvs_handle);
+        // Drops any pending write of the key as well
+        cache_[ns][key] = Entry{};
+        cache_[ns][key].probed = (1 << kEntryString) | (1 << kEntryInt);
+    }
+    Notify(ns, key);
+}
+
+void SettingsStore::EraseAll(const std::string& ns) {
+    {
+        std::lock_guard<std::mutex> nvs_lock(nvs_mutex_);
+        std::lock_guard<std::mutex> lock(mutex_);
+        nvs_handle_t nvs_handle;
+        ESP_ERROR_CHECK(nvs_open(ns.c_str(), NVS_READWRITE, &nvs_handle));
+        ESP_ERROR_CHECK(nvs_erase_all(nvs_handle));
+        ESP_ERROR_CHECK(nvs_commit(nvs_handle));
+        nvs_close(nvs_handle);
+        stats_.nvs_writes++;
+        stats_.nvs_commits++;
+        cache_.erase(ns);
+    }
+    Notify(ns, "");
+}
+
+void SettingsStore::Flush() {
+    struct PendingValue {
+        std::string key;
+        Entry entry;
+    };
+
+    // Copy the pending values under the lock and write them without it, so
+    // readers are not blocked behind the flash writes
+    std::lock_guard<std::mutex> nvs_lock(nvs_mutex_);
+    std::map<std::string, std::vector<PendingValue>> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& [ns, entries] : cache_) {
+            for (auto& [key, entry] : entries) {
+                if (entry.dirty) {
+                    pending[ns].push_back({key, entry});
+                    entry.dirty = false;
+                }
+            }
+        }
+    }
+    if (pending.empty()) {
+        return;
     }
 
-    size_t length = 0;
-    if (nvs_get_str(nvs_handle_, key.c_str(), nullptr, &length) != ESP_OK) {
-        return default_value;
+    uint32_t writes = 0;
+    uint32_t commits = 0;
+    for (auto& [ns, values] : pending) {
+        nvs_handle_t nvs_handle;
+        ESP_ERROR_CHECK(nvs_open(ns.c_str(), NVS_READWRITE, &nvs_handle));
+        for (auto& value : values) {
+            if (value.entry.type == kEntryString) {
+                ESP_ERROR_CHECK(nvs_set_str(nvs_handle, value.key.c_str(), value.entry.string_value.c_str()));
+            } else if (value.entry.type == kEntryInt) {
+                ESP_ERROR_CHECK(nvs_set_i32(nvs_handle, value.key.c_str(), value.entry.int_value));
+            }
+            writes++;
+        }
+        // One commit per namespace for the whole batch
+        ESP_ERROR_CHECK(nvs_commit(nvs_handle));
+        nvs_close(nvs_handle);
+        commits++;
     }
 
-    std::string value;
-    value.resize(length);
-    ESP_ERROR_CHECK(nvs_get_str(nvs_handle_, key.c_str(), value.data(), &length));
-    while (!value.empty() && value.back() == '\0') {
-        value.pop_back();
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.nvs_writes += writes;
+    stats_.nvs_commits += commits;
+    ESP_LOGD(TAG, "NVS reads: %lu, writes: %lu, commits: %lu, cache hits: %lu",
+        stats_.nvs_reads, stats_.nvs_writes, stats_.nvs_commits, stats_.cache_hits);
+}
+
+int SettingsStore::Subscribe(const std::string& ns, std::function<void(const std::string&, const std::string&)> callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int id = next_subscription_id_++;
+    subscriptions_[id] = Subscription{ns, std::move(callback)};
+    return id;
+}
+
+void SettingsStore::Unsubscribe(int subscription_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscriptions_.erase(subscription_id);
+}
+
+void SettingsStore::Notify(const std::string& ns, const std::string& key) {
+    std::vector<std::function<void(const std::string&, const std::string&)>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& [id, subscription] : subscriptions_) {
+            if (subscription.ns == ns) {
+                callbacks.push_back(subscription.callback);
+            }
+        }
     }
-    return value;
+    // Called without the lock so subscribers may read settings
+    for (auto& callback : callbacks) {
+        callback(ns, key);
+    }
+}
+
+SettingsStore::Stats SettingsStore::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
+}
+
+Settings::~Settings() {
+}
+
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
+    return SettingsStore::GetInstance().GetString(ns_, key, default_value);
 }
 
 void Settings::SetString(const std::string& key, const std::string& value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_str(nvs_handle_, key.c_str(), value.c_str()));
-        dirty_ = true;
+        SettingsStore::GetInstance().SetString(ns_, key, value);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
-    int32_t value;
-    if (nvs_get_i32(nvs_handle_, key.c_str(), &value) != ESP_OK) {
-        return default_value;
-    }
-    return value;
+    return SettingsStore::GetInstance().GetInt(ns_, key, default_value);
 }
 
 void Settings::SetInt(const std::string& key, int32_t value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_i32(nvs_handle_, key.c_str(), value));
-        dirty_ = true;
+        SettingsStore::GetInstance().SetInt(ns_, key, value);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -69,10 +268,7 @@ void Settings::SetInt(const std::string& key, int32_t value) {
 
 void Settings::EraseKey(const std::string& key) {
     if (read_write_) {
-        auto ret = nvs_erase_key(nvs_handle_, key.c_str());
-        if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_ERROR_CHECK(ret);
-        }
+        SettingsStore::GetInstance().EraseKey(ns_, key);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -80,7 +276,7 @@ void Settings::EraseKey(const std::string& key) {
 
 void Settings::EraseAll() {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_erase_all(nvs_handle_));
+        SettingsStore::GetInstance().EraseAll(ns_);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
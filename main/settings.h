@@ -2,7 +2,86 @@
 #define SETTINGS_H
 
 #include <string>
+#include <map>
+#include <mutex>
+#include <functional>
 #include <nvs_flash.h>
+#include <esp_timer.h>
+
+// Process-wide write-back cache in front of NVS. Reads are served from memory
+// after the first access, writes are batched and committed by a timer or on
+// shutdown. Values written to NVS behind its back are not seen until reboot.
+class SettingsStore {
+public:
+    struct Stats {
+        uint32_t nvs_reads;
+        uint32_t nvs_writes;
+        uint32_t nvs_commits;
+        uint32_t cache_hits;
+    };
+
+    static SettingsStore& GetInstance() {
+        static SettingsStore instance;
+        return instance;
+    }
+
+    SettingsStore(const SettingsStore&) = delete;
+    SettingsStore& operator=(const SettingsStore&) = delete;
+
+    std::string GetString(const std::string& ns, const std::string& key, const std::string& default_value = "");
+    void SetString(const std::string& ns, const std::string& key, const std::string& value);
+    int32_t GetInt(const std::string& ns, const std::string& key, int32_t default_value = 0);
+    void SetInt(const std::string& ns, const std::string& key, int32_t value);
+    void EraseKey(const std::string& ns, const std::string& key);
+    void EraseAll(const std::string& ns);
+
+    // Write all pending values to NVS and commit them. Shutdown handlers do
+    // not run before deep sleep or a PMIC power off, so call it explicitly there.
+    void Flush();
+
+    // Called with (namespace, key) after a value in the namespace changes
+    int Subscribe(const std::string& ns, std::function<void(const std::string&, const std::string&)> callback);
+    void Unsubscribe(int subscription_id);
+
+    Stats GetStats();
+
+private:
+    SettingsStore();
+    ~SettingsStore();
+
+    enum EntryType {
+        kEntryMissing,
+        kEntryString,
+        kEntryInt,
+    };
+
+    struct Entry {
+        EntryType type = kEntryMissing;
+        std::string string_value;
+        int32_t int_value = 0;
+        uint8_t probed = 0;     // Types already looked up in NVS while missing
+        bool dirty = false;
+    };
+
+    struct Subscription {
+        std::string ns;
+        std::function<void(const std::string&, const std::string&)> callback;
+    };
+
+    std::mutex mutex_;
+    // Serializes the NVS writes of Flush and the erases, taken before mutex_
+    std::mutex nvs_mutex_;
+    std::map<std::string, std::map<std::string, Entry>> cache_;
+    std::map<int, Subscription> subscriptions_;
+    int next_subscription_id_ = 1;
+    esp_timer_handle_t commit_timer_ = nullptr;
+    Stats stats_ = {};
+
+    // Returns the cached entry of the key, or nullptr when it has no value of the given type
+    Entry* Load(const std::string& ns, const std::string& key, EntryType type);
+    void Store(const std::string& ns, const std::string& key, Entry entry);
+    void Notify(const std::string& ns, const std::string& key);
+};
 
 class Settings {
 public:
@@ -18,9 +97,7 @@ public:
 
 private:
     std::string ns_;
-    nvs_handle_t nvs_handle_ = 0;
     bool read_write_ = false;
-    bool dirty_ = false;
 };
 
 #endif
@@ -0,0 +1,191 @@
+#include "system_profiler.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+
+#define TAG "SystemProfiler"
+
+#define TASK_SLACK 5
+
+void SystemProfiler::Start(int interval_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (timer_ != nullptr) {
+        return;
+    }
+
+    status_buffer_.resize(ProfilerStats::kMaxTasks + TASK_SLACK);
+    snapshots_.reserve(status_buffer_.size());
+    interval_ms_ = interval_ms;
+
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            static_cast<SystemProfiler*>(arg)->Sample();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "system_profiler",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer_));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(timer_, interval_ms * 1000));
+}
+
+void SystemProfiler::Stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (timer_ != nullptr) {
+        esp_timer_stop(timer_);
+        esp_timer_delete(timer_);
+        timer_ = nullptr;
+    }
+}
+
+void SystemProfiler::Sample() {
+    auto start_time = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // uxTaskGetSystemState() returns nothing when the buffer is too small, so
+    // grow it to the current task count, and once more if tasks were created meanwhile
+    configRUN_TIME_COUNTER_TYPE total_run_time;
+    UBaseType_t task_count = 0;
+    for (int attempt = 0; attempt < 2 && task_count == 0; attempt++) {
+        size_t needed = uxTaskGetNumberOfTasks() + TASK_SLACK;
+        if (status_buffer_.size() < needed) {
+            status_buffer_.resize(needed);
+        }
+        task_count = uxTaskGetSystemState(status_buffer_.data(), status_buffer_.size(), &total_run_time);
+    }
+    if (task_count == 0) {
+        ESP_LOGW(TAG, "More than %u tasks, skip sample", (unsigned)status_buffer_.size());
+        return;
+    }
+
+    snapshots_.clear();
+    for (UBaseType_t i = 0; i < task_count; i++) {
+        const auto& status = status_buffer_[i];
+        snapshots_.push_back({
+            .handle = status.xHandle,
+            .name = status.pcTaskName,
+            .priority = (uint32_t)status.uxCurrentPriority,
+            .run_time = (uint32_t)status.ulRunTimeCounter,
+            .stack_free = (uint32_t)status.usStackHighWaterMark,
+        });
+    }
+
+    ProfilerStats::HeapSample heap = {
+        .internal_free = (uint32_t)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+        .internal_largest = (uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL),
+        .psram_free = (uint32_t)heap_caps_get_free_size(MALLOC_CAP_SPIRAM),
+        .psram_largest = (uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM),
+    };
+    // The first sample only sets the run time baselines
+    if (!stats_.AddSample(snapshots_.data(), snapshots_.size(), (uint32_t)total_run_time, heap)) {
+        return;
+    }
+    internal_min_free_ = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+
+    sample_time_us_ = esp_timer_get_time() - start_time;
+    max_sample_time_us_ = std::max(max_sample_time_us_, sample_time_us_);
+}
+
+static void AddSeriesStats(cJSON* object, const ProfilerStats::SeriesStats& stats) {
+    cJSON_AddNumberToObject(object, "min", stats.min);
+    cJSON_AddNumberToObject(object, "avg", stats.avg);
+    cJSON_AddNumberToObject(object, "max", stats.max);
+}
+
+// Oldest to newest
+template <typename T, typename F>
+static cJSON* CreateSeries(const ProfilerStats& stats, const T* ring, F value) {
+    auto array = cJSON_CreateArray();
+    stats.ForEach(ring, [&](const T& item) {
+        cJSON_AddItemToArray(array, cJSON_CreateNumber(value(item)));
+    });
+    return array;
+}
+
+std::string SystemProfiler::GetStatsJson(bool with_history) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    using HeapSample = ProfilerStats::HeapSample;
+    int count = stats_.count();
+    auto root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "interval_ms", interval_ms_);
+    cJSON_AddNumberToObject(root, "samples", count);
+
+    auto cost = cJSON_CreateObject();
+    cJSON_AddNumberToObject(cost, "last_us", sample_time_us_);
+    cJSON_AddNumberToObject(cost, "max_us", max_sample_time_us_);
+    cJSON_AddItemToObject(root, "sample_cost", cost);
+
+    auto identity = [](auto v) { return (int64_t)v; };
+
+    auto cpu = cJSON_CreateObject();
+    cJSON_AddNumberToObject(cpu, "load", count > 0 ? stats_.cpu_load() : 0);
+    AddSeriesStats(cpu, stats_.Stats(stats_.cpu_load_ring(), identity));
+    if (with_history) {
+        cJSON_AddItemToObject(cpu, "history", CreateSeries(stats_, stats_.cpu_load_ring(), identity));
+    }
+    cJSON_AddItemToObject(root, "cpu", cpu);
+
+    auto add_heap = [&](uint32_t HeapSample::*free_field, uint32_t HeapSample::*largest_field) {
+        auto free_value = [free_field](const HeapSample& s) { return (int64_t)(s.*free_field); };
+        auto largest_value = [largest_field](const HeapSample& s) { return (int64_t)(s.*largest_field); };
+        auto object = cJSON_CreateObject();
+        if (count > 0) {
+            const auto& heap = stats_.heap();
+            cJSON_AddNumberToObject(object, "free", heap.*free_field);
+            cJSON_AddNumberToObject(object, "largest_free_block", heap.*largest_field);
+            cJSON_AddNumberToObject(object, "fragmentation", ProfilerStats::Fragmentation(heap.*free_field, heap.*largest_field));
+        }
+        auto free_stats = cJSON_CreateObject();
+        AddSeriesStats(free_stats, stats_.Stats(stats_.heap_ring(), free_value));
+        cJSON_AddItemToObject(object, "free_window", free_stats);
+        if (with_history) {
+            cJSON_AddItemToObject(object, "free_history", CreateSeries(stats_, stats_.heap_ring(), free_value));
+            cJSON_AddItemToObject(object, "largest_free_block_history", CreateSeries(stats_, stats_.heap_ring(), largest_value));
+        }
+        return object;
+    };
+    auto internal = add_heap(&HeapSample::internal_free, &HeapSample::internal_largest);
+    cJSON_AddNumberToObject(internal, "min_free_ever", internal_min_free_ == UINT32_MAX ? 0 : internal_min_free_);
+    cJSON_AddItemToObject(root, "internal_heap", internal);
+    cJSON_AddItemToObject(root, "psram_heap", add_heap(&HeapSample::psram_free, &HeapSample::psram_largest));
+
+    auto tasks = cJSON_CreateArray();
+    for (const auto& task : stats_.tasks()) {
+        auto item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", task.name);
+        cJSON_AddNumberToObject(item, "priority", task.priority);
+        cJSON_AddNumberToObject(item, "stack_free_min", task.min_stack_free);
+        auto task_cpu = cJSON_CreateObject();
+        cJSON_AddNumberToObject(task_cpu, "last", count > 0 ? stats_.cpu_percent(task) : 0);
+        AddSeriesStats(task_cpu, stats_.Stats(task.cpu_percent, identity));
+        if (with_history) {
+            cJSON_AddItemToObject(task_cpu, "history", CreateSeries(stats_, task.cpu_percent, identity));
+        }
+        cJSON_AddItemToObject(item, "cpu", task_cpu);
+        cJSON_AddItemToArray(tasks, item);
+    }
+    cJSON_AddItemToObject(root, "tasks", tasks);
+
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
+
+cJSON* SystemProfiler::GetStatusJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto system = cJSON_CreateObject();
+    if (stats_.count() == 0) {
+        return system;
+    }
+    const auto& heap = stats_.heap();
+    cJSON_AddNumberToObject(system, "cpu_load", stats_.cpu_load());
+    cJSON_AddNumberToObject(system, "free_internal_heap", heap.internal_free);
+    cJSON_AddNumberToObject(system, "largest_internal_block", heap.internal_largest);
+    cJSON_AddNumberToObject(system, "free_psram", heap.psram_free);
+    return system;
+}
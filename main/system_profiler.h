@@ -0,0 +1,51 @@
+#ifndef _SYSTEM_PROFILER_H_
+#define _SYSTEM_PROFILER_H_
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <cJSON.h>
+
+#include "profiler_stats.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Periodically samples per-task CPU share, stack high-water marks and heap
+// usage into fixed-size rings. All buffers are allocated on Start(), so a
+// sample costs one uxTaskGetSystemState() call plus a pass over the tasks.
+// The aggregation itself lives in ProfilerStats, which also builds on the host.
+class SystemProfiler {
+public:
+    static SystemProfiler& GetInstance() {
+        static SystemProfiler instance;
+        return instance;
+    }
+    SystemProfiler(const SystemProfiler&) = delete;
+    SystemProfiler& operator=(const SystemProfiler&) = delete;
+
+    void Start(int interval_ms = 5000);
+    void Stop();
+
+    // Latest values with min/avg/max over the kept history, optionally with the raw series
+    std::string GetStatsJson(bool with_history);
+    // Compact snapshot for the device status JSON
+    cJSON* GetStatusJson();
+
+private:
+    std::mutex mutex_;
+    esp_timer_handle_t timer_ = nullptr;
+    int interval_ms_ = 0;
+    std::vector<TaskStatus_t> status_buffer_;
+    std::vector<ProfilerStats::TaskSnapshot> snapshots_;
+    ProfilerStats stats_{CONFIG_FREERTOS_NUMBER_OF_CORES};
+    uint32_t internal_min_free_ = UINT32_MAX;
+    int64_t sample_time_us_ = 0;
+    int64_t max_sample_time_us_ = 0;
+
+    SystemProfiler() = default;
+    void Sample();
+};
+
+#endif // _SYSTEM_PROFILER_H_
@@ -130,6 +130,7 @@ void TimeSyncManager::SyncTimeOnBoot() {
                     // 使用RTC时间更新系统时间
                     if (rtc_->SyncRtcToSystemTime()) {
                         ESP_LOGI(TAG, "System time synced from RTC successfully");
+                        AlarmManager::GetInstance().OnTimeChanged();
                     } else {
                         ESP_LOGW(TAG, "Failed to sync system time from RTC");
                     }
@@ -284,8 +285,8 @@ void TimeSyncManager::SmartNtpSync() {
         
         retry_count++;
         if (retry_count < max_retries) {
-            // 使用递增的重试间隔：10s, 15s, 20s, 25s
-            int retry_interval = base_interval_ms + (retry_count * 5000);
+            // 指数退避：10s, 20s, 40s, 80s，网络故障时避免频繁请求服务器
+            int retry_interval = base_interval_ms << (retry_count - 1);
             ESP_LOGI(TAG, "Waiting %d seconds before next sync attempt", retry_interval / 1000);
             vTaskDelay(pdMS_TO_TICKS(retry_interval));
         }
@@ -377,6 +378,9 @@ void TimeSyncManager::OnNtpSyncComplete(bool success, const std::string& message
                 ESP_LOGW(TAG, "Failed to read RTC time for comparison");
             }
         }
+        
+        // 时间已校准，重新计算闹钟触发时间
+        AlarmManager::GetInstance().OnTimeChanged();
     } else {
         ESP_LOGW(TAG, "NTP sync failed: %s", message.c_str());
     }
@@ -1,54 +1,143 @@
 import socket
+import struct
 import wave
 import argparse
+import os
+from array import array
 
 
 '''
-  Create a UDP socket and bind it to the server's IP:8000.
-  Listen for incoming messages and print them to the console.
-  Save the audio to a WAV file.
+  Receive framed audio debug packets (see main/audio_processing/audio_debugger.h)
+  on UDP 0.0.0.0:PORT and save every channel of every stream to its own WAV file.
+
+  All files share one time base: each track starts at the earliest timestamp seen
+  on any stream, and lost packets (gaps in the sequence numbers) are replaced by
+  silence, so the files stay in sync when opened side by side. Timestamps only
+  place the first packet of a stream; after that packets are written back to
+  back, so timestamp jitter never inserts silence. A loss report is printed when
+  recording stops.
 '''
-def main(samplerate, channels):
-    # Create a UDP socket
-    server_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-    server_socket.bind(('0.0.0.0', 8000))
 
-    # Create WAV file with parameters
-    filename = f"{samplerate}_{channels}.wav"
-    wav_file = wave.open(filename, "wb")
-    wav_file.setnchannels(channels)     # channels parameter
-    wav_file.setsampwidth(2)            # 2 bytes per sample (16-bit)
-    wav_file.setframerate(samplerate)   # samplerate parameter
+HEADER = struct.Struct('<IBBBBIIq')
+MAGIC = 0x47424441
+STREAM_NAMES = {0: 'input', 1: 'processed', 2: 'output'}
+
+
+class Track:
+    def __init__(self, path, sample_rate):
+        self.wav = wave.open(path, 'wb')
+        self.wav.setnchannels(1)
+        self.wav.setsampwidth(2)
+        self.wav.setframerate(sample_rate)
+        self.frames = 0
+
+    def write(self, data, frames):
+        self.wav.writeframes(data)
+        self.frames += frames
+
+    def pad(self, frames):
+        if frames > 0:
+            self.write(b'\x00\x00' * frames, frames)
+
+    def close(self):
+        self.wav.close()
+
+
+class Stream:
+    def __init__(self, name, channels, sample_rate):
+        self.name = name
+        self.channels = channels
+        self.sample_rate = sample_rate
+        self.tracks = []
+        self.next_sequence = None
+        self.packets = 0
+        self.lost = 0
+        self.reordered = 0
+
 
-    print(f"Start saving audio from 0.0.0.0:8000 to {filename}...")
+def channel_name(stream, index, input_format):
+    if stream.name == 'input' and len(input_format) == stream.channels:
+        role = input_format[index]
+        return f"{'mic' if role == 'M' else 'ref' if role == 'R' else 'unused'}{input_format[:index].count(role)}"
+    return f"ch{index}"
+
+
+def main(port, output_dir, input_format):
+    os.makedirs(output_dir, exist_ok=True)
+    server_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    server_socket.bind(('0.0.0.0', port))
+
+    streams = {}
+    base_time = None
+    print(f"Start saving audio from 0.0.0.0:{port} to {output_dir}/ ...")
 
     try:
         while True:
-            # Receive a message from the client
-            message, address = server_socket.recvfrom(8000)
-            
-            # Write PCM data to WAV file
-            wav_file.writeframes(message)
-
-            # Print length of the message
-            print(f"Received {len(message)} bytes from {address}")
-    
+            message, address = server_socket.recvfrom(2048)
+            if len(message) < HEADER.size:
+                continue
+            magic, version, stream_id, channels, _, sequence, sample_rate, timestamp_us = HEADER.unpack_from(message)
+            if magic != MAGIC or version != 1 or channels == 0:
+                print(f"Ignored unknown packet from {address}")
+                continue
+            payload = array('h', message[HEADER.size:HEADER.size + (len(message) - HEADER.size) // 2 * 2])
+            frames = len(payload) // channels
+
+            stream = streams.get(stream_id)
+            if stream is None:
+                name = STREAM_NAMES.get(stream_id, f"stream{stream_id}")
+                stream = Stream(name, channels, sample_rate)
+                for i in range(channels):
+                    path = os.path.join(output_dir, f"{name}_{channel_name(stream, i, input_format)}.wav")
+                    stream.tracks.append(Track(path, sample_rate))
+                streams[stream_id] = stream
+                print(f"New stream {name}: {channels} channels, {sample_rate} Hz")
+            if base_time is None:
+                base_time = timestamp_us
+
+            stream.packets += 1
+            if stream.next_sequence is None:
+                # Align the first packet of the stream with the others by its timestamp
+                silence = max(0, (timestamp_us - base_time) * stream.sample_rate // 1000000)
+            else:
+                gap = (sequence - stream.next_sequence) & 0xFFFFFFFF
+                if gap >= 0x80000000:
+                    # Late packet, its slot was already filled with silence
+                    stream.reordered += 1
+                    continue
+                stream.lost += gap
+                # Packets of a stream have a fixed size, so the lost ones were as long as this one
+                silence = gap * frames
+            stream.next_sequence = (sequence + 1) & 0xFFFFFFFF
+
+            for i, track in enumerate(stream.tracks):
+                track.pad(silence)
+                track.write(payload[i::channels].tobytes(), frames)
+
     except KeyboardInterrupt:
         print("\nStopping recording...")
-    
+
     finally:
-        # Close files and socket
-        wav_file.close()
         server_socket.close()
-        print(f"WAV file '{filename}' saved successfully")
+        print("Loss report:")
+        for stream in streams.values():
+            total = stream.packets + stream.lost
+            percent = stream.lost * 100.0 / total if total else 0
+            print(f"  {stream.name}: {stream.packets} packets received, {stream.lost} lost ({percent:.2f}%), "
+                  f"{stream.reordered} late, {stream.tracks[0].frames / stream.sample_rate:.1f}s")
+            for track in stream.tracks:
+                track.close()
+        print(f"WAV files saved to '{output_dir}'")
 
 
 if __name__ == "__main__":
-    parser = argparse.ArgumentParser(description='UDP音频数据接收器，保存为WAV文件')
-    parser.add_argument('--samplerate', '-s', type=int, default=16000, 
-                        help='采样率 (默认: 16000)')
-    parser.add_argument('--channels', '-c', type=int, default=2, 
-                        help='声道数 (默认: 2)')
-    
+    parser = argparse.ArgumentParser(description='UDP音频调试数据接收器，按数据流和声道保存为同步的WAV文件')
+    parser.add_argument('--port', '-p', type=int, default=8000,
+                        help='UDP端口 (默认: 8000)')
+    parser.add_argument('--output', '-o', default='audio_debug',
+                        help='输出目录 (默认: audio_debug)')
+    parser.add_argument('--input-format', '-f', default='MR',
+                        help='输入声道布局，M为麦克风，R为参考信号 (默认: MR)')
+
     args = parser.parse_args()
-    main(args.samplerate, args.channels)
+    main(args.port, args.output, args.input_format)
@@ -0,0 +1,207 @@
+// Checks AlarmSchedule without the timer and NVS: firing on time, lazy heap
+// invalidation, forward and backward wall clock jumps, the grace window and
+// duplicate suppression after the clock is set back.
+
+#include "alarm_schedule.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        printf("%s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
+
+// Monday 2026-03-02 in UTC, plus whole days
+static time_t At(int hour, int minute, int second = 0, int day = 0) {
+    struct tm tm = {};
+    tm.tm_year = 2026 - 1900;
+    tm.tm_mon = 2;
+    tm.tm_mday = 2 + day;
+    tm.tm_hour = hour;
+    tm.tm_min = minute;
+    tm.tm_sec = second;
+    return mktime(&tm);
+}
+
+static AlarmInfo Alarm(int id, int hour, int minute, std::vector<int> weekdays = {}) {
+    AlarmInfo alarm(hour, minute, weekdays);
+    alarm.id = id;
+    return alarm;
+}
+
+// Wall clock and monotonic clock advanced together unless a jump is simulated
+struct Clock {
+    time_t wall;
+    int64_t mono_us = 1000000;
+
+    void Advance(int seconds) {
+        wall += seconds;
+        mono_us += (int64_t)seconds * 1000000;
+    }
+};
+
+static bool Fired(const AlarmSchedule::CheckResult& result, int id) {
+    for (const auto& alarm : result.triggered) {
+        if (alarm.id == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void TestOnTime() {
+    std::vector<AlarmInfo> alarms = { Alarm(1, 7, 30), Alarm(2, 7, 30, {1, 2, 3, 4, 5}) };
+    AlarmSchedule schedule;
+    Clock clock{At(7, 0)};
+    schedule.Check(alarms, clock.wall, clock.mono_us, true);
+
+    time_t fire_time;
+    int alarm_id;
+    CHECK(schedule.PeekNext(&fire_time, &alarm_id) && fire_time == At(7, 30), "next fire %lld", (long long)fire_time);
+
+    clock.Advance(1799);
+    auto result = schedule.Check(alarms, clock.wall, clock.mono_us, false);
+    CHECK(result.triggered.empty(), "fired one second early");
+
+    clock.Advance(1);
+    result = schedule.Check(alarms, clock.wall, clock.mono_us, false);
+    CHECK(Fired(result, 1) && Fired(result, 2), "%zu alarms fired at 07:30", result.triggered.size());
+    CHECK(result.time_jump_s == 0, "jump %lld without a jump", (long long)result.time_jump_s);
+    // The one-time alarm is done, the weekday alarm moves to Tuesday
+    CHECK(result.finished_ids == std::vector<int>{1} && !alarms[0].enabled, "one-time alarm not finished");
+    CHECK(schedule.PeekNext(&fire_time, &alarm_id) && alarm_id == 2 && fire_time == At(7, 30, 0, 1),
+        "recurring alarm next at %lld", (long long)fire_time);
+
+    // Friday's alarm is followed by Monday's, skipping the weekend
+    schedule.Schedule(alarms[1], At(7, 30, 0, 4));
+    CHECK(schedule.PeekNext(&fire_time, &alarm_id) && fire_time == At(7, 30, 0, 7), "weekday alarm after Friday");
+}
+
+static void TestLazyInvalidation() {
+    AlarmSchedule schedule;
+    auto a = Alarm(1, 8, 0);
+    auto b = Alarm(2, 9, 0);
+    schedule.Schedule(a, At(7, 0));
+    schedule.Schedule(b, At(7, 0));
+
+    // Rescheduling leaves a stale 08:00 entry in the heap; it must be skipped
+    a.hour = 10;
+    schedule.Schedule(a, At(7, 0));
+    time_t fire_time;
+    int alarm_id;
+    CHECK(schedule.PeekNext(&fire_time, &alarm_id) && alarm_id == 2 && fire_time == At(9, 0), "stale entry returned: %d", alarm_id);
+
+    schedule.Unschedule(2);
+    CHECK(schedule.PeekNext(&fire_time, &alarm_id) && alarm_id == 1 && fire_time == At(10, 0), "cancelled entry returned: %d", alarm_id);
+
+    // Disabling unschedules too
+    a.enabled = false;
+    schedule.Schedule(a, At(7, 0));
+    CHECK(!schedule.PeekNext(&fire_time, &alarm_id), "disabled alarm still scheduled");
+}
+
+static void TestForwardJump() {
+    // Within the grace window the skipped alarm still fires
+    {
+        std::vector<AlarmInfo> alarms = { Alarm(1, 7, 30, {1}) };
+        AlarmSchedule schedule;
+        Clock clock{At(7, 0)};
+        schedule.Check(alarms, clock.wall, clock.mono_us, true);
+        clock.Advance(10);
+        clock.wall = At(7, 32);     // NTP moves the clock forward by half an hour
+        auto result = schedule.Check(alarms, clock.wall, clock.mono_us, false);
+        CHECK(result.time_jump_s > 0, "forward jump not detected");
+        CHECK(Fired(result, 1), "alarm skipped by a small forward jump did not fire");
+    }
+    // Further back than the grace window it is dropped, and not fired again later
+    {
+        std::vector<AlarmInfo> alarms = { Alarm(1, 7, 30, {1}) };
+        AlarmSchedule schedule;
+        Clock clock{At(7, 0)};
+        schedule.Check(alarms, clock.wall, clock.mono_us, true);
+        clock.Advance(10);
+        clock.wall = At(8, 0);
+        auto result = schedule.Check(alarms, clock.wall, clock.mono_us, false);
+        CHECK(result.time_jump_s > 0 && result.triggered.empty(), "alarm 30 minutes old fired after a jump");
+        time_t fire_time;
+        int alarm_id;
+        CHECK(schedule.PeekNext(&fire_time, &alarm_id) && fire_time == At(7, 30, 0, 7), "not moved to next Monday");
+    }
+    // A first sync from an unset clock never fires the alarms it passes
+    {
+        std::vector<AlarmInfo> alarms = { Alarm(1, 7, 30) };
+        AlarmSchedule schedule;
+        Clock clock{100};
+        schedule.Check(alarms, clock.wall, clock.mono_us, true);
+        clock.Advance(10);
+        clock.wall = At(7, 31);
+        auto result = schedule.Check(alarms, clock.wall, clock.mono_us, false);
+        CHECK(result.triggered.empty(), "fired on the first time sync");
+        CHECK(alarms[0].enabled, "one-time alarm consumed by the first time sync");
+    }
+}
+
+static void TestBackwardJump() {
+    std::vector<AlarmInfo> alarms = { Alarm(1, 7, 30, {1, 2}) };
+    AlarmSchedule schedule;
+    Clock clock{At(7, 29)};
+    schedule.Check(alarms, clock.wall, clock.mono_us, true);
+    clock.Advance(60);
+    auto result = schedule.Check(alarms, clock.wall, clock.mono_us, false);
+    CHECK(Fired(result, 1), "did not fire at 07:30");
+
+    // The clock is set back 20 s right after firing: 07:30 comes round again
+    clock.Advance(10);
+    clock.wall = At(7, 29, 50);
+    result = schedule.Check(alarms, clock.wall, clock.mono_us, false);
+    CHECK(result.time_jump_s < 0, "backward jump not detected");
+    clock.Advance(10);
+    result = schedule.Check(alarms, clock.wall, clock.mono_us, false);
+    CHECK(result.triggered.empty() && result.duplicates == std::vector<int>{1}, "fired twice for the same 07:30");
+
+    // Tuesday still fires
+    clock.Advance(24 * 3600);
+    result = schedule.Check(alarms, clock.wall, clock.mono_us, false);
+    CHECK(Fired(result, 1), "next day's alarm suppressed");
+}
+
+static void TestLateCheck() {
+    // The timer ran late without a clock jump, e.g. the device was busy
+    std::vector<AlarmInfo> alarms = { Alarm(1, 7, 30), Alarm(2, 7, 30, {1, 2}), Alarm(3, 7, 38) };
+    AlarmSchedule schedule;
+    Clock clock{At(7, 0)};
+    schedule.Check(alarms, clock.wall, clock.mono_us, true);
+    clock.Advance(40 * 60);
+    auto result = schedule.Check(alarms, clock.wall, clock.mono_us, false);
+    CHECK(result.time_jump_s == 0, "late check taken for a jump");
+    CHECK(result.missed.size() == 2, "%zu alarms missed", result.missed.size());
+    CHECK(result.missed.size() > 0 && result.missed[0].second == 600, "missed by %lld s", (long long)result.missed[0].second);
+    CHECK(Fired(result, 3) && result.triggered.size() == 1, "alarm within the grace window did not fire");
+    // Missed one-time alarms are finished too, recurring ones move on
+    CHECK(!alarms[0].enabled && alarms[1].enabled, "missed alarms not cleaned up");
+    time_t fire_time;
+    int alarm_id;
+    CHECK(schedule.PeekNext(&fire_time, &alarm_id) && alarm_id == 2 && fire_time == At(7, 30, 0, 1), "recurring alarm not rescheduled");
+}
+
+int main() {
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    TestOnTime();
+    TestLazyInvalidation();
+    TestForwardJump();
+    TestBackwardJump();
+    TestLateCheck();
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+// Checks the interleave helpers and the slot-string tables that BoxAudioCodec
+// and AudioCodec build the AFE input_format and ES7210 channel masks from.
+
+#include "audio_channels.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void TestRoundTrip() {
+    for (int channels = 1; channels <= 6; channels++) {
+        // Odd frame counts and a single frame exercise the loop bounds
+        for (size_t frames : { 1, 7, 160, 512 }) {
+            std::vector<int16_t> interleaved(frames * channels);
+            for (size_t i = 0; i < interleaved.size(); i++) {
+                interleaved[i] = (int16_t)(i * 7919 - 30000);
+            }
+
+            // Split every channel out, then write them back into a fresh buffer
+            std::vector<int16_t> rebuilt(interleaved.size(), INT16_MIN);
+            std::vector<int16_t> channel(frames);
+            for (int c = 0; c < channels; c++) {
+                DeinterleaveChannel(interleaved.data(), channels, c, channel.data(), frames);
+                for (size_t i = 0; i < frames; i++) {
+                    if (channel[i] != interleaved[i * channels + c]) {
+                        printf("DeinterleaveChannel: %d channels, channel %d, frame %zu of %zu\n", channels, c, i, frames);
+                        failures++;
+                        break;
+                    }
+                }
+                InterleaveChannel(channel.data(), channels, c, rebuilt.data(), frames);
+            }
+            if (rebuilt != interleaved) {
+                printf("Round trip: %d channels, %zu frames\n", channels, frames);
+                failures++;
+            }
+
+            // Writing one channel leaves the others alone
+            std::vector<int16_t> zeros(frames, 0);
+            int target = channels - 1;
+            InterleaveChannel(zeros.data(), channels, target, rebuilt.data(), frames);
+            for (size_t i = 0; i < rebuilt.size(); i++) {
+                int16_t expected = (int)(i % channels) == target ? 0 : interleaved[i];
+                if (rebuilt[i] != expected) {
+                    printf("InterleaveChannel: %d channels, touched sample %zu\n", channels, i);
+                    failures++;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+struct SlotCase {
+    const char* slots;
+    const char* input_format;
+    uint16_t channel_mask;  // Slots opened on the codec
+    uint16_t mic_mask;      // Slots that get the mic gain
+};
+
+static void TestSlotTables() {
+    const SlotCase cases[] = {
+        { "MR",   "MR",   0x3, 0x1 },
+        { "MRMM", "MRMM", 0xF, 0xD },
+        { "MMMM", "MMMM", 0xF, 0xF },
+        { "MNRM", "MRM",  0xD, 0x9 },
+    };
+    for (const auto& c : cases) {
+        if (!IsValidAudioSlots(c.slots, 4)) {
+            printf("%s: rejected\n", c.slots);
+            failures++;
+        }
+        std::string format = AudioSlotsToInputFormat(c.slots);
+        if (format != c.input_format) {
+            printf("%s: input_format %s, expected %s\n", c.slots, format.c_str(), c.input_format);
+            failures++;
+        }
+        uint16_t mic_mask = AudioChannelMask(c.slots, AUDIO_CHANNEL_MIC);
+        uint16_t channel_mask = mic_mask | AudioChannelMask(c.slots, AUDIO_CHANNEL_REFERENCE);
+        if (channel_mask != c.channel_mask || mic_mask != c.mic_mask) {
+            printf("%s: channel mask 0x%x mic mask 0x%x, expected 0x%x 0x%x\n",
+                c.slots, channel_mask, mic_mask, c.channel_mask, c.mic_mask);
+            failures++;
+        }
+        // The reference the AFE sees is the n-th returned channel, not the slot index
+        int reference = FindAudioChannel(format, AUDIO_CHANNEL_REFERENCE);
+        int expected_reference = std::string(c.input_format).find(AUDIO_CHANNEL_REFERENCE);
+        if (reference != expected_reference) {
+            printf("%s: reference at %d, expected %d\n", c.slots, reference, expected_reference);
+            failures++;
+        }
+    }
+
+    for (const char* slots : { "", "RRRR", "NNNN", "MMMMM", "MX" }) {
+        if (IsValidAudioSlots(slots, 4)) {
+            printf("\"%s\": accepted\n", slots);
+            failures++;
+        }
+    }
+
+    // Codecs without a slot table
+    struct { int channels; bool reference; const char* format; } defaults[] = {
+        { 1, false, "M" }, { 2, true, "MR" }, { 2, false, "MM" }, { 4, true, "MMMR" },
+    };
+    for (const auto& d : defaults) {
+        std::string format = DefaultAudioInputFormat(d.channels, d.reference);
+        if (format != d.format) {
+            printf("Default %d/%d: %s, expected %s\n", d.channels, d.reference, format.c_str(), d.format);
+            failures++;
+        }
+    }
+}
+
+int main() {
+    TestRoundTrip();
+    TestSlotTables();
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
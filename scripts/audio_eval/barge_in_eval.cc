@@ -0,0 +1,211 @@
+// Replays recorded playback+speech sessions through BargeInDetector and reports
+// the false trigger rate and reaction time for a range of trigger lengths.
+//
+//   barge_in_eval <corpus_dir> [--labels file] [--trigger 160,240,320]
+//                 [--echo-margin db] [--margin db] [--chunk samples] [-v]
+//
+// Every session is a directory recorded with scripts/audio_debug_server.py
+// while the device was speaking, holding processed_ch0.wav (the AEC output)
+// and output_ch0.wav (the playback). labels.csv lines are `session,start`:
+// when the user starts talking over the playback in seconds, or `-` when the
+// session only contains playback.
+
+#include "barge_in_detector.h"
+#include "wav_file.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define PLAYBACK_START_DB -60.0f
+
+struct Session {
+    std::string name;
+    std::vector<int16_t> processed;
+    std::vector<int16_t> output;
+    int output_rate;
+    double speech_start_s;      // -1 without user speech
+    double playback_start_s;
+};
+
+struct Options {
+    std::string corpus;
+    std::string labels;
+    std::vector<int> triggers = { 160, 240, 320 };
+    float echo_margin_db = BargeInDetectorConfig().echo_margin_db;
+    float margin_db = BargeInDetectorConfig().energy_margin_db;
+    int chunk = 512;    // AFE fetch size at 16kHz
+    bool verbose = false;
+};
+
+static std::vector<int> ParseList(const char* text) {
+    std::vector<int> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        values.push_back(atoi(item.c_str()));
+    }
+    return values;
+}
+
+static double Percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-v") {
+            options.verbose = true;
+        } else if (arg == "--labels" && has_value) {
+            options.labels = argv[++i];
+        } else if (arg == "--trigger" && has_value) {
+            options.triggers = ParseList(argv[++i]);
+        } else if (arg == "--echo-margin" && has_value) {
+            options.echo_margin_db = atof(argv[++i]);
+        } else if (arg == "--margin" && has_value) {
+            options.margin_db = atof(argv[++i]);
+        } else if (arg == "--chunk" && has_value) {
+            options.chunk = std::max(1, atoi(argv[++i]));
+        } else if (arg[0] != '-' && options.corpus.empty()) {
+            options.corpus = arg;
+        } else {
+            return false;
+        }
+    }
+    if (options.labels.empty() && !options.corpus.empty()) {
+        options.labels = (std::filesystem::path(options.corpus) / "labels.csv").string();
+    }
+    return !options.corpus.empty() && !options.triggers.empty();
+}
+
+// Playback level over the output samples that were played during [start_s, end_s)
+static float PlaybackDb(const Session& session, double start_s, double end_s) {
+    size_t begin = std::min(session.output.size(), (size_t)(start_s * session.output_rate));
+    size_t end = std::min(session.output.size(), (size_t)(end_s * session.output_rate));
+    return BargeInDetector::LevelDb(session.output.data() + begin, end - begin);
+}
+
+static bool LoadSession(const std::string& directory, Session& session) {
+    int processed_rate = 0;
+    if (!ReadWav(directory + "/processed_ch0.wav", session.processed, processed_rate) || processed_rate != 16000 ||
+        !ReadWav(directory + "/output_ch0.wav", session.output, session.output_rate)) {
+        return false;
+    }
+    // The device resets the detector when it starts speaking
+    int window = session.output_rate / 100;
+    session.playback_start_s = 0;
+    for (size_t i = 0; i + window <= session.output.size(); i += window) {
+        if (BargeInDetector::LevelDb(session.output.data() + i, window) > PLAYBACK_START_DB) {
+            session.playback_start_s = (double)i / session.output_rate;
+            break;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s <corpus_dir> [--labels file] [--trigger 160,240,320]\n"
+                        "       [--echo-margin db] [--margin db] [--chunk samples] [-v]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<Session> sessions;
+    std::ifstream labels(options.labels);
+    std::string line;
+    while (std::getline(labels, line)) {
+        std::stringstream ss(line);
+        std::string name, start;
+        if (line.empty() || line[0] == '#' || !std::getline(ss, name, ',') || !std::getline(ss, start, ',')) {
+            continue;
+        }
+        Session session;
+        session.name = name;
+        session.speech_start_s = start.find_first_of("0123456789") == std::string::npos ? -1 : atof(start.c_str());
+        if (!LoadSession((std::filesystem::path(options.corpus) / name).string(), session)) {
+            fprintf(stderr, "Skipping %s, expected processed_ch0.wav at 16kHz and output_ch0.wav\n", name.c_str());
+            continue;
+        }
+        sessions.push_back(std::move(session));
+    }
+    if (sessions.empty()) {
+        fprintf(stderr, "No labeled sessions found in %s\n", options.labels.c_str());
+        return 1;
+    }
+
+    printf("%zu sessions, echo margin %.1f dB, margin %.1f dB, chunk %d samples\n",
+           sessions.size(), options.echo_margin_db, options.margin_db, options.chunk);
+    printf("%8s %9s %9s %8s %9s %9s %9s\n", "trigger", "false", "FT/hour", "missed", "react p50", "react p90", "react p99");
+
+    for (int trigger : options.triggers) {
+        BargeInDetectorConfig config;
+        config.trigger_ms = trigger;
+        config.echo_margin_db = options.echo_margin_db;
+        config.energy_margin_db = options.margin_db;
+        BargeInDetector detector(config);
+
+        std::vector<double> reactions;
+        int false_triggers = 0;
+        int missed = 0;
+        int positives = 0;
+        double playback_s = 0;
+        for (auto& session : sessions) {
+            // Without user speech the whole session counts, a false trigger restarts the detector
+            double end_s = session.speech_start_s >= 0 ? session.speech_start_s : session.processed.size() / 16000.0;
+            playback_s += std::max(0.0, end_s - session.playback_start_s);
+            positives += session.speech_start_s >= 0;
+
+            detector.Reset();
+            double reaction_s = -1;
+            for (size_t offset = (size_t)(session.playback_start_s * 16000); offset < session.processed.size();
+                 offset += options.chunk) {
+                size_t count = std::min((size_t)options.chunk, session.processed.size() - offset);
+                double start_s = offset / 16000.0;
+                double stop_s = (offset + count) / 16000.0;
+                if (!detector.Feed(session.processed.data() + offset, count, PlaybackDb(session, start_s, stop_s))) {
+                    continue;
+                }
+                if (session.speech_start_s < 0 || stop_s < session.speech_start_s) {
+                    false_triggers++;
+                    if (options.verbose) {
+                        printf("  %-32s false trigger at %.2fs, echo gain %.1f dB\n",
+                               session.name.c_str(), stop_s, detector.echo_gain_db());
+                    }
+                    detector.Reset();
+                    continue;
+                }
+                reaction_s = stop_s - session.speech_start_s;
+                break;
+            }
+            if (session.speech_start_s >= 0) {
+                if (reaction_s < 0) {
+                    missed++;
+                } else {
+                    reactions.push_back(reaction_s * 1000);
+                }
+                if (options.verbose) {
+                    printf("  %-32s speech %.2fs reaction %.0f ms\n", session.name.c_str(),
+                           session.speech_start_s, reaction_s * 1000);
+                }
+            }
+        }
+
+        printf("%8d %9d %9.2f %7.1f%% %9.0f %9.0f %9.0f\n", trigger, false_triggers,
+               playback_s > 0 ? false_triggers * 3600 / playback_s : 0.0,
+               positives ? missed * 100.0 / positives : 0.0,
+               Percentile(reactions, 0.5), Percentile(reactions, 0.9), Percentile(reactions, 0.99));
+    }
+    return 0;
+}
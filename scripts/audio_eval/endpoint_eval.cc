@@ -0,0 +1,182 @@
+// Runs EndpointDetector over labeled recordings and reports endpoint latency
+// and premature cut-offs for a range of hangover values.
+//
+//   endpoint_eval <corpus_dir> [--labels file] [--hangover 500,700,800,1000]
+//                 [--min-speech ms] [--margin db] [--chunk samples] [--tail s] [-v]
+//
+// labels.csv lines are `file,start,end` in seconds: the first and last moment
+// of speech in the recording, relative to the corpus directory.
+
+#include "endpoint_detector.h"
+#include "wav_file.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Recording {
+    std::string path;
+    std::vector<int16_t> samples;
+    double speech_end_s;
+};
+
+struct Options {
+    std::string corpus;
+    std::string labels;
+    std::vector<int> hangovers = { 500, 700, 800, 1000 };
+    int min_speech_ms = EndpointDetectorConfig().min_speech_ms;
+    float margin_db = EndpointDetectorConfig().energy_margin_db;
+    int chunk = 512;    // AFE fetch size at 16kHz
+    double tail_s = 2.0;
+    bool verbose = false;
+};
+
+static std::map<std::string, double> ReadLabels(const std::string& path) {
+    std::map<std::string, double> labels;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::stringstream ss(line);
+        std::string name, start, end;
+        if (std::getline(ss, name, ',') && std::getline(ss, start, ',') && std::getline(ss, end, ',')) {
+            labels[std::filesystem::path(name).lexically_normal().string()] = atof(end.c_str());
+        }
+    }
+    return labels;
+}
+
+static std::vector<int> ParseList(const char* text) {
+    std::vector<int> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        values.push_back(atoi(item.c_str()));
+    }
+    return values;
+}
+
+static double Percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p * values.size()))];
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-v") {
+            options.verbose = true;
+        } else if (arg == "--labels" && has_value) {
+            options.labels = argv[++i];
+        } else if (arg == "--hangover" && has_value) {
+            options.hangovers = ParseList(argv[++i]);
+        } else if (arg == "--min-speech" && has_value) {
+            options.min_speech_ms = atoi(argv[++i]);
+        } else if (arg == "--margin" && has_value) {
+            options.margin_db = atof(argv[++i]);
+        } else if (arg == "--chunk" && has_value) {
+            options.chunk = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--tail" && has_value) {
+            options.tail_s = atof(argv[++i]);
+        } else if (arg[0] != '-' && options.corpus.empty()) {
+            options.corpus = arg;
+        } else {
+            return false;
+        }
+    }
+    if (options.labels.empty() && !options.corpus.empty()) {
+        options.labels = (std::filesystem::path(options.corpus) / "labels.csv").string();
+    }
+    return !options.corpus.empty() && !options.hangovers.empty();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        fprintf(stderr, "Usage: %s <corpus_dir> [--labels file] [--hangover 500,700,800,1000]\n"
+                        "       [--min-speech ms] [--margin db] [--chunk samples] [--tail s] [-v]\n", argv[0]);
+        return 1;
+    }
+
+    auto labels = ReadLabels(options.labels);
+    std::vector<Recording> recordings;
+    for (auto& [name, speech_end_s] : labels) {
+        Recording recording = { name, {}, speech_end_s };
+        int sample_rate = 0;
+        if (!ReadWav((std::filesystem::path(options.corpus) / name).string(), recording.samples, sample_rate) ||
+            sample_rate != 16000) {
+            fprintf(stderr, "Skipping %s, expected 16kHz 16-bit PCM\n", name.c_str());
+            continue;
+        }
+        // Room for the hangover when the recording stops right after the speech
+        recording.samples.resize(recording.samples.size() + (size_t)(options.tail_s * 16000), 0);
+        recordings.push_back(std::move(recording));
+    }
+    if (recordings.empty()) {
+        fprintf(stderr, "No labeled recordings found in %s\n", options.labels.c_str());
+        return 1;
+    }
+
+    // The AFE VAD is not available on the host, so frames are classified by energy alone
+    printf("%zu recordings, min speech %d ms, margin %.1f dB, chunk %d samples, energy only\n",
+           recordings.size(), options.min_speech_ms, options.margin_db, options.chunk);
+    printf("%9s %10s %10s %9s %9s %9s\n", "hangover", "premature", "missed", "lat p50", "lat p90", "lat p99");
+
+    for (int hangover : options.hangovers) {
+        EndpointDetectorConfig config;
+        config.hangover_ms = hangover;
+        config.min_speech_ms = options.min_speech_ms;
+        config.energy_margin_db = options.margin_db;
+        config.use_vad = false;
+        EndpointDetector detector(config);
+
+        std::vector<double> latencies;
+        int premature = 0;
+        int missed = 0;
+        for (auto& recording : recordings) {
+            detector.Reset();
+            // The endpoint is reported at the end of the chunk that completed it
+            double endpoint_s = -1;
+            for (size_t offset = 0; offset < recording.samples.size(); offset += options.chunk) {
+                size_t count = std::min((size_t)options.chunk, recording.samples.size() - offset);
+                if (detector.Feed(recording.samples.data() + offset, count, true)) {
+                    endpoint_s = (offset + count) / 16000.0;
+                    break;
+                }
+            }
+
+            const char* result = "ok";
+            if (endpoint_s < 0) {
+                missed++;
+                result = "missed";
+            } else if (endpoint_s < recording.speech_end_s) {
+                premature++;
+                result = "premature";
+            } else {
+                latencies.push_back((endpoint_s - recording.speech_end_s) * 1000);
+            }
+            if (options.verbose) {
+                printf("  %-40s end %.2fs endpoint %.2fs floor %.1f dB %s\n", recording.path.c_str(),
+                       recording.speech_end_s, endpoint_s, detector.noise_floor_db(), result);
+            }
+        }
+
+        double total = recordings.size();
+        printf("%9d %9.1f%% %9.1f%% %9.0f %9.0f %9.0f\n", hangover,
+               premature * 100 / total, missed * 100 / total,
+               Percentile(latencies, 0.5), Percentile(latencies, 0.9), Percentile(latencies, 0.99));
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+// Replays voice turns through LatencyStats, the ring and percentile math
+// behind the self.debug.get_voice_latency tool.
+//
+// Usage: latency_replay [turns.csv] [--trace]
+// Without a file it checks the stage breakdown and p50/p95/p99 against
+// hand-computed values. A CSV has one turn per line:
+//   id,wake,open_audio_channel,opus_encode,protocol_send,tts_start,first_audio_output
+// with esp_timer timestamps in microseconds, 0 for stages that were not reached.
+
+#include "latency_stats.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static int failures = 0;
+
+static void ExpectContains(const std::string& json, const std::string& expected) {
+    if (json.find(expected) == std::string::npos) {
+        printf("Missing %s in\n  %s\n", expected.c_str(), json.c_str());
+        failures++;
+    }
+}
+
+// Turn k: the wake word audio is encoded before the channel opens, and the
+// server takes k * 10 ms to start TTS
+static LatencyStats::Turn MakeTurn(uint32_t k) {
+    int64_t wake = 1000000 * (int64_t)k;
+    int64_t tts = wake + 60000 + k * 10000;
+    return {k, {wake, wake + 50000, wake + 20000, wake + 60000, tts, tts + 100000}};
+}
+
+static int SelfTest() {
+    LatencyStats stats;
+    ExpectContains(stats.GetSummaryJson(), "{\"turns\":0,\"stages\":{}}");
+
+    stats.Add(MakeTurn(1));
+    // A single turn: every percentile is that turn
+    ExpectContains(stats.GetSummaryJson(), "\"tts_start\":{\"p50\":10,\"p95\":10,\"p99\":10}");
+
+    for (uint32_t k = 2; k <= LatencyStats::kMaxTurns; k++) {
+        stats.Add(MakeTurn(k));
+    }
+    auto json = stats.GetSummaryJson();
+    ExpectContains(json, "\"turns\":16,");
+    // Overlapping stages are measured from the latest earlier stage
+    ExpectContains(json, "\"open_audio_channel\":{\"p50\":50,\"p95\":50,\"p99\":50}");
+    ExpectContains(json, "\"opus_encode\":{\"p50\":20,\"p95\":20,\"p99\":20}");
+    ExpectContains(json, "\"protocol_send\":{\"p50\":10,\"p95\":10,\"p99\":10}");
+    // Nearest rank over 16 turns: p50 is the 8th, p95 and p99 the 16th
+    ExpectContains(json, "\"tts_start\":{\"p50\":80,\"p95\":160,\"p99\":160}");
+    ExpectContains(json, "\"first_audio_output\":{\"p50\":100,\"p95\":100,\"p99\":100}");
+    ExpectContains(json, "\"total\":{\"p50\":240,\"p95\":320,\"p99\":320}");
+
+    // Older turns drop out of the window
+    for (uint32_t k = LatencyStats::kMaxTurns + 1; k <= 2 * LatencyStats::kMaxTurns; k++) {
+        stats.Add(MakeTurn(k));
+    }
+    json = stats.GetSummaryJson();
+    ExpectContains(json, "\"turns\":16,");
+    ExpectContains(json, "\"tts_start\":{\"p50\":240,\"p95\":320,\"p99\":320}");
+
+    // Stages that were not reached are left out rather than counted as 0
+    LatencyStats partial;
+    auto turn = MakeTurn(1);
+    turn.time_us[kLatencyStageFirstEncode] = 0;
+    turn.time_us[kLatencyStageFirstSend] = 0;
+    partial.Add(turn);
+    json = partial.GetSummaryJson();
+    if (json.find("opus_encode") != std::string::npos) {
+        printf("Unrecorded stage reported: %s\n", json.c_str());
+        failures++;
+    }
+    // tts_start now counts from the channel opening
+    ExpectContains(json, "\"tts_start\":{\"p50\":20,");
+
+    // Trace slices end at the stage timestamp
+    auto trace = partial.GetChromeTraceJson();
+    ExpectContains(trace, "{\"name\":\"open_audio_channel\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":1000000,\"dur\":50000}");
+    ExpectContains(trace, "{\"name\":\"tts_start\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":1050000,\"dur\":20000}");
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    bool trace = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0) {
+            trace = true;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == nullptr) {
+        return SelfTest();
+    }
+
+    std::ifstream in(path);
+    if (!in) {
+        printf("Cannot open %s\n", path);
+        return 1;
+    }
+    LatencyStats stats;
+    std::string line;
+    int turns = 0;
+    while (std::getline(in, line)) {
+        // Skips the header and comments
+        if (line.empty() || !isdigit((unsigned char)line[0])) {
+            continue;
+        }
+        std::istringstream fields(line);
+        LatencyStats::Turn turn = {};
+        std::string value;
+        std::getline(fields, value, ',');
+        turn.id = std::stoul(value);
+        for (int i = 0; i < kLatencyStageCount && std::getline(fields, value, ','); i++) {
+            turn.time_us[i] = std::stoll(value);
+        }
+        stats.Add(turn);
+        turns++;
+    }
+    // The device only keeps the last kMaxTurns turns; replay shows what it would report
+    printf("Replayed %d turns, summary over the last %d\n", turns, stats.count());
+    printf("%s\n", trace ? stats.GetChromeTraceJson().c_str() : stats.GetSummaryJson().c_str());
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Renders LedCompositor scenes at fixed timestamps and compares every frame
+// with led_effect_golden.txt. The scenes cover keyframe, scroll, fade and
+// audio-level effects, add blending and gamma correction.
+//
+// Usage: led_effect_test <golden file> [--update]
+// --update rewrites the golden file; check the diff before committing it.
+
+#include "led_effect.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define LED_COUNT 8
+
+struct Scene {
+    const char* name;
+    std::function<void(LedCompositor&)> setup;
+    std::vector<int64_t> times_ms;
+    // Called before rendering each timestamp, e.g. to move the audio level
+    std::function<void(int64_t)> before_frame = nullptr;
+};
+
+static std::atomic<uint8_t> audio_level{0};
+
+static std::vector<Scene> Scenes() {
+    const StripColor black = {0, 0, 0};
+    const StripColor red = {255, 0, 0};
+    const StripColor green = {0, 255, 0};
+    const StripColor blue = {0, 0, 255};
+    std::vector<StripColor> gradient;
+    for (int i = 0; i < LED_COUNT; i++) {
+        gradient.push_back({(uint8_t)(255 - i * 32), (uint8_t)(i * 32), 128});
+    }
+
+    return {
+        {"keyframe_loop", [=](LedCompositor& c) {
+            c.SetLayer(0, std::make_unique<KeyframeEffect>(std::vector<KeyframeEffect::Keyframe>{
+                {0, black, 255}, {1000, {200, 100, 0}, 255}, {2000, black, 255},
+            }, true), 0);
+        }, {0, 250, 500, 1000, 1500, 1999, 2250}},
+
+        {"keyframe_step", [=](LedCompositor& c) {
+            c.SetLayer(0, std::make_unique<KeyframeEffect>(std::vector<KeyframeEffect::Keyframe>{
+                {0, red, 255}, {500, green, 255}, {1000, blue, 255},
+            }, false, true), 0);
+        }, {0, 499, 500, 1000, 5000}},
+
+        {"scroll", [=](LedCompositor& c) {
+            c.SetLayer(0, std::make_unique<ScrollEffect>(StripColor{0, 0, 20}, StripColor{255, 255, 255}, 3, 100), 0);
+        }, {0, 99, 150, 750, 1650}},
+
+        {"fade_out", [=](LedCompositor& c) {
+            c.SetLayer(0, std::make_unique<FadeOutEffect>(gradient, 200), 0);
+        }, {0, 199, 200, 600, 1800}},
+
+        {"audio_level", [=](LedCompositor& c) {
+            c.SetLayer(0, std::make_unique<AudioLevelEffect>(audio_level, StripColor{0, 200, 255}), 0);
+        }, {0, 15, 40, 100, 250, 500},
+        [](int64_t t) { audio_level = t < 100 ? 160 : 0; }},
+
+        // Static base, an additive pulse on top and a half transparent
+        // keyframe layer above that, all through gamma 2.2
+        {"composite", [=](LedCompositor& c) {
+            c.SetGamma(2.2f);
+            c.SetLayer(0, std::make_unique<StaticEffect>(gradient), 0);
+            c.SetLayer(1, std::make_unique<KeyframeEffect>(std::vector<KeyframeEffect::Keyframe>{
+                {0, {0, 0, 0}, 0}, {400, {100, 200, 50}, 255}, {800, {0, 0, 0}, 0},
+            }, true), 0, kLedBlendAdd);
+            c.SetLayer(2, std::make_unique<KeyframeEffect>(std::vector<KeyframeEffect::Keyframe>{
+                {0, {255, 255, 255}, 128}, {300, {255, 255, 255}, 0},
+            }, false), 100);
+        }, {0, 100, 200, 400, 600, 900}},
+    };
+}
+
+static std::string FrameHex(const std::vector<StripColor>& frame) {
+    std::string line;
+    char buffer[8];
+    for (const auto& color : frame) {
+        snprintf(buffer, sizeof(buffer), " %02x%02x%02x", color.red, color.green, color.blue);
+        line += buffer;
+    }
+    return line;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: %s <golden file> [--update]\n", argv[0]);
+        return 2;
+    }
+    const char* golden_path = argv[1];
+    bool update = argc > 2 && strcmp(argv[2], "--update") == 0;
+
+    // "<scene> <time_ms>" -> frame
+    std::vector<std::pair<std::string, std::string>> rendered;
+    for (const auto& scene : Scenes()) {
+        LedCompositor compositor(LED_COUNT);
+        scene.setup(compositor);
+        for (int64_t t : scene.times_ms) {
+            if (scene.before_frame) {
+                scene.before_frame(t);
+            }
+            compositor.Render(t);
+            rendered.push_back({std::string(scene.name) + " " + std::to_string(t), FrameHex(compositor.frame())});
+        }
+    }
+
+    if (update) {
+        std::ofstream out(golden_path);
+        out << "# <scene> <time_ms> then RGB of each LED, written by led_effect_test --update\n";
+        for (const auto& [key, frame] : rendered) {
+            out << key << frame << "\n";
+        }
+        printf("Wrote %zu frames to %s\n", rendered.size(), golden_path);
+        return 0;
+    }
+
+    std::ifstream in(golden_path);
+    if (!in) {
+        printf("Cannot open %s\n", golden_path);
+        return 1;
+    }
+    std::map<std::string, std::string> golden;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string scene, time;
+        fields >> scene >> time;
+        std::string frame;
+        std::getline(fields, frame);
+        golden[scene + " " + time] = frame;
+    }
+
+    int failures = 0;
+    for (const auto& [key, frame] : rendered) {
+        auto it = golden.find(key);
+        if (it == golden.end()) {
+            printf("%s: no golden frame\n", key.c_str());
+            failures++;
+        } else if (it->second != frame) {
+            printf("%s:\n  expected%s\n  actual  %s\n", key.c_str(), it->second.c_str(), frame.c_str());
+            failures++;
+        }
+    }
+    if (golden.size() != rendered.size()) {
+        printf("Golden file has %zu frames, rendered %zu\n", golden.size(), rendered.size());
+        failures++;
+    }
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
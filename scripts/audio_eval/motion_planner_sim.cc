@@ -0,0 +1,216 @@
+// Runs MotionPlanner at the Otto motion tick with a fake clock. Fails when an
+// angle jumps between ticks, e.g. on Interrupt(), MoveTo chaining or after
+// SetAngles seeding, and reports the per-tick cost of Update().
+//
+// Usage: motion_planner_sim [-v]    -v prints the angles of every tick
+
+#include "motion_planner.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#define SERVO_COUNT 6
+#define TICK_MS 20      // MOTION_TICK_MS in otto_movements.h
+
+static bool verbose = false;
+static int failures = 0;
+static int64_t total_ticks = 0;
+static double total_ns = 0;
+static double max_ns = 0;
+
+class Sim {
+public:
+    // max_step: largest legitimate change of any angle within one tick
+    Sim(const char* name, float max_step) : name_(name), max_step_(max_step), planner_(SERVO_COUNT) {}
+
+    MotionPlanner& planner() { return planner_; }
+    int64_t now() const { return now_; }
+    float angle(int servo) const { return planner_.angles()[servo]; }
+
+    bool Tick() {
+        auto start = std::chrono::steady_clock::now();
+        bool moving = planner_.Update(now_);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        total_ns += ns;
+        max_ns = std::max(max_ns, ns);
+        total_ticks++;
+
+        const auto& angles = planner_.angles();
+        if (verbose) {
+            printf("%s,%lld", name_, (long long)now_);
+            for (float a : angles) {
+                printf(",%.2f", a);
+            }
+            printf("\n");
+        }
+        if (!last_.empty()) {
+            for (int i = 0; i < SERVO_COUNT; i++) {
+                float step = std::fabs(angles[i] - last_[i]);
+                max_seen_ = std::max(max_seen_, step);
+                if (step > max_step_) {
+                    printf("%s: servo %d jumps %.1f -> %.1f at %lld ms\n", name_, i, last_[i], angles[i], (long long)now_);
+                    failures++;
+                }
+            }
+        }
+        last_ = angles;
+        now_ += TICK_MS;
+        return moving;
+    }
+
+    // Servos reported at these angles, as Otto::StartMotion() does when idle.
+    // Later ticks are checked against them rather than the planner's old angles.
+    void Seed(const int* angles) {
+        planner_.SetAngles(angles);
+        last_ = planner_.angles();
+    }
+
+    void RunFor(int ms) {
+        for (int t = 0; t < ms; t += TICK_MS) {
+            Tick();
+        }
+    }
+
+    void RunUntilIdle() {
+        while (Tick() && !planner_.IsIdle()) {
+        }
+    }
+
+    void Expect(int servo, float expected, const char* what) {
+        if (std::fabs(angle(servo) - expected) > 0.01f) {
+            printf("%s: %s: servo %d at %.2f, expected %.2f\n", name_, what, servo, angle(servo), expected);
+            failures++;
+        }
+    }
+
+    void Report() const {
+        printf("%-12s max step %.2f deg/tick (limit %.1f)\n", name_, max_seen_, max_step_);
+    }
+
+private:
+    const char* name_;
+    float max_step_;
+    MotionPlanner planner_;
+    int64_t now_ = 0;
+    std::vector<float> last_;
+    float max_seen_ = 0;
+};
+
+static void Fill(int* values, int value) {
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        values[i] = value;
+    }
+}
+
+// Interrupting an oscillation mid-swing, then moving home or starting a new
+// oscillation in the opposite phase
+static void TestInterrupt() {
+    Sim sim("interrupt", 8.0f);
+    int amplitude[SERVO_COUNT], offset[SERVO_COUNT], home[SERVO_COUNT];
+    double phase[SERVO_COUNT], opposite[SERVO_COUNT];
+    Fill(amplitude, 30);
+    Fill(offset, 0);
+    Fill(home, 90);
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        phase[i] = i * M_PI / 3;
+        opposite[i] = phase[i] + M_PI;
+    }
+
+    sim.planner().Oscillate(amplitude, offset, phase, 1000, 3);
+    sim.RunFor(730);
+    sim.planner().Interrupt();
+    sim.planner().MoveTo(home, 500);
+    sim.RunFor(200);
+    sim.planner().Interrupt();
+    sim.planner().Oscillate(amplitude, offset, opposite, 800, 2);
+    sim.RunFor(450);
+    sim.planner().Interrupt();
+    sim.planner().MoveTo(home, 600);
+    sim.RunUntilIdle();
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        sim.Expect(i, 90, "home");
+    }
+    sim.Report();
+}
+
+// Back-to-back poses, kKeepPosition and a hold in between
+static void TestChaining() {
+    Sim sim("chaining", 10.0f);
+    int a[SERVO_COUNT], b[SERVO_COUNT], keep[SERVO_COUNT];
+    Fill(a, 60);
+    Fill(b, 120);
+    Fill(keep, MotionPlanner::kKeepPosition);
+    keep[0] = 150;
+
+    sim.planner().MoveTo(a, 400);
+    sim.planner().MoveTo(b, 600);
+    sim.planner().Hold(200);
+    sim.planner().MoveTo(keep, 500);
+    sim.planner().MoveTo(a, 300);
+
+    // Each pose is reached exactly at its planned end
+    sim.RunFor(400);
+    sim.Tick();
+    sim.Expect(1, 60, "end of first pose");
+    sim.RunFor(1000 - sim.now());
+    sim.Tick();
+    sim.Expect(1, 120, "end of second pose");
+    sim.RunFor(1700 - sim.now());
+    sim.Tick();
+    sim.Expect(0, 150, "kept pose");
+    sim.Expect(1, 120, "kept pose");
+    sim.RunUntilIdle();
+    for (int i = 0; i < SERVO_COUNT; i++) {
+        sim.Expect(i, 60, "last pose");
+    }
+    sim.Report();
+}
+
+// The planner starts from the servos' real angles, not from 90 degrees
+static void TestSeeding() {
+    Sim sim("seeding", 6.0f);
+    int seed[SERVO_COUNT] = { 20, 160, MotionPlanner::kKeepPosition, 45, 135, 90 };
+    int target[SERVO_COUNT];
+    Fill(target, 100);
+
+    sim.Seed(seed);
+    sim.planner().MoveTo(target, 800);
+    sim.Tick();
+    sim.Expect(0, 20, "first tick");
+    sim.Expect(1, 160, "first tick");
+    sim.Expect(2, 90, "kept servo");
+    sim.RunUntilIdle();
+
+    // Idle again: re-seed with where the servos actually ended up
+    int moved[SERVO_COUNT] = { 70, 110, 100, 100, 100, 100 };
+    sim.Seed(moved);
+    int amplitude[SERVO_COUNT], offset[SERVO_COUNT];
+    double phase[SERVO_COUNT] = {};
+    Fill(amplitude, 20);
+    Fill(offset, 0);
+    sim.planner().Oscillate(amplitude, offset, phase, 1000, 1);
+    sim.Tick();
+    sim.Expect(0, 70, "oscillation start");
+    sim.RunUntilIdle();
+    sim.Report();
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        }
+    }
+    TestInterrupt();
+    TestChaining();
+    TestSeeding();
+
+    printf("Update(): %lld ticks, avg %.0f ns, max %.0f ns\n",
+           (long long)total_ticks, total_ns / total_ticks, max_ns);
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+// Feeds ProfilerStats fake task and heap snapshots and checks the CPU shares,
+// counter wrap, idle-task load, history window and fragmentation.
+
+#include "profiler_stats.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK_EQ(actual, expected) do { \
+    long long a_ = (long long)(actual), e_ = (long long)(expected); \
+    if (a_ != e_) { \
+        printf("%s:%d: %s = %lld, expected %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+        failures++; \
+    } \
+} while (0)
+
+// Fake system: the name pointers double as task handles
+struct FakeTask {
+    const char* name;
+    uint32_t run_time;
+    uint32_t stack_free;
+};
+
+static bool Feed(ProfilerStats& stats, std::vector<FakeTask>& tasks, uint32_t total_run_time,
+        ProfilerStats::HeapSample heap = { 200000, 100000, 4000000, 3000000 }) {
+    std::vector<ProfilerStats::TaskSnapshot> snapshots;
+    for (auto& task : tasks) {
+        snapshots.push_back({ task.name, task.name, 5, task.run_time, task.stack_free });
+    }
+    return stats.AddSample(snapshots.data(), snapshots.size(), total_run_time, heap);
+}
+
+static const ProfilerStats::TaskRecord* Find(const ProfilerStats& stats, const char* name) {
+    for (const auto& task : stats.tasks()) {
+        if (strcmp(task.name, name) == 0) {
+            return &task;
+        }
+    }
+    return nullptr;
+}
+
+static int Percent(const ProfilerStats& stats, const char* name) {
+    auto task = Find(stats, name);
+    return task ? stats.cpu_percent(*task) : -1;
+}
+
+static void TestCpuShare() {
+    // Two cores: each interval has twice the total run time to share out
+    ProfilerStats stats(2);
+    std::vector<FakeTask> tasks = {
+        { "IDLE0", 0, 1000 }, { "IDLE1", 0, 1000 }, { "audio", 0, 3000 }, { "main", 0, 4000 },
+    };
+    CHECK_EQ(Feed(stats, tasks, 0), false);
+    CHECK_EQ(stats.count(), 0);
+
+    tasks[0].run_time += 800;
+    tasks[1].run_time += 600;
+    tasks[2].run_time += 400;
+    tasks[3].run_time += 200;
+    tasks[2].stack_free = 2500;
+    CHECK_EQ(Feed(stats, tasks, 1000), true);
+    CHECK_EQ(stats.count(), 1);
+    CHECK_EQ(Percent(stats, "IDLE0"), 40);
+    CHECK_EQ(Percent(stats, "IDLE1"), 30);
+    CHECK_EQ(Percent(stats, "audio"), 20);
+    CHECK_EQ(Percent(stats, "main"), 10);
+    CHECK_EQ(stats.cpu_load(), 30);
+    CHECK_EQ(Find(stats, "audio")->min_stack_free, 2500);
+
+    // A higher high-water mark does not raise the minimum
+    tasks[2].stack_free = 2800;
+    Feed(stats, tasks, 2000);
+    CHECK_EQ(Find(stats, "audio")->min_stack_free, 2500);
+    // No idle time at all is full load
+    CHECK_EQ(stats.cpu_load(), 100);
+}
+
+static void TestCounterWrap() {
+    ProfilerStats stats(1);
+    std::vector<FakeTask> tasks = { { "IDLE0", UINT32_MAX - 99, 1000 }, { "wifi", UINT32_MAX - 9, 1000 } };
+    Feed(stats, tasks, UINT32_MAX - 199);
+
+    // Every counter wraps during this interval
+    tasks[0].run_time += 750;
+    tasks[1].run_time += 250;
+    CHECK_EQ(Feed(stats, tasks, UINT32_MAX - 199 + 1000), true);
+    CHECK_EQ(Percent(stats, "IDLE0"), 75);
+    CHECK_EQ(Percent(stats, "wifi"), 25);
+    CHECK_EQ(stats.cpu_load(), 25);
+}
+
+static void TestTaskLifetime() {
+    ProfilerStats stats(1);
+    std::vector<FakeTask> tasks = { { "IDLE0", 0, 1000 }, { "old", 0, 1000 } };
+    Feed(stats, tasks, 0);
+    tasks[0].run_time += 500;
+    tasks[1].run_time += 500;
+    Feed(stats, tasks, 1000);
+    CHECK_EQ(stats.tasks().size(), 2);
+
+    // "old" is deleted and "new" appears with a large counter: it starts at 0%, not at its lifetime total
+    tasks.pop_back();
+    tasks.push_back({ "new", 900000, 1000 });
+    tasks[0].run_time += 1000;
+    Feed(stats, tasks, 2000);
+    CHECK_EQ(Find(stats, "old") == nullptr, true);
+    CHECK_EQ(Percent(stats, "new"), 0);
+    tasks[0].run_time += 600;
+    tasks[1].run_time += 400;
+    Feed(stats, tasks, 3000);
+    CHECK_EQ(Percent(stats, "new"), 40);
+
+    // Tasks past kMaxTasks are not tracked
+    std::vector<FakeTask> many;
+    char names[ProfilerStats::kMaxTasks + 4][ProfilerStats::kNameLength];
+    for (int i = 0; i < ProfilerStats::kMaxTasks + 4; i++) {
+        snprintf(names[i], sizeof(names[i]), "task%d", i);
+        many.push_back({ names[i], 0, 1000 });
+    }
+    ProfilerStats full(1);
+    Feed(full, many, 0);
+    CHECK_EQ(full.tasks().size(), ProfilerStats::kMaxTasks);
+}
+
+static void TestHistory() {
+    ProfilerStats stats(1);
+    std::vector<FakeTask> tasks = { { "IDLE0", 0, 1000 } };
+    uint32_t total = 0;
+    Feed(stats, tasks, total);
+
+    // Load ramps 0..99; only the newest kHistorySize samples are kept
+    const int samples = 100;
+    for (int i = 0; i < samples; i++) {
+        tasks[0].run_time += 100 - i;
+        total += 100;
+        ProfilerStats::HeapSample heap = { 100000u + i, 50000, 0, 0 };
+        Feed(stats, tasks, total, heap);
+    }
+    CHECK_EQ(stats.count(), ProfilerStats::kHistorySize);
+    CHECK_EQ(stats.cpu_load(), samples - 1);
+
+    auto identity = [](auto v) { return (int64_t)v; };
+    auto load = stats.Stats(stats.cpu_load_ring(), identity);
+    int first = samples - ProfilerStats::kHistorySize;
+    CHECK_EQ(load.min, first);
+    CHECK_EQ(load.max, samples - 1);
+    CHECK_EQ(load.avg, (first + samples - 1) / 2);
+
+    auto free = stats.Stats(stats.heap_ring(), [](const ProfilerStats::HeapSample& s) { return (int64_t)s.internal_free; });
+    CHECK_EQ(free.min, 100000 + first);
+    CHECK_EQ(free.max, 100000 + samples - 1);
+
+    // Oldest to newest
+    std::vector<int> series;
+    stats.ForEach(stats.cpu_load_ring(), [&](uint8_t v) { series.push_back(v); });
+    CHECK_EQ(series.size(), ProfilerStats::kHistorySize);
+    for (size_t i = 0; i < series.size(); i++) {
+        CHECK_EQ(series[i], first + (int)i);
+    }
+
+    ProfilerStats empty(1);
+    auto none = empty.Stats(empty.cpu_load_ring(), identity);
+    CHECK_EQ(none.min, 0);
+    CHECK_EQ(none.avg, 0);
+    CHECK_EQ(none.max, 0);
+}
+
+static void TestFragmentation() {
+    CHECK_EQ(ProfilerStats::Fragmentation(0, 0), 0);
+    CHECK_EQ(ProfilerStats::Fragmentation(1000, 1000), 0);
+    CHECK_EQ(ProfilerStats::Fragmentation(1000, 250), 75);
+    // No overflow with PSRAM-sized numbers
+    CHECK_EQ(ProfilerStats::Fragmentation(8u << 20, 2u << 20), 75);
+}
+
+int main() {
+    TestCpuShare();
+    TestCounterWrap();
+    TestTaskLifetime();
+    TestHistory();
+    TestFragmentation();
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
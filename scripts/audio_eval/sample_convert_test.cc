@@ -0,0 +1,83 @@
+// Checks the NoAudioCodec sample conversions bit for bit against the
+// per-sample loops they replaced.
+
+#include "sample_convert.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static int32_t ReferenceScale(int16_t sample, int32_t gain) {
+    int64_t temp = int64_t(sample) * gain;
+    if (temp > INT32_MAX) {
+        return INT32_MAX;
+    } else if (temp < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return static_cast<int32_t>(temp);
+}
+
+static int16_t ReferenceNarrow(int32_t sample) {
+    int32_t value = sample >> 12;
+    return (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
+}
+
+int main() {
+    std::mt19937 rng(1);
+    int failures = 0;
+
+    // Odd lengths exercise the tail after the unrolled loop
+    for (int samples : { 0, 1, 3, 4, 7, 160, 481, 1024 }) {
+        std::vector<int32_t> wide(samples);
+        std::vector<int16_t> narrow(samples);
+        for (auto& v : wide) {
+            v = (int32_t)rng();
+        }
+        if (samples >= 4) {
+            wide[0] = INT32_MAX;
+            wide[1] = INT32_MIN;
+            wide[2] = INT16_MAX << 12;
+            wide[3] = -(INT16_MAX << 12) - 1;
+        }
+        NarrowToInt16(wide.data(), narrow.data(), samples);
+        for (int i = 0; i < samples; i++) {
+            if (narrow[i] != ReferenceNarrow(wide[i])) {
+                printf("NarrowToInt16: sample %d of %d: %d != %d\n", i, samples, narrow[i], ReferenceNarrow(wide[i]));
+                failures++;
+            }
+        }
+
+        std::vector<int16_t> pcm(samples);
+        std::vector<int32_t> scaled(samples);
+        for (auto& v : pcm) {
+            v = (int16_t)rng();
+        }
+        if (samples >= 2) {
+            pcm[0] = INT16_MIN;
+            pcm[1] = INT16_MAX;
+        }
+        for (int32_t gain : { 0, 1, 655, 32768, 65535, 65536 }) {
+            ScaleToInt32(pcm.data(), scaled.data(), samples, gain);
+            for (int i = 0; i < samples; i++) {
+                if (scaled[i] != ReferenceScale(pcm[i], gain)) {
+                    printf("ScaleToInt32: gain %d sample %d of %d\n", (int)gain, i, samples);
+                    failures++;
+                }
+            }
+        }
+        if (samples > 0) {
+            int32_t step = (0 - 65536) / samples;
+            ScaleToInt32Ramp(pcm.data(), scaled.data(), samples, 65536, step);
+            for (int i = 0; i < samples; i++) {
+                if (scaled[i] != ReferenceScale(pcm[i], 65536 + step * i)) {
+                    printf("ScaleToInt32Ramp: sample %d of %d\n", i, samples);
+                    failures++;
+                }
+            }
+        }
+    }
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,219 @@
+// Drives StepperScheduler::Poll() with a fake clock and checks the trapezoid
+// timing, the merged two-axis output, early stops and late polls.
+
+#include "stepper_scheduler.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        printf("%s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
+
+struct Change {
+    int64_t time_us;
+    uint8_t output;
+};
+
+// Polls at exactly the requested times until idle, recording every output change
+static std::vector<Change> Run(StepperScheduler& scheduler, int64_t start_us = 0, int max_polls = 100000) {
+    std::vector<Change> changes;
+    uint8_t last = 0;
+    int64_t now = start_us;
+    for (int i = 0; i < max_polls && now >= 0; i++) {
+        uint8_t output;
+        int64_t next = scheduler.Poll(now, &output);
+        if (output != last) {
+            changes.push_back({ now, output });
+            last = output;
+        }
+        now = next;
+    }
+    return changes;
+}
+
+static void TestTrapezoid() {
+    StepperScheduler scheduler(1);
+    StepperScheduler::Move move;
+    move.steps = 60;
+    move.start_speed = 100;
+    move.max_speed = 400;
+    move.acceleration = 2000;
+    int steps_done = -1;
+    move.on_complete = [&](int steps) { steps_done = steps; };
+    scheduler.Enqueue(0, move);
+    auto changes = Run(scheduler);
+
+    // One change per phase, plus the coils switching off at the end
+    int phases = move.steps * 4;
+    CHECK((int)changes.size() == phases + 1, "%zu changes, expected %d", changes.size(), phases + 1);
+    CHECK(steps_done == move.steps, "steps_done %d", steps_done);
+    CHECK(changes.back().output == 0, "coils left on: 0x%x", changes.back().output);
+    CHECK(scheduler.IsIdle(), "not idle");
+    if ((int)changes.size() != phases + 1) {
+        return;
+    }
+
+    std::vector<int64_t> gaps;
+    for (int i = 1; i < phases; i++) {
+        gaps.push_back(changes[i].time_us - changes[i - 1].time_us);
+    }
+    int64_t min_gap = 1000000 / move.max_speed;
+    int64_t max_gap = 1000000 / move.start_speed;
+    bool reached_max = false;
+    for (size_t i = 0; i < gaps.size(); i++) {
+        CHECK(gaps[i] >= min_gap && gaps[i] <= max_gap, "gap %zu = %lld us out of [%lld, %lld]",
+            i, (long long)gaps[i], (long long)min_gap, (long long)max_gap);
+        // Deceleration mirrors acceleration
+        CHECK(gaps[i] == gaps[gaps.size() - 1 - i], "gap %zu = %lld, mirror = %lld",
+            i, (long long)gaps[i], (long long)gaps[gaps.size() - 1 - i]);
+        // Speeds up, then slows down, never the other way round
+        if (i > 0 && i < gaps.size() / 2) {
+            CHECK(gaps[i] <= gaps[i - 1], "gap %zu grows while accelerating", i);
+        }
+        reached_max |= gaps[i] == min_gap;
+    }
+    CHECK(reached_max, "never reached max_speed");
+
+    // Forward drive walks the coils 0, 1, 2, 3
+    for (int i = 0; i < 8; i++) {
+        CHECK(changes[i].output == 1 << (i % 4), "phase %d output 0x%x", i, changes[i].output);
+    }
+}
+
+static void TestTwoAxes() {
+    StepperScheduler scheduler(2);
+    StepperScheduler::Move forward;
+    forward.steps = 10;
+    forward.start_speed = forward.max_speed = 100;
+    StepperScheduler::Move backward;
+    backward.steps = 7;
+    backward.direction = true;
+    backward.start_speed = backward.max_speed = 170;
+    scheduler.Enqueue(0, forward);
+    scheduler.Enqueue(1, backward);
+    auto changes = Run(scheduler);
+
+    // Split the merged byte back into the two nibbles
+    std::vector<uint8_t> sequence[2];
+    for (const auto& change : changes) {
+        for (int axis = 0; axis < 2; axis++) {
+            uint8_t coils = (change.output >> (axis * 4)) & 0x0F;
+            CHECK(coils == 0 || coils == 1 || coils == 2 || coils == 4 || coils == 8,
+                "axis %d drives several coils: 0x%x", axis, change.output);
+            if (coils != 0 && (sequence[axis].empty() || sequence[axis].back() != coils)) {
+                sequence[axis].push_back(coils);
+            }
+        }
+    }
+    CHECK((int)sequence[0].size() == forward.steps * 4, "axis 0 made %zu phases", sequence[0].size());
+    CHECK((int)sequence[1].size() == backward.steps * 4, "axis 1 made %zu phases", sequence[1].size());
+    for (size_t i = 0; i < sequence[0].size(); i++) {
+        CHECK(sequence[0][i] == 1 << (i % 4), "axis 0 phase %zu: 0x%x", i, sequence[0][i]);
+    }
+    for (size_t i = 0; i < sequence[1].size(); i++) {
+        CHECK(sequence[1][i] == 8 >> (i % 4), "axis 1 phase %zu: 0x%x", i, sequence[1][i]);
+    }
+    // Both axes run at once, not one after the other
+    CHECK(changes[0].output == 0x81, "first output 0x%x", changes[0].output);
+    CHECK(changes.back().output == 0, "coils left on: 0x%x", changes.back().output);
+}
+
+static void TestStopCondition() {
+    StepperScheduler scheduler(1);
+    StepperScheduler::Move move;
+    move.steps = 20;
+    int checks = 0;
+    move.stop_condition = [&]() { return ++checks > 5; };
+    int steps_done = -1;
+    move.on_complete = [&](int steps) { steps_done = steps; };
+    scheduler.Enqueue(0, move);
+    auto changes = Run(scheduler);
+    CHECK(steps_done == 5, "stop_condition: steps_done %d", steps_done);
+    CHECK(changes.size() == 5 * 4 + 1, "stop_condition: %zu changes", changes.size());
+    CHECK(scheduler.IsIdle(), "stop_condition: not idle");
+}
+
+static void TestStop() {
+    StepperScheduler scheduler(1);
+    StepperScheduler::Move move;
+    move.steps = 20;
+    int steps_done = -1;
+    move.on_complete = [&](int steps) { steps_done = steps; };
+    bool queued_ran = false;
+    StepperScheduler::Move queued;
+    queued.steps = 5;
+    queued.on_complete = [&](int) { queued_ran = true; };
+    scheduler.Enqueue(0, move);
+    scheduler.Enqueue(0, queued);
+
+    // Stop halfway through the third step
+    uint8_t output;
+    int64_t now = 0;
+    for (int phase = 0; phase < 10; phase++) {
+        now = scheduler.Poll(now, &output);
+    }
+    scheduler.Stop(0);
+    int64_t next = scheduler.Poll(now, &output);
+    CHECK(steps_done == 2, "Stop: steps_done %d", steps_done);
+    CHECK(output == 0, "Stop: coils left on: 0x%x", output);
+    CHECK(next == -1, "Stop: next poll at %lld", (long long)next);
+    CHECK(!queued_ran, "Stop: queued move still ran");
+    CHECK(scheduler.IsIdle(), "Stop: not idle");
+}
+
+static void TestLatePoll() {
+    StepperScheduler scheduler(1);
+    StepperScheduler::Move move;
+    move.steps = 10;
+    move.start_speed = move.max_speed = 100;    // 10 ms per phase
+    scheduler.Enqueue(0, move);
+
+    uint8_t output;
+    int64_t due = scheduler.Poll(0, &output);
+    CHECK(output == 0x1 && due == 10000, "start: output 0x%x, next %lld", output, (long long)due);
+
+    // 55 ms late: one phase, then the schedule restarts from now instead of catching up
+    int64_t late = due + 55000;
+    int64_t next = scheduler.Poll(late, &output);
+    CHECK(output == 0x2, "late poll output 0x%x", output);
+    CHECK(next == late + 10000, "late poll next %lld, expected %lld", (long long)next, (long long)(late + 10000));
+    next = scheduler.Poll(late, &output);
+    CHECK(output == 0x2 && next == late + 10000, "repeated poll advanced to 0x%x", output);
+    CHECK(scheduler.GetStats().max_jitter_us == 55000, "max_jitter_us %lld", (long long)scheduler.GetStats().max_jitter_us);
+
+    // Slightly late polls keep the original grid
+    int64_t on_grid = next;
+    next = scheduler.Poll(on_grid + 300, &output);
+    CHECK(output == 0x4 && next == on_grid + 10000, "small delay: output 0x%x, next %lld", output, (long long)next);
+}
+
+static void TestEmptyMove() {
+    StepperScheduler scheduler(1);
+    StepperScheduler::Move move;
+    int steps_done = -1;
+    move.on_complete = [&](int steps) { steps_done = steps; };
+    scheduler.Enqueue(0, move);
+    uint8_t output;
+    int64_t next = scheduler.Poll(0, &output);
+    CHECK(steps_done == 0 && next == -1 && output == 0, "empty move: steps_done %d, next %lld", steps_done, (long long)next);
+}
+
+int main() {
+    TestTrapezoid();
+    TestTwoAxes();
+    TestStopCondition();
+    TestStop();
+    TestLatePoll();
+    TestEmptyMove();
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
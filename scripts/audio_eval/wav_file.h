@@ -0,0 +1,48 @@
+#ifndef WAV_FILE_H
+#define WAV_FILE_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Reads the first channel of a 16-bit PCM WAV file
+inline bool ReadWav(const std::string& path, std::vector<int16_t>& samples, int& sample_rate) {
+    std::ifstream file(path, std::ios::binary);
+    char riff[12];
+    if (!file.read(riff, sizeof(riff)) || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+    uint16_t format = 0, channels = 0, bits = 0;
+    uint32_t rate = 0;
+    char id[4];
+    uint32_t size;
+    while (file.read(id, 4) && file.read(reinterpret_cast<char*>(&size), 4)) {
+        if (memcmp(id, "fmt ", 4) == 0) {
+            std::vector<char> fmt(size);
+            file.read(fmt.data(), size);
+            memcpy(&format, &fmt[0], 2);
+            memcpy(&channels, &fmt[2], 2);
+            memcpy(&rate, &fmt[4], 4);
+            memcpy(&bits, &fmt[14], 2);
+        } else if (memcmp(id, "data", 4) == 0) {
+            if (format != 1 || bits != 16 || channels == 0) {
+                return false;
+            }
+            std::vector<int16_t> interleaved(size / 2);
+            file.read(reinterpret_cast<char*>(interleaved.data()), size);
+            samples.resize(interleaved.size() / channels);
+            for (size_t i = 0; i < samples.size(); i++) {
+                samples[i] = interleaved[i * channels];
+            }
+            sample_rate = rate;
+            return true;
+        } else {
+            file.seekg(size + (size & 1), std::ios::cur);
+        }
+    }
+    return false;
+}
+
+#endif
@@ -13,10 +13,11 @@ HEADER_TEMPLATE = """// Auto-generated language config
 #endif
 
 namespace Lang {{
-    // 语言元数据
-    constexpr const char* CODE = "{lang_code}";
+    // 语言元数据（加载语言包后指向语言包中的代码）
+    constexpr const char* BUILTIN_CODE = "{lang_code}";
+    inline const char* CODE = BUILTIN_CODE;
 
-    // 字符串资源
+    // 字符串资源，加载语言包时替换为语言包中的字符串
     namespace Strings {{
 {strings}
     }}
@@ -25,6 +26,24 @@ namespace Lang {{
     namespace Sounds {{
 {sounds}
     }}
+
+    // 供语言包按名称查找的资源表
+    struct StringEntry {{
+        const char* key;
+        const char** value;
+        const char* builtin;
+    }};
+    inline const StringEntry STRING_TABLE[] = {{
+{string_table}
+    }};
+
+    struct SoundEntry {{
+        const char* name;
+        const char* data;   // 与Sounds::P3_*的data()相同
+    }};
+    inline const SoundEntry SOUND_TABLE[] = {{
+{sound_table}
+    }};
 }}
 """
 
@@ -41,14 +60,18 @@ def generate_header(input_path, output_path):
     # 生成字符串常量
     strings = []
     sounds = []
+    string_table = []
+    sound_table = []
     for key, value in data['strings'].items():
         value = value.replace('"', '\\"')
-        strings.append(f'        constexpr const char* {key.upper()} = "{value}";')
+        strings.append(f'        inline const char* {key.upper()} = "{value}";')
+        string_table.append(f'        {{"{key.upper()}", &Strings::{key.upper()}, "{value}"}},')
 
     # 生成音效常量
     for file in os.listdir(os.path.dirname(input_path)):
         if file.endswith('.p3'):
             base_name = os.path.splitext(file)[0]
+            sound_table.append(f'        {{"{base_name}", Sounds::p3_{base_name}_start}},')
             sounds.append(f'''
         extern const char p3_{base_name}_start[] asm("_binary_{base_name}_p3_start");
         extern const char p3_{base_name}_end[] asm("_binary_{base_name}_p3_end");
@@ -61,6 +84,7 @@ def generate_header(input_path, output_path):
     for file in os.listdir(os.path.join(os.path.dirname(output_path), 'common')):
         if file.endswith('.p3'):
             base_name = os.path.splitext(file)[0]
+            sound_table.append(f'        {{"{base_name}", Sounds::p3_{base_name}_start}},')
             sounds.append(f'''
         extern const char p3_{base_name}_start[] asm("_binary_{base_name}_p3_start");
         extern const char p3_{base_name}_end[] asm("_binary_{base_name}_p3_end");
@@ -74,7 +98,9 @@ def generate_header(input_path, output_path):
         lang_code=lang_code,
         lang_code_for_font=lang_code.replace('-', '_').lower(),
         strings="\n".join(sorted(strings)),
-        sounds="\n".join(sorted(sounds))
+        sounds="\n".join(sorted(sounds)),
+        string_table="\n".join(sorted(string_table)),
+        sound_table="\n".join(sorted(sound_table))
     )
 
     # 写入文件
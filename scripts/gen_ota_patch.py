@@ -0,0 +1,184 @@
+#! /usr/bin/env python3
+"""
+Generate a delta OTA patch between two application images.
+
+The output is the streaming format applied on the device by OtaPatcher
+(main/ota_patch.cc): the bsdiff control, diff and extra streams interleaved
+per record, with the mostly-zero diff bytes run-length encoded.
+
+Usage:
+    pip install bsdiff4
+    python scripts/gen_ota_patch.py old/xiaozhi.bin new/xiaozhi.bin -o 1.7.3-1.7.4.patch
+
+The header carries the digest of the old image, as esp_partition_get_sha256()
+reports it on the device, and the SHA-256 of the new image file. The device
+refuses a patch made from another build and verifies the new image before
+booting it. The printed sha256 of the new image can also be served as
+firmware.sha256 in the version check response.
+"""
+import argparse
+import hashlib
+import struct
+import sys
+import time
+
+import bsdiff4.core
+
+PATCH_MAGIC = b"XZP2"
+HEADER_SIZE = 12 + 32 + 32
+# Zero runs shorter than this are cheaper to keep inside the literal
+MIN_ZERO_RUN = 3
+
+
+def write_varint(out, value):
+    while True:
+        byte = value & 0x7f
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7f) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def encode_add(out, diff):
+    """Encode diff bytes as (zero_run, literal_len, literal) groups."""
+    pos = 0
+    size = len(diff)
+    while pos < size:
+        start = pos
+        while pos < size and diff[pos] == 0:
+            pos += 1
+        zero_run = pos - start
+
+        literal_start = pos
+        while pos < size:
+            if diff[pos] == 0:
+                end = pos
+                while end < size and diff[end] == 0:
+                    end += 1
+                if end - pos >= MIN_ZERO_RUN or end == size:
+                    break
+                pos = end
+            else:
+                pos += 1
+        write_varint(out, zero_run)
+        write_varint(out, pos - literal_start)
+        out += diff[literal_start:pos]
+
+
+def image_sha256(image):
+    """Digest of an app image as returned by esp_partition_get_sha256()."""
+    # With hash_appended set in the image header the device reports the
+    # appended SHA-256, which covers everything before it
+    if len(image) > 24 + 32 and image[23] == 1 and hashlib.sha256(image[:-32]).digest() == image[-32:]:
+        return image[-32:]
+    return hashlib.sha256(image).digest()
+
+
+def make_patch(old, new):
+    control, diff, extra = bsdiff4.core.diff(old, new)
+    out = bytearray(PATCH_MAGIC)
+    out += struct.pack("<II", len(old), len(new))
+    out += image_sha256(old)
+    out += hashlib.sha256(new).digest()
+    diff_pos = 0
+    extra_pos = 0
+    for add_len, extra_len, seek in control:
+        write_varint(out, add_len)
+        write_varint(out, extra_len)
+        write_varint(out, zigzag(seek))
+        encode_add(out, diff[diff_pos:diff_pos + add_len])
+        out += extra[extra_pos:extra_pos + extra_len]
+        diff_pos += add_len
+        extra_pos += extra_len
+    return bytes(out)
+
+
+def apply_patch(old, patch):
+    """Reference implementation of OtaPatcher, used to verify the output."""
+    if patch[:4] != PATCH_MAGIC:
+        raise ValueError("Invalid patch magic")
+    base_size, target_size = struct.unpack("<II", patch[4:12])
+    if base_size != len(old) or patch[12:44] != image_sha256(old):
+        raise ValueError("Patch was not made from this image")
+    pos = HEADER_SIZE
+    old_pos = 0
+    new = bytearray()
+    while len(new) < target_size:
+        add_len, pos = read_varint(patch, pos)
+        extra_len, pos = read_varint(patch, pos)
+        seek, pos = read_varint(patch, pos)
+        remaining = add_len
+        while remaining > 0:
+            zero_run, pos = read_varint(patch, pos)
+            new += old[old_pos:old_pos + zero_run]
+            old_pos += zero_run
+            literal_len, pos = read_varint(patch, pos)
+            for i in range(literal_len):
+                new.append((old[old_pos] + patch[pos + i]) & 0xff)
+                old_pos += 1
+            pos += literal_len
+            remaining -= zero_run + literal_len
+        new += patch[pos:pos + extra_len]
+        pos += extra_len
+        old_pos += unzigzag(seek)
+    if hashlib.sha256(new).digest() != patch[44:HEADER_SIZE]:
+        raise ValueError("Target SHA-256 mismatch")
+    return bytes(new)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate a delta OTA patch")
+    parser.add_argument("old", help="Application image currently running on the device")
+    parser.add_argument("new", help="Application image to upgrade to")
+    parser.add_argument("-o", "--output", required=True, help="Output patch file")
+    parser.add_argument("--no-verify", action="store_true", help="Skip applying the patch after generation")
+    args = parser.parse_args()
+
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.new, "rb") as f:
+        new = f.read()
+
+    start = time.time()
+    patch = make_patch(old, new)
+    elapsed = time.time() - start
+    with open(args.output, "wb") as f:
+        f.write(patch)
+
+    print(f"Old image:  {len(old)} bytes, device sha256 {image_sha256(old).hex()}")
+    print(f"New image:  {len(new)} bytes, sha256 {hashlib.sha256(new).hexdigest()}")
+    print(f"Patch:      {len(patch)} bytes ({len(patch) * 100 / len(new):.1f}% of full image), generated in {elapsed:.1f}s")
+
+    if not args.no_verify:
+        start = time.time()
+        if apply_patch(old, patch) != new:
+            print("Patch verification failed", file=sys.stderr)
+            sys.exit(1)
+        elapsed = time.time() - start
+        print(f"Verified:   applied in {elapsed:.1f}s ({len(new) / 1024 / max(elapsed, 1e-6):.0f} KB/s in Python)")
+
+
+if __name__ == "__main__":
+    main()
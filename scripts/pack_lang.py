@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+import argparse
+import json
+import os
+import struct
+
+'''
+  Pack language.json strings and P3 clips of one or more languages into an image
+  that main/language_pack.cc can load at runtime, either from the `lang` data
+  partition or from /sdcard/lang.bin.
+
+  Image layout (little endian, offsets from the start of the image):
+    directory:  'LPKD' u16 version u16 count, then count x {char code[8], u32 offset, u32 size}
+  Each pack (offsets from the start of the pack):
+    header:     'LPK1' u16 string_count u16 sound_count u32 pool_size
+    strings:    string_count x {u32 key, u32 value}       pool offsets, sorted by key
+    sounds:     sound_count x {u32 name, u32 offset, u32 size}   name in pool, sorted by name
+    pool:       NUL terminated UTF-8 strings
+    data:       P3 clips, 4-byte aligned
+'''
+
+DIRECTORY = struct.Struct('<4sHH')
+DIRECTORY_ENTRY = struct.Struct('<8sII')
+PACK_HEADER = struct.Struct('<4sHHI')
+STRING_ENTRY = struct.Struct('<II')
+SOUND_ENTRY = struct.Struct('<III')
+VERSION = 1
+
+
+def align(data, alignment=4):
+    return data + b'\x00' * (-len(data) % alignment)
+
+
+def build_pack(lang_dir, common_dir):
+    with open(os.path.join(lang_dir, 'language.json'), 'r', encoding='utf-8') as f:
+        data = json.load(f)
+    code = data['language']['type']
+
+    strings = sorted((key.upper(), value) for key, value in data['strings'].items())
+    clips = {}
+    for directory in ([common_dir] if common_dir else []) + [lang_dir]:
+        for file in os.listdir(directory):
+            if file.endswith('.p3'):
+                with open(os.path.join(directory, file), 'rb') as f:
+                    clips[os.path.splitext(file)[0]] = f.read()
+    sounds = sorted(clips.items())
+
+    pool = bytearray()
+    offsets = {}
+
+    def intern(text):
+        if text not in offsets:
+            offsets[text] = len(pool)
+            pool.extend(text.encode('utf-8') + b'\x00')
+        return offsets[text]
+
+    string_index = b''.join(STRING_ENTRY.pack(intern(key), intern(value)) for key, value in strings)
+    sound_names = [intern(name) for name, _ in sounds]
+    pool = align(bytes(pool))
+
+    data_offset = PACK_HEADER.size + len(string_index) + SOUND_ENTRY.size * len(sounds) + len(pool)
+    sound_index = b''
+    sound_data = b''
+    for name_offset, (name, clip) in zip(sound_names, sounds):
+        sound_index += SOUND_ENTRY.pack(name_offset, data_offset + len(sound_data), len(clip))
+        sound_data += align(clip)
+
+    header = PACK_HEADER.pack(b'LPK1', len(strings), len(sounds), len(pool))
+    pack = header + string_index + sound_index + pool + sound_data
+    footprint = {
+        'code': code,
+        'strings': len(strings),
+        'sounds': len(sounds),
+        'index': len(header) + len(string_index) + len(sound_index),
+        'pool': len(pool),
+        'clips': len(sound_data),
+        'total': len(pack),
+    }
+    return code, pack, footprint
+
+
+def main(lang_dirs, common_dir, output):
+    packs = [build_pack(d, common_dir) for d in lang_dirs]
+
+    image = bytearray(DIRECTORY.pack(b'LPKD', VERSION, len(packs)))
+    offset = len(image) + DIRECTORY_ENTRY.size * len(packs)
+    for code, pack, _ in packs:
+        image += DIRECTORY_ENTRY.pack(code.encode('ascii'), offset, len(pack))
+        offset += len(pack)
+    for _, pack, _ in packs:
+        image += pack
+
+    with open(output, 'wb') as f:
+        f.write(image)
+
+    # 设备加载时常驻内存的是索引和字符串池，音效按需读取到LRU缓存
+    print(f"{'language':<10}{'strings':>8}{'sounds':>8}{'index':>8}{'pool':>8}{'clips':>9}{'resident':>10}{'total':>9}")
+    for _, _, fp in packs:
+        print(f"{fp['code']:<10}{fp['strings']:>8}{fp['sounds']:>8}{fp['index']:>8}{fp['pool']:>8}"
+              f"{fp['clips']:>9}{fp['index'] + fp['pool']:>10}{fp['total']:>9}")
+    print(f"Wrote {len(packs)} language packs, {len(image)} bytes to {output}")
+
+
+if __name__ == "__main__":
+    assets_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'main', 'assets')
+    parser = argparse.ArgumentParser(description='打包语言包（字符串和P3音效），用于写入lang分区或复制到SD卡')
+    parser.add_argument('languages', nargs='*',
+                        help='语言目录，默认为main/assets下除common外的所有目录')
+    parser.add_argument('--output', '-o', default='lang.bin',
+                        help='输出文件 (默认: lang.bin)')
+    parser.add_argument('--no-common', action='store_true',
+                        help='不打包公共音效，使用固件内置的版本')
+    args = parser.parse_args()
+
+    lang_dirs = args.languages or sorted(
+        os.path.join(assets_dir, d) for d in os.listdir(assets_dir)
+        if d != 'common' and os.path.isfile(os.path.join(assets_dir, d, 'language.json')))
+    common_dir = None if args.no_common else os.path.join(assets_dir, 'common')
+    main(lang_dirs, common_dir, args.output)
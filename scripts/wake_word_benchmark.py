@@ -0,0 +1,285 @@
+import socket
+import struct
+import wave
+import argparse
+import json
+import os
+import csv
+import time
+from array import array
+
+
+'''
+  Stream a labeled WAV corpus to a device built with CONFIG_USE_WAKE_WORD_BENCHMARK
+  and measure its wake word detection (see main/audio_processing/wake_word_benchmark.h).
+
+  Corpus layout:
+    positive/*.wav     clips that contain a wake word
+    negative/*.wav     clips that must not trigger
+    labels.csv         optional: path,start,end in seconds, the wake word position in a positive clip
+
+  Clips must be 16 kHz 16-bit; the first channel is fed to every microphone channel
+  of the device input layout and the reference channels stay silent. Each threshold
+  is one pass over the corpus, giving one ROC point, and the report is written as
+  JSON so runs can be compared across builds with --compare.
+'''
+
+HEADER = struct.Struct('<IB3xI')
+INFO = struct.Struct('<HBBI8s32s32s')
+ACK = struct.Struct('<IIII32s')
+MAGIC = 0x42575757
+START, INFO_TYPE, AUDIO, ACK_TYPE = 1, 2, 3, 4
+MAX_SAMPLES = 640
+# A detection this long before the labeled start of the wake word is still counted as correct
+EARLY_TOLERANCE_S = 0.5
+
+
+class Device:
+    def __init__(self, address, timeout, retries):
+        host, port = address.rsplit(':', 1)
+        self.address = (host, int(port))
+        self.socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.socket.settimeout(timeout)
+        self.retries = retries
+        self.sequence = 0
+        self.resends = 0
+
+    def request(self, packet_type, payload, reply_type):
+        self.sequence += 1
+        packet = HEADER.pack(MAGIC, packet_type, self.sequence) + payload
+        for _ in range(self.retries):
+            self.socket.sendto(packet, self.address)
+            try:
+                while True:
+                    reply, _ = self.socket.recvfrom(2048)
+                    magic, rtype, sequence = HEADER.unpack_from(reply)
+                    if magic == MAGIC and rtype == reply_type and sequence == self.sequence:
+                        return reply[HEADER.size:]
+            except socket.timeout:
+                self.resends += 1
+        raise RuntimeError(f"No reply from {self.address[0]}:{self.address[1]}")
+
+    def start(self, threshold):
+        feed_samples, channels, threshold_set, sample_rate, input_format, model, version = \
+            INFO.unpack_from(self.request(START, struct.pack('<f', threshold), INFO_TYPE))
+        decode = lambda b: b.split(b'\x00', 1)[0].decode('utf-8', 'replace')
+        return {
+            'feed_samples': feed_samples,
+            'channels': channels,
+            'threshold_set': bool(threshold_set),
+            'sample_rate': sample_rate,
+            'input_format': decode(input_format),
+            'model': decode(model),
+            'version': decode(version),
+        }
+
+    def feed(self, samples):
+        frames, feed_us, detections, detection_sample, wake_word = \
+            ACK.unpack_from(self.request(AUDIO, samples.tobytes(), ACK_TYPE))
+        return frames, feed_us, detections, detection_sample, wake_word.split(b'\x00', 1)[0].decode('utf-8', 'replace')
+
+
+def read_wav(path):
+    with wave.open(path, 'rb') as wav:
+        if wav.getsampwidth() != 2 or wav.getframerate() != 16000:
+            raise ValueError(f"{path}: expected 16 kHz 16-bit audio")
+        channels = wav.getnchannels()
+        data = array('h', wav.readframes(wav.getnframes()))
+    return data[::channels]
+
+
+def load_corpus(corpus_dir):
+    labels = {}
+    labels_path = os.path.join(corpus_dir, 'labels.csv')
+    if os.path.exists(labels_path):
+        with open(labels_path, newline='') as f:
+            for row in csv.reader(f):
+                if len(row) >= 3 and not row[0].startswith('#'):
+                    labels[os.path.normpath(row[0])] = (float(row[1]), float(row[2]))
+
+    clips = []
+    for kind in ('positive', 'negative'):
+        directory = os.path.join(corpus_dir, kind)
+        if not os.path.isdir(directory):
+            continue
+        for name in sorted(os.listdir(directory)):
+            if name.lower().endswith('.wav'):
+                relative = os.path.normpath(os.path.join(kind, name))
+                clips.append({'path': relative, 'positive': kind == 'positive',
+                              'label': labels.get(relative), 'audio': read_wav(os.path.join(corpus_dir, relative))})
+    return clips
+
+
+def interleave(mono, input_format):
+    silence = array('h', bytes(len(mono) * 2))
+    tracks = [mono if role == 'M' else silence for role in input_format]
+    out = array('h', bytes(len(mono) * len(tracks) * 2))
+    for i, track in enumerate(tracks):
+        out[i::len(tracks)] = track
+    return out
+
+
+def run_clip(device, clip, threshold, tail_s, speed):
+    info = device.start(threshold)
+    channels = info['channels']
+    input_format = info['input_format'] if len(info['input_format']) == channels else 'M' * channels
+    mono = clip['audio'] + array('h', bytes(int(tail_s * 16000) * 2))
+    pcm = interleave(mono, input_format)
+
+    step = MAX_SAMPLES // channels * channels
+    frame_times = []
+    detections = []
+    last_frames = last_detections = 0
+    start_time = time.monotonic()
+    for offset in range(0, len(pcm), step):
+        if speed > 0:
+            # Keep the device close to real time so the AFE ring buffer does not overflow
+            ahead = offset / channels / 16000 / speed - (time.monotonic() - start_time)
+            if ahead > 0:
+                time.sleep(ahead)
+        frames, feed_us, count, sample, wake_word = device.feed(pcm[offset:offset + step])
+        if frames > last_frames and feed_us > 0:
+            frame_times += [feed_us / (frames - last_frames)] * (frames - last_frames)
+        last_frames = frames
+        if count > last_detections:
+            detections.append({'time': sample / 16000, 'wake_word': wake_word})
+            last_detections = count
+    return info, frame_times, detections
+
+
+def percentiles(values):
+    if not values:
+        return None
+    values = sorted(values)
+    pick = lambda p: values[min(len(values) - 1, int(p * len(values)))]
+    return {'p50': pick(0.5), 'p90': pick(0.9), 'p99': pick(0.99), 'max': values[-1],
+            'mean': sum(values) / len(values), 'count': len(values)}
+
+
+def run_threshold(device, clips, threshold, tail_s, speed):
+    frame_times = []
+    latencies = []
+    missed = []
+    false_accepts = []
+    negative_seconds = 0
+    info = None
+    for clip in clips:
+        info, times, detections = run_clip(device, clip, threshold, tail_s, speed)
+        frame_times += times
+        duration = len(clip['audio']) / 16000
+        if clip['positive']:
+            start, end = clip['label'] or (0, duration)
+            hits = [d for d in detections if d['time'] >= start - EARLY_TOLERANCE_S]
+            if hits:
+                latencies.append((hits[0]['time'] - end) * 1000)
+            else:
+                missed.append(clip['path'])
+        else:
+            negative_seconds += duration + tail_s
+            false_accepts += [{'path': clip['path'], **d} for d in detections]
+        print(f"  {clip['path']}: {len(detections)} detections")
+
+    positives = sum(1 for c in clips if c['positive'])
+    chunk_ms = info['feed_samples'] / 16000 * 1000 if info and info['feed_samples'] else 0
+    frame_stats = percentiles(frame_times)
+    return info, {
+        'threshold': threshold,
+        'threshold_applied': info['threshold_set'] if info else False,
+        'positives': positives,
+        'detected': positives - len(missed),
+        'false_reject_rate': len(missed) / positives if positives else None,
+        'negative_hours': negative_seconds / 3600,
+        'false_accepts': len(false_accepts),
+        'false_accepts_per_hour': len(false_accepts) / (negative_seconds / 3600) if negative_seconds else None,
+        'latency_ms': percentiles(latencies),
+        'frame_us': frame_stats,
+        'cpu_load': frame_stats['mean'] / (chunk_ms * 1000) if frame_stats and chunk_ms else None,
+        'missed': missed,
+        'false_accept_events': false_accepts,
+    }
+
+
+def compare(report, baseline_path):
+    with open(baseline_path, 'r', encoding='utf-8') as f:
+        baseline = json.load(f)
+    old_runs = {run['threshold']: run for run in baseline.get('runs', [])}
+    print(f"Compared with {baseline_path} ({baseline['device'].get('version')} -> {report['device'].get('version')}):")
+
+    def delta(new, old, key, sub=None):
+        a, b = new.get(key), old.get(key)
+        if sub:
+            a, b = a and a.get(sub), b and b.get(sub)
+        return f"{b:.3g} -> {a:.3g}" if a is not None and b is not None else "n/a"
+
+    for run in report['runs']:
+        old = old_runs.get(run['threshold'])
+        if old is None:
+            continue
+        print(f"  threshold {run['threshold']}: FRR {delta(run, old, 'false_reject_rate')}, "
+              f"FA/h {delta(run, old, 'false_accepts_per_hour')}, "
+              f"latency p50 {delta(run, old, 'latency_ms', 'p50')} ms, "
+              f"frame p50 {delta(run, old, 'frame_us', 'p50')} us")
+
+
+def main():
+    parser = argparse.ArgumentParser(description='唤醒词基准测试：向设备发送标注过的语料，统计误唤醒/漏唤醒、ROC曲线、检测延迟和每帧耗时')
+    parser.add_argument('--device', '-d', required=True,
+                        help='设备地址，格式 IP:PORT (端口见 CONFIG_WAKE_WORD_BENCHMARK_PORT，默认8100)')
+    parser.add_argument('--corpus', '-c', required=True,
+                        help='语料目录，包含 positive/ negative/ 和可选的 labels.csv')
+    parser.add_argument('--thresholds', '-t', default='0',
+                        help='逗号分隔的检测阈值，0 表示模型默认值 (默认: 0)')
+    parser.add_argument('--output', '-o', default='wake_word_report.json',
+                        help='JSON报告输出路径 (默认: wake_word_report.json)')
+    parser.add_argument('--compare', help='与之前的JSON报告对比')
+    parser.add_argument('--tail', type=float, default=1.0,
+                        help='每段语料后追加的静音秒数，让检测结果输出 (默认: 1.0)')
+    parser.add_argument('--speed', type=float, default=1.0,
+                        help='相对实时的发送速度，0 表示不限速 (默认: 1.0)')
+    parser.add_argument('--timeout', type=float, default=0.5, help='等待回复的超时秒数')
+    args = parser.parse_args()
+
+    clips = load_corpus(args.corpus)
+    if not clips:
+        raise SystemExit(f"No clips found in {args.corpus}")
+    device = Device(args.device, args.timeout, retries=10)
+
+    report = {'device': None, 'corpus': {
+        'path': os.path.abspath(args.corpus),
+        'positives': sum(1 for c in clips if c['positive']),
+        'negatives': sum(1 for c in clips if not c['positive']),
+    }, 'runs': []}
+    for threshold in (float(t) for t in args.thresholds.split(',')):
+        print(f"Threshold {threshold or 'default'}:")
+        info, run = run_threshold(device, clips, threshold, args.tail, args.speed)
+        report['device'] = info
+        report['runs'].append(run)
+        if threshold > 0 and not run['threshold_applied']:
+            print("  Warning: the device did not accept the threshold")
+    report['roc'] = [{'threshold': r['threshold'], 'false_reject_rate': r['false_reject_rate'],
+                      'false_accepts_per_hour': r['false_accepts_per_hour']} for r in report['runs']]
+    report['resends'] = device.resends
+
+    with open(args.output, 'w', encoding='utf-8') as f:
+        json.dump(report, f, indent=2, ensure_ascii=False)
+
+    info = report['device']
+    print(f"\nModel {info['model']}, firmware {info['version']}, input {info['input_format']}, "
+          f"chunk {info['feed_samples']} samples")
+    print(f"{'threshold':>10}{'FRR':>8}{'FA/h':>8}{'lat p50':>9}{'lat p90':>9}{'frame p50':>11}{'frame p99':>11}{'cpu':>7}")
+    fmt = lambda v, spec: format(v, spec) if v is not None else 'n/a'
+    for r in report['runs']:
+        lat = r['latency_ms'] or {}
+        frame = r['frame_us'] or {}
+        print(f"{r['threshold'] or 'default':>10}{fmt(r['false_reject_rate'], '.3f'):>8}"
+              f"{fmt(r['false_accepts_per_hour'], '.2f'):>8}{fmt(lat.get('p50'), '.0f'):>9}"
+              f"{fmt(lat.get('p90'), '.0f'):>9}{fmt(frame.get('p50'), '.0f'):>11}"
+              f"{fmt(frame.get('p99'), '.0f'):>11}{fmt(r['cpu_load'], '.1%'):>7}")
+    print(f"Report saved to {args.output}")
+
+    if args.compare:
+        compare(report, args.compare)
+
+
+if __name__ == "__main__":
+    main()